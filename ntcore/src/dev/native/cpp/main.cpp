@@ -8,18 +8,29 @@
 #include <cmath>
 #include <cstdlib>
 #include <numeric>
+#include <mutex>
 #include <random>
 #include <string_view>
 #include <thread>
 
 #include <fmt/format.h>
+#include <wpi/Logger.h>
 #include <wpi/Synchronization.h>
+#include <wpi/json.h>
+#include <wpi/raw_ostream.h>
 
+#include "net/ServerImpl.h"
+#include "net/WireDecoder.h"
+#include "net/WireEncoder.h"
 #include "ntcore.h"
 #include "ntcore_cpp.h"
 
 void bench();
 void bench2();
+void benchJson();
+void benchWire();
+void benchPersistent();
+void latency();
 void stress();
 
 int main(int argc, char* argv[]) {
@@ -31,6 +42,22 @@ int main(int argc, char* argv[]) {
     bench2();
     return EXIT_SUCCESS;
   }
+  if (argc == 2 && std::string_view{argv[1]} == "benchjson") {
+    benchJson();
+    return EXIT_SUCCESS;
+  }
+  if (argc == 2 && std::string_view{argv[1]} == "benchwire") {
+    benchWire();
+    return EXIT_SUCCESS;
+  }
+  if (argc == 2 && std::string_view{argv[1]} == "benchpersistent") {
+    benchPersistent();
+    return EXIT_SUCCESS;
+  }
+  if (argc == 2 && std::string_view{argv[1]} == "latency") {
+    latency();
+    return EXIT_SUCCESS;
+  }
   if (argc == 2 && std::string_view{argv[1]} == "stress") {
     stress();
     return EXIT_SUCCESS;
@@ -193,6 +220,250 @@ void bench2() {
   PrintTimes(flushTimes);
 }
 
+// end-to-end latency benchmark: values set at irregular intervals on the
+// server, measured when the client listener receives them
+static void LatencyRun(bool lowLatency) {
+  auto client = nt::CreateInstance();
+  auto server = nt::CreateInstance();
+  nt::SetLowLatencyFlush(server, lowLatency);
+  nt::SetLowLatencyFlush(client, lowLatency);
+
+  nt::StartServer(server, "latency.json", "127.0.0.1", 0, 10002);
+  nt::StartClient4(client, "client");
+  nt::SetServer(client, "127.0.0.1", 10002);
+
+  using namespace std::chrono_literals;
+  std::this_thread::sleep_for(1s);
+
+  // the value is the time it was set
+  std::mutex timesMutex;
+  std::vector<int64_t> times;
+  times.reserve(1001);
+  auto sub = nt::Subscribe(nt::GetTopic(client, "latency"), NT_DOUBLE,
+                           "double", {});
+  nt::AddListener(sub, nt::EventFlags::kValueRemote, [&](auto& event) {
+    if (auto valueData = event.GetValueEventData()) {
+      int64_t now = nt::Now();
+      std::scoped_lock lock{timesMutex};
+      times.emplace_back(now - static_cast<int64_t>(
+                                   valueData->value.GetDouble()));
+    }
+  });
+  auto pub =
+      nt::Publish(nt::GetTopic(server, "latency"), NT_DOUBLE, "double", {});
+  std::this_thread::sleep_for(0.5s);
+
+  std::uniform_int_distribution<int> sleepDist{5, 15};
+  std::mt19937 sleepGen{1};
+  {
+    std::scoped_lock lock{timesMutex};
+    times.clear();
+  }
+  for (int i = 0; i < 1000; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{sleepDist(sleepGen)});
+    nt::SetDouble(pub, nt::Now());
+  }
+  std::this_thread::sleep_for(0.5s);
+
+  nt::DestroyInstance(client);
+  nt::DestroyInstance(server);
+
+  fmt::print("-- {} --\n", lowLatency ? "low latency" : "default");
+  PrintTimes(times);
+}
+
+void latency() {
+  LatencyRun(false);
+  LatencyRun(true);
+}
+
+namespace {
+class NullServerMessageHandler final : public nt::net::ServerMessageHandler {
+ public:
+  void ServerAnnounce(std::string_view name, int64_t id,
+                      std::string_view typeStr, const wpi::json& properties,
+                      std::optional<int64_t> pubuid) final {
+    count += id;
+  }
+  void ServerUnannounce(std::string_view name, int64_t id) final {}
+  void ServerPropertiesUpdate(std::string_view name, const wpi::json& update,
+                              bool ack) final {}
+
+  int64_t count = 0;
+};
+}  // namespace
+
+// text frame decode benchmark: streaming decoder vs. DOM parse
+void benchJson() {
+  // a ~4 KB announce batch, as sent to a newly subscribed client
+  std::string frame = "[";
+  for (int i = 0; i < 32; ++i) {
+    if (i != 0) {
+      frame += ',';
+    }
+    frame += fmt::format(
+        "{{\"method\":\"announce\",\"params\":{{\"id\":{},\"name\":"
+        "\"/some/long/name/with/lots/of/slashes/{}\",\"properties\":{{"
+        "\"persistent\":true}},\"type\":\"double[]\"}}}}",
+        i, i);
+  }
+  frame += ']';
+
+  wpi::Logger logger;
+  NullServerMessageHandler handler;
+  constexpr int kIterations = 20000;
+
+  std::vector<int64_t> domTimes;
+  domTimes.reserve(kIterations);
+  std::vector<int64_t> saxTimes;
+  saxTimes.reserve(kIterations);
+
+  for (int i = 0; i < kIterations; ++i) {
+    int64_t start = nt::Now();
+    auto j = wpi::json::parse(frame);
+    int64_t mid = nt::Now();
+    nt::net::WireDecodeText(frame, handler, logger);
+    int64_t stop = nt::Now();
+    handler.count += j.size();
+    domTimes.emplace_back(mid - start);
+    saxTimes.emplace_back(stop - mid);
+  }
+
+  fmt::print("frame size: {} bytes ({})\n", frame.size(), handler.count);
+  fmt::print("-- DOM parse only --\n");
+  PrintTimes(domTimes);
+  fmt::print("-- WireDecodeText --\n");
+  PrintTimes(saxTimes);
+}
+
+// binary value encode/decode benchmark: fast path vs. mpack, over typical
+// double array sizes
+void benchWire() {
+  constexpr int kIterations = 100000;
+  using Clock = std::chrono::steady_clock;
+  auto nsPer = [](Clock::duration d) {
+    return std::chrono::duration<double, std::nano>(d).count() / kIterations;
+  };
+
+  for (size_t size : {1, 8, 50, 100, 200}) {
+    std::vector<double> arr(size);
+    for (size_t i = 0; i < size; ++i) {
+      arr[i] = i * 0.1;
+    }
+    auto value = nt::Value::MakeDoubleArray(std::move(arr));
+    std::vector<uint8_t> buf;
+    wpi::raw_uvector_ostream os{buf};
+
+    auto start = Clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+      buf.clear();
+      nt::net::WireEncodeBinaryMpack(os, 5, i, value);
+    }
+    auto mpackEncode = Clock::now() - start;
+
+    start = Clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+      buf.clear();
+      nt::net::WireEncodeBinary(os, 5, i, value);
+    }
+    auto fastEncode = Clock::now() - start;
+
+    int64_t id;
+    nt::Value out;
+    std::string error;
+    start = Clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+      std::span<const uint8_t> in = buf;
+      nt::net::WireDecodeBinaryMpack(&in, &id, &out, &error, 0);
+    }
+    auto mpackDecode = Clock::now() - start;
+
+    start = Clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+      std::span<const uint8_t> in = buf;
+      nt::net::WireDecodeBinary(&in, &id, &out, &error, 0);
+    }
+    auto fastDecode = Clock::now() - start;
+
+    fmt::print(
+        "double[{}] ({} bytes): encode {:.0f} ns (mpack {:.0f} ns), "
+        "decode {:.0f} ns (mpack {:.0f} ns)\n",
+        size, buf.size(), nsPer(fastEncode), nsPer(mpackEncode),
+        nsPer(fastDecode), nsPer(mpackDecode));
+  }
+}
+
+// persistent file load benchmark: full load vs. DOM parse only
+void benchPersistent() {
+  // 10k persistent entries of the common types
+  constexpr int kEntries = 10000;
+  std::string file = "[\n";
+  for (int i = 0; i < kEntries; ++i) {
+    if (i != 0) {
+      file += ",\n";
+    }
+    std::string_view type;
+    std::string value;
+    switch (i % 5) {
+      case 0:
+        type = "double";
+        value = fmt::format("{}.5", i);
+        break;
+      case 1:
+        type = "int";
+        value = fmt::format("{}", i);
+        break;
+      case 2:
+        type = "boolean";
+        value = i % 2 == 0 ? "true" : "false";
+        break;
+      case 3:
+        type = "string";
+        value = fmt::format("\"value {}\"", i);
+        break;
+      default:
+        type = "double[]";
+        value = "[1.0, 2.0, 3.0, 4.0]";
+        break;
+    }
+    file += fmt::format(
+        "  {{\n    \"name\": \"/Preferences/subsystem{}/constant{}\",\n"
+        "    \"type\": \"{}\",\n    \"value\": {},\n"
+        "    \"properties\": {{\n      \"persistent\": true\n    }}\n  }}",
+        i / 100, i, type, value);
+  }
+  file += "\n]\n";
+
+  wpi::Logger logger;
+  constexpr int kIterations = 20;
+
+  std::vector<int64_t> domTimes;
+  domTimes.reserve(kIterations);
+  std::vector<int64_t> loadTimes;
+  loadTimes.reserve(kIterations);
+
+  for (int i = 0; i < kIterations; ++i) {
+    nt::net::ServerImpl server{logger};
+    int64_t start = nt::Now();
+    auto j = wpi::json::parse(file);
+    int64_t mid = nt::Now();
+    auto errors = server.LoadPersistent(file);
+    int64_t stop = nt::Now();
+    if (!errors.empty() || j.size() != kEntries) {
+      fmt::print("load error: {}\n", errors);
+      return;
+    }
+    domTimes.emplace_back(mid - start);
+    loadTimes.emplace_back(stop - mid);
+  }
+
+  fmt::print("file size: {} bytes, {} entries\n", file.size(), kEntries);
+  fmt::print("-- DOM parse only --\n");
+  PrintTimes(domTimes);
+  fmt::print("-- LoadPersistent --\n");
+  PrintTimes(loadTimes);
+}
+
 static std::random_device r;
 static std::mt19937 gen(r());
 static std::uniform_real_distribution<double> dist;
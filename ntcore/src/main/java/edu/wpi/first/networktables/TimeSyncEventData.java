@@ -13,7 +13,10 @@ public final class TimeSyncEventData {
    */
   public final long serverTimeOffset;
 
-  /** Measured round trip time divided by 2, in microseconds. */
+  /**
+   * Measured round trip time divided by 2, in microseconds, of the ping the offset estimate is
+   * based on. This bounds the error of serverTimeOffset.
+   */
   public final long rtt2;
 
   /**
@@ -25,6 +25,7 @@ class INetworkClient {
 
   virtual void FlushLocal() = 0;
   virtual void Flush() = 0;
+  virtual void SetLowLatencyFlush(bool enabled) = 0;
 };
 
 }  // namespace nt
@@ -109,6 +109,9 @@ void InstanceImpl::StartServer(std::string_view persistFilename,
         std::scoped_lock lock{m_mutex};
         networkMode &= ~NT_NET_MODE_STARTING;
       });
+  if (m_lowLatencyFlush) {
+    m_networkServer->SetLowLatencyFlush(true);
+  }
   networkMode = NT_NET_MODE_SERVER | NT_NET_MODE_STARTING;
   listenerStorage.NotifyTimeSync({}, NT_EVENT_TIMESYNC, 0, 0, true);
   m_serverTimeOffset = 0;
@@ -140,6 +143,9 @@ void InstanceImpl::StartClient3(std::string_view identity) {
   if (!m_servers.empty()) {
     m_networkClient->SetServers(m_servers);
   }
+  if (m_lowLatencyFlush) {
+    m_networkClient->SetLowLatencyFlush(true);
+  }
   networkMode = NT_NET_MODE_CLIENT3;
 }
 
@@ -165,6 +171,9 @@ void InstanceImpl::StartClient4(std::string_view identity) {
   if (!m_servers.empty()) {
     m_networkClient->SetServers(m_servers);
   }
+  if (m_lowLatencyFlush) {
+    m_networkClient->SetLowLatencyFlush(true);
+  }
   networkMode = NT_NET_MODE_CLIENT4;
 }
 
@@ -196,6 +205,17 @@ void InstanceImpl::SetServers(
   }
 }
 
+void InstanceImpl::SetLowLatencyFlush(bool enabled) {
+  std::scoped_lock lock{m_mutex};
+  m_lowLatencyFlush = enabled;
+  if (m_networkServer) {
+    m_networkServer->SetLowLatencyFlush(enabled);
+  }
+  if (m_networkClient) {
+    m_networkClient->SetLowLatencyFlush(enabled);
+  }
+}
+
 std::shared_ptr<NetworkServer> InstanceImpl::GetServer() {
   std::scoped_lock lock{m_mutex};
   return m_networkServer;
@@ -5,6 +5,7 @@
 #include "LocalStorage.h"
 
 #include <algorithm>
+#include <cmath>
 
 #include <wpi/DataLog.h>
 #include <wpi/StringExtras.h>
@@ -57,18 +58,50 @@ struct SubscriberData;
 struct MultiSubscriberData;
 
 struct DataLoggerEntry {
-  DataLoggerEntry(wpi::log::DataLog& log, int entry, NT_DataLogger logger)
-      : log{&log}, entry{entry}, logger{logger} {}
+  DataLoggerEntry(wpi::log::DataLog& log, int entry, NT_DataLogger logger,
+                  const EntryDataLogOptions& options)
+      : log{&log}, entry{entry}, logger{logger} {
+    SetOptions(options);
+  }
 
   static std::string MakeMetadata(std::string_view properties) {
     return fmt::format("{{\"properties\":{},\"source\":\"NT\"}}", properties);
   }
 
+  // applies topic property overrides to the logger's options
+  static EntryDataLogOptions GetOptions(const EntryDataLogOptions& options,
+                                        const wpi::json& properties);
+
+  void SetOptions(const EntryDataLogOptions& options);
+
   void Append(const Value& v);
 
+  // logs the last value held back by the period, if any; called before the
+  // entry is finished.  Returns true if a value was logged.
+  bool Flush();
+
   wpi::log::DataLog* log;
   int entry;
   NT_DataLogger logger;
+
+  // sampling options; period is in microseconds
+  int64_t period{0};
+  double deadband{0};
+  bool keepDuplicates{true};
+  bool sampled{false};  // true if any of the above are non-default
+  Value lastValue;      // last logged value; only kept if sampled
+  Value pendingValue;   // latest value held back by period
+  // start of the current period; the time of the last logged value, or when
+  // a held back value would have been logged at the end of a period
+  int64_t periodStart{0};
+
+ private:
+  bool InPeriod(const Value& v) const {
+    return period != 0 && lastValue && lastValue.type() == v.type() &&
+           (v.time() - periodStart) < period;
+  }
+  bool ShouldAppend(const Value& v) const;
+  void Log(const Value& v);
 };
 
 struct TopicData {
@@ -237,8 +270,13 @@ struct DataLoggerData {
   static constexpr auto kType = Handle::kDataLogger;
 
   DataLoggerData(NT_DataLogger handle, wpi::log::DataLog& log,
-                 std::string_view prefix, std::string_view logPrefix)
-      : handle{handle}, log{log}, prefix{prefix}, logPrefix{logPrefix} {}
+                 std::string_view prefix, std::string_view logPrefix,
+                 const EntryDataLogOptions& options)
+      : handle{handle},
+        log{log},
+        prefix{prefix},
+        logPrefix{logPrefix},
+        options{options} {}
 
   int Start(TopicData* topic, int64_t time) {
     return log.Start(fmt::format("{}{}", logPrefix,
@@ -251,6 +289,7 @@ struct DataLoggerData {
   wpi::log::DataLog& log;
   std::string prefix;
   std::string logPrefix;
+  EntryDataLogOptions options;
 };
 
 struct LSImpl {
@@ -360,7 +399,122 @@ struct LSImpl {
 
 }  // namespace
 
+EntryDataLogOptions DataLoggerEntry::GetOptions(
+    const EntryDataLogOptions& options, const wpi::json& properties) {
+  EntryDataLogOptions rv = options;
+  auto it = properties.find("logPeriod");
+  if (it != properties.end() && it->is_number()) {
+    rv.period = it->get<double>();
+  }
+  it = properties.find("logDeadband");
+  if (it != properties.end() && it->is_number()) {
+    rv.deadband = it->get<double>();
+  }
+  it = properties.find("logDuplicates");
+  if (it != properties.end()) {
+    if (auto val = it->get_ptr<const bool*>()) {
+      rv.keepDuplicates = *val;
+    }
+  }
+  return rv;
+}
+
+void DataLoggerEntry::SetOptions(const EntryDataLogOptions& options) {
+  Flush();
+  period = options.period > 0 ? static_cast<int64_t>(options.period * 1e6) : 0;
+  deadband = options.deadband > 0 ? options.deadband : 0;
+  keepDuplicates = options.keepDuplicates;
+  sampled = period != 0 || deadband != 0 || !keepDuplicates;
+  if (!sampled) {
+    lastValue = {};
+  }
+}
+
+template <typename T>
+static bool ExceedsDeadband(std::span<const T> a, std::span<const T> b,
+                            double deadband) {
+  if (a.size() != b.size()) {
+    return true;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (std::abs(static_cast<double>(a[i]) - static_cast<double>(b[i])) >
+        deadband) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DataLoggerEntry::ShouldAppend(const Value& v) const {
+  if (!lastValue || lastValue.type() != v.type()) {
+    return true;
+  }
+  if (deadband != 0) {
+    switch (v.type()) {
+      case NT_INTEGER:
+        return std::abs(static_cast<double>(v.GetInteger()) -
+                        static_cast<double>(lastValue.GetInteger())) > deadband;
+      case NT_FLOAT:
+        return std::abs(static_cast<double>(v.GetFloat()) -
+                        lastValue.GetFloat()) > deadband;
+      case NT_DOUBLE:
+        return std::abs(v.GetDouble() - lastValue.GetDouble()) > deadband;
+      case NT_INTEGER_ARRAY:
+        return ExceedsDeadband(v.GetIntegerArray(),
+                               lastValue.GetIntegerArray(), deadband);
+      case NT_FLOAT_ARRAY:
+        return ExceedsDeadband(v.GetFloatArray(), lastValue.GetFloatArray(),
+                               deadband);
+      case NT_DOUBLE_ARRAY:
+        return ExceedsDeadband(v.GetDoubleArray(), lastValue.GetDoubleArray(),
+                               deadband);
+      default:
+        break;  // not numeric
+    }
+  }
+  return keepDuplicates || v != lastValue;
+}
+
 void DataLoggerEntry::Append(const Value& v) {
+  if (sampled) {
+    if (!InPeriod(v) && pendingValue) {
+      // the period has expired since a value was held back; log it as if at
+      // the end of that period, which starts a new period
+      int64_t end = periodStart + period;
+      if (Flush()) {
+        periodStart = end;
+      }
+    }
+    if (InPeriod(v)) {
+      // hold on to it so the final value of a burst is not lost
+      pendingValue = v;
+      return;
+    }
+    if (!ShouldAppend(v)) {
+      return;
+    }
+    lastValue = v;
+    periodStart = v.time();
+  }
+  Log(v);
+}
+
+bool DataLoggerEntry::Flush() {
+  if (!pendingValue) {
+    return false;
+  }
+  Value v = std::move(pendingValue);
+  pendingValue = {};
+  if (!ShouldAppend(v)) {
+    return false;
+  }
+  lastValue = v;
+  periodStart = v.time();
+  Log(v);
+  return true;
+}
+
+void DataLoggerEntry::Log(const Value& v) {
   auto time = v.time();
   switch (v.type()) {
     case NT_BOOLEAN:
@@ -456,12 +610,15 @@ void LSImpl::NotifyTopic(TopicData* topic, unsigned int eventFlags) {
                                  });
           if ((eventFlags & NT_EVENT_PUBLISH) != 0 &&
               it == topic->datalogs.end()) {
-            topic->datalogs.emplace_back(datalogger->log,
-                                         datalogger->Start(topic, now),
-                                         datalogger->handle);
+            topic->datalogs.emplace_back(
+                datalogger->log, datalogger->Start(topic, now),
+                datalogger->handle,
+                DataLoggerEntry::GetOptions(datalogger->options,
+                                            topic->properties));
             topic->datalogType = topic->type;
           } else if ((eventFlags & NT_EVENT_UNPUBLISH) != 0 &&
                      it != topic->datalogs.end()) {
+            it->Flush();
             it->log->Finish(it->entry, now);
             topic->datalogType = NT_UNASSIGNED;
             topic->datalogs.erase(it);
@@ -474,6 +631,10 @@ void LSImpl::NotifyTopic(TopicData* topic, unsigned int eventFlags) {
       auto metadata = DataLoggerEntry::MakeMetadata(topic->propertiesStr);
       for (auto&& datalog : topic->datalogs) {
         datalog.log->SetMetadata(datalog.entry, metadata);
+        if (auto datalogger = m_dataloggers.Get(datalog.logger)) {
+          datalog.SetOptions(DataLoggerEntry::GetOptions(datalogger->options,
+                                                         topic->properties));
+        }
       }
     }
   }
@@ -2233,10 +2394,11 @@ void LocalStorage::RemoveListener(NT_Listener listener, unsigned int mask) {
 
 NT_DataLogger LocalStorage::StartDataLog(wpi::log::DataLog& log,
                                          std::string_view prefix,
-                                         std::string_view logPrefix) {
+                                         std::string_view logPrefix,
+                                         const EntryDataLogOptions& options) {
   std::scoped_lock lock{m_mutex};
-  auto datalogger =
-      m_impl->m_dataloggers.Add(m_impl->m_inst, log, prefix, logPrefix);
+  auto datalogger = m_impl->m_dataloggers.Add(m_impl->m_inst, log, prefix,
+                                              logPrefix, options);
 
   // start logging any matching topics
   auto now = nt::Now();
@@ -2245,8 +2407,9 @@ NT_DataLogger LocalStorage::StartDataLog(wpi::log::DataLog& log,
         topic->type == NT_UNASSIGNED || topic->typeStr.empty()) {
       continue;
     }
-    topic->datalogs.emplace_back(log, datalogger->Start(topic.get(), now),
-                                 datalogger->handle);
+    topic->datalogs.emplace_back(
+        log, datalogger->Start(topic.get(), now), datalogger->handle,
+        DataLoggerEntry::GetOptions(options, topic->properties));
 
     // log current value, if any
     if (!topic->lastValue) {
@@ -2269,6 +2432,7 @@ void LocalStorage::StopDataLog(NT_DataLogger logger) {
           std::find_if(topic->datalogs.begin(), topic->datalogs.end(),
                        [&](const auto& elem) { return elem.logger == logger; });
       if (it != topic->datalogs.end()) {
+        it->Flush();
         it->log->Finish(it->entry, now);
         topic->datalogs.erase(it);
       }
@@ -204,7 +204,8 @@ class LocalStorage final : public net::ILocalStorage {
   // Data log functions
   //
   NT_DataLogger StartDataLog(wpi::log::DataLog& log, std::string_view prefix,
-                             std::string_view logPrefix);
+                             std::string_view logPrefix,
+                             const EntryDataLogOptions& options);
   void StopDataLog(NT_DataLogger logger);
 
   void Reset();
@@ -140,6 +140,11 @@ NCImpl::NCImpl(int inst, std::string_view id, net::ILocalStorage& localStorage,
       m_localQueue{logger},
       m_loop{*m_loopRunner.GetLoop()} {
   m_localMsgs.reserve(net::NetworkLoopQueue::kInitialQueueSize);
+  m_localQueue.SetWakeup([this] {
+    if (auto async = m_flushAtomic.load(std::memory_order_relaxed)) {
+      async->UnsafeSend();
+    }
+  });
 
   INFO("starting network client");
 }
@@ -446,7 +451,7 @@ void NCImpl4::TcpConnected(uv::Tcp& tcp) {
   wpi::SmallString<128> idBuf;
   auto ws = wpi::WebSocket::CreateClient(
       tcp, fmt::format("/nt/{}", wpi::EscapeURI(m_id, idBuf)), "",
-      {{"networktables.first.wpi.edu"}}, options);
+      {net::kBinaryControlProtocol, net::kTextControlProtocol}, options);
   ws->SetMaxMessageSize(kMaxMessageSize);
   ws->open.connect([this, &tcp, ws = ws.get()](std::string_view) {
     if (m_connList.IsConnected()) {
@@ -469,6 +474,9 @@ void NCImpl4::WsConnected(wpi::WebSocket& ws, uv::Tcp& tcp) {
   INFO("CONNECTED NT4 to {} port {}", connInfo.remote_ip, connInfo.remote_port);
   m_connHandle = m_connList.AddConnection(connInfo);
 
+  bool binaryControl = ws.GetProtocol() == net::kBinaryControlProtocol;
+  DEBUG4("Using {} control messages", binaryControl ? "binary" : "text");
+
   m_wire = std::make_shared<net::WebSocketConnection>(ws);
   m_clientImpl = std::make_unique<net::ClientImpl>(
       m_loop.Now().count(), m_inst, *m_wire, m_logger, m_timeSyncUpdated,
@@ -478,7 +486,8 @@ void NCImpl4::WsConnected(wpi::WebSocket& ws, uv::Tcp& tcp) {
           m_sendValuesTimer->Start(uv::Timer::Time{repeatMs},
                                    uv::Timer::Time{repeatMs});
         }
-      });
+      },
+      binaryControl);
   m_clientImpl->SetLocal(&m_localStorage);
   m_localStorage.StartNetwork(&m_localQueue);
   HandleLocal();
@@ -566,6 +575,10 @@ void NetworkClient::FlushLocal() {
   }
 }
 
+void NetworkClient::SetLowLatencyFlush(bool enabled) {
+  m_impl->m_localQueue.SetLowLatency(enabled);
+}
+
 void NetworkClient::Flush() {
   if (auto async = m_impl->m_flushAtomic.load(std::memory_order_relaxed)) {
     async->UnsafeSend();
@@ -614,6 +627,10 @@ void NetworkClient3::FlushLocal() {
   }
 }
 
+void NetworkClient3::SetLowLatencyFlush(bool enabled) {
+  m_impl->m_localQueue.SetLowLatency(enabled);
+}
+
 void NetworkClient3::Flush() {
   if (auto async = m_impl->m_flushAtomic.load(std::memory_order_relaxed)) {
     async->UnsafeSend();
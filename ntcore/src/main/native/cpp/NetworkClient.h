@@ -45,6 +45,7 @@ class NetworkClient final : public INetworkClient {
 
   void FlushLocal() final;
   void Flush() final;
+  void SetLowLatencyFlush(bool enabled) final;
 
  private:
   class Impl;
@@ -67,6 +68,7 @@ class NetworkClient3 final : public INetworkClient {
 
   void FlushLocal() final;
   void Flush() final;
+  void SetLowLatencyFlush(bool enabled) final;
 
  private:
   class Impl;
@@ -7,6 +7,7 @@
 #include <stdint.h>
 
 #include <atomic>
+#include <mutex>
 #include <span>
 #include <system_error>
 #include <vector>
@@ -81,7 +82,8 @@ class ServerConnection4 final
                     std::string_view addr, unsigned int port,
                     wpi::Logger& logger)
       : ServerConnection{server, addr, port, logger},
-        HttpWebSocketServerConnection(stream, {"networktables.first.wpi.edu"}) {
+        HttpWebSocketServerConnection(stream, {net::kBinaryControlProtocol,
+                                               net::kTextControlProtocol}) {
     m_info.protocol_version = 0x0400;
   }
 
@@ -112,7 +114,7 @@ class NSImpl {
 
   void HandleLocal();
   void LoadPersistent();
-  void SavePersistent(std::string_view filename, std::string_view data);
+  void SavePersistent(std::string_view filename);
   void Init();
   void AddConnection(ServerConnection* conn, const ConnectionInfo& info);
   void RemoveConnection(ServerConnection* conn);
@@ -136,6 +138,15 @@ class NSImpl {
 
   std::vector<net::ClientMessage> m_localMsgs;
 
+  // persistent topic changes copied from the loop, waiting to be saved
+  wpi::mutex m_persistentPendingMutex;
+  std::vector<net::PersistentTopic> m_persistentPending;
+
+  // used only from save workers, while holding m_persistentSaveMutex
+  wpi::mutex m_persistentSaveMutex;
+  net::PersistentSnapshot m_persistentSnapshot;
+  std::vector<net::PersistentTopic> m_persistentChanges;
+
   net::ServerImpl m_serverImpl;
 
   // shared with user (must be atomic or mutex-protected)
@@ -248,10 +259,14 @@ void ServerConnection4::ProcessWsUpgrade() {
     m_wire = std::make_shared<net::WebSocketConnection>(*m_websocket);
     // TODO: set local flag appropriately
     std::string dedupName;
+    bool binaryControl =
+        m_websocket->GetProtocol() == net::kBinaryControlProtocol;
     std::tie(dedupName, m_clientId) = m_server.m_serverImpl.AddClient(
         name, m_connInfo, false, *m_wire,
-        [this](uint32_t repeatMs) { UpdatePeriodicTimer(repeatMs); });
-    INFO("CONNECTED NT4 client '{}' (from {})", dedupName, m_connInfo);
+        [this](uint32_t repeatMs) { UpdatePeriodicTimer(repeatMs); },
+        binaryControl);
+    INFO("CONNECTED NT4 client '{}' (from {}){}", dedupName, m_connInfo,
+         binaryControl ? " with binary control" : "");
     m_info.remote_id = dedupName;
     m_server.AddConnection(this, m_info);
     m_websocket->closed.connect([this](uint16_t, std::string_view reason) {
@@ -335,6 +350,11 @@ NSImpl::NSImpl(std::string_view persistentFilename,
       m_localQueue{logger},
       m_loop(*m_loopRunner.GetLoop()) {
   m_localMsgs.reserve(net::NetworkLoopQueue::kInitialQueueSize);
+  m_localQueue.SetWakeup([this] {
+    if (auto async = m_flushAtomic.load(std::memory_order_relaxed)) {
+      async->UnsafeSend();
+    }
+  });
   m_loopRunner.ExecAsync([=, this](uv::Loop& loop) {
     // connect local storage to server
     m_serverImpl.SetLocal(&m_localStorage);
@@ -381,7 +401,19 @@ void NSImpl::LoadPersistent() {
   }
 }
 
-void NSImpl::SavePersistent(std::string_view filename, std::string_view data) {
+void NSImpl::SavePersistent(std::string_view filename) {
+  std::scoped_lock saveLock{m_persistentSaveMutex};
+  {
+    std::scoped_lock lock{m_persistentPendingMutex};
+    m_persistentChanges.swap(m_persistentPending);
+  }
+  if (m_persistentChanges.empty()) {
+    return;  // already saved by an earlier worker
+  }
+  m_persistentSnapshot.Update(std::move(m_persistentChanges));
+  m_persistentChanges.clear();
+  auto data = m_persistentSnapshot.Dump();
+
   // write to temporary file
   auto tmp = fmt::format("{}.tmp", filename);
   std::error_code ec;
@@ -418,6 +450,15 @@ void NSImpl::Init() {
     WARNING("error reading persistent file: {}", errs);
   }
 
+  // start the saved snapshot from everything loaded; after this only the
+  // changed topics are copied
+  {
+    std::vector<net::PersistentTopic> topics;
+    m_serverImpl.GetPersistentChanges(&topics, true);
+    std::scoped_lock lock{m_persistentSaveMutex};
+    m_persistentSnapshot.Update(std::move(topics));
+  }
+
   // set up timers
   m_readLocalTimer = uv::Timer::Create(m_loop);
   if (m_readLocalTimer) {
@@ -432,12 +473,14 @@ void NSImpl::Init() {
   if (m_savePersistentTimer) {
     m_savePersistentTimer->timeout.connect([this] {
       if (m_serverImpl.PersistentChanged()) {
+        // only copy the changed topics here; the full file is serialized
+        // and written by the worker
+        {
+          std::scoped_lock lock{m_persistentPendingMutex};
+          m_serverImpl.GetPersistentChanges(&m_persistentPending);
+        }
         uv::QueueWork(
-            m_loop,
-            [this, fn = m_persistentFilename,
-             data = m_serverImpl.DumpPersistent()] {
-              SavePersistent(fn, data);
-            },
+            m_loop, [this, fn = m_persistentFilename] { SavePersistent(fn); },
             nullptr);
       }
     });
@@ -583,6 +626,10 @@ void NetworkServer::FlushLocal() {
   }
 }
 
+void NetworkServer::SetLowLatencyFlush(bool enabled) {
+  m_impl->m_localQueue.SetLowLatency(enabled);
+}
+
 void NetworkServer::Flush() {
   if (auto async = m_impl->m_flushAtomic.load(std::memory_order_relaxed)) {
     async->UnsafeSend();
@@ -33,6 +33,7 @@ class NetworkServer {
 
   void FlushLocal();
   void Flush();
+  void SetLowLatencyFlush(bool enabled);
 
  private:
   class Impl;
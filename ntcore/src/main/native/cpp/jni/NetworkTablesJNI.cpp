@@ -1346,6 +1346,18 @@ Java_edu_wpi_first_networktables_NetworkTablesJNI_flushLocal
   nt::FlushLocal(inst);
 }
 
+/*
+ * Class:     edu_wpi_first_networktables_NetworkTablesJNI
+ * Method:    setLowLatencyFlush
+ * Signature: (IZ)V
+ */
+JNIEXPORT void JNICALL
+Java_edu_wpi_first_networktables_NetworkTablesJNI_setLowLatencyFlush
+  (JNIEnv*, jclass, jint inst, jboolean enabled)
+{
+  nt::SetLowLatencyFlush(inst, enabled);
+}
+
 /*
  * Class:     edu_wpi_first_networktables_NetworkTablesJNI
  * Method:    flush
@@ -4,6 +4,7 @@
 
 #include "ClientImpl.h"
 
+#include <algorithm>
 #include <numeric>
 #include <optional>
 #include <string>
@@ -20,6 +21,7 @@
 #include "Message.h"
 #include "NetworkInterface.h"
 #include "PubSubOptions.h"
+#include "TimeSync.h"
 #include "WireConnection.h"
 #include "WireDecoder.h"
 #include "WireEncoder.h"
@@ -30,6 +32,10 @@ using namespace nt::net;
 
 static constexpr uint32_t kMinPeriodMs = 5;
 
+// maximum amount of time to wait for a RTT ping response before we close the
+// connection
+static constexpr uint32_t kPingTimeoutMs = 3000;
+
 // maximum amount of time the wire can be not ready to send another
 // transmission before we close the connection
 static constexpr uint32_t kWireMaxNotReadyUs = 1000000;
@@ -51,7 +57,7 @@ class CImpl : public ServerMessageHandler {
   CImpl(uint64_t curTimeMs, int inst, WireConnection& wire, wpi::Logger& logger,
         std::function<void(int64_t serverTimeOffset, int64_t rtt2, bool valid)>
             timeSyncUpdated,
-        std::function<void(uint32_t repeatMs)> setPeriodic);
+        std::function<void(uint32_t repeatMs)> setPeriodic, bool binaryControl);
 
   void ProcessIncomingBinary(uint64_t curTimeMs, std::span<const uint8_t> data);
   void HandleLocal(std::vector<ClientMessage>&& msgs);
@@ -59,6 +65,7 @@ class CImpl : public ServerMessageHandler {
   void SendValues(uint64_t curTimeMs, bool flush);
   void SendInitialValues();
   bool CheckNetworkReady(uint64_t curTimeMs);
+  void UpdatePeriodic();
 
   // ServerMessageHandler interface
   void ServerAnnounce(std::string_view name, int64_t id,
@@ -76,6 +83,8 @@ class CImpl : public ServerMessageHandler {
 
   int m_inst;
   WireConnection& m_wire;
+  // control messages are sent as msgpack in binary frames
+  bool m_binaryControl;
   wpi::Logger& m_logger;
   LocalInterface* m_local{nullptr};
   std::function<void(int64_t serverTimeOffset, int64_t rtt2, bool valid)>
@@ -89,15 +98,17 @@ class CImpl : public ServerMessageHandler {
   wpi::DenseMap<int64_t, NT_Topic> m_topicMap;
 
   // timestamp handling
-  static constexpr uint32_t kPingIntervalMs = 3000;
+  TimeSync m_timeSync;
+  uint64_t m_pingTimeMs{0};
   uint64_t m_nextPingTimeMs{0};
   uint64_t m_pongTimeMs{0};
-  uint32_t m_rtt2Us{UINT32_MAX};
   bool m_haveTimeOffset{false};
   int64_t m_serverTimeOffsetUs{0};
+  int64_t m_timeErrorBoundUs{0};
 
   // periodic sweep handling
-  uint32_t m_periodMs{kPingIntervalMs + 10};
+  uint32_t m_periodMs{TimeSync::kPingIntervalMs + 10};
+  uint32_t m_setPeriodMs{0};
   uint64_t m_lastSendMs{0};
 
   // outgoing queue
@@ -110,20 +121,22 @@ CImpl::CImpl(
     uint64_t curTimeMs, int inst, WireConnection& wire, wpi::Logger& logger,
     std::function<void(int64_t serverTimeOffset, int64_t rtt2, bool valid)>
         timeSyncUpdated,
-    std::function<void(uint32_t repeatMs)> setPeriodic)
+    std::function<void(uint32_t repeatMs)> setPeriodic, bool binaryControl)
     : m_inst{inst},
       m_wire{wire},
+      m_binaryControl{binaryControl},
       m_logger{logger},
       m_timeSyncUpdated{std::move(timeSyncUpdated)},
       m_setPeriodic{std::move(setPeriodic)},
-      m_nextPingTimeMs{curTimeMs + kPingIntervalMs} {
+      m_pingTimeMs{curTimeMs},
+      m_nextPingTimeMs{curTimeMs + m_timeSync.GetPingIntervalMs()} {
   // immediately send RTT ping
   auto out = m_wire.SendBinary();
   auto now = wpi::Now();
   DEBUG4("Sending initial RTT ping {}", now);
   WireEncodeBinary(out.Add(), -1, 0, Value::MakeInteger(now));
   m_wire.Flush();
-  m_setPeriodic(m_periodMs);
+  UpdatePeriodic();
 }
 
 void CImpl::ProcessIncomingBinary(uint64_t curTimeMs,
@@ -133,10 +146,22 @@ void CImpl::ProcessIncomingBinary(uint64_t curTimeMs,
       break;
     }
 
+    // control message
+    std::string error;
+    if (m_binaryControl && WireIsBinaryControl(data)) {
+      if (!m_local) {
+        return;
+      }
+      if (!WireDecodeBinary(&data, *this, &error, m_logger)) {
+        ERROR("binary decode error: {}", error);
+        break;
+      }
+      continue;
+    }
+
     // decode message
     int64_t id;
     Value value;
-    std::string error;
     if (!WireDecodeBinary(&data, &id, &value, &error, -m_serverTimeOffsetUs)) {
       ERROR("binary decode error: {}", error);
       break;  // FIXME
@@ -154,14 +179,22 @@ void CImpl::ProcessIncomingBinary(uint64_t curTimeMs,
              value.GetInteger());
       m_pongTimeMs = curTimeMs;
       int64_t now = wpi::Now();
-      int64_t rtt2 = (now - value.GetInteger()) / 2;
-      if (rtt2 < m_rtt2Us) {
-        m_rtt2Us = rtt2;
-        m_serverTimeOffsetUs = value.server_time() + rtt2 - now;
-        DEBUG3("Time offset: {}", m_serverTimeOffsetUs);
+      if (!m_timeSync.AddSample(value.GetInteger(), value.server_time(),
+                                now)) {
+        continue;
+      }
+      int64_t offset = m_timeSync.GetOffset(now);
+      int64_t errorBound = m_timeSync.GetErrorBound();
+      if (!m_haveTimeOffset || offset != m_serverTimeOffsetUs ||
+          errorBound != m_timeErrorBoundUs) {
+        m_serverTimeOffsetUs = offset;
+        m_timeErrorBoundUs = errorBound;
+        DEBUG3("Time offset: {} +/- {} (drift {} ppm)", offset, errorBound,
+               m_timeSync.GetDrift() * 1e6);
         m_haveTimeOffset = true;
-        m_timeSyncUpdated(m_serverTimeOffsetUs, m_rtt2Us, true);
+        m_timeSyncUpdated(offset, errorBound, true);
       }
+      UpdatePeriodic();
       continue;
     }
 
@@ -209,13 +242,14 @@ bool CImpl::SendControl(uint64_t curTimeMs) {
   }
 
   // start a timestamp RTT ping if it's time to do one
-  if (curTimeMs >= m_nextPingTimeMs) {
+  // (only one ping is outstanding at a time)
+  if (m_pongTimeMs == 0) {
     // if we didn't receive a response to our last ping, disconnect
-    if (m_nextPingTimeMs != 0 && m_pongTimeMs == 0) {
+    if (curTimeMs >= (m_pingTimeMs + kPingTimeoutMs)) {
       m_wire.Disconnect("timed out");
       return false;
     }
-
+  } else if (curTimeMs >= m_nextPingTimeMs) {
     if (!CheckNetworkReady(curTimeMs)) {
       return false;
     }
@@ -223,7 +257,8 @@ bool CImpl::SendControl(uint64_t curTimeMs) {
     DEBUG4("Sending RTT ping {}", now);
     WireEncodeBinary(m_wire.SendBinary().Add(), -1, 0, Value::MakeInteger(now));
     // drift isn't critical here, so just go from current time
-    m_nextPingTimeMs = curTimeMs + kPingIntervalMs;
+    m_pingTimeMs = curTimeMs;
+    m_nextPingTimeMs = curTimeMs + m_timeSync.GetPingIntervalMs();
     m_pongTimeMs = 0;
   }
 
@@ -231,12 +266,19 @@ bool CImpl::SendControl(uint64_t curTimeMs) {
     if (!CheckNetworkReady(curTimeMs)) {
       return false;
     }
-    auto writer = m_wire.SendText();
-    for (auto&& msg : m_outgoing) {
-      auto& stream = writer.Add();
-      if (!WireEncodeText(stream, msg)) {
-        // shouldn't happen, but just in case...
-        stream << "{}";
+    if (m_binaryControl) {
+      auto writer = m_wire.SendBinary();
+      for (auto&& msg : m_outgoing) {
+        WireEncodeBinary(writer.Add(), msg);
+      }
+    } else {
+      auto writer = m_wire.SendText();
+      for (auto&& msg : m_outgoing) {
+        auto& stream = writer.Add();
+        if (!WireEncodeText(stream, msg)) {
+          // shouldn't happen, but just in case...
+          stream << "{}";
+        }
       }
     }
     m_outgoing.resize(0);
@@ -333,6 +375,16 @@ bool CImpl::CheckNetworkReady(uint64_t curTimeMs) {
   return true;
 }
 
+void CImpl::UpdatePeriodic() {
+  // sweep at least as often as RTT pings are due
+  uint32_t periodMs =
+      (std::min)(m_periodMs, m_timeSync.GetPingIntervalMs() + 10);
+  if (periodMs != m_setPeriodMs) {
+    m_setPeriodMs = periodMs;
+    m_setPeriodic(periodMs);
+  }
+}
+
 void CImpl::Publish(NT_Publisher pubHandle, NT_Topic topicHandle,
                     std::string_view name, std::string_view typeStr,
                     const wpi::json& properties,
@@ -357,7 +409,7 @@ void CImpl::Publish(NT_Publisher pubHandle, NT_Topic topicHandle,
   if (m_periodMs < kMinPeriodMs) {
     m_periodMs = kMinPeriodMs;
   }
-  m_setPeriodic(m_periodMs);
+  UpdatePeriodic();
 }
 
 bool CImpl::Unpublish(NT_Publisher pubHandle, NT_Topic topicHandle) {
@@ -386,7 +438,7 @@ bool CImpl::Unpublish(NT_Publisher pubHandle, NT_Topic topicHandle) {
   m_publishers[index].reset();
 
   // loop over all publishers to update period
-  m_periodMs = kPingIntervalMs + 10;
+  m_periodMs = TimeSync::kPingIntervalMs + 10;
   for (auto&& pub : m_publishers) {
     if (pub) {
       m_periodMs = std::gcd(m_periodMs, pub->periodMs);
@@ -395,7 +447,7 @@ bool CImpl::Unpublish(NT_Publisher pubHandle, NT_Topic topicHandle) {
   if (m_periodMs < kMinPeriodMs) {
     m_periodMs = kMinPeriodMs;
   }
-  m_setPeriodic(m_periodMs);
+  UpdatePeriodic();
 
   return doSend;
 }
@@ -448,23 +500,24 @@ class ClientImpl::Impl final : public CImpl {
   Impl(uint64_t curTimeMs, int inst, WireConnection& wire, wpi::Logger& logger,
        std::function<void(int64_t serverTimeOffset, int64_t rtt2, bool valid)>
            timeSyncUpdated,
-       std::function<void(uint32_t repeatMs)> setPeriodic)
+       std::function<void(uint32_t repeatMs)> setPeriodic, bool binaryControl)
       : CImpl{curTimeMs,
               inst,
               wire,
               logger,
               std::move(timeSyncUpdated),
-              std::move(setPeriodic)} {}
+              std::move(setPeriodic),
+              binaryControl} {}
 };
 
 ClientImpl::ClientImpl(
     uint64_t curTimeMs, int inst, WireConnection& wire, wpi::Logger& logger,
     std::function<void(int64_t serverTimeOffset, int64_t rtt2, bool valid)>
         timeSyncUpdated,
-    std::function<void(uint32_t repeatMs)> setPeriodic)
+    std::function<void(uint32_t repeatMs)> setPeriodic, bool binaryControl)
     : m_impl{std::make_unique<Impl>(curTimeMs, inst, wire, logger,
                                     std::move(timeSyncUpdated),
-                                    std::move(setPeriodic))} {}
+                                    std::move(setPeriodic), binaryControl)} {}
 
 ClientImpl::~ClientImpl() = default;
 
@@ -32,11 +32,13 @@ class WireConnection;
 
 class ClientImpl {
  public:
+  // If binaryControl is true, the server accepted kBinaryControlProtocol.
   ClientImpl(
       uint64_t curTimeMs, int inst, WireConnection& wire, wpi::Logger& logger,
       std::function<void(int64_t serverTimeOffset, int64_t rtt2, bool valid)>
           timeSyncUpdated,
-      std::function<void(uint32_t repeatMs)> setPeriodic);
+      std::function<void(uint32_t repeatMs)> setPeriodic,
+      bool binaryControl = false);
   ~ClientImpl();
 
   void ProcessIncomingText(std::string_view data);
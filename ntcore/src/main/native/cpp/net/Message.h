@@ -6,6 +6,7 @@
 
 #include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -17,6 +18,14 @@
 
 namespace nt::net {
 
+// WebSocket subprotocols, in server preference order.  With the binary
+// control subprotocol, control messages are sent as msgpack maps in binary
+// frames (interleaved with value messages) instead of as JSON text frames.
+inline constexpr std::string_view kBinaryControlProtocol =
+    "v4.2.binary.networktables.first.wpi.edu";
+inline constexpr std::string_view kTextControlProtocol =
+    "networktables.first.wpi.edu";
+
 struct PublishMsg {
   static constexpr std::string_view kMethodStr = "publish";
   NT_Publisher pubHandle{0};
@@ -71,6 +80,9 @@ struct AnnounceMsg {
   std::string typeStr;
   std::optional<int64_t> pubuid;
   wpi::json properties;
+  // if not empty, properties serialized as JSON text; used instead of
+  // properties by the text encoder
+  std::string propertiesStr{};
 };
 
 struct UnannounceMsg {
@@ -4,51 +4,156 @@
 
 #include "NetworkLoopQueue.h"
 
+#include <stdint.h>
+
 #include <wpi/Logger.h>
 
 using namespace nt::net;
 
+static_assert((NetworkLoopQueue::kValueQueueSize &
+               (NetworkLoopQueue::kValueQueueSize - 1)) == 0,
+              "kValueQueueSize must be a power of 2");
+
+// maximum heap storage (strings and arrays) referenced by queued values
 static constexpr size_t kMaxSize = 2 * 1024 * 1024;
 
-void NetworkLoopQueue::SetValue(NT_Publisher pubHandle, const Value& value) {
-  std::scoped_lock lock{m_mutex};
+static size_t GetHeapSize(const nt::Value& value) {
   switch (value.type()) {
     case NT_STRING:
-      m_size += value.GetString().size();  // imperfect but good enough
-      break;
+      return value.GetString().size();
     case NT_RAW:
-      m_size += value.GetRaw().size_bytes();
-      break;
+      return value.GetRaw().size_bytes();
     case NT_BOOLEAN_ARRAY:
-      m_size += value.GetBooleanArray().size_bytes();
-      break;
+      return value.GetBooleanArray().size_bytes();
     case NT_INTEGER_ARRAY:
-      m_size += value.GetIntegerArray().size_bytes();
-      break;
+      return value.GetIntegerArray().size_bytes();
     case NT_FLOAT_ARRAY:
-      m_size += value.GetFloatArray().size_bytes();
-      break;
+      return value.GetFloatArray().size_bytes();
     case NT_DOUBLE_ARRAY:
-      m_size += value.GetDoubleArray().size_bytes();
-      break;
+      return value.GetDoubleArray().size_bytes();
     case NT_STRING_ARRAY: {
       auto arr = value.GetStringArray();
-      m_size += arr.size_bytes();
+      size_t size = arr.size_bytes();
       for (auto&& s : arr) {
-        m_size += s.capacity();
+        size += s.capacity();
       }
-      break;
+      return size;
     }
     default:
-      break;
+      return 0;
   }
-  m_size += sizeof(ClientMessage);
-  if (m_size > kMaxSize) {
-    if (!m_sizeErrored) {
+}
+
+NetworkLoopQueue::NetworkLoopQueue(wpi::Logger& logger)
+    : m_logger{logger},
+      m_values{std::make_unique<ValueCell[]>(kValueQueueSize)} {
+  m_control.reserve(kInitialQueueSize);
+  for (size_t i = 0; i < kValueQueueSize; ++i) {
+    m_values[i].seq.store(i, std::memory_order_relaxed);
+  }
+}
+
+void NetworkLoopQueue::SetValue(NT_Publisher pubHandle, const Value& value) {
+  size_t size = GetHeapSize(value);
+  if (size != 0 &&
+      m_size.fetch_add(size, std::memory_order_relaxed) + size > kMaxSize) {
+    m_size.fetch_sub(size, std::memory_order_relaxed);
+    size = SIZE_MAX;
+  }
+
+  // claim a cell; each cell's sequence number equals the position it can be
+  // written at, or position + 1 once written
+  size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+  ValueCell* cell = nullptr;
+  while (size != SIZE_MAX) {
+    cell = &m_values[pos & (kValueQueueSize - 1)];
+    size_t seq = cell->seq.load(std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (m_enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // full
+      m_size.fetch_sub(size, std::memory_order_relaxed);
+      size = SIZE_MAX;
+    } else {
+      pos = m_enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  if (size == SIZE_MAX) {
+    if (!m_sizeErrored.exchange(true, std::memory_order_relaxed)) {
       WPI_ERROR(m_logger, "NT: dropping value set due to memory limits");
-      m_sizeErrored = true;
     }
     return;  // avoid potential out of memory
   }
-  m_queue.emplace_back(ClientMessage{ClientValueMsg{pubHandle, value}});
+
+  cell->pubHandle = pubHandle;
+  cell->size = size;
+  cell->value = value;
+  cell->seq.store(pos + 1, std::memory_order_release);
+  Wakeup();
+}
+
+void NetworkLoopQueue::ReadQueue(std::vector<ClientMessage>* out) {
+  m_wakeupPending.exchange(false, std::memory_order_acq_rel);
+  out->resize(0);
+  {
+    std::scoped_lock lock{m_mutex};
+    if (m_controlPending.empty()) {
+      m_controlPending.swap(m_control);
+    } else {
+      m_controlPending.insert(m_controlPending.end(),
+                              std::make_move_iterator(m_control.begin()),
+                              std::make_move_iterator(m_control.end()));
+      m_control.resize(0);
+    }
+  }
+
+  auto control = m_controlPending.begin();
+  auto controlEnd = m_controlPending.end();
+  for (;;) {
+    // control messages queued before this value
+    for (; control != controlEnd && control->pos <= m_dequeuePos; ++control) {
+      out->emplace_back(std::move(control->msg));
+    }
+
+    auto& cell = m_values[m_dequeuePos & (kValueQueueSize - 1)];
+    if (cell.seq.load(std::memory_order_acquire) != m_dequeuePos + 1) {
+      break;  // empty, or not written yet
+    }
+    out->emplace_back().contents.emplace<ClientValueMsg>(
+        cell.pubHandle, std::move(cell.value));
+    m_size.fetch_sub(cell.size, std::memory_order_relaxed);
+    cell.value = {};
+    cell.seq.store(m_dequeuePos + kValueQueueSize, std::memory_order_release);
+    ++m_dequeuePos;
+  }
+
+  // any remaining control messages follow a value that is still being written
+  m_controlPending.erase(m_controlPending.begin(), control);
+  m_sizeErrored.store(false, std::memory_order_relaxed);
+}
+
+void NetworkLoopQueue::ClearQueue() {
+  m_wakeupPending.exchange(false, std::memory_order_acq_rel);
+  {
+    std::scoped_lock lock{m_mutex};
+    m_control.resize(0);
+  }
+  m_controlPending.resize(0);
+
+  for (;;) {
+    auto& cell = m_values[m_dequeuePos & (kValueQueueSize - 1)];
+    if (cell.seq.load(std::memory_order_acquire) != m_dequeuePos + 1) {
+      break;
+    }
+    m_size.fetch_sub(cell.size, std::memory_order_relaxed);
+    cell.value = {};
+    cell.seq.store(m_dequeuePos + kValueQueueSize, std::memory_order_release);
+    ++m_dequeuePos;
+  }
+  m_sizeErrored.store(false, std::memory_order_relaxed);
 }
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <span>
 #include <string>
 #include <vector>
@@ -19,12 +22,32 @@ class Logger;
 
 namespace nt::net {
 
+// Queue of local changes to be processed by the network loop.
+//
+// Values are written to a bounded lock-free multiple-producer ring, so
+// publishing a value from a user thread does not take a lock or construct a
+// ClientMessage.  Control messages are rarer and go into a mutex-protected
+// vector; each one records the ring position at the time it was queued so
+// ReadQueue() can interleave the two in the original order.
+//
+// ReadQueue() and ClearQueue() must only be called from a single thread (the
+// network loop).
+//
+// In low latency mode, the first change queued after a ReadQueue() calls the
+// wakeup function, so the loop can read the queue without waiting for its
+// next scheduled poll.
 class NetworkLoopQueue : public NetworkInterface {
  public:
   static constexpr size_t kInitialQueueSize = 2000;
+  // maximum number of queued values; must be a power of 2
+  static constexpr size_t kValueQueueSize = 8192;
 
-  explicit NetworkLoopQueue(wpi::Logger& logger) : m_logger{logger} {
-    m_queue.reserve(kInitialQueueSize);
+  explicit NetworkLoopQueue(wpi::Logger& logger);
+
+  // must be called before any changes are queued
+  void SetWakeup(std::function<void()> wakeup) { m_wakeup = std::move(wakeup); }
+  void SetLowLatency(bool enabled) {
+    m_lowLatency.store(enabled, std::memory_order_relaxed);
   }
 
   void ReadQueue(std::vector<ClientMessage>* out);
@@ -45,11 +68,37 @@ class NetworkLoopQueue : public NetworkInterface {
   void SetValue(NT_Publisher pubHandle, const Value& value) final;
 
  private:
-  wpi::mutex m_mutex;
-  std::vector<ClientMessage> m_queue;
+  struct ControlMsg {
+    size_t pos;  // value queue position when queued
+    ClientMessage msg;
+  };
+
+  struct ValueCell {
+    std::atomic<size_t> seq;
+    NT_Publisher pubHandle;
+    size_t size;  // heap bytes counted in m_size
+    Value value;
+  };
+
+  void QueueControl(ClientMessage&& msg);
+  void Wakeup();
+
   wpi::Logger& m_logger;
-  size_t m_size{0};
-  bool m_sizeErrored{false};
+  std::function<void()> m_wakeup;
+  std::atomic_bool m_lowLatency{false};
+  std::atomic_bool m_wakeupPending{false};
+
+  wpi::mutex m_mutex;
+  std::vector<ControlMsg> m_control;  // protected by m_mutex
+
+  // control messages waiting on a value that has not been written yet
+  std::vector<ControlMsg> m_controlPending;
+
+  std::unique_ptr<ValueCell[]> m_values;
+  alignas(64) std::atomic<size_t> m_enqueuePos{0};
+  alignas(64) size_t m_dequeuePos{0};
+  std::atomic<size_t> m_size{0};
+  std::atomic_bool m_sizeErrored{false};
 };
 
 }  // namespace nt::net
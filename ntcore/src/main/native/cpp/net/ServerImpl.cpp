@@ -10,6 +10,7 @@
 #include <cmath>
 #include <numeric>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -76,6 +77,12 @@ struct SubscriberData;
 struct TopicData;
 class SImpl;
 
+// value received from a client, waiting to be fanned out
+struct IncomingValue {
+  TopicData* topic;
+  Value value;
+};
+
 class ClientData {
  public:
   ClientData(std::string_view name, std::string_view connInfo, bool local,
@@ -107,6 +114,8 @@ class ClientData {
 
   void UpdateMetaClientPub();
   void UpdateMetaClientSub();
+  void RebuildMetaClientPub();
+  void RebuildMetaClientSub();
 
   std::span<SubscriberData*> GetSubscribers(
       std::string_view name, bool special,
@@ -114,6 +123,7 @@ class ClientData {
 
   std::string_view GetName() const { return m_name; }
   int GetId() const { return m_id; }
+  bool IsLocal() const { return m_local; }
 
  protected:
   std::string m_name;
@@ -156,9 +166,13 @@ class ClientData4Base : public ClientData, protected ClientMessageHandler {
                        const PubSubOptionsImpl& options) final;
   void ClientUnsubscribe(int64_t subuid) final;
 
-  void ClientSetValue(int64_t pubuid, const Value& value);
+  // Values are queued and fanned out together by FlushIncomingValues(); this
+  // must be called before processing any other message.
+  void ClientSetValue(int64_t pubuid, Value&& value);
+  void FlushIncomingValues();
 
   wpi::DenseMap<TopicData*, bool> m_announceSent;
+  std::vector<IncomingValue> m_incomingValues;
 };
 
 class ClientDataLocal final : public ClientData4Base {
@@ -183,10 +197,12 @@ class ClientDataLocal final : public ClientData4Base {
 class ClientData4 final : public ClientData4Base {
  public:
   ClientData4(std::string_view name, std::string_view connInfo, bool local,
-              WireConnection& wire, ServerImpl::SetPeriodicFunc setPeriodic,
-              SImpl& server, int id, wpi::Logger& logger)
+              WireConnection& wire, bool binaryControl,
+              ServerImpl::SetPeriodicFunc setPeriodic, SImpl& server, int id,
+              wpi::Logger& logger)
       : ClientData4Base{name, connInfo, local, setPeriodic, server, id, logger},
-        m_wire{wire} {}
+        m_wire{wire},
+        m_binaryControl{binaryControl} {}
 
   void ProcessIncomingText(std::string_view data) final;
   void ProcessIncomingBinary(std::span<const uint8_t> data) final;
@@ -204,6 +220,8 @@ class ClientData4 final : public ClientData4Base {
   WireConnection& m_wire;
 
  private:
+  // control messages are sent as msgpack in binary frames
+  bool m_binaryControl;
   std::vector<ServerMessage> m_outgoing;
   wpi::DenseMap<NT_Topic, size_t> m_outgoingValueMap;
 
@@ -211,6 +229,14 @@ class ClientData4 final : public ClientData4Base {
     return WireEncodeBinary(SendBinary().Add(), id, time, value);
   }
 
+  bool WriteControl(const ServerMessage& msg) {
+    if (m_binaryControl) {
+      return WireEncodeBinary(SendBinary().Add(), msg);
+    } else {
+      return WireEncodeText(SendText().Add(), msg);
+    }
+  }
+
   TextWriter& SendText() {
     m_outBinary.reset();  // ensure proper interleaving of text and binary
     if (!m_outText) {
@@ -321,23 +347,64 @@ struct TopicData {
   void RefreshProperties();
   bool SetFlags(unsigned int flags_);
 
+  // properties serialized as JSON text, for announce messages
+  std::string_view GetPropertiesStr();
+
+  void AddSubscriber(SubscriberData* subscriber) {
+    subscribers.Add(subscriber);
+    sendModesDirty = true;
+  }
+  // returns true if subscriber was present
+  bool RemoveSubscriber(SubscriberData* subscriber) {
+    bool removed = subscribers.Remove(subscriber);
+    sendModesDirty |= removed;
+    return removed;
+  }
+  // returns true if any subscribers were removed
+  bool RemoveSubscribers(ClientData* client);
+
+  struct ClientSendMode {
+    int clientId;
+    ClientData::SendMode mode;
+  };
+
+  // clients that values should be sent to, in clientId order
+  std::span<const ClientSendMode> GetSendModes();
+
   std::string name;
   unsigned int id;
   Value lastValue;
   ClientData* lastValueClient = nullptr;
   std::string typeStr;
   wpi::json properties = wpi::json::object();
+  std::string propertiesStr;  // cache; empty if properties changed
   bool persistent{false};
+  bool persistentDirty{false};  // in SImpl::m_persistentDirty
   bool retained{false};
   bool special{false};
   NT_Topic localHandle{0};
 
   VectorSet<PublisherData*> publishers;
-  VectorSet<SubscriberData*> subscribers;
+  VectorSet<SubscriberData*> subscribers;  // modify via Add/RemoveSubscriber
+  std::vector<ClientSendMode> sendModes;  // cache; rebuilt if sendModesDirty
+  bool sendModesDirty{false};
+
+  // used by SImpl::SetValues(); index into m_batchTopics (or -1), and index of
+  // the last value for this topic in the batch
+  int batchIndex{-1};
+  size_t batchLast{0};
 
   // meta topics
   TopicData* metaPub = nullptr;
   TopicData* metaSub = nullptr;
+
+  // for meta topics: the topic or client whose publishers (metaIsPub) or
+  // subscribers the value describes, and whether it needs to be rebuilt by
+  // SImpl::UpdateMetaTopics()
+  TopicData* metaOfTopic = nullptr;
+  ClientData* metaOfClient = nullptr;
+  bool metaIsPub{false};
+  bool metaDirty{false};
 };
 
 struct PublisherData {
@@ -396,15 +463,28 @@ class SImpl {
   wpi::UidVector<std::unique_ptr<TopicData>, 16> m_topics;
   wpi::StringMap<TopicData*> m_nameTopics;
   bool m_persistentChanged{false};
+  // ids of topics whose persistent state changed since the last
+  // GetPersistentChanges() call
+  std::vector<unsigned int> m_persistentDirty;
+  // ids of meta topics to rebuild in UpdateMetaTopics()
+  std::vector<unsigned int> m_metaDirty;
 
   // global meta topics (other meta topics are linked to from the specific
   // client or topic)
   TopicData* m_metaClients;
 
+  // scratch space for SetValues()
+  std::vector<TopicData*> m_batchTopics;
+  std::vector<ClientData::SendMode> m_batchModes;
+  // true while SetValues() is sending; local clients are flushed once at the
+  // end rather than after every value
+  bool m_sendingBatch{false};
+
   // ServerImpl interface
   std::pair<std::string, int> AddClient(
       std::string_view name, std::string_view connInfo, bool local,
-      WireConnection& wire, ServerImpl::SetPeriodicFunc setPeriodic);
+      WireConnection& wire, ServerImpl::SetPeriodicFunc setPeriodic,
+      bool binaryControl);
   int AddClient3(std::string_view connInfo, bool local,
                  net3::WireConnection3& wire,
                  ServerImpl::Connected3Func connected,
@@ -412,6 +492,7 @@ class SImpl {
   void RemoveClient(int clientId);
 
   bool PersistentChanged();
+  void GetPersistentChanges(std::vector<PersistentTopic>* changes, bool all);
   void DumpPersistent(wpi::raw_ostream& os);
   std::string LoadPersistent(std::string_view in);
 
@@ -420,20 +501,34 @@ class SImpl {
                          std::string_view typeStr, const wpi::json& properties,
                          bool special = false);
   TopicData* CreateMetaTopic(std::string_view name);
+  TopicData* CreateMetaTopic(std::string_view name, TopicData* ofTopic,
+                             ClientData* ofClient, bool pub);
   void DeleteTopic(TopicData* topic);
+  void MarkPersistentDirty(TopicData* topic);
   void SetProperties(ClientData* client, TopicData* topic,
                      const wpi::json& update);
   void SetFlags(ClientData* client, TopicData* topic, unsigned int flags);
   void SetValue(ClientData* client, TopicData* topic, const Value& value);
+  void SetValues(ClientData* client, std::span<const IncomingValue> values);
 
   // update meta topic values from data structures
   void UpdateMetaClients(const std::vector<ConnectionInfo>& conns);
+  // these only mark the meta topic dirty; see UpdateMetaTopics()
   void UpdateMetaTopicPub(TopicData* topic);
   void UpdateMetaTopicSub(TopicData* topic);
+  void MarkMetaDirty(TopicData* meta);
+  // rebuilds the dirty meta topics that have subscribers; called once per
+  // control period
+  void UpdateMetaTopics();
+  void RebuildMetaTopic(TopicData* meta);
+  void RebuildMetaTopicPub(TopicData* topic);
+  void RebuildMetaTopicSub(TopicData* topic);
 
  private:
   void PropertiesChanged(ClientData* client, TopicData* topic,
                          const wpi::json& update);
+  void UpdateLastValue(ClientData* client, TopicData* topic,
+                       const Value& value);
 };
 
 struct Writer : public mpack_writer_t {
@@ -478,6 +573,14 @@ static void WriteOptions(mpack_writer_t& w, const PubSubOptionsImpl& options) {
 }
 
 void ClientData::UpdateMetaClientPub() {
+  m_server.MarkMetaDirty(m_metaPub);
+}
+
+void ClientData::UpdateMetaClientSub() {
+  m_server.MarkMetaDirty(m_metaSub);
+}
+
+void ClientData::RebuildMetaClientPub() {
   if (!m_metaPub) {
     return;
   }
@@ -497,7 +600,7 @@ void ClientData::UpdateMetaClientPub() {
   }
 }
 
-void ClientData::UpdateMetaClientSub() {
+void ClientData::RebuildMetaClientSub() {
   if (!m_metaSub) {
     return;
   }
@@ -651,7 +754,7 @@ void ClientData4Base::ClientSubscribe(int64_t subuid,
   for (auto&& topic : m_server.m_topics) {
     bool removed = false;
     if (replace) {
-      removed = topic->subscribers.Remove(sub.get());
+      removed = topic->RemoveSubscriber(sub.get());
     }
 
     // is client already subscribed?
@@ -668,7 +771,7 @@ void ClientData4Base::ClientSubscribe(int64_t subuid,
 
     bool added = false;
     if (sub->Matches(topic->name, topic->special)) {
-      topic->subscribers.Add(sub.get());
+      topic->AddSubscriber(sub.get());
       added = true;
     }
 
@@ -682,10 +785,14 @@ void ClientData4Base::ClientSubscribe(int64_t subuid,
       SendAnnounce(topic.get(), std::nullopt);
     }
 
-    // send last value
-    if (added && !sub->options.topicsOnly && !wasSubscribedValue &&
-        topic->lastValue) {
-      dataToSend.emplace_back(topic.get());
+    // send last value; out of date meta topics are instead sent when they
+    // are next rebuilt
+    if (added && !sub->options.topicsOnly && !wasSubscribedValue) {
+      if (topic->metaDirty) {
+        m_server.m_metaDirty.emplace_back(topic->id);
+      } else if (topic->lastValue) {
+        dataToSend.emplace_back(topic.get());
+      }
     }
   }
 
@@ -710,7 +817,7 @@ void ClientData4Base::ClientUnsubscribe(int64_t subuid) {
 
   // remove from topics
   for (auto&& topic : m_server.m_topics) {
-    if (topic->subscribers.Remove(sub)) {
+    if (topic->RemoveSubscriber(sub)) {
       m_server.UpdateMetaTopicSub(topic.get());
     }
   }
@@ -734,7 +841,7 @@ void ClientData4Base::ClientUnsubscribe(int64_t subuid) {
   m_setPeriodic(m_periodMs);
 }
 
-void ClientData4Base::ClientSetValue(int64_t pubuid, const Value& value) {
+void ClientData4Base::ClientSetValue(int64_t pubuid, Value&& value) {
   DEBUG4("ClientSetValue({}, {})", m_id, pubuid);
   auto publisherIt = m_publishers.find(pubuid);
   if (publisherIt == m_publishers.end()) {
@@ -742,7 +849,15 @@ void ClientData4Base::ClientSetValue(int64_t pubuid, const Value& value) {
     return;  // ignore unrecognized pubuids
   }
   auto topic = publisherIt->getSecond().get()->topic;
-  m_server.SetValue(this, topic, value);
+  m_incomingValues.emplace_back(IncomingValue{topic, std::move(value)});
+}
+
+void ClientData4Base::FlushIncomingValues() {
+  if (m_incomingValues.empty()) {
+    return;
+  }
+  m_server.SetValues(this, m_incomingValues);
+  m_incomingValues.clear();
 }
 
 void ClientDataLocal::SendValue(TopicData* topic, const Value& value,
@@ -793,8 +908,11 @@ void ClientDataLocal::HandleLocal(std::span<const ClientMessage> msgs) {
   for (const auto& elem : msgs) {  // NOLINT
     // common case is value, so check that first
     if (auto msg = std::get_if<ClientValueMsg>(&elem.contents)) {
-      ClientSetValue(msg->pubHandle, msg->value);
-    } else if (auto msg = std::get_if<PublishMsg>(&elem.contents)) {
+      ClientSetValue(msg->pubHandle, Value{msg->value});
+      continue;
+    }
+    FlushIncomingValues();
+    if (auto msg = std::get_if<PublishMsg>(&elem.contents)) {
       ClientPublish(msg->pubHandle, msg->name, msg->typeStr, msg->properties);
     } else if (auto msg = std::get_if<UnpublishMsg>(&elem.contents)) {
       ClientUnpublish(msg->pubHandle);
@@ -806,6 +924,7 @@ void ClientDataLocal::HandleLocal(std::span<const ClientMessage> msgs) {
       ClientUnsubscribe(msg->subHandle);
     }
   }
+  FlushIncomingValues();
 }
 
 void ClientData4::ProcessIncomingText(std::string_view data) {
@@ -818,10 +937,20 @@ void ClientData4::ProcessIncomingBinary(std::span<const uint8_t> data) {
       break;
     }
 
+    // control message
+    std::string error;
+    if (m_binaryControl && WireIsBinaryControl(data)) {
+      FlushIncomingValues();
+      if (!WireDecodeBinary(&data, *this, &error, m_logger)) {
+        m_wire.Disconnect(fmt::format("binary decode error: {}", error));
+        break;
+      }
+      continue;
+    }
+
     // decode message
     int64_t pubuid;
     Value value;
-    std::string error;
     if (!WireDecodeBinary(&data, &pubuid, &value, &error, 0)) {
       m_wire.Disconnect(fmt::format("binary decode error: {}", error));
       break;
@@ -840,8 +969,11 @@ void ClientData4::ProcessIncomingBinary(std::span<const uint8_t> data) {
     }
 
     // handle value set
-    ClientSetValue(pubuid, value);
+    ClientSetValue(pubuid, std::move(value));
   }
+
+  // fan out all the values from this frame together
+  FlushIncomingValues();
 }
 
 void ClientData4::SendValue(TopicData* topic, const Value& value,
@@ -854,7 +986,7 @@ void ClientData4::SendValue(TopicData* topic, const Value& value,
       break;
     case ClientData::kSendImmNoFlush:  // send immediately
       WriteBinary(topic->id, value.time(), value);
-      if (m_local) {
+      if (m_local && !m_server.m_sendingBatch) {
         Flush();
       }
       break;
@@ -890,13 +1022,25 @@ void ClientData4::SendAnnounce(TopicData* topic,
   sent = true;
 
   if (m_local) {
-    WireEncodeAnnounce(SendText().Add(), topic->name, topic->id, topic->typeStr,
-                       topic->properties, pubuid);
+    if (m_binaryControl) {
+      WriteControl(ServerMessage{AnnounceMsg{
+          topic->name, topic->id, topic->typeStr, pubuid, topic->properties}});
+    } else {
+      WireEncodeAnnounceRaw(SendText().Add(), topic->name, topic->id,
+                            topic->typeStr, topic->GetPropertiesStr(), pubuid);
+    }
     Flush();
-  } else {
+  } else if (m_binaryControl) {
     m_outgoing.emplace_back(ServerMessage{AnnounceMsg{
         topic->name, topic->id, topic->typeStr, pubuid, topic->properties}});
     m_server.m_controlReady = true;
+  } else {
+    // avoid copying the properties object; the text encoder uses the
+    // serialized form directly
+    m_outgoing.emplace_back(ServerMessage{
+        AnnounceMsg{topic->name, topic->id, topic->typeStr, pubuid, {},
+                    std::string{topic->GetPropertiesStr()}}});
+    m_server.m_controlReady = true;
   }
 }
 
@@ -908,7 +1052,11 @@ void ClientData4::SendUnannounce(TopicData* topic) {
   sent = false;
 
   if (m_local) {
-    WireEncodeUnannounce(SendText().Add(), topic->name, topic->id);
+    if (m_binaryControl) {
+      WriteControl(ServerMessage{UnannounceMsg{topic->name, topic->id}});
+    } else {
+      WireEncodeUnannounce(SendText().Add(), topic->name, topic->id);
+    }
     Flush();
   } else {
     m_outgoing.emplace_back(
@@ -924,7 +1072,12 @@ void ClientData4::SendPropertiesUpdate(TopicData* topic,
   }
 
   if (m_local) {
-    WireEncodePropertiesUpdate(SendText().Add(), topic->name, update, ack);
+    if (m_binaryControl) {
+      WriteControl(
+          ServerMessage{PropertiesUpdateMsg{topic->name, update, ack}});
+    } else {
+      WireEncodePropertiesUpdate(SendText().Add(), topic->name, update, ack);
+    }
     Flush();
   } else {
     m_outgoing.emplace_back(
@@ -956,7 +1109,7 @@ void ClientData4::SendOutgoing(uint64_t curTimeMs) {
     if (auto m = std::get_if<ServerValueMsg>(&msg.contents)) {
       WriteBinary(m->topic, m->value.time(), m->value);
     } else {
-      WireEncodeText(SendText().Add(), msg);
+      WriteControl(msg);
     }
   }
   m_outgoing.resize(0);
@@ -1009,7 +1162,7 @@ void ClientData3::SendValue(TopicData* topic, const Value& value,
                                     topic3->flags);
         topic3->sentAssign = true;
       }
-      if (m_local) {
+      if (m_local && !m_server.m_sendingBatch) {
         Flush();
       }
       break;
@@ -1057,7 +1210,7 @@ void ClientData3::SendAnnounce(TopicData* topic,
 
   // subscribe to all non-special topics
   if (!topic->special) {
-    topic->subscribers.Add(m_subscribers[0].get());
+    topic->AddSubscriber(m_subscribers[0].get());
     m_server.UpdateMetaTopicSub(topic);
   }
 
@@ -1221,8 +1374,10 @@ void ClientData3::ClientHello(std::string_view self_id,
   m_connected = nullptr;  // no longer required
 
   // create client meta topics
-  m_metaPub = m_server.CreateMetaTopic(fmt::format("$clientpub${}", m_name));
-  m_metaSub = m_server.CreateMetaTopic(fmt::format("$clientsub${}", m_name));
+  m_metaPub = m_server.CreateMetaTopic(fmt::format("$clientpub${}", m_name),
+                                       nullptr, this, true);
+  m_metaSub = m_server.CreateMetaTopic(fmt::format("$clientsub${}", m_name),
+                                       nullptr, this, false);
 
   // subscribe and send initial assignments
   auto& sub = m_subscribers[0];
@@ -1245,7 +1400,7 @@ void ClientData3::ClientHello(std::string_view self_id,
           topic->lastValue) {
         DEBUG4("client {}: initial announce of '{}' (id {})", m_id, topic->name,
                topic->id);
-        topic->subscribers.Add(sub.get());
+        topic->AddSubscriber(sub.get());
         m_server.UpdateMetaTopicSub(topic.get());
 
         TopicData3* topic3 = GetTopic3(topic.get());
@@ -1461,6 +1616,7 @@ bool TopicData::SetProperties(const wpi::json& update) {
 }
 
 void TopicData::RefreshProperties() {
+  propertiesStr.clear();
   persistent = false;
   retained = false;
 
@@ -1490,9 +1646,57 @@ bool TopicData::SetFlags(unsigned int flags_) {
     persistent = false;
     properties.erase("persistent");
   }
+  propertiesStr.clear();
   return updated;
 }
 
+std::string_view TopicData::GetPropertiesStr() {
+  if (propertiesStr.empty()) {
+    wpi::raw_string_ostream os{propertiesStr};
+    wpi::json::serializer s{os, ' ', 0};
+    s.dump(properties, false, false, 0, 0);
+  }
+  return propertiesStr;
+}
+
+bool TopicData::RemoveSubscribers(ClientData* client) {
+  auto subRemove =
+      std::remove_if(subscribers.begin(), subscribers.end(),
+                     [&](auto&& e) { return e->client == client; });
+  if (subRemove == subscribers.end()) {
+    return false;
+  }
+  subscribers.erase(subRemove, subscribers.end());
+  sendModesDirty = true;
+  return true;
+}
+
+std::span<const TopicData::ClientSendMode> TopicData::GetSendModes() {
+  if (sendModesDirty) {
+    // as each client may have multiple subscribers, but we only want to send
+    // the value once, take the union of each client's subscriptions
+    sendModes.clear();
+    for (auto&& subscriber : subscribers) {
+      if (subscriber->options.topicsOnly) {
+        continue;
+      }
+      int id = subscriber->client->GetId();
+      auto mode = subscriber->options.sendAll ? ClientData::kSendAll
+                                              : ClientData::kSendNormal;
+      auto it = std::lower_bound(
+          sendModes.begin(), sendModes.end(), id,
+          [](const auto& elem, int id) { return elem.clientId < id; });
+      if (it == sendModes.end() || it->clientId != id) {
+        sendModes.insert(it, {id, mode});
+      } else if (mode == ClientData::kSendAll) {
+        it->mode = mode;
+      }
+    }
+    sendModesDirty = false;
+  }
+  return sendModes;
+}
+
 bool SubscriberData::Matches(std::string_view name, bool special) {
   for (auto&& topicName : topicNames) {
     if ((!options.prefixMatch && name == topicName) ||
@@ -1512,7 +1716,8 @@ SImpl::SImpl(wpi::Logger& logger) : m_logger{logger} {
 
 std::pair<std::string, int> SImpl::AddClient(
     std::string_view name, std::string_view connInfo, bool local,
-    WireConnection& wire, ServerImpl::SetPeriodicFunc setPeriodic) {
+    WireConnection& wire, ServerImpl::SetPeriodicFunc setPeriodic,
+    bool binaryControl) {
   if (name.empty()) {
     name = "NT4";
   }
@@ -1533,15 +1738,17 @@ std::pair<std::string, int> SImpl::AddClient(
   std::string dedupName = fmt::format("{}@{}", name, index);
 
   auto& clientData = m_clients[index];
-  clientData = std::make_unique<ClientData4>(dedupName, connInfo, local, wire,
-                                             std::move(setPeriodic), *this,
-                                             index, m_logger);
+  clientData = std::make_unique<ClientData4>(
+      dedupName, connInfo, local, wire, binaryControl, std::move(setPeriodic),
+      *this, index, m_logger);
 
   // create client meta topics
   clientData->m_metaPub =
-      CreateMetaTopic(fmt::format("$clientpub${}", dedupName));
+      CreateMetaTopic(fmt::format("$clientpub${}", dedupName), nullptr,
+                      clientData.get(), true);
   clientData->m_metaSub =
-      CreateMetaTopic(fmt::format("$clientsub${}", dedupName));
+      CreateMetaTopic(fmt::format("$clientsub${}", dedupName), nullptr,
+                      clientData.get(), false);
 
   // update meta topics
   clientData->UpdateMetaClientPub();
@@ -1591,11 +1798,7 @@ void SImpl::RemoveClient(int clientId) {
     bool pubChanged = pubRemove != topic->publishers.end();
     topic->publishers.erase(pubRemove, topic->publishers.end());
 
-    auto subRemove =
-        std::remove_if(topic->subscribers.begin(), topic->subscribers.end(),
-                       [&](auto&& e) { return e->client == client.get(); });
-    bool subChanged = subRemove != topic->subscribers.end();
-    topic->subscribers.erase(subRemove, topic->subscribers.end());
+    bool subChanged = topic->RemoveSubscribers(client.get());
 
     if (!topic->IsPublished()) {
       toDelete.push_back(topic.get());
@@ -1626,6 +1829,49 @@ bool SImpl::PersistentChanged() {
   return rv;
 }
 
+static void CopyPersistentTopic(std::vector<PersistentTopic>* changes,
+                                const TopicData* topic) {
+  auto& change = changes->emplace_back();
+  change.id = topic->id;
+  if (topic->persistent && topic->lastValue) {
+    change.name = topic->name;
+    change.typeStr = topic->typeStr;
+    change.value = topic->lastValue;
+    change.properties = topic->properties;
+  }
+}
+
+void SImpl::GetPersistentChanges(std::vector<PersistentTopic>* changes,
+                                 bool all) {
+  if (all) {
+    for (auto&& topic : m_topics) {
+      topic->persistentDirty = false;
+      if (topic->persistent && topic->lastValue) {
+        CopyPersistentTopic(changes, topic.get());
+      }
+    }
+    m_persistentDirty.clear();
+    return;
+  }
+  // a topic that is not dirty was deleted, and its id may have since been
+  // reused by a topic that is not persistent; remove all of these first, as
+  // the id can also be in the list again for a new topic that is dirty
+  for (auto id : m_persistentDirty) {
+    TopicData* topic = id < m_topics.size() ? m_topics[id].get() : nullptr;
+    if (!topic || !topic->persistentDirty) {
+      changes->emplace_back().id = id;
+    }
+  }
+  for (auto id : m_persistentDirty) {
+    TopicData* topic = id < m_topics.size() ? m_topics[id].get() : nullptr;
+    if (topic && topic->persistentDirty) {
+      topic->persistentDirty = false;
+      CopyPersistentTopic(changes, topic);
+    }
+  }
+  m_persistentDirty.clear();
+}
+
 static void DumpValue(wpi::raw_ostream& os, const Value& value,
                       wpi::json::serializer& s) {
   switch (value.type()) {
@@ -1738,6 +1984,27 @@ static void DumpValue(wpi::raw_ostream& os, const Value& value,
   }
 }
 
+static void DumpPersistentTopic(wpi::raw_ostream& os,
+                                wpi::json::serializer& s, bool* first,
+                                std::string_view name, std::string_view typeStr,
+                                const Value& value,
+                                const wpi::json& properties) {
+  if (*first) {
+    *first = false;
+  } else {
+    os << ",\n";
+  }
+  os << "  {\n    \"name\": \"";
+  s.dump_escaped(name, false);
+  os << "\",\n    \"type\": \"";
+  s.dump_escaped(typeStr, false);
+  os << "\",\n    \"value\": ";
+  DumpValue(os, value, s);
+  os << ",\n    \"properties\": ";
+  s.dump(properties, true, false, 2, 4);
+  os << "\n  }";
+}
+
 void SImpl::DumpPersistent(wpi::raw_ostream& os) {
   wpi::json::serializer s{os, ' ', 16};
   os << "[\n";
@@ -1746,257 +2013,559 @@ void SImpl::DumpPersistent(wpi::raw_ostream& os) {
     if (!topic->persistent || !topic->lastValue) {
       continue;
     }
-    if (first) {
-      first = false;
-    } else {
-      os << ",\n";
-    }
-    os << "  {\n    \"name\": \"";
-    s.dump_escaped(topic->name, false);
-    os << "\",\n    \"type\": \"";
-    s.dump_escaped(topic->typeStr, false);
-    os << "\",\n    \"value\": ";
-    DumpValue(os, topic->lastValue, s);
-    os << ",\n    \"properties\": ";
-    s.dump(topic->properties, true, false, 2, 4);
-    os << "\n  }";
+    DumpPersistentTopic(os, s, &first, topic->name, topic->typeStr,
+                        topic->lastValue, topic->properties);
   }
   os << "\n]\n";
 }
 
-static std::string* ObjGetString(wpi::json::object_t& obj, std::string_view key,
-                                 std::string* error) {
-  auto it = obj.find(key);
-  if (it == obj.end()) {
-    *error = fmt::format("no {} key", key);
-    return nullptr;
-  }
-  auto val = it->second.get_ptr<std::string*>();
-  if (!val) {
-    *error = fmt::format("{} must be a string", key);
+void PersistentSnapshot::Update(std::vector<PersistentTopic>&& changes) {
+  for (auto&& change : changes) {
+    if (change.value) {
+      m_topics.insert_or_assign(change.id, std::move(change));
+    } else {
+      m_topics.erase(change.id);
+    }
   }
-  return val;
 }
 
-std::string SImpl::LoadPersistent(std::string_view in) {
-  if (in.empty()) {
-    return {};
+std::string PersistentSnapshot::Dump() const {
+  std::string rv;
+  wpi::raw_string_ostream os{rv};
+  wpi::json::serializer s{os, ' ', 16};
+  os << "[\n";
+  bool first = true;
+  for (auto&& [id, topic] : m_topics) {
+    DumpPersistentTopic(os, s, &first, topic.name, topic.typeStr, topic.value,
+                        topic.properties);
   }
+  os << "\n]\n";
+  os.flush();
+  return rv;
+}
 
-  wpi::json j;
-  try {
-    j = wpi::json::parse(in);
-  } catch (wpi::json::parse_error& err) {
-    return fmt::format("could not decode JSON: {}", err.what());
+namespace {
+
+// A scalar value of the persistent file, captured as the SAX parser reports
+// it.  The string storage is reused between entries.
+struct PersistentScalar {
+  enum Type {
+    kMissing,
+    kString,
+    kInteger,
+    kUnsigned,
+    kFloat,
+    kBoolean,
+    kOther
+  };
+
+  Type type = kMissing;
+  std::string str;
+  union {
+    int64_t i;
+    uint64_t u;
+    double d;
+    bool b;
+  };
+};
+
+// The fields of a single persistent file entry.  Keys may appear in any
+// order (e.g. value before type), so everything is captured first and the
+// entry is converted once its object ends.
+struct PersistentEntry {
+  void Reset() {
+    name.type = PersistentScalar::kMissing;
+    type.type = PersistentScalar::kMissing;
+    hasProperties = false;
+    propertiesOk = false;
+    value.type = PersistentScalar::kMissing;
+    valueIsArray = false;
+    numElems = 0;
+  }
+
+  PersistentScalar name;
+  PersistentScalar type;
+  bool hasProperties = false;
+  bool propertiesOk = false;
+  wpi::json properties;
+  PersistentScalar value;  // kOther if an object or array
+  bool valueIsArray = false;
+  std::vector<PersistentScalar> elems;  // first numElems are valid
+  size_t numElems = 0;
+};
+
+// A topic decoded from the persistent file.
+struct PersistentLoadTopic {
+  std::string name;
+  std::string typeStr;
+  wpi::json properties;
+  Value value;
+};
+
+// Decodes the persistent file (a JSON array of topic objects) directly from
+// the SAX events, without building a DOM for the file; only each entry's
+// properties object is materialized.  Topics are collected rather than
+// created so that a parse error partway through leaves the server unchanged.
+//
+// Nesting levels that are decoded: 1 = top-level array, 2 = entry object,
+// 3 = value array.  Anything else is skipped.
+class PersistentLoader final : public wpi::json::json_sax {
+ public:
+  explicit PersistentLoader(int64_t time) : m_time{time} {}
+
+  // true if the top level value was an array
+  bool IsArray() const { return m_isArray; }
+
+  std::vector<PersistentLoadTopic> topics;
+  std::string errors;  // newline-separated
+
+  bool null() override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(nullptr);
+      } else {
+        Scalar(PersistentScalar::kOther);
+      }
+    }
+    return true;
   }
 
-  if (!j.is_array()) {
-    return "expected JSON array at top level";
+  bool boolean(bool val) override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(val);
+      } else if (auto v = Scalar(PersistentScalar::kBoolean)) {
+        v->b = val;
+      }
+    }
+    return true;
   }
 
-  bool persistentChanged = m_persistentChanged;
+  bool number_integer(int64_t val) override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(val);
+      } else if (auto v = Scalar(PersistentScalar::kInteger)) {
+        v->i = val;
+      }
+    }
+    return true;
+  }
 
-  std::string allerrors;
-  int i = -1;
-  auto time = nt::Now();
-  for (auto&& jitem : j) {
-    ++i;
-    std::string error;
-    {
-      auto obj = jitem.get_ptr<wpi::json::object_t*>();
-      if (!obj) {
-        error = "expected item to be an object";
-        goto err;
+  bool number_unsigned(uint64_t val) override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(val);
+      } else if (auto v = Scalar(PersistentScalar::kUnsigned)) {
+        v->u = val;
       }
+    }
+    return true;
+  }
 
-      // name
-      auto name = ObjGetString(*obj, "name", &error);
-      if (!name) {
-        goto err;
+  bool number_float(double val) override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(val);
+      } else if (auto v = Scalar(PersistentScalar::kFloat)) {
+        v->d = val;
       }
+    }
+    return true;
+  }
 
-      // type
-      auto typeStr = ObjGetString(*obj, "type", &error);
-      if (!typeStr) {
-        goto err;
+  bool string(std::string_view val) override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(val);
+      } else if (auto v = Scalar(PersistentScalar::kString)) {
+        v->str.assign(val);
       }
+    }
+    return true;
+  }
 
-      // properties
-      auto propsIt = obj->find("properties");
-      if (propsIt == obj->end()) {
-        error = "no properties key";
-        goto err;
+  bool start_object() override { return StartContainer(true); }
+
+  bool key(std::string_view key) override {
+    if (m_skip != 0) {
+      return true;
+    }
+    if (!m_build.empty()) {
+      m_buildKey.assign(key);
+      return true;
+    }
+    m_field = kNone;
+    if (m_depth == 2) {
+      if (key == "name") {
+        m_field = kName;
+      } else if (key == "type") {
+        m_field = kType;
+      } else if (key == "value") {
+        m_field = kValue;
+      } else if (key == "properties") {
+        m_field = kProperties;
       }
-      auto& props = propsIt->second;
-      if (!props.is_object()) {
-        error = "properties must be an object";
-        goto err;
+    }
+    return true;
+  }
+
+  bool end_object() override { return EndContainer(); }
+
+  bool start_array() override { return StartContainer(false); }
+
+  bool end_array() override { return EndContainer(); }
+
+ private:
+  enum Field { kNone, kName, kType, kValue, kProperties };
+
+  PersistentScalar* NextElem() {
+    if (m_entry.elems.size() <= m_entry.numElems) {
+      m_entry.elems.resize(m_entry.numElems + 1);
+    }
+    return &m_entry.elems[m_entry.numElems++];
+  }
+
+  // Handles a scalar value outside of a JSON value being built; returns
+  // where to store it, if anywhere.
+  PersistentScalar* Scalar(PersistentScalar::Type type) {
+    if (m_depth == 0) {
+      return nullptr;
+    }
+    if (m_depth == 1) {
+      Error("expected item to be an object");
+      return nullptr;
+    }
+    PersistentScalar* v = nullptr;
+    if (m_depth == 3) {
+      v = NextElem();
+    } else {
+      Field field = m_field;
+      m_field = kNone;
+      switch (field) {
+        case kName:
+          v = &m_entry.name;
+          break;
+        case kType:
+          v = &m_entry.type;
+          break;
+        case kValue:
+          v = &m_entry.value;
+          m_entry.valueIsArray = false;
+          break;
+        case kProperties:
+          m_entry.hasProperties = true;
+          m_entry.propertiesOk = false;
+          break;
+        default:
+          break;
       }
+    }
+    if (v) {
+      v->type = type;
+    }
+    return v;
+  }
 
-      // check to make sure persistent property is set
-      auto persistentIt = props.find("persistent");
-      if (persistentIt == props.end()) {
-        error = "no persistent property";
-        goto err;
+  bool StartContainer(bool isObject) {
+    if (m_skip != 0) {
+      ++m_skip;
+      return true;
+    }
+    if (!m_build.empty()) {
+      BuildContainer(isObject);
+      return true;
+    }
+    if (m_depth == 0) {
+      m_isArray = !isObject;
+      if (m_isArray) {
+        m_depth = 1;
+      } else {
+        m_skip = 1;
       }
-      if (auto v = persistentIt->get_ptr<bool*>()) {
-        if (!*v) {
-          error = "persistent property is false";
-          goto err;
-        }
+      return true;
+    }
+    if (m_depth == 1) {
+      if (isObject) {
+        m_entry.Reset();
+        m_field = kNone;
+        m_depth = 2;
       } else {
-        error = "persistent property is not boolean";
-        goto err;
+        Error("expected item to be an object");
+        m_skip = 1;
       }
+      return true;
+    }
+    if (m_depth == 3) {
+      NextElem()->type = PersistentScalar::kOther;
+      m_skip = 1;
+      return true;
+    }
 
-      // value
-      auto valueIt = obj->find("value");
-      if (valueIt == obj->end()) {
-        error = "no value key";
-        goto err;
-      }
-      Value value;
-      if (*typeStr == "boolean") {
-        if (auto v = valueIt->second.get_ptr<bool*>()) {
-          value = Value::MakeBoolean(*v, time);
-        } else {
-          error = "value type mismatch, expected boolean";
-          goto err;
-        }
-      } else if (*typeStr == "int") {
-        if (auto v = valueIt->second.get_ptr<int64_t*>()) {
-          value = Value::MakeInteger(*v, time);
-        } else if (auto v = valueIt->second.get_ptr<uint64_t*>()) {
-          value = Value::MakeInteger(*v, time);
-        } else {
-          error = "value type mismatch, expected int";
-          goto err;
-        }
-      } else if (*typeStr == "float") {
-        if (auto v = valueIt->second.get_ptr<double*>()) {
-          value = Value::MakeFloat(*v, time);
-        } else {
-          error = "value type mismatch, expected float";
-          goto err;
-        }
-      } else if (*typeStr == "double") {
-        if (auto v = valueIt->second.get_ptr<double*>()) {
-          value = Value::MakeDouble(*v, time);
-        } else {
-          error = "value type mismatch, expected double";
-          goto err;
-        }
-      } else if (*typeStr == "string" || *typeStr == "json") {
-        if (auto v = valueIt->second.get_ptr<std::string*>()) {
-          value = Value::MakeString(*v, time);
-        } else {
-          error = "value type mismatch, expected string";
-          goto err;
-        }
-      } else if (*typeStr == "boolean[]") {
-        auto arr = valueIt->second.get_ptr<wpi::json::array_t*>();
-        if (!arr) {
-          error = "value type mismatch, expected array";
-          goto err;
+    Field field = m_field;
+    m_field = kNone;
+    switch (field) {
+      case kName:
+        m_entry.name.type = PersistentScalar::kOther;
+        break;
+      case kType:
+        m_entry.type.type = PersistentScalar::kOther;
+        break;
+      case kValue:
+        m_entry.value.type = PersistentScalar::kOther;
+        m_entry.valueIsArray = !isObject;
+        if (!isObject) {
+          m_entry.numElems = 0;
+          m_depth = 3;
+          return true;
         }
-        std::vector<int> elems;
-        for (auto&& jelem : valueIt->second) {
-          if (auto v = jelem.get_ptr<bool*>()) {
-            elems.push_back(*v);
-          } else {
-            error = "value type mismatch, expected boolean";
-          }
-        }
-        value = Value::MakeBooleanArray(elems, time);
-      } else if (*typeStr == "int[]") {
-        auto arr = valueIt->second.get_ptr<wpi::json::array_t*>();
-        if (!arr) {
-          error = "value type mismatch, expected array";
-          goto err;
+        break;
+      case kProperties:
+        m_entry.hasProperties = true;
+        m_entry.propertiesOk = isObject;
+        if (isObject) {
+          m_entry.properties = wpi::json::object();
+          m_build.push_back(&m_entry.properties);
+          return true;
         }
-        std::vector<int64_t> elems;
-        for (auto&& jelem : valueIt->second) {
-          if (auto v = jelem.get_ptr<int64_t*>()) {
-            elems.push_back(*v);
-          } else if (auto v = jelem.get_ptr<uint64_t*>()) {
-            elems.push_back(*v);
-          } else {
-            error = "value type mismatch, expected int";
+        break;
+      default:
+        break;
+    }
+    m_skip = 1;
+    return true;
+  }
+
+  bool EndContainer() {
+    if (m_skip != 0) {
+      --m_skip;
+      return true;
+    }
+    if (!m_build.empty()) {
+      m_build.pop_back();
+      return true;
+    }
+    if (m_depth == 2) {
+      auto error = AddTopic();
+      if (!error.empty()) {
+        Error(error);
+      } else {
+        ++m_index;
+      }
+    }
+    if (m_depth > 0) {
+      --m_depth;
+    }
+    return true;
+  }
+
+  void Error(std::string_view error) {
+    errors += fmt::format("{}: {}\n", m_index, error);
+    ++m_index;
+  }
+
+  // Checks the captured entry and converts its value; returns an error, or
+  // an empty string if the topic was added.
+  std::string_view AddTopic() {
+    const auto& name = m_entry.name;
+    if (name.type == PersistentScalar::kMissing) {
+      return "no name key";
+    } else if (name.type != PersistentScalar::kString) {
+      return "name must be a string";
+    }
+    const auto& type = m_entry.type;
+    if (type.type == PersistentScalar::kMissing) {
+      return "no type key";
+    } else if (type.type != PersistentScalar::kString) {
+      return "type must be a string";
+    }
+    if (!m_entry.hasProperties) {
+      return "no properties key";
+    } else if (!m_entry.propertiesOk) {
+      return "properties must be an object";
+    }
+
+    // check to make sure persistent property is set
+    auto& props = m_entry.properties;
+    auto persistentIt = props.find("persistent");
+    if (persistentIt == props.end()) {
+      return "no persistent property";
+    }
+    if (auto v = persistentIt->get_ptr<bool*>()) {
+      if (!*v) {
+        return "persistent property is false";
+      }
+    } else {
+      return "persistent property is not boolean";
+    }
+
+    // value
+    const auto& val = m_entry.value;
+    if (val.type == PersistentScalar::kMissing) {
+      return "no value key";
+    }
+    std::span<const PersistentScalar> elems{m_entry.elems.data(),
+                                            m_entry.numElems};
+    std::string_view typeStr = type.str;
+    Value value;
+    if (typeStr == "boolean") {
+      if (val.type != PersistentScalar::kBoolean) {
+        return "value type mismatch, expected boolean";
+      }
+      value = Value::MakeBoolean(val.b, m_time);
+    } else if (typeStr == "int") {
+      if (val.type == PersistentScalar::kInteger) {
+        value = Value::MakeInteger(val.i, m_time);
+      } else if (val.type == PersistentScalar::kUnsigned) {
+        value = Value::MakeInteger(val.u, m_time);
+      } else {
+        return "value type mismatch, expected int";
+      }
+    } else if (typeStr == "float") {
+      if (val.type != PersistentScalar::kFloat) {
+        return "value type mismatch, expected float";
+      }
+      value = Value::MakeFloat(val.d, m_time);
+    } else if (typeStr == "double") {
+      if (val.type != PersistentScalar::kFloat) {
+        return "value type mismatch, expected double";
+      }
+      value = Value::MakeDouble(val.d, m_time);
+    } else if (typeStr == "string" || typeStr == "json") {
+      if (val.type != PersistentScalar::kString) {
+        return "value type mismatch, expected string";
+      }
+      value = Value::MakeString(val.str, m_time);
+    } else if (typeStr == "boolean[]" || typeStr == "int[]" ||
+               typeStr == "double[]" || typeStr == "float[]" ||
+               typeStr == "string[]") {
+      if (!m_entry.valueIsArray) {
+        return "value type mismatch, expected array";
+      }
+      // elements of the wrong type are skipped
+      if (typeStr == "boolean[]") {
+        std::vector<int> arr;
+        arr.reserve(elems.size());
+        for (auto&& elem : elems) {
+          if (elem.type == PersistentScalar::kBoolean) {
+            arr.push_back(elem.b);
           }
         }
-        value = Value::MakeIntegerArray(elems, time);
-      } else if (*typeStr == "double[]") {
-        auto arr = valueIt->second.get_ptr<wpi::json::array_t*>();
-        if (!arr) {
-          error = "value type mismatch, expected array";
-          goto err;
-        }
-        std::vector<double> elems;
-        for (auto&& jelem : valueIt->second) {
-          if (auto v = jelem.get_ptr<double*>()) {
-            elems.push_back(*v);
-          } else {
-            error = "value type mismatch, expected double";
+        value = Value::MakeBooleanArray(std::move(arr), m_time);
+      } else if (typeStr == "int[]") {
+        std::vector<int64_t> arr;
+        arr.reserve(elems.size());
+        for (auto&& elem : elems) {
+          if (elem.type == PersistentScalar::kInteger) {
+            arr.push_back(elem.i);
+          } else if (elem.type == PersistentScalar::kUnsigned) {
+            arr.push_back(elem.u);
           }
         }
-        value = Value::MakeDoubleArray(elems, time);
-      } else if (*typeStr == "float[]") {
-        auto arr = valueIt->second.get_ptr<wpi::json::array_t*>();
-        if (!arr) {
-          error = "value type mismatch, expected array";
-          goto err;
-        }
-        std::vector<float> elems;
-        for (auto&& jelem : valueIt->second) {
-          if (auto v = jelem.get_ptr<double*>()) {
-            elems.push_back(*v);
-          } else {
-            error = "value type mismatch, expected float";
+        value = Value::MakeIntegerArray(std::move(arr), m_time);
+      } else if (typeStr == "double[]") {
+        std::vector<double> arr;
+        arr.reserve(elems.size());
+        for (auto&& elem : elems) {
+          if (elem.type == PersistentScalar::kFloat) {
+            arr.push_back(elem.d);
           }
         }
-        value = Value::MakeFloatArray(elems, time);
-      } else if (*typeStr == "string[]") {
-        auto arr = valueIt->second.get_ptr<wpi::json::array_t*>();
-        if (!arr) {
-          error = "value type mismatch, expected array";
-          goto err;
-        }
-        std::vector<std::string> elems;
-        for (auto&& jelem : valueIt->second) {
-          if (auto v = jelem.get_ptr<std::string*>()) {
-            elems.emplace_back(*v);
-          } else {
-            error = "value type mismatch, expected string";
+        value = Value::MakeDoubleArray(std::move(arr), m_time);
+      } else if (typeStr == "float[]") {
+        std::vector<float> arr;
+        arr.reserve(elems.size());
+        for (auto&& elem : elems) {
+          if (elem.type == PersistentScalar::kFloat) {
+            arr.push_back(elem.d);
           }
         }
-        value = Value::MakeStringArray(std::move(elems), time);
+        value = Value::MakeFloatArray(std::move(arr), m_time);
       } else {
-        // raw
-        if (auto v = valueIt->second.get_ptr<std::string*>()) {
-          std::vector<uint8_t> data;
-          wpi::Base64Decode(*v, &data);
-          value = Value::MakeRaw(std::move(data), time);
-        } else {
-          error = "value type mismatch, expected string";
-          goto err;
+        std::vector<std::string> arr;
+        arr.reserve(elems.size());
+        for (auto&& elem : elems) {
+          if (elem.type == PersistentScalar::kString) {
+            arr.emplace_back(elem.str);
+          }
         }
+        value = Value::MakeStringArray(std::move(arr), m_time);
       }
+    } else {
+      // raw
+      if (val.type != PersistentScalar::kString) {
+        return "value type mismatch, expected string";
+      }
+      std::vector<uint8_t> data;
+      wpi::Base64Decode(val.str, &data);
+      value = Value::MakeRaw(std::move(data), m_time);
+    }
 
-      // create persistent topic
-      auto topic = CreateTopic(nullptr, *name, *typeStr, props);
-
-      // set value
-      SetValue(nullptr, topic, value);
+    topics.emplace_back(PersistentLoadTopic{
+        name.str, type.str, std::move(props), std::move(value)});
+    return {};
+  }
 
-      continue;
+  // adds a value to the JSON value currently being built
+  template <typename V>
+  wpi::json& BuildValue(V&& val) {
+    wpi::json& parent = *m_build.back();
+    if (parent.is_object()) {
+      return parent[m_buildKey] = std::forward<V>(val);
+    } else {
+      parent.push_back(std::forward<V>(val));
+      return parent.back();
     }
-  err:
-    allerrors += fmt::format("{}: {}\n", i, error);
+  }
+
+  void BuildContainer(bool isObject) {
+    m_build.push_back(&BuildValue(isObject ? wpi::json::object()
+                                           : wpi::json::array()));
+  }
+
+  int64_t m_time;
+  PersistentEntry m_entry;
+  int m_index = 0;
+  int m_depth = 0;
+  int m_skip = 0;
+  bool m_isArray = false;
+  Field m_field = kNone;
+  wpi::SmallVector<wpi::json*, 4> m_build;
+  std::string m_buildKey;
+};
+
+}  // namespace
+
+std::string SImpl::LoadPersistent(std::string_view in) {
+  if (in.empty()) {
+    return {};
+  }
+
+  PersistentLoader loader{nt::Now()};
+  try {
+    wpi::json::sax_parse(in, &loader);
+  } catch (wpi::json::parse_error& err) {
+    return fmt::format("could not decode JSON: {}", err.what());
+  }
+
+  if (!loader.IsArray()) {
+    return "expected JSON array at top level";
+  }
+
+  bool persistentChanged = m_persistentChanged;
+
+  for (auto&& entry : loader.topics) {
+    // create persistent topic
+    auto topic = CreateTopic(nullptr, entry.name, entry.typeStr,
+                             entry.properties);
+
+    // set value
+    SetValue(nullptr, topic, entry.value);
   }
 
   m_persistentChanged = persistentChanged;  // restore flag
 
-  return allerrors;
+  return std::move(loader.errors);
 }
 
 TopicData* SImpl::CreateTopic(ClientData* client, std::string_view name,
@@ -2028,7 +2597,7 @@ TopicData* SImpl::CreateTopic(ClientData* client, std::string_view name,
       auto subscribers =
           aClient->GetSubscribers(name, topic->special, subscribersBuf);
       for (auto subscriber : subscribers) {
-        topic->subscribers.Add(subscriber);
+        topic->AddSubscriber(subscriber);
       }
 
       // don't announce to this client if no subscribers
@@ -2046,8 +2615,10 @@ TopicData* SImpl::CreateTopic(ClientData* client, std::string_view name,
 
     // create meta topics; don't create if topic is itself a meta topic
     if (!special) {
-      topic->metaPub = CreateMetaTopic(fmt::format("$pub${}", name));
-      topic->metaSub = CreateMetaTopic(fmt::format("$sub${}", name));
+      topic->metaPub =
+          CreateMetaTopic(fmt::format("$pub${}", name), topic, nullptr, true);
+      topic->metaSub =
+          CreateMetaTopic(fmt::format("$sub${}", name), topic, nullptr, false);
       UpdateMetaTopicPub(topic);
       UpdateMetaTopicSub(topic);
     }
@@ -2060,6 +2631,15 @@ TopicData* SImpl::CreateMetaTopic(std::string_view name) {
   return CreateTopic(nullptr, name, "msgpack", {{"retained", true}}, true);
 }
 
+TopicData* SImpl::CreateMetaTopic(std::string_view name, TopicData* ofTopic,
+                                  ClientData* ofClient, bool pub) {
+  auto meta = CreateMetaTopic(name);
+  meta->metaOfTopic = ofTopic;
+  meta->metaOfClient = ofClient;
+  meta->metaIsPub = pub;
+  return meta;
+}
+
 void SImpl::DeleteTopic(TopicData* topic) {
   if (!topic) {
     return;
@@ -2089,19 +2669,30 @@ void SImpl::DeleteTopic(TopicData* topic) {
   }
 
   // erase the topic
+  if (topic->persistent) {
+    MarkPersistentDirty(topic);
+  }
   m_nameTopics.erase(topic->name);
   m_topics.erase(topic->id);
 }
 
+void SImpl::MarkPersistentDirty(TopicData* topic) {
+  m_persistentChanged = true;
+  if (!topic->persistentDirty) {
+    topic->persistentDirty = true;
+    m_persistentDirty.emplace_back(topic->id);
+  }
+}
+
 void SImpl::SetProperties(ClientData* client, TopicData* topic,
                           const wpi::json& update) {
   DEBUG4("SetProperties({}, {}, {})", client ? client->GetId() : -1,
          topic->name, update.dump());
   bool wasPersistent = topic->persistent;
   if (topic->SetProperties(update)) {
-    // update persistentChanged flag
-    if (topic->persistent != wasPersistent) {
-      m_persistentChanged = true;
+    // properties are saved with persistent topics
+    if (topic->persistent || wasPersistent) {
+      MarkPersistentDirty(topic);
     }
     PropertiesChanged(client, topic, update);
   }
@@ -2112,7 +2703,7 @@ void SImpl::SetFlags(ClientData* client, TopicData* topic, unsigned int flags) {
   if (topic->SetFlags(flags)) {
     // update persistentChanged flag
     if (topic->persistent != wasPersistent) {
-      m_persistentChanged = true;
+      MarkPersistentDirty(topic);
       wpi::json update;
       if (topic->persistent) {
         update = {{"persistent", true}};
@@ -2124,7 +2715,8 @@ void SImpl::SetFlags(ClientData* client, TopicData* topic, unsigned int flags) {
   }
 }
 
-void SImpl::SetValue(ClientData* client, TopicData* topic, const Value& value) {
+void SImpl::UpdateLastValue(ClientData* client, TopicData* topic,
+                            const Value& value) {
   // update retained value if from same client or timestamp newer
   if (!topic->lastValue || topic->lastValueClient == client ||
       topic->lastValue.time() == 0 || value.time() >= topic->lastValue.time()) {
@@ -2135,38 +2727,82 @@ void SImpl::SetValue(ClientData* client, TopicData* topic, const Value& value) {
 
     // if persistent, update flag
     if (topic->persistent) {
-      m_persistentChanged = true;
+      MarkPersistentDirty(topic);
     }
   }
+}
 
-  // propagate to subscribers; as each client may have multiple subscribers,
-  // but we only want to send the value once, first map to clients and then
-  // take action based on union of subscriptions
+void SImpl::SetValue(ClientData* client, TopicData* topic, const Value& value) {
+  UpdateLastValue(client, topic, value);
 
-  // indexed by clientId
-  wpi::SmallVector<ClientData::SendMode, 16> toSend;
-  toSend.resize(m_clients.size());
+  // propagate to subscribers
+  for (auto&& [id, mode] : topic->GetSendModes()) {
+    auto aClient = m_clients[id].get();
+    if (!aClient || client == aClient) {
+      continue;  // don't echo back
+    }
+    aClient->SendValue(topic, value, mode);
+  }
+}
 
-  for (auto&& subscriber : topic->subscribers) {
-    int id = subscriber->client->GetId();
-    if (subscriber->options.topicsOnly) {
-      continue;
-    } else if (subscriber->options.sendAll) {
-      toSend[id] = ClientData::kSendAll;
-    } else if (toSend[id] != ClientData::kSendAll) {
-      toSend[id] = ClientData::kSendNormal;
+void SImpl::SetValues(ClientData* client,
+                      std::span<const IncomingValue> values) {
+  if (values.size() == 1) {
+    SetValue(client, values[0].topic, values[0].value);
+    return;
+  }
+
+  // update retained values in order, and number the distinct topics
+  for (size_t i = 0; i < values.size(); ++i) {
+    auto topic = values[i].topic;
+    UpdateLastValue(client, topic, values[i].value);
+    if (topic->batchIndex < 0) {
+      topic->batchIndex = m_batchTopics.size();
+      m_batchTopics.emplace_back(topic);
     }
+    topic->batchLast = i;
   }
 
-  for (size_t i = 0, iend = toSend.size(); i < iend; ++i) {
-    auto aClient = m_clients[i].get();
+  // send modes, indexed by [batchIndex * numClients + clientId]
+  size_t numClients = m_clients.size();
+  m_batchModes.assign(m_batchTopics.size() * numClients,
+                      ClientData::kSendDisabled);
+  for (size_t i = 0; i < m_batchTopics.size(); ++i) {
+    for (auto&& [id, mode] : m_batchTopics[i]->GetSendModes()) {
+      m_batchModes[i * numClients + id] = mode;
+    }
+  }
+
+  // one pass per destination client, so all of its updates are queued (or
+  // written) together; only sendAll subscribers get values that are
+  // superseded later in the batch
+  m_sendingBatch = true;
+  for (size_t id = 0; id < numClients; ++id) {
+    auto aClient = m_clients[id].get();
     if (!aClient || client == aClient) {
       continue;  // don't echo back
     }
-    if (toSend[i] != ClientData::kSendDisabled) {
-      aClient->SendValue(topic, value, toSend[i]);
+    bool sent = false;
+    for (size_t i = 0; i < values.size(); ++i) {
+      auto topic = values[i].topic;
+      auto mode = m_batchModes[topic->batchIndex * numClients + id];
+      if (mode == ClientData::kSendDisabled ||
+          (mode != ClientData::kSendAll && topic->batchLast != i)) {
+        continue;
+      }
+      aClient->SendValue(topic, values[i].value, mode);
+      sent = true;
+    }
+    if (sent && aClient->IsLocal()) {
+      aClient->Flush();
     }
   }
+  m_sendingBatch = false;
+
+  for (auto topic : m_batchTopics) {
+    topic->batchIndex = -1;
+  }
+  m_batchTopics.clear();
 }
 
 void SImpl::UpdateMetaClients(const std::vector<ConnectionInfo>& conns) {
@@ -2191,6 +2827,55 @@ void SImpl::UpdateMetaClients(const std::vector<ConnectionInfo>& conns) {
 }
 
 void SImpl::UpdateMetaTopicPub(TopicData* topic) {
+  MarkMetaDirty(topic->metaPub);
+}
+
+void SImpl::UpdateMetaTopicSub(TopicData* topic) {
+  MarkMetaDirty(topic->metaSub);
+}
+
+void SImpl::MarkMetaDirty(TopicData* meta) {
+  if (!meta || meta->metaDirty) {
+    return;
+  }
+  meta->metaDirty = true;
+  m_metaDirty.emplace_back(meta->id);
+}
+
+void SImpl::UpdateMetaTopics() {
+  // meta topics without subscribers are left dirty, and are queued again
+  // when something subscribes to them; the ids may refer to since deleted
+  // (or reused) topics, so check the flag
+  for (auto id : m_metaDirty) {
+    if (id >= m_topics.size()) {
+      continue;
+    }
+    auto meta = m_topics[id].get();
+    if (meta && meta->metaDirty && !meta->subscribers.empty()) {
+      RebuildMetaTopic(meta);
+    }
+  }
+  m_metaDirty.clear();
+}
+
+void SImpl::RebuildMetaTopic(TopicData* meta) {
+  meta->metaDirty = false;
+  if (meta->metaOfTopic) {
+    if (meta->metaIsPub) {
+      RebuildMetaTopicPub(meta->metaOfTopic);
+    } else {
+      RebuildMetaTopicSub(meta->metaOfTopic);
+    }
+  } else if (meta->metaOfClient) {
+    if (meta->metaIsPub) {
+      meta->metaOfClient->RebuildMetaClientPub();
+    } else {
+      meta->metaOfClient->RebuildMetaClientSub();
+    }
+  }
+}
+
+void SImpl::RebuildMetaTopicPub(TopicData* topic) {
   if (!topic->metaPub) {
     return;
   }
@@ -2214,7 +2899,7 @@ void SImpl::UpdateMetaTopicPub(TopicData* topic) {
   }
 }
 
-void SImpl::UpdateMetaTopicSub(TopicData* topic) {
+void SImpl::RebuildMetaTopicSub(TopicData* topic) {
   if (!topic->metaSub) {
     return;
   }
@@ -2274,6 +2959,8 @@ ServerImpl::ServerImpl(wpi::Logger& logger)
 ServerImpl::~ServerImpl() = default;
 
 void ServerImpl::SendControl(uint64_t curTimeMs) {
+  m_impl->UpdateMetaTopics();
+
   if (!m_impl->m_controlReady) {
     return;
   }
@@ -2308,8 +2995,10 @@ void ServerImpl::SetLocal(LocalInterface* local) {
   m_impl->m_metaClients = m_impl->CreateMetaTopic("$clients");
 
   // create local client meta topics
-  m_impl->m_localClient->m_metaPub = m_impl->CreateMetaTopic("$serverpub");
-  m_impl->m_localClient->m_metaSub = m_impl->CreateMetaTopic("$serversub");
+  m_impl->m_localClient->m_metaPub = m_impl->CreateMetaTopic(
+      "$serverpub", nullptr, m_impl->m_localClient, true);
+  m_impl->m_localClient->m_metaSub = m_impl->CreateMetaTopic(
+      "$serversub", nullptr, m_impl->m_localClient, false);
 
   // update meta topics
   m_impl->m_localClient->UpdateMetaClientPub();
@@ -2329,8 +3018,10 @@ std::pair<std::string, int> ServerImpl::AddClient(std::string_view name,
                                                   std::string_view connInfo,
                                                   bool local,
                                                   WireConnection& wire,
-                                                  SetPeriodicFunc setPeriodic) {
-  return m_impl->AddClient(name, connInfo, local, wire, std::move(setPeriodic));
+                                                  SetPeriodicFunc setPeriodic,
+                                                  bool binaryControl) {
+  return m_impl->AddClient(name, connInfo, local, wire, std::move(setPeriodic),
+                           binaryControl);
 }
 
 int ServerImpl::AddClient3(std::string_view connInfo, bool local,
@@ -2353,6 +3044,11 @@ bool ServerImpl::PersistentChanged() {
   return m_impl->PersistentChanged();
 }
 
+void ServerImpl::GetPersistentChanges(std::vector<PersistentTopic>* changes,
+                                      bool all) {
+  m_impl->GetPersistentChanges(changes, all);
+}
+
 std::string ServerImpl::DumpPersistent() {
   std::string rv;
   wpi::raw_string_ostream os{rv};
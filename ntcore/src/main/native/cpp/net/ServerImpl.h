@@ -7,6 +7,7 @@
 #include <stdint.h>
 
 #include <functional>
+#include <map>
 #include <memory>
 #include <span>
 #include <string>
@@ -14,8 +15,11 @@
 #include <utility>
 #include <vector>
 
+#include <wpi/json.h>
+
 #include "NetworkInterface.h"
 #include "net3/WireConnection3.h"
+#include "networktables/NetworkTableValue.h"
 
 namespace wpi {
 class Logger;
@@ -31,6 +35,29 @@ struct ClientMessage;
 class LocalInterface;
 class WireConnection;
 
+// A persistent topic's saved state.  An empty value means the topic is no
+// longer saved (it was deleted, made non-persistent, or has no value).
+struct PersistentTopic {
+  unsigned int id;
+  std::string name;
+  std::string typeStr;
+  Value value;
+  wpi::json properties;
+};
+
+// A copy of the persistent topics that is kept up to date from the changed
+// topics only (see ServerImpl::GetPersistentChanges()) and serialized to the
+// persistent file format independently of the server.
+class PersistentSnapshot {
+ public:
+  // applies changes in order (later changes to a topic win)
+  void Update(std::vector<PersistentTopic>&& changes);
+  std::string Dump() const;
+
+ private:
+  std::map<unsigned int, PersistentTopic> m_topics;  // keyed by topic id
+};
+
 class ServerImpl final {
  public:
   using SetPeriodicFunc = std::function<void(uint32_t repeatMs)>;
@@ -51,10 +78,12 @@ class ServerImpl final {
 
   // Returns -1 if cannot add client (e.g. due to duplicate name).
   // Caller must ensure WireConnection lifetime lasts until RemoveClient() call.
+  // If binaryControl is true, the client negotiated kBinaryControlProtocol.
   std::pair<std::string, int> AddClient(std::string_view name,
                                         std::string_view connInfo, bool local,
                                         WireConnection& wire,
-                                        SetPeriodicFunc setPeriodic);
+                                        SetPeriodicFunc setPeriodic,
+                                        bool binaryControl = false);
   int AddClient3(std::string_view connInfo, bool local,
                  net3::WireConnection3& wire, Connected3Func connected,
                  SetPeriodicFunc setPeriodic);
@@ -64,6 +93,10 @@ class ServerImpl final {
 
   // if any persistent values changed since the last call to this function
   bool PersistentChanged();
+  // appends copies of the persistent topics that changed since the last call
+  // to this function; if all is true, appends every persistent topic
+  void GetPersistentChanges(std::vector<PersistentTopic>* changes,
+                            bool all = false);
   std::string DumpPersistent();
   // returns newline-separated errors
   std::string LoadPersistent(std::string_view in);
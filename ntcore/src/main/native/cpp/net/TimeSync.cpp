@@ -0,0 +1,98 @@
+// Copyright (c) FIRST and other WPILib contributors.
+// Open Source Software; you can modify and/or share it under the terms of
+// the WPILib BSD license file in the root directory of this project.
+
+#include "TimeSync.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace nt::net;
+
+// minimum time span of the history before drift is estimated
+static constexpr int64_t kMinDriftSpanUs = 10000000;
+
+// drift estimates beyond this are assumed to be bad samples (crystal
+// oscillators are typically within 100 ppm)
+static constexpr double kMaxDrift = 0.001;
+
+bool TimeSync::AddSample(int64_t sendTime, int64_t serverTime,
+                         int64_t recvTime) {
+  if (recvTime < sendTime) {
+    return false;
+  }
+  int64_t rtt2 = (recvTime - sendTime) / 2;
+  int64_t midpoint = recvTime - rtt2;
+
+  size_t pos = m_sampleCount % kWindowSize;
+  m_window[pos] = {midpoint, serverTime - midpoint, rtt2};
+  ++m_sampleCount;
+
+  // pick the lowest RTT in the window, preferring the newest sample on ties
+  m_best = pos;
+  size_t count = (std::min)(m_sampleCount, uint64_t{kWindowSize});
+  for (size_t i = 0; i < count; ++i) {
+    if (m_window[i].rtt2 < m_window[m_best].rtt2) {
+      m_best = i;
+    }
+  }
+
+  // every time the window has been completely replaced, its best sample
+  // becomes a drift estimation point
+  if ((m_sampleCount % kWindowSize) == 0) {
+    m_history[m_historyCount % kHistorySize] = m_window[m_best];
+    ++m_historyCount;
+    UpdateDrift();
+  }
+
+  // back off the ping rate once the window is full
+  if (m_sampleCount >= kWindowSize) {
+    m_pingIntervalMs = (std::min)(m_pingIntervalMs * 2, kPingIntervalMs);
+  }
+  return true;
+}
+
+int64_t TimeSync::GetOffset(int64_t now) const {
+  auto& best = m_window[m_best];
+  return best.offset + std::llround(m_drift * (now - best.time));
+}
+
+void TimeSync::UpdateDrift() {
+  size_t count = (std::min)(m_historyCount, kHistorySize);
+  if (count < 2) {
+    return;
+  }
+
+  // work relative to the first point to keep precision
+  auto& first = m_history[0];
+  int64_t minTime = 0;
+  int64_t maxTime = 0;
+  double meanTime = 0;
+  double meanOffset = 0;
+  for (size_t i = 0; i < count; ++i) {
+    int64_t time = m_history[i].time - first.time;
+    minTime = (std::min)(minTime, time);
+    maxTime = (std::max)(maxTime, time);
+    meanTime += time;
+    meanOffset += m_history[i].offset - first.offset;
+  }
+  if ((maxTime - minTime) < kMinDriftSpanUs) {
+    return;
+  }
+  meanTime /= count;
+  meanOffset /= count;
+
+  // least squares slope of offset vs time
+  double sumTT = 0;
+  double sumTO = 0;
+  for (size_t i = 0; i < count; ++i) {
+    double dt = (m_history[i].time - first.time) - meanTime;
+    double doff = (m_history[i].offset - first.offset) - meanOffset;
+    sumTT += dt * dt;
+    sumTO += dt * doff;
+  }
+  double drift = sumTO / sumTT;
+  if (std::abs(drift) <= kMaxDrift) {
+    m_drift = drift;
+  }
+}
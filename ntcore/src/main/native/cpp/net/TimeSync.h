@@ -0,0 +1,77 @@
+// Copyright (c) FIRST and other WPILib contributors.
+// Open Source Software; you can modify and/or share it under the terms of
+// the WPILib BSD license file in the root directory of this project.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+
+namespace nt::net {
+
+// Estimates the offset between the local clock and the server clock from RTT
+// ping samples.
+//
+// Each sample gives an offset whose error is bounded by half its round trip
+// time, so the estimate is based on the lowest-RTT sample among the most
+// recent kWindowSize samples.  As the window slides, a single lucky sample
+// ages out rather than pinning the offset forever.
+//
+// The best sample of each full window is also kept in a longer history, and
+// a least squares fit over that history gives the rate at which the server
+// clock drifts relative to the local clock.  The offset is extrapolated from
+// the best sample using that drift.
+//
+// The suggested ping interval starts fast so the window fills quickly after
+// connecting, then backs off to kPingIntervalMs.
+//
+// All times are in microseconds unless noted.
+class TimeSync {
+ public:
+  static constexpr size_t kWindowSize = 8;
+  static constexpr size_t kHistorySize = 16;
+  static constexpr uint32_t kFastPingIntervalMs = 100;
+  static constexpr uint32_t kPingIntervalMs = 3000;
+
+  // Adds the result of a ping sent at local time sendTime, answered by the
+  // server at serverTime, and received at local time recvTime.  Returns false
+  // if the sample was rejected.
+  bool AddSample(int64_t sendTime, int64_t serverTime, int64_t recvTime);
+
+  bool IsValid() const { return m_sampleCount != 0; }
+
+  // Offset to add to local time to get server time, at local time now.
+  int64_t GetOffset(int64_t now) const;
+
+  // Bound on the error of the offset (half the RTT of the sample used).
+  int64_t GetErrorBound() const { return m_window[m_best].rtt2; }
+
+  // Estimated server clock drift relative to the local clock, in
+  // microseconds per microsecond.
+  double GetDrift() const { return m_drift; }
+
+  uint32_t GetPingIntervalMs() const { return m_pingIntervalMs; }
+
+ private:
+  struct Sample {
+    int64_t time;  // local time of the round trip midpoint
+    int64_t offset;
+    int64_t rtt2;
+  };
+
+  void UpdateDrift();
+
+  std::array<Sample, kWindowSize> m_window;
+  size_t m_best{0};
+  uint64_t m_sampleCount{0};
+
+  std::array<Sample, kHistorySize> m_history;
+  size_t m_historyCount{0};
+
+  double m_drift{0};
+  uint32_t m_pingIntervalMs{kFastPingIntervalMs};
+};
+
+}  // namespace nt::net
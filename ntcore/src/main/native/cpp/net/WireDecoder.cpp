@@ -5,9 +5,14 @@
 #include "WireDecoder.h"
 
 #include <algorithm>
+#include <utility>
+#include <vector>
 
 #include <fmt/format.h>
+#include <wpi/Endian.h>
 #include <wpi/Logger.h>
+#include <wpi/MathExtras.h>
+#include <wpi/SmallVector.h>
 #include <wpi/SpanExtras.h>
 #include <wpi/json.h>
 #include <wpi/mpack.h>
@@ -18,82 +23,155 @@ using namespace nt;
 using namespace nt::net;
 using namespace mpack;
 
-static bool GetNumber(wpi::json& val, double* num) {
-  if (auto v = val.get_ptr<const int64_t*>()) {
-    *num = *v;
-  } else if (auto v = val.get_ptr<const uint64_t*>()) {
-    *num = *v;
-  } else if (auto v = val.get_ptr<const double*>()) {
-    *num = *v;
-  } else {
-    return false;
+namespace {
+
+// A scalar field of a text message, captured as the SAX parser reports it.
+// The string storage is reused between messages.
+struct TextValue {
+  enum Type {
+    kMissing,
+    kString,
+    kInteger,
+    kUnsigned,
+    kFloat,
+    kBoolean,
+    kOther
+  };
+
+  void Reset() { type = kMissing; }
+
+  Type type = kMissing;
+  std::string str;
+  union {
+    int64_t i;
+    uint64_t u;
+    double d;
+    bool b;
+  };
+};
+
+// An object or array field of a text message; only presence and whether it
+// had the expected kind are recorded.
+struct TextContainer {
+  void Reset() {
+    present = false;
+    ok = false;
+  }
+
+  bool present = false;
+  bool ok = false;
+};
+
+// The fields of a single text message that any method uses.  Keys may appear
+// in any order (e.g. params before method), so everything is captured first
+// and the message is dispatched once its object ends.
+struct TextMessage {
+  void Reset() {
+    method.Reset();
+    params.Reset();
+    name.Reset();
+    type.Reset();
+    pubuid.Reset();
+    subuid.Reset();
+    id.Reset();
+    ack.Reset();
+    properties.Reset();
+    update.Reset();
+    options.Reset();
+    periodic.Reset();
+    all.Reset();
+    topicsOnly.Reset();
+    prefix.Reset();
+    topics.Reset();
+    numTopics = 0;
+    badTopic = -1;
+  }
+
+  TextValue method;
+  TextContainer params;
+  TextValue name;
+  TextValue type;
+  TextValue pubuid;
+  TextValue subuid;
+  TextValue id;
+  TextValue ack;
+  TextContainer properties;
+  wpi::json propertiesJson;
+  TextContainer update;
+  wpi::json updateJson;
+  TextContainer options;
+  TextValue periodic;
+  TextValue all;
+  TextValue topicsOnly;
+  TextValue prefix;
+  TextContainer topics;
+  std::vector<std::string> topicNames;
+  size_t numTopics = 0;
+  int badTopic = -1;
+};
+
+}  // namespace
+
+static bool GetNumber(const TextValue& val, double* num) {
+  switch (val.type) {
+    case TextValue::kInteger:
+      *num = val.i;
+      return true;
+    case TextValue::kUnsigned:
+      *num = val.u;
+      return true;
+    case TextValue::kFloat:
+      *num = val.d;
+      return true;
+    default:
+      return false;
   }
-  return true;
 }
 
-static bool GetNumber(wpi::json& val, int64_t* num) {
-  if (auto v = val.get_ptr<const int64_t*>()) {
-    *num = *v;
-  } else if (auto v = val.get_ptr<const uint64_t*>()) {
-    *num = *v;
-  } else {
-    return false;
+static bool GetNumber(const TextValue& val, int64_t* num) {
+  switch (val.type) {
+    case TextValue::kInteger:
+      *num = val.i;
+      return true;
+    case TextValue::kUnsigned:
+      *num = val.u;
+      return true;
+    default:
+      return false;
   }
-  return true;
 }
 
-static std::string* ObjGetString(wpi::json::object_t& obj, std::string_view key,
-                                 std::string* error) {
-  auto it = obj.find(key);
-  if (it == obj.end()) {
+static const std::string* GetString(const TextValue& val, std::string_view key,
+                                    std::string* error) {
+  if (val.type == TextValue::kMissing) {
     *error = fmt::format("no {} key", key);
     return nullptr;
   }
-  auto val = it->second.get_ptr<std::string*>();
-  if (!val) {
+  if (val.type != TextValue::kString) {
     *error = fmt::format("{} must be a string", key);
+    return nullptr;
   }
-  return val;
+  return &val.str;
 }
 
-static bool ObjGetNumber(wpi::json::object_t& obj, std::string_view key,
-                         std::string* error, int64_t* num) {
-  auto it = obj.find(key);
-  if (it == obj.end()) {
+static bool GetNumber(const TextValue& val, std::string_view key,
+                      std::string* error, int64_t* num) {
+  if (val.type == TextValue::kMissing) {
     *error = fmt::format("no {} key", key);
     return false;
   }
-  if (!GetNumber(it->second, num)) {
+  if (!GetNumber(val, num)) {
     *error = fmt::format("{} must be a number", key);
     return false;
   }
   return true;
 }
 
-static bool ObjGetStringArray(wpi::json::object_t& obj, std::string_view key,
-                              std::string* error,
-                              std::vector<std::string>* out) {
-  // prefixes
-  auto it = obj.find(key);
-  if (it == obj.end()) {
-    *error = fmt::format("no {} key", key);
+static bool GetBool(const TextValue& val, bool* out) {
+  if (val.type != TextValue::kBoolean) {
     return false;
   }
-  auto jarr = it->second.get_ptr<wpi::json::array_t*>();
-  if (!jarr) {
-    *error = fmt::format("{} must be an array", key);
-    return false;
-  }
-  out->resize(0);
-  out->reserve(jarr->size());
-  for (auto&& jval : *jarr) {
-    auto str = jval.get_ptr<std::string*>();
-    if (!str) {
-      *error = fmt::format("{}/{} must be a string", key, out->size());
-      return false;
-    }
-    out->emplace_back(std::move(*str));
-  }
+  *out = val.b;
   return true;
 }
 
@@ -104,326 +182,980 @@ static bool ObjGetStringArray(wpi::json::object_t& obj, std::string_view key,
 #endif
 
 template <typename T>
-static void WireDecodeTextImpl(std::string_view in, T& out,
-                               wpi::Logger& logger) {
-  static_assert(std::is_same_v<T, ClientMessageHandler> ||
-                    std::is_same_v<T, ServerMessageHandler>,
-                "T must be ClientMessageHandler or ServerMessageHandler");
-
-  wpi::json j;
-  try {
-    j = wpi::json::parse(in);
-  } catch (wpi::json::parse_error& err) {
-    WPI_WARNING(logger, "could not decode JSON message: {}", err.what());
+static void DispatchText(TextMessage& msg, T& out, std::string* error,
+                         wpi::Logger& logger) {
+  auto method = GetString(msg.method, "method", error);
+  if (!method) {
     return;
   }
 
-  if (!j.is_array()) {
-    WPI_WARNING(logger, "expected JSON array at top level");
+  if (!msg.params.present) {
+    *error = "no params key";
+    return;
+  }
+  if (!msg.params.ok) {
+    *error = "params must be an object";
     return;
   }
 
-  int i = -1;
-  for (auto&& jmsg : j) {
-    ++i;
-    std::string error;
-    {
-      auto obj = jmsg.get_ptr<wpi::json::object_t*>();
-      if (!obj) {
-        error = "expected message to be an object";
-        goto err;
+  if constexpr (std::is_same_v<T, ClientMessageHandler>) {
+    if (*method == PublishMsg::kMethodStr) {
+      // name
+      auto name = GetString(msg.name, "name", error);
+      if (!name) {
+        return;
       }
 
-      auto method = ObjGetString(*obj, "method", &error);
-      if (!method) {
-        goto err;
+      // type
+      auto typeStr = GetString(msg.type, "type", error);
+      if (!typeStr) {
+        return;
       }
 
-      auto paramsIt = obj->find("params");
-      if (paramsIt == obj->end()) {
-        error = "no params key";
-        goto err;
+      // pubuid
+      int64_t pubuid;
+      if (!GetNumber(msg.pubuid, "pubuid", error, &pubuid)) {
+        return;
       }
-      auto params = paramsIt->second.get_ptr<wpi::json::object_t*>();
-      if (!params) {
-        error = "params must be an object";
-        goto err;
+
+      // properties; allow missing (treated as empty)
+      if (msg.properties.present && !msg.properties.ok) {
+        *error = "properties must be an object";
+        return;
+      }
+      if (!msg.properties.present) {
+        msg.propertiesJson = wpi::json::object();
       }
 
-      if constexpr (std::is_same_v<T, ClientMessageHandler>) {
-        if (*method == PublishMsg::kMethodStr) {
-          // name
-          auto name = ObjGetString(*params, "name", &error);
-          if (!name) {
-            goto err;
-          }
+      // complete
+      out.ClientPublish(pubuid, *name, *typeStr, msg.propertiesJson);
+    } else if (*method == UnpublishMsg::kMethodStr) {
+      // pubuid
+      int64_t pubuid;
+      if (!GetNumber(msg.pubuid, "pubuid", error, &pubuid)) {
+        return;
+      }
 
-          // type
-          auto typeStr = ObjGetString(*params, "type", &error);
-          if (!typeStr) {
-            goto err;
-          }
+      // complete
+      out.ClientUnpublish(pubuid);
+    } else if (*method == SetPropertiesMsg::kMethodStr) {
+      // name
+      auto name = GetString(msg.name, "name", error);
+      if (!name) {
+        return;
+      }
 
-          // pubuid
-          int64_t pubuid;
-          if (!ObjGetNumber(*params, "pubuid", &error, &pubuid)) {
-            goto err;
-          }
+      // update
+      if (!msg.update.present) {
+        *error = "no update key";
+        return;
+      }
+      if (!msg.update.ok) {
+        *error = "update must be an object";
+        return;
+      }
 
-          // properties; allow missing (treated as empty)
-          wpi::json* properties = nullptr;
-          auto propertiesIt = params->find("properties");
-          if (propertiesIt != params->end()) {
-            properties = &propertiesIt->second;
-            if (!properties->is_object()) {
-              error = "properties must be an object";
-              goto err;
-            }
-          }
-          wpi::json propertiesEmpty;
-          if (!properties) {
-            propertiesEmpty = wpi::json::object();
-            properties = &propertiesEmpty;
-          }
+      // complete
+      out.ClientSetProperties(*name, msg.updateJson);
+    } else if (*method == SubscribeMsg::kMethodStr) {
+      // subuid
+      int64_t subuid;
+      if (!GetNumber(msg.subuid, "subuid", error, &subuid)) {
+        return;
+      }
 
-          // complete
-          out.ClientPublish(pubuid, *name, *typeStr, *properties);
-        } else if (*method == UnpublishMsg::kMethodStr) {
-          // pubuid
-          int64_t pubuid;
-          if (!ObjGetNumber(*params, "pubuid", &error, &pubuid)) {
-            goto err;
-          }
+      // options
+      PubSubOptionsImpl options;
+      if (msg.options.present) {
+        if (!msg.options.ok) {
+          *error = "options must be an object";
+          return;
+        }
 
-          // complete
-          out.ClientUnpublish(pubuid);
-        } else if (*method == SetPropertiesMsg::kMethodStr) {
-          // name
-          auto name = ObjGetString(*params, "name", &error);
-          if (!name) {
-            goto err;
+        // periodic
+        if (msg.periodic.type != TextValue::kMissing) {
+          double val;
+          if (!GetNumber(msg.periodic, &val)) {
+            *error = "periodic value must be a number";
+            return;
           }
+          options.periodic = val;
+          options.periodicMs = val * 1000;
+        }
 
-          // update
-          auto updateIt = params->find("update");
-          if (updateIt == params->end()) {
-            error = "no update key";
-            goto err;
-          }
-          auto update = &updateIt->second;
-          if (!update->is_object()) {
-            error = "update must be an object";
-            goto err;
-          }
+        // send all changes
+        if (msg.all.type != TextValue::kMissing &&
+            !GetBool(msg.all, &options.sendAll)) {
+          *error = "all value must be a boolean";
+          return;
+        }
 
-          // complete
-          out.ClientSetProperties(*name, *update);
-        } else if (*method == SubscribeMsg::kMethodStr) {
-          // subuid
-          int64_t subuid;
-          if (!ObjGetNumber(*params, "subuid", &error, &subuid)) {
-            goto err;
-          }
+        // topics only
+        if (msg.topicsOnly.type != TextValue::kMissing &&
+            !GetBool(msg.topicsOnly, &options.topicsOnly)) {
+          *error = "topicsonly value must be a boolean";
+          return;
+        }
 
-          // options
-          PubSubOptionsImpl options;
-          auto optionsIt = params->find("options");
-          if (optionsIt != params->end()) {
-            auto joptions = optionsIt->second.get_ptr<wpi::json::object_t*>();
-            if (!joptions) {
-              error = "options must be an object";
-              goto err;
-            }
-
-            // periodic
-            auto periodicIt = joptions->find("periodic");
-            if (periodicIt != joptions->end()) {
-              double val;
-              if (!GetNumber(periodicIt->second, &val)) {
-                error = "periodic value must be a number";
-                goto err;
-              }
-              options.periodic = val;
-              options.periodicMs = val * 1000;
-            }
-
-            // send all changes
-            auto sendAllIt = joptions->find("all");
-            if (sendAllIt != joptions->end()) {
-              auto sendAll = sendAllIt->second.get_ptr<bool*>();
-              if (!sendAll) {
-                error = "all value must be a boolean";
-                goto err;
-              }
-              options.sendAll = *sendAll;
-            }
-
-            // topics only
-            auto topicsOnlyIt = joptions->find("topicsonly");
-            if (topicsOnlyIt != joptions->end()) {
-              auto topicsOnly = topicsOnlyIt->second.get_ptr<bool*>();
-              if (!topicsOnly) {
-                error = "topicsonly value must be a boolean";
-                goto err;
-              }
-              options.topicsOnly = *topicsOnly;
-            }
-
-            // prefix match
-            auto prefixMatchIt = joptions->find("prefix");
-            if (prefixMatchIt != joptions->end()) {
-              auto prefixMatch = prefixMatchIt->second.get_ptr<bool*>();
-              if (!prefixMatch) {
-                error = "prefix value must be a boolean";
-                goto err;
-              }
-              options.prefixMatch = *prefixMatch;
-            }
-          }
+        // prefix match
+        if (msg.prefix.type != TextValue::kMissing &&
+            !GetBool(msg.prefix, &options.prefixMatch)) {
+          *error = "prefix value must be a boolean";
+          return;
+        }
+      }
 
-          // topic names
-          std::vector<std::string> topicNames;
-          if (!ObjGetStringArray(*params, "topics", &error, &topicNames)) {
-            goto err;
-          }
+      // topic names
+      if (!msg.topics.present) {
+        *error = "no topics key";
+        return;
+      }
+      if (!msg.topics.ok) {
+        *error = "topics must be an array";
+        return;
+      }
+      if (msg.badTopic >= 0) {
+        *error = fmt::format("topics/{} must be a string", msg.badTopic);
+        return;
+      }
 
-          // complete
-          out.ClientSubscribe(subuid, topicNames, options);
-        } else if (*method == UnsubscribeMsg::kMethodStr) {
-          // subuid
-          int64_t subuid;
-          if (!ObjGetNumber(*params, "subuid", &error, &subuid)) {
-            goto err;
-          }
+      // complete
+      out.ClientSubscribe(subuid, {msg.topicNames.data(), msg.numTopics},
+                          options);
+    } else if (*method == UnsubscribeMsg::kMethodStr) {
+      // subuid
+      int64_t subuid;
+      if (!GetNumber(msg.subuid, "subuid", error, &subuid)) {
+        return;
+      }
 
-          // complete
-          out.ClientUnsubscribe(subuid);
-        } else {
-          error = fmt::format("unrecognized method '{}'", *method);
-          goto err;
+      // complete
+      out.ClientUnsubscribe(subuid);
+    } else {
+      *error = fmt::format("unrecognized method '{}'", *method);
+      return;
+    }
+  } else if constexpr (std::is_same_v<T, ServerMessageHandler>) {
+    if (*method == AnnounceMsg::kMethodStr) {
+      // name
+      auto name = GetString(msg.name, "name", error);
+      if (!name) {
+        return;
+      }
+
+      // id
+      int64_t id;
+      if (!GetNumber(msg.id, "id", error, &id)) {
+        return;
+      }
+
+      // type
+      auto typeStr = GetString(msg.type, "type", error);
+      if (!typeStr) {
+        return;
+      }
+
+      // pubuid
+      std::optional<int64_t> pubuid;
+      if (msg.pubuid.type != TextValue::kMissing) {
+        int64_t val;
+        if (!GetNumber(msg.pubuid, &val)) {
+          *error = "pubuid value must be a number";
+          return;
         }
-      } else if constexpr (std::is_same_v<T, ServerMessageHandler>) {
-        if (*method == AnnounceMsg::kMethodStr) {
-          // name
-          auto name = ObjGetString(*params, "name", &error);
-          if (!name) {
-            goto err;
-          }
+        pubuid = val;
+      }
 
-          // id
-          int64_t id;
-          if (!ObjGetNumber(*params, "id", &error, &id)) {
-            goto err;
-          }
+      // properties
+      if (!msg.properties.present) {
+        *error = "no properties key";
+        return;
+      }
+      if (!msg.properties.ok) {
+        WPI_WARNING(logger, "{}: properties is not an object", *name);
+        msg.propertiesJson = wpi::json::object();
+      }
 
-          // type
-          auto typeStr = ObjGetString(*params, "type", &error);
-          if (!typeStr) {
-            goto err;
-          }
+      // complete
+      out.ServerAnnounce(*name, id, *typeStr, msg.propertiesJson, pubuid);
+    } else if (*method == UnannounceMsg::kMethodStr) {
+      // name
+      auto name = GetString(msg.name, "name", error);
+      if (!name) {
+        return;
+      }
 
-          // pubuid
-          std::optional<int64_t> pubuid;
-          auto pubuidIt = params->find("pubuid");
-          if (pubuidIt != params->end()) {
-            int64_t val;
-            if (!GetNumber(pubuidIt->second, &val)) {
-              error = "pubuid value must be a number";
-              goto err;
-            }
-            pubuid = val;
-          }
+      // id
+      int64_t id;
+      if (!GetNumber(msg.id, "id", error, &id)) {
+        return;
+      }
 
-          // properties
-          auto propertiesIt = params->find("properties");
-          if (propertiesIt == params->end()) {
-            error = "no properties key";
-            goto err;
-          }
-          auto properties = &propertiesIt->second;
-          if (!properties->is_object()) {
-            WPI_WARNING(logger, "{}: properties is not an object", *name);
-            *properties = wpi::json::object();
-          }
+      // complete
+      out.ServerUnannounce(*name, id);
+    } else if (*method == PropertiesUpdateMsg::kMethodStr) {
+      // name
+      auto name = GetString(msg.name, "name", error);
+      if (!name) {
+        return;
+      }
 
-          // complete
-          out.ServerAnnounce(*name, id, *typeStr, *properties, pubuid);
-        } else if (*method == UnannounceMsg::kMethodStr) {
-          // name
-          auto name = ObjGetString(*params, "name", &error);
-          if (!name) {
-            goto err;
-          }
+      // update
+      if (!msg.update.present) {
+        *error = "no update key";
+        return;
+      }
+      if (!msg.update.ok) {
+        *error = "update must be an object";
+        return;
+      }
 
-          // id
-          int64_t id;
-          if (!ObjGetNumber(*params, "id", &error, &id)) {
-            goto err;
-          }
+      bool ack = false;
+      if (msg.ack.type != TextValue::kMissing && !GetBool(msg.ack, &ack)) {
+        *error = "ack must be a boolean";
+        return;
+      }
 
-          // complete
-          out.ServerUnannounce(*name, id);
-        } else if (*method == PropertiesUpdateMsg::kMethodStr) {
-          // name
-          auto name = ObjGetString(*params, "name", &error);
-          if (!name) {
-            goto err;
-          }
+      // complete
+      out.ServerPropertiesUpdate(*name, msg.updateJson, ack);
+    } else {
+      *error = fmt::format("unrecognized method '{}'", *method);
+      return;
+    }
+  }
+}
 
-          // update
-          auto updateIt = params->find("update");
-          if (updateIt == params->end()) {
-            error = "no update key";
-            goto err;
-          }
-          auto update = &updateIt->second;
-          if (!update->is_object()) {
-            error = "update must be an object";
-            goto err;
-          }
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
 
-          bool ack = false;
-          auto ackIt = params->find("ack");
-          if (ackIt != params->end()) {
-            auto val = ackIt->second.get_ptr<bool*>();
-            if (!val) {
-              error = "ack must be a boolean";
-              goto err;
-            }
-            ack = *val;
-          }
+namespace {
+
+// Decodes a text frame (a JSON array of message objects) directly from the
+// SAX events, without building a DOM for the frame.  Only the properties and
+// update objects, which are passed through to the handlers, are materialized
+// as JSON values.
+//
+// Nesting levels that are decoded: 1 = top-level array, 2 = message object,
+// 3 = params object, 4 = options object or topics array.  Anything else is
+// skipped.
+template <typename T>
+class TextDecoder final : public wpi::json::json_sax {
+ public:
+  TextDecoder(T& out, wpi::Logger& logger) : m_out{out}, m_logger{logger} {}
+
+  // true if the top level value was an array
+  bool IsArray() const { return m_isArray; }
+
+  bool null() override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(nullptr);
+      } else {
+        Scalar(TextValue::kOther);
+      }
+    }
+    return true;
+  }
+
+  bool boolean(bool val) override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(val);
+      } else if (auto v = Scalar(TextValue::kBoolean)) {
+        v->b = val;
+      }
+    }
+    return true;
+  }
+
+  bool number_integer(int64_t val) override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(val);
+      } else if (auto v = Scalar(TextValue::kInteger)) {
+        v->i = val;
+      }
+    }
+    return true;
+  }
+
+  bool number_unsigned(uint64_t val) override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(val);
+      } else if (auto v = Scalar(TextValue::kUnsigned)) {
+        v->u = val;
+      }
+    }
+    return true;
+  }
+
+  bool number_float(double val) override {
+    if (m_skip == 0) {
+      if (!m_build.empty()) {
+        BuildValue(val);
+      } else if (auto v = Scalar(TextValue::kFloat)) {
+        v->d = val;
+      }
+    }
+    return true;
+  }
+
+  bool string(std::string_view val) override {
+    if (m_skip != 0) {
+      return true;
+    }
+    if (!m_build.empty()) {
+      BuildValue(val);
+    } else if (m_depth == 4 && m_inTopics) {
+      if (m_msg.topicNames.size() <= m_msg.numTopics) {
+        m_msg.topicNames.resize(m_msg.numTopics + 1);
+      }
+      m_msg.topicNames[m_msg.numTopics++].assign(val);
+    } else if (auto v = Scalar(TextValue::kString)) {
+      v->str.assign(val);
+    }
+    return true;
+  }
+
+  bool start_object() override { return StartContainer(true); }
+
+  bool key(std::string_view key) override {
+    if (m_skip != 0) {
+      return true;
+    }
+    if (!m_build.empty()) {
+      m_buildKey.assign(key);
+      return true;
+    }
+    m_field = kNone;
+    if (m_depth == 2) {
+      if (key == "method") {
+        m_field = kMethod;
+      } else if (key == "params") {
+        m_field = kParams;
+      }
+    } else if (m_depth == 3) {
+      if (key == "name") {
+        m_field = kName;
+      } else if (key == "type") {
+        m_field = kType;
+      } else if (key == "pubuid") {
+        m_field = kPubuid;
+      } else if (key == "subuid") {
+        m_field = kSubuid;
+      } else if (key == "id") {
+        m_field = kId;
+      } else if (key == "ack") {
+        m_field = kAck;
+      } else if (key == "properties") {
+        m_field = kProperties;
+      } else if (key == "update") {
+        m_field = kUpdate;
+      } else if (key == "options") {
+        m_field = kOptions;
+      } else if (key == "topics") {
+        m_field = kTopics;
+      }
+    } else if (m_depth == 4) {
+      if (key == "periodic") {
+        m_field = kPeriodic;
+      } else if (key == "all") {
+        m_field = kAll;
+      } else if (key == "topicsonly") {
+        m_field = kTopicsOnly;
+      } else if (key == "prefix") {
+        m_field = kPrefix;
+      }
+    }
+    return true;
+  }
+
+  bool end_object() override { return EndContainer(); }
+
+  bool start_array() override { return StartContainer(false); }
+
+  bool end_array() override { return EndContainer(); }
+
+ private:
+  enum Field {
+    kNone,
+    kMethod,
+    kParams,
+    kName,
+    kType,
+    kPubuid,
+    kSubuid,
+    kId,
+    kAck,
+    kProperties,
+    kUpdate,
+    kOptions,
+    kTopics,
+    kPeriodic,
+    kAll,
+    kTopicsOnly,
+    kPrefix
+  };
+
+  TextValue* GetScalarField(Field field) {
+    switch (field) {
+      case kMethod:
+        return &m_msg.method;
+      case kName:
+        return &m_msg.name;
+      case kType:
+        return &m_msg.type;
+      case kPubuid:
+        return &m_msg.pubuid;
+      case kSubuid:
+        return &m_msg.subuid;
+      case kId:
+        return &m_msg.id;
+      case kAck:
+        return &m_msg.ack;
+      case kPeriodic:
+        return &m_msg.periodic;
+      case kAll:
+        return &m_msg.all;
+      case kTopicsOnly:
+        return &m_msg.topicsOnly;
+      case kPrefix:
+        return &m_msg.prefix;
+      default:
+        return nullptr;
+    }
+  }
+
+  TextContainer* GetContainerField(Field field) {
+    switch (field) {
+      case kParams:
+        return &m_msg.params;
+      case kProperties:
+        return &m_msg.properties;
+      case kUpdate:
+        return &m_msg.update;
+      case kOptions:
+        return &m_msg.options;
+      case kTopics:
+        return &m_msg.topics;
+      default:
+        return nullptr;
+    }
+  }
+
+  // Handles a scalar value outside of a JSON value being built; returns the
+  // field to store it into, if any.
+  TextValue* Scalar(TextValue::Type type) {
+    if (m_depth == 0) {
+      return nullptr;
+    }
+    if (m_depth == 1) {
+      MessageError("expected message to be an object");
+      return nullptr;
+    }
+    if (m_depth == 4 && m_inTopics) {
+      BadTopic();
+      return nullptr;
+    }
+    Field field = m_field;
+    m_field = kNone;
+    if (auto v = GetScalarField(field)) {
+      v->type = type;
+      return v;
+    }
+    if (auto c = GetContainerField(field)) {
+      c->present = true;
+      c->ok = false;
+    }
+    return nullptr;
+  }
+
+  bool StartContainer(bool isObject) {
+    if (m_skip != 0) {
+      ++m_skip;
+      return true;
+    }
+    if (!m_build.empty()) {
+      BuildContainer(isObject);
+      return true;
+    }
+    if (m_depth == 0) {
+      m_isArray = !isObject;
+      if (m_isArray) {
+        m_depth = 1;
+      } else {
+        m_skip = 1;
+      }
+      return true;
+    }
+    if (m_depth == 1) {
+      if (isObject) {
+        m_msg.Reset();
+        m_field = kNone;
+        m_depth = 2;
+      } else {
+        MessageError("expected message to be an object");
+        m_skip = 1;
+      }
+      return true;
+    }
+    if (m_depth == 4 && m_inTopics) {
+      BadTopic();
+      m_skip = 1;
+      return true;
+    }
+
+    Field field = m_field;
+    m_field = kNone;
+    if (auto v = GetScalarField(field)) {
+      v->type = TextValue::kOther;
+    } else if (auto c = GetContainerField(field)) {
+      c->present = true;
+      c->ok = field == kTopics ? !isObject : isObject;
+      if (c->ok) {
+        switch (field) {
+          case kParams:
+            m_depth = 3;
+            return true;
+          case kProperties:
+            m_msg.propertiesJson = wpi::json::object();
+            m_build.push_back(&m_msg.propertiesJson);
+            return true;
+          case kUpdate:
+            m_msg.updateJson = wpi::json::object();
+            m_build.push_back(&m_msg.updateJson);
+            return true;
+          case kOptions:
+            m_inTopics = false;
+            m_depth = 4;
+            return true;
+          case kTopics:
+            m_msg.numTopics = 0;
+            m_msg.badTopic = -1;
+            m_inTopics = true;
+            m_depth = 4;
+            return true;
+          default:
+            break;
+        }
+      }
+    }
+    m_skip = 1;
+    return true;
+  }
+
+  bool EndContainer() {
+    if (m_skip != 0) {
+      --m_skip;
+      return true;
+    }
+    if (!m_build.empty()) {
+      m_build.pop_back();
+      return true;
+    }
+    if (m_depth == 2) {
+      std::string error;
+      DispatchText(m_msg, m_out, &error, m_logger);
+      if (!error.empty()) {
+        WPI_WARNING(m_logger, "{}: {}", m_index, error);
+      }
+      ++m_index;
+    }
+    if (m_depth > 0) {
+      --m_depth;
+    }
+    return true;
+  }
+
+  void MessageError(std::string_view error) {
+    WPI_WARNING(m_logger, "{}: {}", m_index, error);
+    ++m_index;
+  }
+
+  void BadTopic() {
+    if (m_msg.badTopic < 0) {
+      m_msg.badTopic = static_cast<int>(m_msg.numTopics);
+    }
+    ++m_msg.numTopics;
+  }
+
+  // adds a value to the JSON value currently being built
+  template <typename V>
+  wpi::json& BuildValue(V&& val) {
+    wpi::json& parent = *m_build.back();
+    if (parent.is_object()) {
+      return parent[m_buildKey] = std::forward<V>(val);
+    } else {
+      parent.push_back(std::forward<V>(val));
+      return parent.back();
+    }
+  }
+
+  void BuildContainer(bool isObject) {
+    m_build.push_back(&BuildValue(isObject ? wpi::json::object()
+                                           : wpi::json::array()));
+  }
+
+  T& m_out;
+  wpi::Logger& m_logger;
+  TextMessage m_msg;
+  int m_index = 0;
+  int m_depth = 0;
+  int m_skip = 0;
+  bool m_isArray = false;
+  bool m_inTopics = false;
+  Field m_field = kNone;
+  wpi::SmallVector<wpi::json*, 4> m_build;
+  std::string m_buildKey;
+};
+
+}  // namespace
+
+template <typename T>
+static void WireDecodeTextImpl(std::string_view in, T& out,
+                               wpi::Logger& logger) {
+  static_assert(std::is_same_v<T, ClientMessageHandler> ||
+                    std::is_same_v<T, ServerMessageHandler>,
+                "T must be ClientMessageHandler or ServerMessageHandler");
+
+  TextDecoder<T> decoder{out, logger};
+  try {
+    wpi::json::sax_parse(in, &decoder);
+  } catch (wpi::json::exception& err) {
+    WPI_WARNING(logger, "could not decode JSON message: {}", err.what());
+    return;
+  }
+
+  if (!decoder.IsArray()) {
+    WPI_WARNING(logger, "expected JSON array at top level");
+  }
+}
+
+void nt::net::WireDecodeText(std::string_view in, ClientMessageHandler& out,
+                             wpi::Logger& logger) {
+  ::WireDecodeTextImpl(in, out, logger);
+}
+
+void nt::net::WireDecodeText(std::string_view in, ServerMessageHandler& out,
+                             wpi::Logger& logger) {
+  ::WireDecodeTextImpl(in, out, logger);
+}
+
+// Reads a msgpack integer that fits in an int64_t.  Returns false if the
+// next value is something else or is truncated.
+static bool ReadFastInt(const uint8_t** pos, const uint8_t* end,
+                        int64_t* out) {
+  const uint8_t* p = *pos;
+  if (p == end) {
+    return false;
+  }
+  uint8_t tag = *p++;
+  size_t size = 0;
+  if (tag <= 0x7f || tag >= 0xe0) {  // positive or negative fixint
+    *out = static_cast<int8_t>(tag);
+    *pos = p;
+    return true;
+  } else if (tag >= 0xcc && tag <= 0xd3) {  // uint8..uint64, int8..int64
+    size = size_t{1} << (tag & 0x3);
+  } else {
+    return false;
+  }
+  if (static_cast<size_t>(end - p) < size) {
+    return false;
+  }
+  switch (tag) {
+    case 0xcc:
+      *out = p[0];
+      break;
+    case 0xcd:
+      *out = wpi::support::endian::read16be(p);
+      break;
+    case 0xce:
+      *out = wpi::support::endian::read32be(p);
+      break;
+    case 0xcf: {
+      uint64_t val = wpi::support::endian::read64be(p);
+      if (val > static_cast<uint64_t>(INT64_MAX)) {
+        return false;
+      }
+      *out = val;
+      break;
+    }
+    case 0xd0:
+      *out = static_cast<int8_t>(p[0]);
+      break;
+    case 0xd1:
+      *out = static_cast<int16_t>(wpi::support::endian::read16be(p));
+      break;
+    case 0xd2:
+      *out = static_cast<int32_t>(wpi::support::endian::read32be(p));
+      break;
+    default:
+      *out = static_cast<int64_t>(wpi::support::endian::read64be(p));
+      break;
+  }
+  *pos = p + size;
+  return true;
+}
+
+// Reads a msgpack str (isStr) or bin header and the data following it.
+static bool ReadFastBytes(const uint8_t** pos, const uint8_t* end, bool isStr,
+                          std::span<const uint8_t>* out) {
+  const uint8_t* p = *pos;
+  if (p == end) {
+    return false;
+  }
+  uint8_t tag = *p++;
+  size_t size;
+  size_t lenSize;
+  if (isStr && (tag & 0xe0) == 0xa0) {  // fixstr
+    size = tag & 0x1f;
+    lenSize = 0;
+  } else if (tag == (isStr ? 0xd9 : 0xc4)) {
+    lenSize = 1;
+  } else if (tag == (isStr ? 0xda : 0xc5)) {
+    lenSize = 2;
+  } else if (tag == (isStr ? 0xdb : 0xc6)) {
+    lenSize = 4;
+  } else {
+    return false;
+  }
+  if (static_cast<size_t>(end - p) < lenSize) {
+    return false;
+  }
+  switch (lenSize) {
+    case 1:
+      size = p[0];
+      break;
+    case 2:
+      size = wpi::support::endian::read16be(p);
+      break;
+    case 4:
+      size = wpi::support::endian::read32be(p);
+      break;
+    default:
+      break;
+  }
+  p += lenSize;
+  if (static_cast<size_t>(end - p) < size) {
+    return false;
+  }
+  *out = {p, size};
+  *pos = p + size;
+  return true;
+}
+
+// Reads a msgpack array header.
+static bool ReadFastArrayHeader(const uint8_t** pos, const uint8_t* end,
+                                size_t* out) {
+  const uint8_t* p = *pos;
+  if (p == end) {
+    return false;
+  }
+  uint8_t tag = *p++;
+  if ((tag & 0xf0) == 0x90) {  // fixarray
+    *out = tag & 0x0f;
+  } else if (tag == 0xdc && end - p >= 2) {
+    *out = wpi::support::endian::read16be(p);
+    p += 2;
+  } else if (tag == 0xdd && end - p >= 4) {
+    *out = wpi::support::endian::read32be(p);
+    p += 4;
+  } else {
+    return false;
+  }
+  *pos = p;
+  return true;
+}
+
+// Checks that count fixed-size elements of stride bytes starting at p all
+// have the given tag.  Written as a branch-free reduction so the compiler
+// can vectorize it.
+static bool AllTagsMatch(const uint8_t* p, size_t count, size_t stride,
+                         uint8_t tag) {
+  uint8_t diff = 0;
+  for (size_t i = 0; i < count; ++i) {
+    diff |= p[i * stride] ^ tag;
+  }
+  return diff == 0;
+}
+
+// Reads a run of count float32 (tag 0xca) or float64 (tag 0xcb) elements
+// into out, converting from big-endian in one pass; as with mpack, either
+// encoding is accepted and cast to T.  Returns false if the elements are not
+// all the same type, or if the run is truncated.
+template <typename T>
+static bool ReadFastFloatRun(const uint8_t** pos, const uint8_t* end,
+                             size_t count, std::vector<T>* out) {
+  const uint8_t* p = *pos;
+  if (count == 0) {
+    out->clear();
+    return true;
+  }
+  if (p == end) {
+    return false;
+  }
+  bool isDouble = *p == 0xcb;
+  if (!isDouble && *p != 0xca) {
+    return false;
+  }
+  size_t stride = isDouble ? 9 : 5;
+  if (static_cast<size_t>(end - p) / stride < count ||
+      !AllTagsMatch(p, count, stride, *p)) {
+    return false;
+  }
+  out->resize(count);
+  T* data = out->data();
+  if (isDouble) {
+    for (size_t i = 0; i < count; ++i) {
+      data[i] = static_cast<T>(wpi::BitsToDouble(
+          wpi::support::endian::read64be(p + i * 9 + 1)));
+    }
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      data[i] = static_cast<T>(
+          wpi::BitsToFloat(wpi::support::endian::read32be(p + i * 5 + 1)));
+    }
+  }
+  *pos = p + count * stride;
+  return true;
+}
 
-          // complete
-          out.ServerPropertiesUpdate(*name, *update, ack);
-        } else {
-          error = fmt::format("unrecognized method '{}'", *method);
-          goto err;
+// Fast path for the common case of a [id, time, type, value] message with a
+// scalar, string, raw, or numeric array value.  Reads directly from the input
+// without per-field error tracking.  Returns false without changing anything
+// if the message needs the generic decoder (other encodings, mixed-type
+// float arrays, boolean or string arrays, or errors); the generic decoder
+// produces the same result for anything this accepts.
+static bool WireDecodeBinaryFast(std::span<const uint8_t>* in, int64_t* outId,
+                                 Value* outValue, int64_t localTimeOffset) {
+  const uint8_t* p = in->data();
+  const uint8_t* end = p + in->size();
+  if (p == end || *p++ != 0x94) {  // fixarray of 4
+    return false;
+  }
+  int64_t id;
+  int64_t time;
+  int64_t type;
+  if (!ReadFastInt(&p, end, &id) || !ReadFastInt(&p, end, &time) ||
+      !ReadFastInt(&p, end, &type) || p == end) {
+    return false;
+  }
+  switch (type) {
+    case 0:  // boolean
+      if (*p != 0xc2 && *p != 0xc3) {
+        return false;
+      }
+      *outValue = Value::MakeBoolean(*p++ == 0xc3, 1);
+      break;
+    case 2: {  // integer
+      int64_t val;
+      if (!ReadFastInt(&p, end, &val)) {
+        return false;
+      }
+      *outValue = Value::MakeInteger(val, 1);
+      break;
+    }
+    case 3:  // float
+      if (*p != 0xca || end - p < 5) {
+        return false;
+      }
+      *outValue = Value::MakeFloat(
+          wpi::BitsToFloat(wpi::support::endian::read32be(p + 1)), 1);
+      p += 5;
+      break;
+    case 1:  // double
+      if (*p == 0xcb && end - p >= 9) {
+        *outValue = Value::MakeDouble(
+            wpi::BitsToDouble(wpi::support::endian::read64be(p + 1)), 1);
+        p += 9;
+      } else if (*p == 0xca && end - p >= 5) {
+        *outValue = Value::MakeDouble(
+            wpi::BitsToFloat(wpi::support::endian::read32be(p + 1)), 1);
+        p += 5;
+      } else {
+        return false;
+      }
+      break;
+    case 4: {  // string
+      std::span<const uint8_t> str;
+      if (!ReadFastBytes(&p, end, true, &str)) {
+        return false;
+      }
+      *outValue = Value::MakeString(
+          {reinterpret_cast<const char*>(str.data()), str.size()}, 1);
+      break;
+    }
+    case 5: {  // raw
+      std::span<const uint8_t> raw;
+      if (!ReadFastBytes(&p, end, false, &raw)) {
+        return false;
+      }
+      *outValue = Value::MakeRaw(raw, 1);
+      break;
+    }
+    case 18: {  // integer array
+      size_t length;
+      if (!ReadFastArrayHeader(&p, end, &length) ||
+          static_cast<size_t>(end - p) < length) {
+        return false;
+      }
+      std::vector<int64_t> arr(length);
+      for (auto&& val : arr) {
+        if (!ReadFastInt(&p, end, &val)) {
+          return false;
         }
       }
-      continue;
+      *outValue = Value::MakeIntegerArray(std::move(arr), 1);
+      break;
+    }
+    case 19: {  // float array
+      size_t length;
+      std::vector<float> arr;
+      if (!ReadFastArrayHeader(&p, end, &length) ||
+          !ReadFastFloatRun(&p, end, length, &arr)) {
+        return false;
+      }
+      *outValue = Value::MakeFloatArray(std::move(arr), 1);
+      break;
+    }
+    case 17: {  // double array
+      size_t length;
+      std::vector<double> arr;
+      if (!ReadFastArrayHeader(&p, end, &length) ||
+          !ReadFastFloatRun(&p, end, length, &arr)) {
+        return false;
+      }
+      *outValue = Value::MakeDoubleArray(std::move(arr), 1);
+      break;
     }
-  err:
-    WPI_WARNING(logger, "{}: {}", i, error);
+    default:
+      return false;
   }
-}
-
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
-
-void nt::net::WireDecodeText(std::string_view in, ClientMessageHandler& out,
-                             wpi::Logger& logger) {
-  ::WireDecodeTextImpl(in, out, logger);
-}
-
-void nt::net::WireDecodeText(std::string_view in, ServerMessageHandler& out,
-                             wpi::Logger& logger) {
-  ::WireDecodeTextImpl(in, out, logger);
+  *outId = id;
+  // set time
+  outValue->SetServerTime(time);
+  outValue->SetTime(time == 0 ? 0 : time + localTimeOffset);
+  // update input range
+  *in = wpi::drop_front(*in, p - in->data());
+  return true;
 }
 
 bool nt::net::WireDecodeBinary(std::span<const uint8_t>* in, int64_t* outId,
                                Value* outValue, std::string* error,
                                int64_t localTimeOffset) {
+  if (WireDecodeBinaryFast(in, outId, outValue, localTimeOffset)) {
+    return true;
+  }
+  return WireDecodeBinaryMpack(in, outId, outValue, error, localTimeOffset);
+}
+
+bool nt::net::WireDecodeBinaryMpack(std::span<const uint8_t>* in,
+                                    int64_t* outId, Value* outValue,
+                                    std::string* error,
+                                    int64_t localTimeOffset) {
   mpack_reader_t reader;
   mpack_reader_init_data(&reader, reinterpret_cast<const char*>(in->data()),
                          in->size());
@@ -565,3 +1297,455 @@ bool nt::net::WireDecodeBinary(std::span<const uint8_t>* in, int64_t* outId,
                         in->size() - mpack_reader_remaining(&reader, nullptr));
   return true;
 }
+
+bool nt::net::WireIsBinaryControl(std::span<const uint8_t> in) {
+  if (in.empty()) {
+    return false;
+  }
+  // fixmap, map 16, or map 32
+  return (in[0] & 0xf0) == 0x80 || in[0] == 0xde || in[0] == 0xdf;
+}
+
+namespace {
+
+// Encoded msgpack values of a map, by key.  Values are only decoded when a
+// message actually needs them, so nothing is materialized up front.
+using BinaryMap =
+    wpi::SmallVector<std::pair<std::string_view, std::span<const char>>, 8>;
+
+// reader for a single value recorded in a BinaryMap
+class ValueReader {
+ public:
+  explicit ValueReader(std::span<const char> value) {
+    mpack_reader_init_data(&m_reader, value.data(), value.size());
+  }
+  ~ValueReader() { mpack_reader_destroy(&m_reader); }
+  ValueReader(const ValueReader&) = delete;
+  ValueReader& operator=(const ValueReader&) = delete;
+
+  mpack_reader_t* get() { return &m_reader; }
+
+ private:
+  mpack_reader_t m_reader;
+};
+
+}  // namespace
+
+// all of the Read functions skip the next element if it has the wrong type
+static bool ReadStr(mpack_reader_t* reader, std::string_view* out) {
+  if (mpack_peek_tag(reader).type != mpack_type_str) {
+    mpack_discard(reader);
+    return false;
+  }
+  auto length = mpack_expect_str(reader);
+  auto data = mpack_read_bytes_inplace(reader, length);
+  mpack_done_str(reader);
+  if (mpack_reader_error(reader) != mpack_ok) {
+    return false;
+  }
+  *out = {data, length};
+  return true;
+}
+
+static bool ReadNumber(mpack_reader_t* reader, int64_t* num) {
+  auto type = mpack_peek_tag(reader).type;
+  if (type == mpack_type_int) {
+    *num = mpack_expect_i64(reader);
+  } else if (type == mpack_type_uint) {
+    *num = mpack_expect_u64(reader);
+  } else {
+    mpack_discard(reader);
+    return false;
+  }
+  return mpack_reader_error(reader) == mpack_ok;
+}
+
+static bool ReadNumber(mpack_reader_t* reader, double* num) {
+  auto type = mpack_peek_tag(reader).type;
+  if (type != mpack_type_int && type != mpack_type_uint &&
+      type != mpack_type_float && type != mpack_type_double) {
+    mpack_discard(reader);
+    return false;
+  }
+  *num = mpack_expect_double(reader);
+  return mpack_reader_error(reader) == mpack_ok;
+}
+
+static bool ReadBool(mpack_reader_t* reader, bool* val) {
+  if (mpack_peek_tag(reader).type != mpack_type_bool) {
+    mpack_discard(reader);
+    return false;
+  }
+  *val = mpack_expect_bool(reader);
+  return mpack_reader_error(reader) == mpack_ok;
+}
+
+// records each value of a map without decoding it
+static bool ReadMap(mpack_reader_t* reader, BinaryMap* out) {
+  if (mpack_peek_tag(reader).type != mpack_type_map) {
+    mpack_discard(reader);
+    return false;
+  }
+  auto count = mpack_expect_map(reader);
+  for (uint32_t i = 0; i < count; ++i) {
+    std::string_view key;
+    bool haveKey = ReadStr(reader, &key);
+    const char* start;
+    size_t before = mpack_reader_remaining(reader, &start);
+    mpack_discard(reader);
+    if (mpack_reader_error(reader) != mpack_ok) {
+      break;
+    }
+    if (haveKey) {
+      size_t after = mpack_reader_remaining(reader, nullptr);
+      out->emplace_back(key, std::span{start, before - after});
+    }
+  }
+  mpack_done_map(reader);
+  return mpack_reader_error(reader) == mpack_ok;
+}
+
+// materializes a map as a JSON object (used for properties)
+static bool ReadObject(mpack_reader_t* reader, wpi::json* out) {
+  if (mpack_peek_tag(reader).type != mpack_type_map) {
+    mpack_discard(reader);
+    return false;
+  }
+  const char* start;
+  size_t before = mpack_reader_remaining(reader, &start);
+  mpack_discard(reader);
+  if (mpack_reader_error(reader) != mpack_ok) {
+    return false;
+  }
+  try {
+    *out = wpi::json::from_msgpack(
+        {reinterpret_cast<const uint8_t*>(start),
+         before - mpack_reader_remaining(reader, nullptr)});
+  } catch (wpi::json::exception&) {
+    return false;
+  }
+  return true;
+}
+
+static const std::span<const char>* MapFind(const BinaryMap& map,
+                                            std::string_view key) {
+  for (auto&& [k, v] : map) {
+    if (k == key) {
+      return &v;
+    }
+  }
+  return nullptr;
+}
+
+static bool MapGetString(const BinaryMap& map, std::string_view key,
+                         std::string* error, std::string_view* out) {
+  auto val = MapFind(map, key);
+  if (!val) {
+    *error = fmt::format("no {} key", key);
+    return false;
+  }
+  if (!ReadStr(ValueReader{*val}.get(), out)) {
+    *error = fmt::format("{} must be a string", key);
+    return false;
+  }
+  return true;
+}
+
+static bool MapGetNumber(const BinaryMap& map, std::string_view key,
+                         std::string* error, int64_t* num) {
+  auto val = MapFind(map, key);
+  if (!val) {
+    *error = fmt::format("no {} key", key);
+    return false;
+  }
+  if (!ReadNumber(ValueReader{*val}.get(), num)) {
+    *error = fmt::format("{} must be a number", key);
+    return false;
+  }
+  return true;
+}
+
+static bool MapGetOptionBool(const BinaryMap& map, std::string_view key,
+                             std::string* error, bool* out) {
+  auto val = MapFind(map, key);
+  if (val && !ReadBool(ValueReader{*val}.get(), out)) {
+    *error = fmt::format("{} value must be a boolean", key);
+    return false;
+  }
+  return true;
+}
+
+static bool MapGetStringArray(const BinaryMap& map, std::string_view key,
+                              std::string* error,
+                              std::vector<std::string>* out) {
+  auto val = MapFind(map, key);
+  if (!val) {
+    *error = fmt::format("no {} key", key);
+    return false;
+  }
+  ValueReader r{*val};
+  auto reader = r.get();
+  if (mpack_peek_tag(reader).type != mpack_type_array) {
+    *error = fmt::format("{} must be an array", key);
+    return false;
+  }
+  auto length = mpack_expect_array(reader);
+  out->resize(0);
+  out->reserve((std::min)(length, 1000u));
+  for (uint32_t i = 0; i < length; ++i) {
+    std::string_view str;
+    if (!ReadStr(reader, &str)) {
+      *error = fmt::format("{}/{} must be a string", key, i);
+      // abandon the rest of the array
+      mpack_reader_flag_error(reader, mpack_error_type);
+      return false;
+    }
+    out->emplace_back(str);
+  }
+  mpack_done_array(reader);
+  return true;
+}
+
+template <typename T>
+static bool DecodeBinaryControl(const BinaryMap& msg, T& out,
+                                std::string* error, wpi::Logger& logger) {
+  std::string_view method;
+  if (!MapGetString(msg, "method", error, &method)) {
+    return false;
+  }
+
+  auto paramsVal = MapFind(msg, "params");
+  if (!paramsVal) {
+    *error = "no params key";
+    return false;
+  }
+  BinaryMap params;
+  if (!ReadMap(ValueReader{*paramsVal}.get(), &params)) {
+    *error = "params must be an object";
+    return false;
+  }
+
+  if constexpr (std::is_same_v<T, ClientMessageHandler>) {
+    if (method == PublishMsg::kMethodStr) {
+      std::string_view name;
+      if (!MapGetString(params, "name", error, &name)) {
+        return false;
+      }
+      std::string_view typeStr;
+      if (!MapGetString(params, "type", error, &typeStr)) {
+        return false;
+      }
+      int64_t pubuid;
+      if (!MapGetNumber(params, "pubuid", error, &pubuid)) {
+        return false;
+      }
+
+      // properties; allow missing (treated as empty)
+      wpi::json properties = wpi::json::object();
+      if (auto val = MapFind(params, "properties")) {
+        if (!ReadObject(ValueReader{*val}.get(), &properties)) {
+          *error = "properties must be an object";
+          return false;
+        }
+      }
+
+      out.ClientPublish(pubuid, name, typeStr, properties);
+    } else if (method == UnpublishMsg::kMethodStr) {
+      int64_t pubuid;
+      if (!MapGetNumber(params, "pubuid", error, &pubuid)) {
+        return false;
+      }
+
+      out.ClientUnpublish(pubuid);
+    } else if (method == SetPropertiesMsg::kMethodStr) {
+      std::string_view name;
+      if (!MapGetString(params, "name", error, &name)) {
+        return false;
+      }
+
+      auto updateVal = MapFind(params, "update");
+      if (!updateVal) {
+        *error = "no update key";
+        return false;
+      }
+      wpi::json update;
+      if (!ReadObject(ValueReader{*updateVal}.get(), &update)) {
+        *error = "update must be an object";
+        return false;
+      }
+
+      out.ClientSetProperties(name, update);
+    } else if (method == SubscribeMsg::kMethodStr) {
+      int64_t subuid;
+      if (!MapGetNumber(params, "subuid", error, &subuid)) {
+        return false;
+      }
+
+      PubSubOptionsImpl options;
+      if (auto optionsVal = MapFind(params, "options")) {
+        BinaryMap joptions;
+        if (!ReadMap(ValueReader{*optionsVal}.get(), &joptions)) {
+          *error = "options must be an object";
+          return false;
+        }
+
+        if (auto periodicVal = MapFind(joptions, "periodic")) {
+          double val;
+          if (!ReadNumber(ValueReader{*periodicVal}.get(), &val)) {
+            *error = "periodic value must be a number";
+            return false;
+          }
+          options.periodic = val;
+          options.periodicMs = val * 1000;
+        }
+
+        if (!MapGetOptionBool(joptions, "all", error, &options.sendAll) ||
+            !MapGetOptionBool(joptions, "topicsonly", error,
+                              &options.topicsOnly) ||
+            !MapGetOptionBool(joptions, "prefix", error,
+                              &options.prefixMatch)) {
+          return false;
+        }
+      }
+
+      std::vector<std::string> topicNames;
+      if (!MapGetStringArray(params, "topics", error, &topicNames)) {
+        return false;
+      }
+
+      out.ClientSubscribe(subuid, topicNames, options);
+    } else if (method == UnsubscribeMsg::kMethodStr) {
+      int64_t subuid;
+      if (!MapGetNumber(params, "subuid", error, &subuid)) {
+        return false;
+      }
+
+      out.ClientUnsubscribe(subuid);
+    } else {
+      *error = fmt::format("unrecognized method '{}'", method);
+      return false;
+    }
+  } else if constexpr (std::is_same_v<T, ServerMessageHandler>) {
+    if (method == AnnounceMsg::kMethodStr) {
+      std::string_view name;
+      if (!MapGetString(params, "name", error, &name)) {
+        return false;
+      }
+      int64_t id;
+      if (!MapGetNumber(params, "id", error, &id)) {
+        return false;
+      }
+      std::string_view typeStr;
+      if (!MapGetString(params, "type", error, &typeStr)) {
+        return false;
+      }
+
+      std::optional<int64_t> pubuid;
+      if (auto pubuidVal = MapFind(params, "pubuid")) {
+        int64_t val;
+        if (!ReadNumber(ValueReader{*pubuidVal}.get(), &val)) {
+          *error = "pubuid value must be a number";
+          return false;
+        }
+        pubuid = val;
+      }
+
+      auto propertiesVal = MapFind(params, "properties");
+      if (!propertiesVal) {
+        *error = "no properties key";
+        return false;
+      }
+      wpi::json properties;
+      if (!ReadObject(ValueReader{*propertiesVal}.get(), &properties)) {
+        WPI_WARNING(logger, "{}: properties is not an object", name);
+        properties = wpi::json::object();
+      }
+
+      out.ServerAnnounce(name, id, typeStr, properties, pubuid);
+    } else if (method == UnannounceMsg::kMethodStr) {
+      std::string_view name;
+      if (!MapGetString(params, "name", error, &name)) {
+        return false;
+      }
+      int64_t id;
+      if (!MapGetNumber(params, "id", error, &id)) {
+        return false;
+      }
+
+      out.ServerUnannounce(name, id);
+    } else if (method == PropertiesUpdateMsg::kMethodStr) {
+      std::string_view name;
+      if (!MapGetString(params, "name", error, &name)) {
+        return false;
+      }
+
+      auto updateVal = MapFind(params, "update");
+      if (!updateVal) {
+        *error = "no update key";
+        return false;
+      }
+      wpi::json update;
+      if (!ReadObject(ValueReader{*updateVal}.get(), &update)) {
+        *error = "update must be an object";
+        return false;
+      }
+
+      bool ack = false;
+      if (auto ackVal = MapFind(params, "ack")) {
+        if (!ReadBool(ValueReader{*ackVal}.get(), &ack)) {
+          *error = "ack must be a boolean";
+          return false;
+        }
+      }
+
+      out.ServerPropertiesUpdate(name, update, ack);
+    } else {
+      *error = fmt::format("unrecognized method '{}'", method);
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+static bool WireDecodeBinaryImpl(std::span<const uint8_t>* in, T& out,
+                                 std::string* error, wpi::Logger& logger) {
+  static_assert(std::is_same_v<T, ClientMessageHandler> ||
+                    std::is_same_v<T, ServerMessageHandler>,
+                "T must be ClientMessageHandler or ServerMessageHandler");
+
+  // this validates the framing of the entire message
+  mpack_reader_t reader;
+  mpack_reader_init_data(&reader, reinterpret_cast<const char*>(in->data()),
+                         in->size());
+  BinaryMap msg;
+  bool isMap = ReadMap(&reader, &msg);
+  auto err = mpack_reader_destroy(&reader);
+  if (err != mpack_ok) {
+    *error = mpack_error_to_string(err);
+    return false;
+  }
+  // update input range
+  *in = wpi::drop_front(*in,
+                        in->size() - mpack_reader_remaining(&reader, nullptr));
+
+  std::string msgError;
+  if (!isMap) {
+    WPI_WARNING(logger, "expected message to be a map");
+  } else if (!DecodeBinaryControl(msg, out, &msgError, logger)) {
+    WPI_WARNING(logger, "{}", msgError);
+  }
+  return true;
+}
+
+bool nt::net::WireDecodeBinary(std::span<const uint8_t>* in,
+                               ClientMessageHandler& out, std::string* error,
+                               wpi::Logger& logger) {
+  return ::WireDecodeBinaryImpl(in, out, error, logger);
+}
+
+bool nt::net::WireDecodeBinary(std::span<const uint8_t>* in,
+                               ServerMessageHandler& out, std::string* error,
+                               wpi::Logger& logger) {
+  return ::WireDecodeBinaryImpl(in, out, error, logger);
+}
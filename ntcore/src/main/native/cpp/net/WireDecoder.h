@@ -61,4 +61,23 @@ bool WireDecodeBinary(std::span<const uint8_t>* in, int64_t* outId,
                       Value* outValue, std::string* error,
                       int64_t localTimeOffset);
 
+// same as above, but always uses the generic msgpack reader rather than the
+// fast path for common value encodings (the fast path falls back to this)
+bool WireDecodeBinaryMpack(std::span<const uint8_t>* in, int64_t* outId,
+                           Value* outValue, std::string* error,
+                           int64_t localTimeOffset);
+
+// With the binary control subprotocol, binary frames contain both value
+// messages (msgpack arrays) and control messages (msgpack maps).
+// Returns true if the next message in the input is a control message.
+bool WireIsBinaryControl(std::span<const uint8_t> in);
+
+// Decodes a single binary control message and dispatches it to out.
+// Errors in the message contents are logged and the message is skipped;
+// returns false (and sets error) only if the msgpack data is malformed.
+bool WireDecodeBinary(std::span<const uint8_t>* in, ClientMessageHandler& out,
+                      std::string* error, wpi::Logger& logger);
+bool WireDecodeBinary(std::span<const uint8_t>* in, ServerMessageHandler& out,
+                      std::string* error, wpi::Logger& logger);
+
 }  // namespace nt::net
@@ -4,8 +4,13 @@
 
 #include "WireEncoder.h"
 
+#include <algorithm>
 #include <optional>
+#include <span>
 
+#include <wpi/Endian.h>
+#include <wpi/MathExtras.h>
+#include <wpi/SmallVector.h>
 #include <wpi/json_serializer.h>
 #include <wpi/mpack.h>
 #include <wpi/raw_ostream.h>
@@ -151,10 +156,11 @@ bool nt::net::WireEncodeText(wpi::raw_ostream& os, const ClientMessage& msg) {
   return true;
 }
 
-void nt::net::WireEncodeAnnounce(wpi::raw_ostream& os, std::string_view name,
-                                 int64_t id, std::string_view typeStr,
-                                 const wpi::json& properties,
-                                 std::optional<int64_t> pubHandle) {
+template <typename F>
+static void WireEncodeAnnounceImpl(wpi::raw_ostream& os, std::string_view name,
+                                   int64_t id, std::string_view typeStr,
+                                   F&& writeProperties,
+                                   std::optional<int64_t> pubHandle) {
   wpi::json::serializer s{os, ' ', 0};
   os << "{\"method\":\"" << AnnounceMsg::kMethodStr << "\",\"params\":{";
   os << "\"id\":";
@@ -162,7 +168,7 @@ void nt::net::WireEncodeAnnounce(wpi::raw_ostream& os, std::string_view name,
   os << ",\"name\":\"";
   s.dump_escaped(name, false);
   os << "\",\"properties\":";
-  s.dump(properties, false, false, 0, 0);
+  writeProperties(s);
   if (pubHandle) {
     os << ",\"pubuid\":";
     s.dump_integer(*pubHandle);
@@ -172,6 +178,25 @@ void nt::net::WireEncodeAnnounce(wpi::raw_ostream& os, std::string_view name,
   os << "\"}}";
 }
 
+void nt::net::WireEncodeAnnounce(wpi::raw_ostream& os, std::string_view name,
+                                 int64_t id, std::string_view typeStr,
+                                 const wpi::json& properties,
+                                 std::optional<int64_t> pubHandle) {
+  WireEncodeAnnounceImpl(
+      os, name, id, typeStr,
+      [&](wpi::json::serializer& s) { s.dump(properties, false, false, 0, 0); },
+      pubHandle);
+}
+
+void nt::net::WireEncodeAnnounceRaw(wpi::raw_ostream& os, std::string_view name,
+                                    int64_t id, std::string_view typeStr,
+                                    std::string_view properties,
+                                    std::optional<int64_t> pubHandle) {
+  WireEncodeAnnounceImpl(
+      os, name, id, typeStr,
+      [&](wpi::json::serializer&) { os << properties; }, pubHandle);
+}
+
 void nt::net::WireEncodeUnannounce(wpi::raw_ostream& os, std::string_view name,
                                    int64_t id) {
   wpi::json::serializer s{os, ' ', 0};
@@ -201,8 +226,13 @@ void nt::net::WireEncodePropertiesUpdate(wpi::raw_ostream& os,
 
 bool nt::net::WireEncodeText(wpi::raw_ostream& os, const ServerMessage& msg) {
   if (auto m = std::get_if<AnnounceMsg>(&msg.contents)) {
-    WireEncodeAnnounce(os, m->name, m->id, m->typeStr, m->properties,
-                       m->pubuid);
+    if (!m->propertiesStr.empty()) {
+      WireEncodeAnnounceRaw(os, m->name, m->id, m->typeStr, m->propertiesStr,
+                            m->pubuid);
+    } else {
+      WireEncodeAnnounce(os, m->name, m->id, m->typeStr, m->properties,
+                         m->pubuid);
+    }
   } else if (auto m = std::get_if<UnannounceMsg>(&msg.contents)) {
     WireEncodeUnannounce(os, m->name, m->id);
   } else if (auto m = std::get_if<PropertiesUpdateMsg>(&msg.contents)) {
@@ -213,16 +243,204 @@ bool nt::net::WireEncodeText(wpi::raw_ostream& os, const ServerMessage& msg) {
   return true;
 }
 
+static void InitWriter(mpack_writer_t* writer, char* buf, size_t size,
+                       wpi::raw_ostream& os) {
+  mpack_writer_init(writer, buf, size);
+  mpack_writer_set_context(writer, &os);
+  mpack_writer_set_flush(
+      writer, [](mpack_writer_t* writer, const char* buffer, size_t count) {
+        static_cast<wpi::raw_ostream*>(writer->context)->write(buffer, count);
+      });
+}
+
+// Writes an integer with the same (smallest) encoding as mpack_write_int().
+static uint8_t* WriteFastInt(uint8_t* buf, int64_t val) {
+  if (val >= -32 && val <= 127) {  // fixint
+    *buf++ = static_cast<uint8_t>(val);
+  } else if (val > 0) {
+    if (val <= UINT8_MAX) {
+      *buf++ = 0xcc;
+      *buf++ = static_cast<uint8_t>(val);
+    } else if (val <= UINT16_MAX) {
+      *buf++ = 0xcd;
+      wpi::support::endian::write16be(buf, val);
+      buf += 2;
+    } else if (val <= UINT32_MAX) {
+      *buf++ = 0xce;
+      wpi::support::endian::write32be(buf, val);
+      buf += 4;
+    } else {
+      *buf++ = 0xcf;
+      wpi::support::endian::write64be(buf, val);
+      buf += 8;
+    }
+  } else if (val >= INT8_MIN) {
+    *buf++ = 0xd0;
+    *buf++ = static_cast<uint8_t>(val);
+  } else if (val >= INT16_MIN) {
+    *buf++ = 0xd1;
+    wpi::support::endian::write16be(buf, val);
+    buf += 2;
+  } else if (val >= INT32_MIN) {
+    *buf++ = 0xd2;
+    wpi::support::endian::write32be(buf, val);
+    buf += 4;
+  } else {
+    *buf++ = 0xd3;
+    wpi::support::endian::write64be(buf, val);
+    buf += 8;
+  }
+  return buf;
+}
+
+// Writes a str (isStr) or bin header with the same encoding as
+// mpack_write_str() / mpack_write_bin().
+static uint8_t* WriteFastBytesHeader(uint8_t* buf, bool isStr, size_t size) {
+  if (isStr && size <= 31) {
+    *buf++ = 0xa0 | size;
+  } else if (size <= UINT8_MAX) {
+    *buf++ = isStr ? 0xd9 : 0xc4;
+    *buf++ = size;
+  } else if (size <= UINT16_MAX) {
+    *buf++ = isStr ? 0xda : 0xc5;
+    wpi::support::endian::write16be(buf, size);
+    buf += 2;
+  } else {
+    *buf++ = isStr ? 0xdb : 0xc6;
+    wpi::support::endian::write32be(buf, size);
+    buf += 4;
+  }
+  return buf;
+}
+
+// Writes an array header with the same encoding as mpack_start_array().
+static uint8_t* WriteFastArrayHeader(uint8_t* buf, size_t size) {
+  if (size <= 15) {
+    *buf++ = 0x90 | size;
+  } else if (size <= UINT16_MAX) {
+    *buf++ = 0xdc;
+    wpi::support::endian::write16be(buf, size);
+    buf += 2;
+  } else {
+    *buf++ = 0xdd;
+    wpi::support::endian::write32be(buf, size);
+    buf += 4;
+  }
+  return buf;
+}
+
+// Writes the elements of a numeric array through a local buffer, converting
+// a block of elements at a time and writing each block with a single call.
+// MaxSize is the largest encoded size of one element.
+template <size_t MaxSize, typename T, typename F>
+static void WriteFastArrayElements(wpi::raw_ostream& os,
+                                   std::span<const T> arr, F&& writeElem) {
+  constexpr size_t kBlockElems = 128;
+  uint8_t buf[kBlockElems * MaxSize];
+  while (!arr.empty()) {
+    auto block = arr.first((std::min)(arr.size(), kBlockElems));
+    uint8_t* p = buf;
+    for (auto val : block) {
+      p = writeElem(p, val);
+    }
+    os.write(buf, p - buf);
+    arr = arr.subspan(block.size());
+  }
+}
+
 bool nt::net::WireEncodeBinary(wpi::raw_ostream& os, int64_t id, int64_t time,
                                const Value& value) {
+  // Fast path for scalar, string, raw, and numeric array values: the
+  // fixed-size part of the [id, time, type, value] array is encoded directly
+  // into a local buffer and written with a single call; string and raw data
+  // follow as-is, and numeric array elements are converted in blocks.
+  uint8_t buf[32];
+  uint8_t* p = buf;
+  std::span<const uint8_t> data;
+  *p++ = 0x94;  // fixarray of 4
+  p = WriteFastInt(p, id);
+  p = WriteFastInt(p, time);
+  switch (value.type()) {
+    case NT_BOOLEAN:
+      *p++ = 0;
+      *p++ = value.GetBoolean() ? 0xc3 : 0xc2;
+      break;
+    case NT_INTEGER:
+      *p++ = 2;
+      p = WriteFastInt(p, value.GetInteger());
+      break;
+    case NT_FLOAT:
+      *p++ = 3;
+      *p++ = 0xca;
+      wpi::support::endian::write32be(p, wpi::FloatToBits(value.GetFloat()));
+      p += 4;
+      break;
+    case NT_DOUBLE:
+      *p++ = 1;
+      *p++ = 0xcb;
+      wpi::support::endian::write64be(p, wpi::DoubleToBits(value.GetDouble()));
+      p += 8;
+      break;
+    case NT_STRING: {
+      auto v = value.GetString();
+      *p++ = 4;
+      p = WriteFastBytesHeader(p, true, v.size());
+      data = {reinterpret_cast<const uint8_t*>(v.data()), v.size()};
+      break;
+    }
+    case NT_RPC:
+    case NT_RAW:
+      data = value.GetRaw();
+      *p++ = 5;
+      p = WriteFastBytesHeader(p, false, data.size());
+      break;
+    case NT_INTEGER_ARRAY: {
+      auto v = value.GetIntegerArray();
+      *p++ = 18;
+      p = WriteFastArrayHeader(p, v.size());
+      os.write(buf, p - buf);
+      WriteFastArrayElements<9>(os, v, WriteFastInt);
+      return true;
+    }
+    case NT_FLOAT_ARRAY: {
+      auto v = value.GetFloatArray();
+      *p++ = 19;
+      p = WriteFastArrayHeader(p, v.size());
+      os.write(buf, p - buf);
+      WriteFastArrayElements<5>(os, v, [](uint8_t* p, float val) {
+        *p = 0xca;
+        wpi::support::endian::write32be(p + 1, wpi::FloatToBits(val));
+        return p + 5;
+      });
+      return true;
+    }
+    case NT_DOUBLE_ARRAY: {
+      auto v = value.GetDoubleArray();
+      *p++ = 17;
+      p = WriteFastArrayHeader(p, v.size());
+      os.write(buf, p - buf);
+      WriteFastArrayElements<9>(os, v, [](uint8_t* p, double val) {
+        *p = 0xcb;
+        wpi::support::endian::write64be(p + 1, wpi::DoubleToBits(val));
+        return p + 9;
+      });
+      return true;
+    }
+    default:
+      return WireEncodeBinaryMpack(os, id, time, value);
+  }
+  os.write(buf, p - buf);
+  if (!data.empty()) {
+    os.write(data.data(), data.size());
+  }
+  return true;
+}
+
+bool nt::net::WireEncodeBinaryMpack(wpi::raw_ostream& os, int64_t id,
+                                    int64_t time, const Value& value) {
   char buf[128];
   mpack_writer_t writer;
-  mpack_writer_init(&writer, buf, sizeof(buf));
-  mpack_writer_set_context(&writer, &os);
-  mpack_writer_set_flush(
-      &writer, [](mpack_writer_t* writer, const char* buffer, size_t count) {
-        static_cast<wpi::raw_ostream*>(writer->context)->write(buffer, count);
-      });
+  InitWriter(&writer, buf, sizeof(buf), os);
   mpack_start_array(&writer, 4);
   mpack_write_int(&writer, id);
   mpack_write_int(&writer, time);
@@ -313,3 +531,146 @@ bool nt::net::WireEncodeBinary(wpi::raw_ostream& os, int64_t id, int64_t time,
   mpack_finish_array(&writer);
   return mpack_writer_destroy(&writer) == mpack_ok;
 }
+
+static void WriteStr(mpack_writer_t* writer, std::string_view str) {
+  mpack_write_str(writer, str.data(), str.size());
+}
+
+static void WriteJson(mpack_writer_t* writer, const wpi::json& j) {
+  wpi::SmallVector<uint8_t, 128> buf;
+  auto data = wpi::json::to_msgpack(j, buf);
+  mpack_write_object_bytes(writer, reinterpret_cast<const char*>(data.data()),
+                           data.size());
+}
+
+// writes {"method": method, "params": {...}}; caller must write numParams
+// key/value pairs and then call FinishControl()
+static void StartControl(mpack_writer_t* writer, std::string_view method,
+                         uint32_t numParams) {
+  mpack_start_map(writer, 2);
+  WriteStr(writer, "method");
+  WriteStr(writer, method);
+  WriteStr(writer, "params");
+  mpack_start_map(writer, numParams);
+}
+
+static bool FinishControl(mpack_writer_t* writer) {
+  mpack_finish_map(writer);
+  mpack_finish_map(writer);
+  return mpack_writer_destroy(writer) == mpack_ok;
+}
+
+static void WriteSubscribe(mpack_writer_t* writer, int64_t subuid,
+                           std::span<const std::string> topicNames,
+                           const PubSubOptionsImpl& options) {
+  StartControl(writer, SubscribeMsg::kMethodStr, 3);
+  WriteStr(writer, "options");
+  bool periodic = options.periodicMs != PubSubOptionsImpl::kDefaultPeriodicMs;
+  mpack_start_map(writer, (options.sendAll ? 1 : 0) +
+                              (options.topicsOnly ? 1 : 0) +
+                              (options.prefixMatch ? 1 : 0) +
+                              (periodic ? 1 : 0));
+  if (options.sendAll) {
+    WriteStr(writer, "all");
+    mpack_write_bool(writer, true);
+  }
+  if (options.topicsOnly) {
+    WriteStr(writer, "topicsonly");
+    mpack_write_bool(writer, true);
+  }
+  if (options.prefixMatch) {
+    WriteStr(writer, "prefix");
+    mpack_write_bool(writer, true);
+  }
+  if (periodic) {
+    WriteStr(writer, "periodic");
+    mpack_write_double(writer, options.periodicMs / 1000.0);
+  }
+  mpack_finish_map(writer);
+  WriteStr(writer, "topics");
+  mpack_start_array(writer, topicNames.size());
+  for (auto&& name : topicNames) {
+    WriteStr(writer, name);
+  }
+  mpack_finish_array(writer);
+  WriteStr(writer, "subuid");
+  mpack_write_int(writer, subuid);
+}
+
+bool nt::net::WireEncodeBinary(wpi::raw_ostream& os, const ClientMessage& msg) {
+  char buf[128];
+  mpack_writer_t writer;
+  InitWriter(&writer, buf, sizeof(buf), os);
+  if (auto m = std::get_if<PublishMsg>(&msg.contents)) {
+    StartControl(&writer, PublishMsg::kMethodStr, 4);
+    WriteStr(&writer, "name");
+    WriteStr(&writer, m->name);
+    WriteStr(&writer, "properties");
+    WriteJson(&writer, m->properties);
+    WriteStr(&writer, "pubuid");
+    mpack_write_int(&writer, Handle{m->pubHandle}.GetIndex());
+    WriteStr(&writer, "type");
+    WriteStr(&writer, m->typeStr);
+  } else if (auto m = std::get_if<UnpublishMsg>(&msg.contents)) {
+    StartControl(&writer, UnpublishMsg::kMethodStr, 1);
+    WriteStr(&writer, "pubuid");
+    mpack_write_int(&writer, Handle{m->pubHandle}.GetIndex());
+  } else if (auto m = std::get_if<SetPropertiesMsg>(&msg.contents)) {
+    StartControl(&writer, SetPropertiesMsg::kMethodStr, 2);
+    WriteStr(&writer, "name");
+    WriteStr(&writer, m->name);
+    WriteStr(&writer, "update");
+    WriteJson(&writer, m->update);
+  } else if (auto m = std::get_if<SubscribeMsg>(&msg.contents)) {
+    WriteSubscribe(&writer, m->subHandle, m->topicNames, m->options);
+  } else if (auto m = std::get_if<UnsubscribeMsg>(&msg.contents)) {
+    StartControl(&writer, UnsubscribeMsg::kMethodStr, 1);
+    WriteStr(&writer, "subuid");
+    mpack_write_int(&writer, m->subHandle);
+  } else {
+    mpack_writer_destroy(&writer);
+    return false;
+  }
+  return FinishControl(&writer);
+}
+
+bool nt::net::WireEncodeBinary(wpi::raw_ostream& os, const ServerMessage& msg) {
+  char buf[128];
+  mpack_writer_t writer;
+  InitWriter(&writer, buf, sizeof(buf), os);
+  if (auto m = std::get_if<AnnounceMsg>(&msg.contents)) {
+    StartControl(&writer, AnnounceMsg::kMethodStr, m->pubuid ? 5 : 4);
+    WriteStr(&writer, "id");
+    mpack_write_int(&writer, m->id);
+    WriteStr(&writer, "name");
+    WriteStr(&writer, m->name);
+    WriteStr(&writer, "properties");
+    WriteJson(&writer, m->properties);
+    if (m->pubuid) {
+      WriteStr(&writer, "pubuid");
+      mpack_write_int(&writer, *m->pubuid);
+    }
+    WriteStr(&writer, "type");
+    WriteStr(&writer, m->typeStr);
+  } else if (auto m = std::get_if<UnannounceMsg>(&msg.contents)) {
+    StartControl(&writer, UnannounceMsg::kMethodStr, 2);
+    WriteStr(&writer, "id");
+    mpack_write_int(&writer, m->id);
+    WriteStr(&writer, "name");
+    WriteStr(&writer, m->name);
+  } else if (auto m = std::get_if<PropertiesUpdateMsg>(&msg.contents)) {
+    StartControl(&writer, PropertiesUpdateMsg::kMethodStr, m->ack ? 3 : 2);
+    WriteStr(&writer, "name");
+    WriteStr(&writer, m->name);
+    WriteStr(&writer, "update");
+    WriteJson(&writer, m->update);
+    if (m->ack) {
+      WriteStr(&writer, "ack");
+      mpack_write_bool(&writer, true);
+    }
+  } else {
+    mpack_writer_destroy(&writer);
+    return false;
+  }
+  return FinishControl(&writer);
+}
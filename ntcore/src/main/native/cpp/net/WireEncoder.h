@@ -43,6 +43,11 @@ void WireEncodeUnsubscribe(wpi::raw_ostream& os, int64_t subuid);
 void WireEncodeAnnounce(wpi::raw_ostream& os, std::string_view name, int64_t id,
                         std::string_view typeStr, const wpi::json& properties,
                         std::optional<int64_t> pubuid);
+// same as above, but properties is already serialized as a JSON object
+void WireEncodeAnnounceRaw(wpi::raw_ostream& os, std::string_view name,
+                           int64_t id, std::string_view typeStr,
+                           std::string_view properties,
+                           std::optional<int64_t> pubuid);
 void WireEncodeUnannounce(wpi::raw_ostream& os, std::string_view name,
                           int64_t id);
 void WireEncodePropertiesUpdate(wpi::raw_ostream& os, std::string_view name,
@@ -58,4 +63,16 @@ bool WireEncodeText(wpi::raw_ostream& os, const ServerMessage& msg);
 bool WireEncodeBinary(wpi::raw_ostream& os, int64_t id, int64_t time,
                       const Value& value);
 
+// same as above, but always uses the generic msgpack writer rather than the
+// fast path for scalar, string, and raw values; the output is identical
+bool WireEncodeBinaryMpack(wpi::raw_ostream& os, int64_t id, int64_t time,
+                           const Value& value);
+
+// Encode a single control message as a msgpack map for the binary control
+// subprotocol (kBinaryControlProtocol).  The structure mirrors the JSON text
+// message; these are sent in binary frames along with value messages.
+// Returns true if message was written
+bool WireEncodeBinary(wpi::raw_ostream& os, const ClientMessage& msg);
+bool WireEncodeBinary(wpi::raw_ostream& os, const ServerMessage& msg);
+
 }  // namespace nt::net
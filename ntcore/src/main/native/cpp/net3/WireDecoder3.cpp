@@ -10,6 +10,7 @@
 #include <vector>
 
 #include <fmt/format.h>
+#include <wpi/Endian.h>
 #include <wpi/MathExtras.h>
 #include <wpi/SpanExtras.h>
 #include <wpi/leb128.h>
@@ -33,6 +34,96 @@ class SimpleValueReader {
   int m_count = 0;
 };
 
+// Bounds-checked reader over input that is expected to hold complete
+// messages.  Once a read runs past the end of the input, that read and all
+// later reads fail (ok() returns false) and return zero/empty values.
+class SpanReader {
+ public:
+  explicit SpanReader(std::span<const uint8_t> in)
+      : m_pos{in.data()}, m_end{in.data() + in.size()} {}
+
+  bool ok() const { return m_ok; }
+  const uint8_t* pos() const { return m_pos; }
+
+  uint8_t Read8() {
+    if (!Check(1)) {
+      return 0;
+    }
+    return *m_pos++;
+  }
+
+  uint16_t Read16() {
+    if (!Check(2)) {
+      return 0;
+    }
+    uint16_t val = wpi::support::endian::read16be(m_pos);
+    m_pos += 2;
+    return val;
+  }
+
+  uint32_t Read32() {
+    if (!Check(4)) {
+      return 0;
+    }
+    uint32_t val = wpi::support::endian::read32be(m_pos);
+    m_pos += 4;
+    return val;
+  }
+
+  double ReadDouble() {
+    if (!Check(8)) {
+      return 0;
+    }
+    double val = wpi::BitsToDouble(wpi::support::endian::read64be(m_pos));
+    m_pos += 8;
+    return val;
+  }
+
+  // ULEB128 length-prefixed bytes, referencing the input
+  std::span<const uint8_t> ReadBytes() {
+    uint64_t len = 0;
+    int shift = 0;
+    for (;;) {
+      // longer encodings than a uint64_t can hold are left to the
+      // state machine
+      if (!Check(1) || shift >= 64) {
+        m_ok = false;
+        return {};
+      }
+      uint8_t byte = *m_pos++;
+      len |= (byte & 0x7fULL) << shift;
+      shift += 7;
+      if (!(byte & 0x80)) {
+        break;
+      }
+    }
+    if (!Check(len)) {
+      return {};
+    }
+    std::span<const uint8_t> rv{m_pos, static_cast<size_t>(len)};
+    m_pos += len;
+    return rv;
+  }
+
+  std::string_view ReadString() {
+    auto bytes = ReadBytes();
+    return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+  }
+
+ private:
+  bool Check(uint64_t size) {
+    if (m_ok && static_cast<uint64_t>(m_end - m_pos) >= size) {
+      return true;
+    }
+    m_ok = false;
+    return false;
+  }
+
+  const uint8_t* m_pos;
+  const uint8_t* m_end;
+  bool m_ok = true;
+};
+
 struct StringReader {
   void SetLen(uint64_t len_) {
     len = len_;
@@ -124,6 +215,8 @@ struct WDImpl {
   unsigned int m_seq_num_uid{0};
 
   void Execute(std::span<const uint8_t>* in);
+  bool ExecuteFast(std::span<const uint8_t>* in);
+  std::optional<Value> ReadValueFast(SpanReader& r, uint8_t type);
 
   std::nullopt_t EmitError(std::string_view msg) {
     m_state = kError;
@@ -202,10 +295,211 @@ std::optional<double> SimpleValueReader::ReadDouble(
   }
 }
 
+// Decodes one complete message directly from the input, passing strings and
+// raw data to the handler (or into the value) straight from the input rather
+// than through the incremental readers.  Returns false without consuming
+// anything if the message is not entirely within the input or is invalid;
+// the state machine then handles it (buffering partial messages across
+// reads, and reporting errors).
+bool WDImpl::ExecuteFast(std::span<const uint8_t>* in) {
+  SpanReader r{*in};
+  uint8_t msgType = r.Read8();
+  switch (msgType) {
+    case Message3::kKeepAlive:
+      m_out.KeepAlive();
+      break;
+    case Message3::kClientHello: {
+      unsigned int protoRev = r.Read16();
+      if (!r.ok()) {
+        return false;
+      }
+      std::string_view selfId;
+      if (protoRev >= 0x0300u) {
+        selfId = r.ReadString();
+        if (!r.ok()) {
+          return false;
+        }
+      }
+      m_out.ClientHello(selfId, protoRev);
+      break;
+    }
+    case Message3::kProtoUnsup: {
+      unsigned int protoRev = r.Read16();
+      if (!r.ok()) {
+        return false;
+      }
+      m_out.ProtoUnsup(protoRev);
+      break;
+    }
+    case Message3::kServerHello: {
+      unsigned int flags = r.Read8();
+      auto selfId = r.ReadString();
+      if (!r.ok()) {
+        return false;
+      }
+      m_out.ServerHello(flags, selfId);
+      break;
+    }
+    case Message3::kServerHelloDone:
+      m_out.ServerHelloDone();
+      break;
+    case Message3::kClientHelloDone:
+      m_out.ClientHelloDone();
+      break;
+    case Message3::kEntryAssign: {
+      auto name = r.ReadString();
+      uint8_t type = r.Read8();
+      unsigned int id = r.Read16();
+      unsigned int seqNum = r.Read16();
+      unsigned int flags = r.Read8();
+      if (!r.ok()) {
+        return false;
+      }
+      auto value = ReadValueFast(r, type);
+      if (!value) {
+        return false;
+      }
+      m_out.EntryAssign(name, id, seqNum, *value, flags);
+      break;
+    }
+    case Message3::kEntryUpdate: {
+      unsigned int id = r.Read16();
+      unsigned int seqNum = r.Read16();
+      uint8_t type = r.Read8();
+      if (!r.ok()) {
+        return false;
+      }
+      auto value = ReadValueFast(r, type);
+      if (!value) {
+        return false;
+      }
+      m_out.EntryUpdate(id, seqNum, *value);
+      break;
+    }
+    case Message3::kFlagsUpdate: {
+      unsigned int id = r.Read16();
+      unsigned int flags = r.Read8();
+      if (!r.ok()) {
+        return false;
+      }
+      m_out.FlagsUpdate(id, flags);
+      break;
+    }
+    case Message3::kEntryDelete: {
+      unsigned int id = r.Read16();
+      if (!r.ok()) {
+        return false;
+      }
+      m_out.EntryDelete(id);
+      break;
+    }
+    case Message3::kClearEntries:
+      if (r.Read32() != Message3::kClearAllMagic || !r.ok()) {
+        return false;
+      }
+      m_out.ClearEntries();
+      break;
+    case Message3::kExecuteRpc:
+    case Message3::kRpcResponse: {
+      unsigned int id = r.Read16();
+      unsigned int uid = r.Read16();
+      auto data = r.ReadBytes();
+      if (!r.ok()) {
+        return false;
+      }
+      if (msgType == Message3::kRpcResponse) {
+        m_out.RpcResponse(id, uid, data);
+      } else {
+        m_out.ExecuteRpc(id, uid, data);
+      }
+      break;
+    }
+    default:
+      return false;
+  }
+  *in = wpi::drop_front(*in, r.pos() - in->data());
+  return true;
+}
+
+std::optional<Value> WDImpl::ReadValueFast(SpanReader& r, uint8_t type) {
+  switch (type) {
+    case Message3::kBoolean: {
+      bool val = r.Read8() != 0;
+      if (!r.ok()) {
+        return std::nullopt;
+      }
+      return Value::MakeBoolean(val);
+    }
+    case Message3::kDouble: {
+      double val = r.ReadDouble();
+      if (!r.ok()) {
+        return std::nullopt;
+      }
+      return Value::MakeDouble(val);
+    }
+    case Message3::kString: {
+      auto val = r.ReadString();
+      if (!r.ok()) {
+        return std::nullopt;
+      }
+      return Value::MakeString(val);
+    }
+    case Message3::kRaw:
+    case Message3::kRpcDef: {
+      auto val = r.ReadBytes();
+      if (!r.ok()) {
+        return std::nullopt;
+      }
+      return Value::MakeRaw(val);
+    }
+    case Message3::kBooleanArray: {
+      size_t size = r.Read8();
+      std::vector<int> arr(size);
+      for (auto&& val : arr) {
+        val = r.Read8() ? 1 : 0;
+      }
+      if (!r.ok()) {
+        return std::nullopt;
+      }
+      return Value::MakeBooleanArray(std::move(arr));
+    }
+    case Message3::kDoubleArray: {
+      size_t size = r.Read8();
+      std::vector<double> arr(size);
+      for (auto&& val : arr) {
+        val = r.ReadDouble();
+      }
+      if (!r.ok()) {
+        return std::nullopt;
+      }
+      return Value::MakeDoubleArray(std::move(arr));
+    }
+    case Message3::kStringArray: {
+      size_t size = r.Read8();
+      std::vector<std::string> arr;
+      arr.reserve(size);
+      for (size_t i = 0; i < size && r.ok(); ++i) {
+        arr.emplace_back(r.ReadString());
+      }
+      if (!r.ok()) {
+        return std::nullopt;
+      }
+      return Value::MakeStringArray(std::move(arr));
+    }
+    default:
+      return std::nullopt;
+  }
+}
+
 void WDImpl::Execute(std::span<const uint8_t>* in) {
   while (!in->empty()) {
     switch (m_state) {
       case kStart: {
+        // complete messages are decoded directly from the input
+        if (ExecuteFast(in)) {
+          break;
+        }
+
         uint8_t msgType = Read8(in);
         switch (msgType) {
           case Message3::kKeepAlive:
@@ -553,6 +553,10 @@ void NT_FlushLocal(NT_Inst inst) {
   nt::FlushLocal(inst);
 }
 
+void NT_SetLowLatencyFlush(NT_Inst inst, NT_Bool enabled) {
+  nt::SetLowLatencyFlush(inst, enabled);
+}
+
 void NT_Flush(NT_Inst inst) {
   nt::Flush(inst);
 }
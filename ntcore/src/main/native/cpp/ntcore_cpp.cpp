@@ -555,9 +555,10 @@ std::string_view GetStringFromType(NT_Type type) {
  */
 NT_DataLogger StartEntryDataLog(NT_Inst inst, wpi::log::DataLog& log,
                                 std::string_view prefix,
-                                std::string_view logPrefix) {
+                                std::string_view logPrefix,
+                                const EntryDataLogOptions& options) {
   if (auto ii = InstanceImpl::GetTyped(inst, Handle::kInstance)) {
-    return ii->localStorage.StartDataLog(log, prefix, logPrefix);
+    return ii->localStorage.StartDataLog(log, prefix, logPrefix, options);
   } else {
     return 0;
   }
@@ -719,6 +720,12 @@ void FlushLocal(NT_Inst inst) {
   }
 }
 
+void SetLowLatencyFlush(NT_Inst inst, bool enabled) {
+  if (auto ii = InstanceImpl::GetTyped(inst, Handle::kInstance)) {
+    ii->SetLowLatencyFlush(enabled);
+  }
+}
+
 void Flush(NT_Inst inst) {
   if (auto ii = InstanceImpl::GetTyped(inst, Handle::kInstance)) {
     if (auto client = ii->GetClient()) {
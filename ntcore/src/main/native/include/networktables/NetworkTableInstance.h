@@ -612,6 +612,16 @@ class NetworkTableInstance final {
    */
   void FlushLocal() const;
 
+  /**
+   * Sets low-latency flush mode. When enabled, the first local change after
+   * each flush wakes up the network thread and flushes to the network,
+   * instead of waiting for the regularly scheduled interval. Disabled by
+   * default.
+   *
+   * @param enabled true to enable low-latency flush mode
+   */
+  void SetLowLatencyFlush(bool enabled);
+
   /**
    * Flushes all updated values immediately to the network.
    * @note This is rate-limited to protect the network from flooding.
@@ -663,11 +673,13 @@ class NetworkTableInstance final {
    * @param prefix only store entries with names that start with this prefix;
    *               the prefix is not included in the data log entry name
    * @param logPrefix prefix to add to data log entry names
+   * @param options sampling options
    * @return Data logger handle
    */
-  NT_DataLogger StartEntryDataLog(wpi::log::DataLog& log,
-                                  std::string_view prefix,
-                                  std::string_view logPrefix);
+  NT_DataLogger StartEntryDataLog(
+      wpi::log::DataLog& log, std::string_view prefix,
+      std::string_view logPrefix,
+      const EntryDataLogOptions& options = kDefaultEntryDataLogOptions);
 
   /**
    * Stops logging entry changes to a DataLog.
@@ -257,7 +257,10 @@ struct NT_TimeSyncEventData {
    */
   int64_t serverTimeOffset;
 
-  /** Measured round trip time divided by 2, in microseconds. */
+  /**
+   * Measured round trip time divided by 2, in microseconds, of the ping the
+   * offset estimate is based on. This bounds the error of serverTimeOffset.
+   */
   int64_t rtt2;
 
   /**
@@ -1184,6 +1187,19 @@ void NT_StopDSClient(NT_Inst inst);
  */
 void NT_FlushLocal(NT_Inst inst);
 
+/**
+ * Set low-latency flush mode.
+ *
+ * When enabled, the first local change after each flush wakes up the network
+ * thread and flushes to the network (subject to the network rate limit),
+ * instead of waiting for the regularly scheduled interval.  Disabled by
+ * default.
+ *
+ * @param inst      instance handle
+ * @param enabled   true to enable low-latency flush mode
+ */
+void NT_SetLowLatencyFlush(NT_Inst inst, NT_Bool enabled);
+
 /**
  * Flush to network.
  *
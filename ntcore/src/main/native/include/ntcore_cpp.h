@@ -202,7 +202,10 @@ class TimeSyncEventData {
    */
   int64_t serverTimeOffset;
 
-  /** Measured round trip time divided by 2, in microseconds. */
+  /**
+   * Measured round trip time divided by 2, in microseconds, of the ping the
+   * offset estimate is based on. This bounds the error of serverTimeOffset.
+   */
   int64_t rtt2;
 
   /**
@@ -380,6 +383,45 @@ struct PubSubOptions {
  */
 constexpr PubSubOptions kDefaultPubSubOptions;
 
+/**
+ * Options for logging entry changes to a DataLog. These apply to every entry
+ * logged by a data logger; individual topics can override them with the
+ * "logPeriod", "logDeadband", and "logDuplicates" properties.
+ */
+struct EntryDataLogOptions {
+  /**
+   * Minimum time between logged values of each entry, in seconds. Value
+   * changes that occur sooner than this after the last logged value are not
+   * logged. The default (0) logs every value change.
+   *
+   * The latest value that is not logged because of this is held back, and
+   * is logged with its original timestamp once the period has expired, so
+   * the last value of a burst is not lost. Values are only checked as they
+   * arrive; there is no timer. A held back value is logged when the next
+   * value arrives after the period, or when logging of the entry stops (the
+   * topic is unpublished, the data logger is stopped, or the options change).
+   */
+  double period = 0;
+
+  /**
+   * For numeric and numeric array entries, only log a value if it differs
+   * from the last logged value by more than this amount (for arrays, in any
+   * element, or if the array length changes). The default (0) logs every
+   * value change.
+   */
+  double deadband = 0;
+
+  /**
+   * Log values that are identical to the last logged value.
+   */
+  bool keepDuplicates = true;
+};
+
+/**
+ * Default entry data log options.
+ */
+constexpr EntryDataLogOptions kDefaultEntryDataLogOptions;
+
 /**
  * @defgroup ntcore_instance_func Instance Functions
  * @{
@@ -1124,6 +1166,20 @@ void StopDSClient(NT_Inst inst);
  */
 void FlushLocal(NT_Inst inst);
 
+/**
+ * Set low-latency flush mode.
+ *
+ * When enabled, the first local change after each flush wakes up the network
+ * thread and flushes to the network (subject to the network rate limit),
+ * instead of waiting for the regularly scheduled interval.  Further changes
+ * made before that flush runs are sent with it, so this does not cause a
+ * wakeup per value.  Disabled by default.
+ *
+ * @param inst      instance handle
+ * @param enabled   true to enable low-latency flush mode
+ */
+void SetLowLatencyFlush(NT_Inst inst, bool enabled);
+
 /**
  * Flush to network.
  *
@@ -1230,11 +1286,13 @@ std::string_view GetStringFromType(NT_Type type);
  * @param prefix only store entries with names that start with this prefix;
  *               the prefix is not included in the data log entry name
  * @param logPrefix prefix to add to data log entry names
+ * @param options sampling options
  * @return Data logger handle
  */
-NT_DataLogger StartEntryDataLog(NT_Inst inst, wpi::log::DataLog& log,
-                                std::string_view prefix,
-                                std::string_view logPrefix);
+NT_DataLogger StartEntryDataLog(
+    NT_Inst inst, wpi::log::DataLog& log, std::string_view prefix,
+    std::string_view logPrefix,
+    const EntryDataLogOptions& options = kDefaultEntryDataLogOptions);
 
 /**
  * Stops logging entry changes to a DataLog.
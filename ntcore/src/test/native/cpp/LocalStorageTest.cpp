@@ -2,6 +2,12 @@
 // Open Source Software; you can modify and/or share it under the terms of
 // the WPILib BSD license file in the root directory of this project.
 
+#include <wpi/DataLog.h>
+#include <wpi/DataLogReader.h>
+#include <wpi/DenseMap.h>
+#include <wpi/MemoryBuffer.h>
+#include <wpi/StringMap.h>
+
 #include "LocalStorage.h"
 #include "MockListenerStorage.h"
 #include "MockLogger.h"
@@ -957,4 +963,70 @@ TEST_F(LocalStorageTest, ReadQueueInitialRemote) {
   EXPECT_THAT(storage.ReadQueueDouble(subLocal), IsEmpty());
 }
 
+TEST_F(LocalStorageTest, DataLogSampling) {
+  std::vector<uint8_t> data;
+  auto log = std::make_unique<wpi::log::DataLog>(
+      [&](auto out) { data.insert(data.end(), out.begin(), out.end()); },
+      60.0);
+  auto logger = storage.StartDataLog(*log, "", "", {.period = 0.01});
+
+  // logger options: at most one value per 10 ms, plus the latest value held
+  // back within each period
+  auto foo = storage.NetworkAnnounce("foo", "double", wpi::json::object(), 0);
+  for (int i = 0; i < 10; ++i) {
+    storage.NetworkSetValue(foo, Value::MakeDouble(i, 1000 + i * 5000));
+  }
+
+  // the last value of a burst is logged when a value arrives after a gap
+  auto qux = storage.NetworkAnnounce("qux", "double", wpi::json::object(), 0);
+  storage.NetworkSetValue(qux, Value::MakeDouble(1.0, 1000));
+  storage.NetworkSetValue(qux, Value::MakeDouble(2.0, 2000));
+  storage.NetworkSetValue(qux, Value::MakeDouble(3.0, 3000));
+  storage.NetworkSetValue(qux, Value::MakeDouble(4.0, 100000));
+
+  // overridden by properties
+  auto bar = storage.NetworkAnnounce(
+      "bar", "double", {{"logPeriod", 0}, {"logDeadband", 0.5}}, 0);
+  storage.NetworkSetValue(bar, Value::MakeDouble(1.0, 1));
+  storage.NetworkSetValue(bar, Value::MakeDouble(1.2, 2));
+  storage.NetworkSetValue(bar, Value::MakeDouble(1.6, 3));
+  storage.NetworkSetValue(bar, Value::MakeDouble(1.2, 4));
+  storage.NetworkSetValue(bar, Value::MakeDouble(3.0, 5));
+
+  auto baz = storage.NetworkAnnounce("baz", "string",
+                                     {{"logDuplicates", false}}, 0);
+  storage.NetworkSetValue(baz, Value::MakeString("a", 1));
+  storage.NetworkSetValue(baz, Value::MakeString("b", 2));
+  storage.NetworkSetValue(baz, Value::MakeString("a", 20000));
+  storage.NetworkSetValue(baz, Value::MakeString("c", 30000));
+  storage.NetworkSetValue(baz, Value::MakeString("c", 40000));
+
+  // the last held back value of foo is logged when logging stops
+  storage.StopDataLog(logger);
+  log.reset();
+  wpi::log::DataLogReader reader{wpi::MemoryBuffer::GetMemBufferCopy(data)};
+  wpi::DenseMap<int, std::string> names;
+  wpi::StringMap<std::vector<std::string>> values;
+  for (auto&& record : reader) {
+    wpi::log::StartRecordData start;
+    if (record.GetStartData(&start)) {
+      names[start.entry] = start.name;
+    } else if (!record.IsControl()) {
+      auto& name = names[record.GetEntry()];
+      double d;
+      std::string_view str;
+      if (name == "baz" && record.GetString(&str)) {
+        values[name].emplace_back(str);
+      } else if (record.GetDouble(&d)) {
+        values[name].emplace_back(fmt::format("{}", d));
+      }
+    }
+  }
+  EXPECT_THAT(values["foo"], ElementsAre("0", "1", "3", "5", "7", "9"));
+  EXPECT_THAT(values["qux"], ElementsAre("1", "3", "4"));
+  EXPECT_THAT(values["bar"], ElementsAre("1", "1.6", "3"));
+  // b is held back by the period, then logged once it expires
+  EXPECT_THAT(values["baz"], ElementsAre("a", "b", "a", "c"));
+}
+
 }  // namespace nt
@@ -0,0 +1,149 @@
+// Copyright (c) FIRST and other WPILib contributors.
+// Open Source Software; you can modify and/or share it under the terms of
+// the WPILib BSD license file in the root directory of this project.
+
+#include <stdint.h>
+
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "../MockLogger.h"
+#include "Handle.h"
+#include "PubSubOptions.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "net/Message.h"
+#include "net/NetworkLoopQueue.h"
+#include "networktables/NetworkTableValue.h"
+
+using ::testing::_;
+
+using namespace std::string_view_literals;
+
+namespace nt {
+
+class NetworkLoopQueueTest : public ::testing::Test {
+ public:
+  ::testing::StrictMock<wpi::MockLogger> logger;
+  net::NetworkLoopQueue queue{logger};
+  std::vector<net::ClientMessage> msgs;
+};
+
+TEST_F(NetworkLoopQueueTest, Empty) {
+  queue.ReadQueue(&msgs);
+  EXPECT_TRUE(msgs.empty());
+}
+
+TEST_F(NetworkLoopQueueTest, Order) {
+  NT_Publisher pubHandle = nt::Handle{0, 1, nt::Handle::kPublisher};
+  NT_Topic topicHandle = nt::Handle{0, 1, nt::Handle::kTopic};
+  queue.Publish(pubHandle, topicHandle, "test", "double", wpi::json::object(),
+                {});
+  queue.SetValue(pubHandle, Value::MakeDouble(1.0, 10));
+  queue.SetValue(pubHandle, Value::MakeDouble(2.0, 20));
+  queue.SetProperties(topicHandle, "test", {{"persistent", true}});
+  queue.SetValue(pubHandle, Value::MakeDouble(3.0, 30));
+  queue.Unpublish(pubHandle, topicHandle);
+
+  queue.ReadQueue(&msgs);
+  ASSERT_EQ(msgs.size(), 6u);
+  EXPECT_TRUE(std::holds_alternative<net::PublishMsg>(msgs[0].contents));
+  auto value = std::get_if<net::ClientValueMsg>(&msgs[1].contents);
+  ASSERT_TRUE(value);
+  EXPECT_EQ(value->pubHandle, pubHandle);
+  EXPECT_EQ(value->value, Value::MakeDouble(1.0, 10));
+  value = std::get_if<net::ClientValueMsg>(&msgs[2].contents);
+  ASSERT_TRUE(value);
+  EXPECT_EQ(value->value, Value::MakeDouble(2.0, 20));
+  EXPECT_TRUE(std::holds_alternative<net::SetPropertiesMsg>(msgs[3].contents));
+  value = std::get_if<net::ClientValueMsg>(&msgs[4].contents);
+  ASSERT_TRUE(value);
+  EXPECT_EQ(value->value, Value::MakeDouble(3.0, 30));
+  EXPECT_TRUE(std::holds_alternative<net::UnpublishMsg>(msgs[5].contents));
+
+  // queue is emptied by read
+  queue.ReadQueue(&msgs);
+  EXPECT_TRUE(msgs.empty());
+}
+
+TEST_F(NetworkLoopQueueTest, Full) {
+  EXPECT_CALL(logger,
+              Call(_, _, _, "NT: dropping value set due to memory limits"sv));
+  for (size_t i = 0; i < net::NetworkLoopQueue::kValueQueueSize + 10; ++i) {
+    queue.SetValue(1, Value::MakeInteger(i));
+  }
+  queue.Unsubscribe(2);
+  queue.ReadQueue(&msgs);
+  ASSERT_EQ(msgs.size(), net::NetworkLoopQueue::kValueQueueSize + 1);
+  EXPECT_TRUE(
+      std::holds_alternative<net::UnsubscribeMsg>(msgs.back().contents));
+
+  // space is available again after a read
+  queue.SetValue(1, Value::MakeInteger(5));
+  queue.ReadQueue(&msgs);
+  ASSERT_EQ(msgs.size(), 1u);
+}
+
+TEST_F(NetworkLoopQueueTest, Clear) {
+  queue.SetValue(1, Value::MakeString("hello"));
+  queue.Unsubscribe(2);
+  queue.ClearQueue();
+  queue.ReadQueue(&msgs);
+  EXPECT_TRUE(msgs.empty());
+}
+
+TEST_F(NetworkLoopQueueTest, Wakeup) {
+  int wakeups = 0;
+  queue.SetWakeup([&] { ++wakeups; });
+
+  // not called unless low latency is enabled
+  queue.SetValue(1, Value::MakeDouble(1.0));
+  EXPECT_EQ(wakeups, 0);
+
+  // called once per read
+  queue.SetLowLatency(true);
+  queue.SetValue(1, Value::MakeDouble(2.0));
+  queue.SetValue(1, Value::MakeDouble(3.0));
+  queue.Unsubscribe(2);
+  EXPECT_EQ(wakeups, 1);
+  queue.ReadQueue(&msgs);
+  EXPECT_EQ(msgs.size(), 4u);
+  queue.Unsubscribe(2);
+  EXPECT_EQ(wakeups, 2);
+}
+
+TEST_F(NetworkLoopQueueTest, MultipleProducers) {
+  // total is less than the queue size, so nothing is dropped even if the
+  // consumer falls behind
+  static constexpr int kThreads = 4;
+  static constexpr int kValues = 2000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kValues; ++i) {
+        queue.SetValue(t + 1, Value::MakeInteger(i));
+      }
+    });
+  }
+
+  // each producer's values must be received in order
+  std::vector<int64_t> next(kThreads, 0);
+  int total = 0;
+  while (total < kThreads * kValues) {
+    queue.ReadQueue(&msgs);
+    for (auto&& msg : msgs) {
+      auto value = std::get_if<net::ClientValueMsg>(&msg.contents);
+      ASSERT_TRUE(value);
+      ASSERT_EQ(value->value.GetInteger(), next[value->pubHandle - 1]++);
+      ++total;
+    }
+  }
+
+  for (auto&& thr : threads) {
+    thr.join();
+  }
+}
+
+}  // namespace nt
@@ -5,6 +5,7 @@
 #include <stdint.h>
 
 #include <span>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -330,4 +331,312 @@ TEST_F(ServerImplTest, ZeroTimestampNegativeTime) {
   }
 }
 
+TEST_F(ServerImplTest, BatchedValues) {
+  server.SetLocal(&local);
+  NT_Topic topicHandleA = nt::Handle{0, 1, nt::Handle::kTopic};
+  NT_Topic topicHandleB = nt::Handle{0, 2, nt::Handle::kTopic};
+  NT_Subscriber subHandleA = nt::Handle{0, 1, nt::Handle::kSubscriber};
+  NT_Subscriber subHandleB = nt::Handle{0, 2, nt::Handle::kSubscriber};
+  {
+    std::vector<net::ClientMessage> msgs;
+    msgs.emplace_back(
+        net::ClientMessage{net::SubscribeMsg{subHandleA, {"a"}, {}}});
+    msgs.emplace_back(net::ClientMessage{
+        net::SubscribeMsg{subHandleB, {"b"}, PubSubOptions{.sendAll = true}}});
+    server.HandleLocal(msgs);
+  }
+
+  ::testing::StrictMock<net::MockWireConnection> wire;
+  MockSetPeriodicFunc setPeriodic;
+  EXPECT_CALL(wire, Flush());  // AddClient()
+  auto [name, id] = server.AddClient("test", "connInfo", false, wire,
+                                     setPeriodic.AsStdFunction());
+
+  EXPECT_CALL(local, NetworkAnnounce("a", "double", wpi::json::object(), 0))
+      .WillOnce(Return(topicHandleA));
+  EXPECT_CALL(local, NetworkAnnounce("b", "double", wpi::json::object(), 0))
+      .WillOnce(Return(topicHandleB));
+  NT_Publisher pubHandleA = nt::Handle{0, 1, nt::Handle::kPublisher};
+  NT_Publisher pubHandleB = nt::Handle{0, 2, nt::Handle::kPublisher};
+  {
+    std::vector<net::ClientMessage> msgs;
+    msgs.emplace_back(net::ClientMessage{net::PublishMsg{
+        pubHandleA, topicHandleA, "a", "double", wpi::json::object(), {}}});
+    msgs.emplace_back(net::ClientMessage{net::PublishMsg{
+        pubHandleB, topicHandleB, "b", "double", wpi::json::object(), {}}});
+    server.ProcessIncomingText(id, EncodeText(msgs));
+  }
+
+  // all values for the sendAll subscriber, only the last for the other
+  {
+    ::testing::InSequence seq;
+    EXPECT_CALL(local,
+                NetworkSetValue(topicHandleB, Value::MakeDouble(1.0, 10)));
+    EXPECT_CALL(local,
+                NetworkSetValue(topicHandleB, Value::MakeDouble(2.0, 20)));
+    EXPECT_CALL(local,
+                NetworkSetValue(topicHandleA, Value::MakeDouble(3.0, 30)));
+  }
+  {
+    std::vector<net::ClientMessage> msgs;
+    msgs.emplace_back(net::ClientMessage{
+        net::ClientValueMsg{pubHandleA, Value::MakeDouble(1.0, 10)}});
+    msgs.emplace_back(net::ClientMessage{
+        net::ClientValueMsg{pubHandleB, Value::MakeDouble(1.0, 10)}});
+    msgs.emplace_back(net::ClientMessage{
+        net::ClientValueMsg{pubHandleA, Value::MakeDouble(2.0, 20)}});
+    msgs.emplace_back(net::ClientMessage{
+        net::ClientValueMsg{pubHandleB, Value::MakeDouble(2.0, 20)}});
+    msgs.emplace_back(net::ClientMessage{
+        net::ClientValueMsg{pubHandleA, Value::MakeDouble(3.0, 30)}});
+    server.ProcessIncomingBinary(id, EncodeServerBinary(msgs));
+  }
+}
+
+TEST_F(ServerImplTest, SendModesFollowSubscriptions) {
+  server.SetLocal(&local);
+  NT_Topic topicHandle = nt::Handle{0, 1, nt::Handle::kTopic};
+  NT_Subscriber subHandle = nt::Handle{0, 1, nt::Handle::kSubscriber};
+  NT_Publisher pubHandle = nt::Handle{0, 1, nt::Handle::kPublisher};
+
+  ::testing::StrictMock<net::MockWireConnection> wire;
+  MockSetPeriodicFunc setPeriodic;
+  EXPECT_CALL(wire, Flush());  // AddClient()
+  auto [name, id] = server.AddClient("test", "connInfo", false, wire,
+                                     setPeriodic.AsStdFunction());
+  {
+    std::vector<net::ClientMessage> msgs;
+    msgs.emplace_back(net::ClientMessage{net::PublishMsg{
+        pubHandle, topicHandle, "a", "double", wpi::json::object(), {}}});
+    server.ProcessIncomingText(id, EncodeText(msgs));
+  }
+
+  auto subscribe = [&](const PubSubOptions& options) {
+    std::vector<net::ClientMessage> msgs;
+    msgs.emplace_back(
+        net::ClientMessage{net::SubscribeMsg{subHandle, {"a"}, options}});
+    server.HandleLocal(msgs);
+  };
+  auto sendValues = [&](double first, double second) {
+    std::vector<net::ClientMessage> msgs;
+    msgs.emplace_back(net::ClientMessage{
+        net::ClientValueMsg{pubHandle, Value::MakeDouble(first, 10)}});
+    msgs.emplace_back(net::ClientMessage{
+        net::ClientValueMsg{pubHandle, Value::MakeDouble(second, 20)}});
+    server.ProcessIncomingBinary(id, EncodeServerBinary(msgs));
+  };
+
+  // topics only; no values
+  EXPECT_CALL(local, NetworkAnnounce("a", "double", wpi::json::object(), 0))
+      .WillOnce(Return(topicHandle));
+  subscribe(PubSubOptions{.topicsOnly = true});
+  sendValues(1.0, 2.0);
+
+  // replace with normal subscription (which sends the last value); last
+  // value of each batch only
+  EXPECT_CALL(local, NetworkSetValue(topicHandle, Value::MakeDouble(2.0, 20)));
+  subscribe(PubSubOptions{});
+  EXPECT_CALL(local, NetworkSetValue(topicHandle, Value::MakeDouble(4.0, 20)));
+  sendValues(3.0, 4.0);
+
+  // replace with sendAll (which resends the last value); every value
+  EXPECT_CALL(local, NetworkSetValue(topicHandle, Value::MakeDouble(4.0, 20)));
+  subscribe(PubSubOptions{.sendAll = true});
+  {
+    ::testing::InSequence seq;
+    EXPECT_CALL(local,
+                NetworkSetValue(topicHandle, Value::MakeDouble(5.0, 10)));
+    EXPECT_CALL(local,
+                NetworkSetValue(topicHandle, Value::MakeDouble(6.0, 20)));
+  }
+  sendValues(5.0, 6.0);
+
+  // unsubscribed; no values
+  {
+    std::vector<net::ClientMessage> msgs;
+    msgs.emplace_back(net::ClientMessage{net::UnsubscribeMsg{subHandle}});
+    server.HandleLocal(msgs);
+  }
+  sendValues(7.0, 8.0);
+}
+
+TEST_F(ServerImplTest, MetaTopicLazyUpdate) {
+  server.SetLocal(&local);
+  NT_Topic metaHandle = nt::Handle{0, 1, nt::Handle::kTopic};
+  {
+    NT_Subscriber subHandle = nt::Handle{0, 1, nt::Handle::kSubscriber};
+    std::vector<net::ClientMessage> msgs;
+    msgs.emplace_back(
+        net::ClientMessage{net::SubscribeMsg{subHandle, {"$sub$a"}, {}}});
+    server.HandleLocal(msgs);
+  }
+
+  ::testing::NiceMock<net::MockWireConnection> wire;
+  ::testing::NiceMock<MockSetPeriodicFunc> setPeriodic;
+  auto [name, id] = server.AddClient("test", "connInfo", false, wire,
+                                     setPeriodic.AsStdFunction());
+
+  // publishing creates the meta topic, but its value is not built yet
+  EXPECT_CALL(local, NetworkAnnounce("$sub$a", "msgpack", _, 0))
+      .WillOnce(Return(metaHandle));
+  {
+    NT_Publisher pubHandle = nt::Handle{0, 1, nt::Handle::kPublisher};
+    NT_Topic topicHandle = nt::Handle{0, 1, nt::Handle::kTopic};
+    std::vector<net::ClientMessage> msgs;
+    msgs.emplace_back(net::ClientMessage{net::PublishMsg{
+        pubHandle, topicHandle, "a", "double", wpi::json::object(), {}}});
+    server.ProcessIncomingText(id, EncodeText(msgs));
+  }
+
+  // nor is it rebuilt on every subscribe
+  for (int i = 1; i <= 2; ++i) {
+    NT_Subscriber subHandle = nt::Handle{0, i, nt::Handle::kSubscriber};
+    std::vector<net::ClientMessage> msgs;
+    msgs.emplace_back(
+        net::ClientMessage{net::SubscribeMsg{subHandle, {"a"}, {}}});
+    server.ProcessIncomingText(id, EncodeText(msgs));
+  }
+
+  // it is built once per control period, with both subscribers
+  EXPECT_CALL(local,
+              NetworkSetValue(metaHandle, ::testing::Truly([](const Value& v) {
+                                return v.IsRaw() && !v.GetRaw().empty() &&
+                                       v.GetRaw()[0] == 0x92;
+                              })));
+  server.SendControl(100);
+  server.SendControl(200);
+}
+
+TEST_F(ServerImplTest, PersistentSnapshot) {
+  ASSERT_EQ(server.LoadPersistent(R"([
+  {"name": "a", "type": "double", "value": 1.5,
+   "properties": {"persistent": true}},
+  {"name": "b", "type": "string", "value": "x",
+   "properties": {"persistent": true}}
+])"),
+            "");
+
+  // seed with everything
+  net::PersistentSnapshot snapshot;
+  std::vector<net::PersistentTopic> changes;
+  server.GetPersistentChanges(&changes, true);
+  EXPECT_EQ(changes.size(), 2u);
+  snapshot.Update(std::move(changes));
+  EXPECT_EQ(snapshot.Dump(), server.DumpPersistent());
+
+  // nothing changed
+  changes.clear();
+  server.GetPersistentChanges(&changes);
+  EXPECT_THAT(changes, IsEmpty());
+
+  // only changed topics are copied
+  ASSERT_EQ(server.LoadPersistent(R"([
+  {"name": "b", "type": "string", "value": "y",
+   "properties": {"persistent": true}},
+  {"name": "c", "type": "int", "value": 5,
+   "properties": {"persistent": true}}
+])"),
+            "");
+  changes.clear();
+  server.GetPersistentChanges(&changes);
+  ASSERT_EQ(changes.size(), 2u);
+  EXPECT_EQ(changes[0].name, "b");
+  EXPECT_EQ(changes[1].name, "c");
+  snapshot.Update(std::move(changes));
+  EXPECT_EQ(snapshot.Dump(), server.DumpPersistent());
+}
+
+TEST_F(ServerImplTest, PersistentSnapshotReusedId) {
+  ASSERT_EQ(server.LoadPersistent(R"([
+  {"name": "a", "type": "double", "value": 1.5,
+   "properties": {"persistent": true}}
+])"),
+            "");
+  net::PersistentSnapshot snapshot;
+  std::vector<net::PersistentTopic> changes;
+  server.GetPersistentChanges(&changes, true);
+  snapshot.Update(std::move(changes));
+
+  // delete the persistent topic, then free enough other topics that its id
+  // is reused by the next (non-persistent) topic
+  std::vector<net::ClientMessage> msgs;
+  msgs.emplace_back(net::ClientMessage{
+      net::SetPropertiesMsg{0, "a", {{"persistent", false}}}});
+  for (int i = 1; i <= 16; ++i) {
+    msgs.emplace_back(net::ClientMessage{net::PublishMsg{
+        nt::Handle{0, i, nt::Handle::kPublisher}, 0,
+        std::string(1, static_cast<char>('a' + i)), "double",
+        wpi::json::object(), {}}});
+  }
+  for (int i = 1; i <= 16; ++i) {
+    msgs.emplace_back(net::ClientMessage{
+        net::UnpublishMsg{nt::Handle{0, i, nt::Handle::kPublisher}, 0}});
+  }
+  msgs.emplace_back(net::ClientMessage{net::PublishMsg{
+      nt::Handle{0, 17, nt::Handle::kPublisher}, 0, "n", "double",
+      wpi::json::object(), {}}});
+  server.HandleLocal(msgs);
+
+  changes.clear();
+  server.GetPersistentChanges(&changes);
+  snapshot.Update(std::move(changes));
+  EXPECT_EQ(snapshot.Dump(), server.DumpPersistent());
+  EXPECT_EQ(snapshot.Dump().find("\"a\""), std::string::npos);
+}
+
+TEST_F(ServerImplTest, LoadPersistent) {
+  // keys in any order, nested properties, and per-entry errors
+  auto errors = server.LoadPersistent(R"([
+  {"value": [true, 1, false, [true]], "type": "boolean[]", "name": "ba",
+   "properties": {"persistent": true, "extra": {"a": [1, {}]}}},
+  {"name": "i", "type": "int", "value": -5,
+   "properties": {"persistent": true}},
+  {"name": "r", "type": "raw", "value": "AQI=",
+   "properties": {"persistent": true}},
+  5,
+  {"name": "d", "type": "double", "value": 1,
+   "properties": {"persistent": true}},
+  {"name": "s", "type": "string", "value": "x",
+   "properties": {"persistent": false}},
+  {"name": "n", "type": "int", "value": 1, "properties": []},
+  {"type": "int", "value": 1, "properties": {"persistent": true}},
+  {"name": "a", "type": "double[]", "value": 1.0,
+   "properties": {"persistent": true}}
+])");
+  EXPECT_EQ(errors,
+            "3: expected item to be an object\n"
+            "4: value type mismatch, expected double\n"
+            "5: persistent property is false\n"
+            "6: properties must be an object\n"
+            "7: no name key\n"
+            "8: value type mismatch, expected array\n");
+
+  std::vector<net::PersistentTopic> topics;
+  server.GetPersistentChanges(&topics, true);
+  ASSERT_EQ(topics.size(), 3u);
+  EXPECT_EQ(topics[0].name, "ba");
+  EXPECT_EQ(topics[0].typeStr, "boolean[]");
+  auto ba = topics[0].value.GetBooleanArray();
+  EXPECT_EQ(std::vector<int>(ba.begin(), ba.end()), (std::vector<int>{1, 0}));
+  EXPECT_EQ(topics[0].properties,
+            wpi::json::parse(
+                R"({"persistent": true, "extra": {"a": [1, {}]}})"));
+  EXPECT_EQ(topics[1].name, "i");
+  EXPECT_EQ(topics[1].value.GetInteger(), -5);
+  EXPECT_EQ(topics[2].name, "r");
+  auto raw = topics[2].value.GetRaw();
+  EXPECT_EQ(std::vector<uint8_t>(raw.begin(), raw.end()),
+            (std::vector<uint8_t>{1, 2}));
+
+  // a parse error does not create anything
+  EXPECT_EQ(server.LoadPersistent(R"([{"name": "x", "type": "int",
+    "value": 1, "properties": {"persistent": true}}, {)")
+                .substr(0, 21),
+            "could not decode JSON");
+  EXPECT_EQ(server.LoadPersistent("{}"), "expected JSON array at top level");
+  topics.clear();
+  server.GetPersistentChanges(&topics, true);
+  EXPECT_EQ(topics.size(), 3u);
+}
+
 }  // namespace nt
@@ -0,0 +1,121 @@
+// Copyright (c) FIRST and other WPILib contributors.
+// Open Source Software; you can modify and/or share it under the terms of
+// the WPILib BSD license file in the root directory of this project.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "gtest/gtest.h"
+#include "net/TimeSync.h"
+
+namespace nt {
+
+class TimeSyncEstimatorTest : public ::testing::Test {
+ public:
+  // Simulates a ping sent at local time sendTime; the server clock runs at
+  // (1 + drift) times the local rate plus offset.
+  bool Ping(int64_t sendTime, int64_t upDelay, int64_t downDelay) {
+    int64_t serverRecv = sendTime + upDelay;
+    int64_t serverTime = serverRecv + TrueOffset(serverRecv);
+    return sync.AddSample(sendTime, serverTime, serverRecv + downDelay);
+  }
+
+  int64_t TrueOffset(int64_t time) const {
+    return offset + std::llround(drift * time);
+  }
+
+  net::TimeSync sync;
+  int64_t offset = 123456789;
+  double drift = 0;
+};
+
+TEST_F(TimeSyncEstimatorTest, Empty) {
+  EXPECT_FALSE(sync.IsValid());
+  EXPECT_EQ(sync.GetPingIntervalMs(), net::TimeSync::kFastPingIntervalMs);
+}
+
+TEST_F(TimeSyncEstimatorTest, Reject) {
+  EXPECT_FALSE(sync.AddSample(1000, 5000, 999));
+  EXPECT_FALSE(sync.IsValid());
+}
+
+TEST_F(TimeSyncEstimatorTest, MinRtt) {
+  ASSERT_TRUE(Ping(1000000, 3000, 5000));
+  EXPECT_TRUE(sync.IsValid());
+  EXPECT_EQ(sync.GetErrorBound(), 4000);
+  EXPECT_EQ(sync.GetOffset(1010000), offset - 1000);
+
+  // lower RTT sample is used
+  ASSERT_TRUE(Ping(1100000, 400, 400));
+  EXPECT_EQ(sync.GetErrorBound(), 400);
+  EXPECT_EQ(sync.GetOffset(1110000), offset);
+
+  // higher RTT sample is not
+  ASSERT_TRUE(Ping(1200000, 1000, 9000));
+  EXPECT_EQ(sync.GetErrorBound(), 400);
+  EXPECT_EQ(sync.GetOffset(1210000), offset);
+}
+
+TEST_F(TimeSyncEstimatorTest, WindowExpires) {
+  ASSERT_TRUE(Ping(1000000, 100, 100));
+  EXPECT_EQ(sync.GetErrorBound(), 100);
+  for (size_t i = 1; i < net::TimeSync::kWindowSize; ++i) {
+    ASSERT_TRUE(Ping(1000000 + i * 100000, 1000, 1000));
+    EXPECT_EQ(sync.GetErrorBound(), 100);
+  }
+  ASSERT_TRUE(Ping(2000000, 1000, 1000));
+  EXPECT_EQ(sync.GetErrorBound(), 1000);
+}
+
+TEST_F(TimeSyncEstimatorTest, PingInterval) {
+  int64_t time = 1000000;
+  for (size_t i = 1; i < net::TimeSync::kWindowSize; ++i) {
+    ASSERT_TRUE(Ping(time, 500, 500));
+    EXPECT_EQ(sync.GetPingIntervalMs(), net::TimeSync::kFastPingIntervalMs);
+    time += sync.GetPingIntervalMs() * 1000;
+  }
+  uint32_t prev = sync.GetPingIntervalMs();
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(Ping(time, 500, 500));
+    EXPECT_EQ(sync.GetPingIntervalMs(),
+              (std::min)(prev * 2, net::TimeSync::kPingIntervalMs));
+    prev = sync.GetPingIntervalMs();
+    time += prev * 1000;
+  }
+  EXPECT_EQ(sync.GetPingIntervalMs(), net::TimeSync::kPingIntervalMs);
+}
+
+TEST_F(TimeSyncEstimatorTest, Drift) {
+  drift = 50e-6;
+  int64_t time = 1000000;
+  for (int i = 0; i < 400; ++i) {
+    // variable, asymmetric delays; every 5th ping gets through quickly
+    int64_t up = (i % 5) == 0 ? 200 : 200 + (i * 7919) % 3000;
+    int64_t down = (i % 5) == 0 ? 200 : 200 + (i * 104729) % 5000;
+    ASSERT_TRUE(Ping(time, up, down));
+    time += sync.GetPingIntervalMs() * 1000;
+  }
+  EXPECT_NEAR(sync.GetDrift(), drift, 1e-6);
+
+  // extrapolation stays within the error bound of the true offset
+  EXPECT_EQ(sync.GetErrorBound(), 200);
+  for (int64_t ahead : {0, 3000000, 10000000}) {
+    EXPECT_NEAR(sync.GetOffset(time + ahead), TrueOffset(time + ahead),
+                sync.GetErrorBound())
+        << "ahead " << ahead;
+  }
+}
+
+TEST_F(TimeSyncEstimatorTest, NoDrift) {
+  int64_t time = 1000000;
+  for (int i = 0; i < 200; ++i) {
+    ASSERT_TRUE(Ping(time, 300 + (i * 7919) % 700, 300 + (i * 6007) % 900));
+    time += sync.GetPingIntervalMs() * 1000;
+  }
+  EXPECT_NEAR(sync.GetDrift(), 0, 1e-6);
+  EXPECT_NEAR(sync.GetOffset(time), offset, sync.GetErrorBound());
+}
+
+}  // namespace nt
@@ -2,16 +2,22 @@
 // Open Source Software; you can modify and/or share it under the terms of
 // the WPILib BSD license file in the root directory of this project.
 
+#include <random>
+#include <string>
+#include <vector>
+
 #include <wpi/SmallString.h>
 #include <wpi/raw_ostream.h>
 
 #include "../MockLogger.h"
+#include "../SpanMatcher.h"
 #include "../TestPrinters.h"
 #include "Handle.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "net/Message.h"
 #include "net/WireDecoder.h"
+#include "net/WireEncoder.h"
 #include "networktables/NetworkTableValue.h"
 
 using namespace std::string_view_literals;
@@ -211,4 +217,284 @@ TEST_F(WireDecodeTextClientTest, UnpublishError) {
       logger);
 }
 
+TEST_F(WireDecodeTextClientTest, PublishPropsNested) {
+  wpi::json props = {{"a", {1, {{"b", nullptr}}, -2.5}}, {"c", "d"}};
+  EXPECT_CALL(handler, ClientPublish(5, std::string_view{"test"},
+                                     std::string_view{"double"}, props));
+  net::WireDecodeText(
+      "[{\"params\":{\"properties\":{\"a\":[1,{\"b\":null},-2.5],"
+      "\"c\":\"d\"},\"name\":\"test\",\"pubuid\":5,\"type\":\"double\"},"
+      "\"method\":\"publish\"}]",
+      handler, logger);
+}
+
+TEST_F(WireDecodeTextClientTest, Subscribe) {
+  EXPECT_CALL(handler, ClientSubscribe(7, _, _))
+      .WillOnce([](int64_t, std::span<const std::string> topicNames,
+                   const PubSubOptionsImpl& options) {
+        ASSERT_EQ(topicNames.size(), 2u);
+        EXPECT_EQ(topicNames[0], "a");
+        EXPECT_EQ(topicNames[1], "b");
+        EXPECT_TRUE(options.prefixMatch);
+        EXPECT_FALSE(options.sendAll);
+        EXPECT_EQ(options.periodicMs, 500u);
+      });
+  net::WireDecodeText(
+      "[{\"method\":\"subscribe\",\"params\":{\"options\":{\"periodic\":"
+      "0.5,\"prefix\":true,\"x\":[{}]},\"subuid\":7,\"topics\":[\"a\","
+      "\"b\"]}}]",
+      handler, logger);
+}
+
+TEST_F(WireDecodeTextClientTest, SubscribeError) {
+  EXPECT_CALL(logger, Call(_, _, _, "0: topics/1 must be a string"sv));
+  net::WireDecodeText(
+      "[{\"method\":\"subscribe\",\"params\":{\"subuid\":7,"
+      "\"topics\":[\"a\",[\"b\"],5]}}]",
+      handler, logger);
+
+  EXPECT_CALL(logger, Call(_, _, _, "0: topics must be an array"sv));
+  net::WireDecodeText(
+      "[{\"method\":\"subscribe\",\"params\":{\"subuid\":7,"
+      "\"topics\":{\"a\":1}}}]",
+      handler, logger);
+}
+
+class WireDecodeBinaryControlClientTest : public ::testing::Test {
+ public:
+  StrictMock<MockClientMessageHandler> handler;
+  StrictMock<wpi::MockLogger> logger;
+
+  // returns number of bytes left undecoded
+  size_t Decode(const wpi::json& msg) {
+    auto data = wpi::json::to_msgpack(msg);
+    std::span<const uint8_t> in{data};
+    EXPECT_TRUE(net::WireIsBinaryControl(in));
+    std::string error;
+    EXPECT_TRUE(net::WireDecodeBinary(&in, handler, &error, logger)) << error;
+    return in.size();
+  }
+};
+
+class WireDecodeBinaryControlServerTest : public ::testing::Test {
+ public:
+  StrictMock<MockServerMessageHandler> handler;
+  StrictMock<wpi::MockLogger> logger;
+
+  size_t Decode(const wpi::json& msg) {
+    auto data = wpi::json::to_msgpack(msg);
+    std::span<const uint8_t> in{data};
+    EXPECT_TRUE(net::WireIsBinaryControl(in));
+    std::string error;
+    EXPECT_TRUE(net::WireDecodeBinary(&in, handler, &error, logger)) << error;
+    return in.size();
+  }
+};
+
+TEST_F(WireDecodeBinaryControlClientTest, IsBinaryControl) {
+  ASSERT_FALSE(net::WireIsBinaryControl({}));
+  ASSERT_FALSE(net::WireIsBinaryControl("\x94\x05\x06\x02\x07"_us));
+  ASSERT_TRUE(net::WireIsBinaryControl("\x80"_us));
+  ASSERT_TRUE(net::WireIsBinaryControl("\xde\x00\x00"_us));
+}
+
+TEST_F(WireDecodeBinaryControlClientTest, Publish) {
+  wpi::json props = {{"k", 6}};
+  EXPECT_CALL(handler, ClientPublish(5, std::string_view{"test"},
+                                     std::string_view{"double"}, props));
+  ASSERT_EQ(Decode({{"method", "publish"},
+                    {"params",
+                     {{"name", "test"},
+                      {"properties", props},
+                      {"pubuid", 5},
+                      {"type", "double"}}}}),
+            0u);
+
+  EXPECT_CALL(handler,
+              ClientPublish(5, std::string_view{"test"},
+                            std::string_view{"double"}, wpi::json::object()));
+  Decode({{"method", "publish"},
+          {"params", {{"name", "test"}, {"pubuid", 5}, {"type", "double"}}}});
+}
+
+TEST_F(WireDecodeBinaryControlClientTest, PublishError) {
+  EXPECT_CALL(logger, Call(_, _, _, "no pubuid key"sv));
+  Decode({{"method", "publish"},
+          {"params", {{"name", "test"}, {"type", "double"}}}});
+
+  EXPECT_CALL(logger, Call(_, _, _, "properties must be an object"sv));
+  Decode({{"method", "publish"},
+          {"params",
+           {{"name", "test"},
+            {"properties", {"k"}},
+            {"pubuid", 5},
+            {"type", "double"}}}});
+}
+
+TEST_F(WireDecodeBinaryControlClientTest, Subscribe) {
+  EXPECT_CALL(handler, ClientSubscribe(7, _, _))
+      .WillOnce([](int64_t, std::span<const std::string> topicNames,
+                   const PubSubOptionsImpl& options) {
+        ASSERT_EQ(topicNames.size(), 2u);
+        EXPECT_EQ(topicNames[0], "a");
+        EXPECT_EQ(topicNames[1], "b");
+        EXPECT_TRUE(options.prefixMatch);
+        EXPECT_FALSE(options.sendAll);
+        EXPECT_EQ(options.periodicMs, 500u);
+      });
+  Decode({{"method", "subscribe"},
+          {"params",
+           {{"options", {{"periodic", 0.5}, {"prefix", true}}},
+            {"subuid", 7},
+            {"topics", {"a", "b"}}}}});
+}
+
+TEST_F(WireDecodeBinaryControlClientTest, SubscribeError) {
+  EXPECT_CALL(logger, Call(_, _, _, "topics/1 must be a string"sv));
+  Decode({{"method", "subscribe"},
+          {"params", {{"subuid", 7}, {"topics", {"a", 5}}}}});
+
+  EXPECT_CALL(logger, Call(_, _, _, "all value must be a boolean"sv));
+  Decode({{"method", "subscribe"},
+          {"params",
+           {{"options", {{"all", 1}}}, {"subuid", 7}, {"topics", {"a"}}}}});
+}
+
+TEST_F(WireDecodeBinaryControlClientTest, Multiple) {
+  auto data = wpi::json::to_msgpack(
+      {{"method", "unpublish"}, {"params", {{"pubuid", 5}}}});
+  auto data2 = wpi::json::to_msgpack(
+      {{"method", "unsubscribe"}, {"params", {{"subuid", 6}}}});
+  data.insert(data.end(), data2.begin(), data2.end());
+
+  EXPECT_CALL(handler, ClientUnpublish(5));
+  EXPECT_CALL(handler, ClientUnsubscribe(6));
+  std::span<const uint8_t> in{data};
+  std::string error;
+  ASSERT_TRUE(net::WireDecodeBinary(&in, handler, &error, logger));
+  ASSERT_EQ(in.size(), data2.size());
+  ASSERT_TRUE(net::WireDecodeBinary(&in, handler, &error, logger));
+  ASSERT_TRUE(in.empty());
+}
+
+TEST_F(WireDecodeBinaryControlClientTest, ErrorUnknownMethod) {
+  EXPECT_CALL(logger, Call(_, _, _, "unrecognized method 'a'"sv));
+  Decode({{"method", "a"}, {"params", wpi::json::object()}});
+}
+
+TEST_F(WireDecodeBinaryControlClientTest, ErrorTruncated) {
+  auto data = wpi::json::to_msgpack(
+      {{"method", "unpublish"}, {"params", {{"pubuid", 5}}}});
+  data.pop_back();
+  std::span<const uint8_t> in{data};
+  std::string error;
+  ASSERT_FALSE(net::WireDecodeBinary(&in, handler, &error, logger));
+  ASSERT_FALSE(error.empty());
+}
+
+TEST_F(WireDecodeBinaryControlServerTest, Announce) {
+  wpi::json props = {{"persistent", true}};
+  EXPECT_CALL(handler, ServerAnnounce(std::string_view{"test"}, 5,
+                                      std::string_view{"double"}, props,
+                                      std::optional<int64_t>{3}));
+  ASSERT_EQ(Decode({{"method", "announce"},
+                    {"params",
+                     {{"id", 5},
+                      {"name", "test"},
+                      {"properties", props},
+                      {"pubuid", 3},
+                      {"type", "double"}}}}),
+            0u);
+}
+
+TEST_F(WireDecodeBinaryControlServerTest, PropertiesUpdate) {
+  wpi::json update = {{"retained", true}};
+  EXPECT_CALL(handler,
+              ServerPropertiesUpdate(std::string_view{"test"}, update, true));
+  Decode({{"method", "properties"},
+          {"params", {{"ack", true}, {"name", "test"}, {"update", update}}}});
+}
+
+TEST(WireDecodeBinaryTest, FastPathMatchesMpack) {
+  // start from valid messages, including wider than necessary encodings
+  std::vector<std::vector<uint8_t>> seeds;
+  auto add = [&](const Value& value) {
+    wpi::raw_uvector_ostream os{seeds.emplace_back()};
+    net::WireEncodeBinaryMpack(os, 5, 1000000, value);
+  };
+  add(Value::MakeBoolean(true));
+  add(Value::MakeInteger(-5));
+  add(Value::MakeInteger(INT64_MIN));
+  add(Value::MakeFloat(2.5));
+  add(Value::MakeDouble(-0.5));
+  add(Value::MakeString("hello"));
+  add(Value::MakeString(std::string(300, 'x')));
+  add(Value::MakeRaw("\x01\x02"_us));
+  add(Value::MakeDoubleArray({1.0, 2.0}));
+  add(Value::MakeDoubleArray(std::vector<double>(20, -1.5)));
+  add(Value::MakeFloatArray({0.5f, 3.0f, -2.0f}));
+  add(Value::MakeIntegerArray({1, -200, 70000, INT64_MAX}));
+  add(Value::MakeDoubleArray(std::vector<double>{}));
+  // mixed float32/float64 and integer elements in float arrays
+  seeds.push_back({0x94, 1, 2, 17, 0x93, 0xcb, 0x3f, 0xf0, 0, 0, 0, 0, 0, 0,
+                   0xca, 0x40, 0, 0, 0, 3});
+  seeds.push_back({0x94, 1, 2, 19, 0x92, 0xcb, 0x3f, 0xf0, 0, 0, 0, 0, 0, 0,
+                   0xcb, 0x40, 0, 0, 0, 0, 0, 0, 0});
+  seeds.push_back({0x94, 1, 2, 17, 0xdc, 0, 2, 0xca, 0x3f, 0x80, 0, 0, 0xca,
+                   0x40, 0, 0, 0});
+  seeds.push_back({0x94, 0xcf, 0, 0, 0, 0, 0, 0, 0, 1, 0xd3, 0, 0, 0, 0, 0, 0,
+                   0, 2, 0xd0, 1, 0xca, 0x40, 0x20, 0, 0});
+  seeds.push_back({0x94, 0xd1, 0xff, 0xff, 0xcc, 0x80, 0xcd, 0, 4, 0xda, 0, 1,
+                   'a'});
+  seeds.push_back({0x94, 0xff, 0xce, 0, 1, 0, 0, 5, 0xc6, 0, 0, 0, 1, 'b'});
+
+  // decodes with both decoders and checks the results match; the decoded
+  // values are compared by their encoding so NaNs compare equal
+  auto check = [](std::span<const uint8_t> data) {
+    std::span<const uint8_t> in = data;
+    std::span<const uint8_t> expectedIn = data;
+    int64_t id = 0;
+    int64_t expectedId = 0;
+    Value value;
+    Value expectedValue;
+    std::string error;
+    std::string expectedError;
+    bool rv = net::WireDecodeBinary(&in, &id, &value, &error, 10);
+    bool expectedRv = net::WireDecodeBinaryMpack(
+        &expectedIn, &expectedId, &expectedValue, &expectedError, 10);
+    ASSERT_EQ(rv, expectedRv);
+    ASSERT_EQ(error, expectedError);
+    if (!rv) {
+      return;
+    }
+    ASSERT_EQ(in.size(), expectedIn.size());
+    ASSERT_EQ(id, expectedId);
+    ASSERT_EQ(value.time(), expectedValue.time());
+    ASSERT_EQ(value.server_time(), expectedValue.server_time());
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> expectedEncoded;
+    wpi::raw_uvector_ostream os{encoded};
+    wpi::raw_uvector_ostream expectedOs{expectedEncoded};
+    net::WireEncodeBinaryMpack(os, 0, 0, value);
+    net::WireEncodeBinaryMpack(expectedOs, 0, 0, expectedValue);
+    ASSERT_EQ(encoded, expectedEncoded);
+  };
+
+  std::mt19937 rng{5};
+  for (auto&& seed : seeds) {
+    SCOPED_TRACE(::testing::PrintToString(seed));
+    check(seed);
+    for (size_t len = 0; len < seed.size(); ++len) {
+      check(std::span{seed}.subspan(0, len));
+    }
+    for (int i = 0; i < 2000; ++i) {
+      auto data = seed;
+      for (int n = rng() % 3 + 1; n > 0; --n) {
+        data[rng() % data.size()] = rng();
+      }
+      check(data);
+    }
+  }
+}
+
 }  // namespace nt
@@ -2,6 +2,8 @@
 // Open Source Software; you can modify and/or share it under the terms of
 // the WPILib BSD license file in the root directory of this project.
 
+#include <bit>
+#include <random>
 #include <span>
 #include <string>
 #include <string_view>
@@ -183,6 +185,13 @@ TEST_F(WireEncoderTextTest, MessageUnsubscribe) {
             "{\"method\":\"unsubscribe\",\"params\":{\"subuid\":402653189}}");
 }
 
+TEST_F(WireEncoderTextTest, AnnounceRaw) {
+  net::WireEncodeAnnounceRaw(os, "test", 5, "double", "{\"k\":6}", 6);
+  ASSERT_EQ(os.str(),
+            "{\"method\":\"announce\",\"params\":{\"id\":5,\"name\":\"test\","
+            "\"properties\":{\"k\":6},\"pubuid\":6,\"type\":\"double\"}}");
+}
+
 TEST_F(WireEncoderTextTest, MessageAnnounce) {
   net::ServerMessage msg{
       net::AnnounceMsg{"test", 5, "double", std::nullopt, wpi::json::object()}};
@@ -201,6 +210,15 @@ TEST_F(WireEncoderTextTest, MessageAnnounceProperties) {
             "\"properties\":{\"k\":6},\"type\":\"double\"}}");
 }
 
+TEST_F(WireEncoderTextTest, MessageAnnouncePropertiesStr) {
+  net::ServerMessage msg{
+      net::AnnounceMsg{"test", 5, "double", std::nullopt, {}, "{\"k\":6}"}};
+  ASSERT_TRUE(net::WireEncodeText(os, msg));
+  ASSERT_EQ(os.str(),
+            "{\"method\":\"announce\",\"params\":{\"id\":5,\"name\":\"test\","
+            "\"properties\":{\"k\":6},\"type\":\"double\"}}");
+}
+
 TEST_F(WireEncoderTextTest, MessageAnnouncePubuid) {
   net::ServerMessage msg{
       net::AnnounceMsg{"test", 5, "double", 6, wpi::json::object()}};
@@ -291,4 +309,161 @@ TEST_F(WireEncoderBinaryTest, StringArray) {
                                "bye"_us));
 }
 
+TEST_F(WireEncoderBinaryTest, ControlUnpublish) {
+  net::ClientMessage msg{net::UnpublishMsg{Handle{0, 5, Handle::kPublisher}}};
+  ASSERT_TRUE(net::WireEncodeBinary(os, msg));
+  ASSERT_THAT(out, wpi::SpanEq("\x82\xa6method\xa9unpublish"
+                               "\xa6params\x81\xa6pubuid\x05"_us));
+}
+
+TEST_F(WireEncoderBinaryTest, ControlPublish) {
+  net::ClientMessage msg{net::PublishMsg{
+      Handle{0, 5, Handle::kPublisher}, 0, "test", "double", {{"k", 6}}, {}}};
+  ASSERT_TRUE(net::WireEncodeBinary(os, msg));
+  ASSERT_EQ(wpi::json::from_msgpack(out),
+            wpi::json({{"method", "publish"},
+                       {"params",
+                        {{"name", "test"},
+                         {"properties", {{"k", 6}}},
+                         {"pubuid", 5},
+                         {"type", "double"}}}}));
+}
+
+TEST_F(WireEncoderBinaryTest, ControlSubscribe) {
+  PubSubOptionsImpl options;
+  options.sendAll = true;
+  options.periodicMs = 500;
+  net::ClientMessage msg{net::SubscribeMsg{7, {"a", "b"}, options}};
+  ASSERT_TRUE(net::WireEncodeBinary(os, msg));
+  ASSERT_EQ(wpi::json::from_msgpack(out),
+            wpi::json({{"method", "subscribe"},
+                       {"params",
+                        {{"options", {{"all", true}, {"periodic", 0.5}}},
+                         {"subuid", 7},
+                         {"topics", {"a", "b"}}}}}));
+}
+
+TEST_F(WireEncoderBinaryTest, ControlAnnounce) {
+  net::ServerMessage msg{net::AnnounceMsg{"test", 5, "double", 3, {{"k", 6}}}};
+  ASSERT_TRUE(net::WireEncodeBinary(os, msg));
+  ASSERT_EQ(wpi::json::from_msgpack(out),
+            wpi::json({{"method", "announce"},
+                       {"params",
+                        {{"id", 5},
+                         {"name", "test"},
+                         {"properties", {{"k", 6}}},
+                         {"pubuid", 3},
+                         {"type", "double"}}}}));
+}
+
+TEST_F(WireEncoderBinaryTest, ControlPropertiesUpdate) {
+  net::ServerMessage msg{net::PropertiesUpdateMsg{"test", {{"k", 6}}, true}};
+  ASSERT_TRUE(net::WireEncodeBinary(os, msg));
+  ASSERT_EQ(wpi::json::from_msgpack(out),
+            wpi::json({{"method", "properties"},
+                       {"params",
+                        {{"ack", true},
+                         {"name", "test"},
+                         {"update", {{"k", 6}}}}}}));
+}
+
+TEST_F(WireEncoderBinaryTest, ControlValue) {
+  ASSERT_FALSE(net::WireEncodeBinary(os, net::ServerMessage{}));
+  ASSERT_FALSE(
+      net::WireEncodeBinary(os, net::ServerMessage{net::ServerValueMsg{}}));
+  ASSERT_TRUE(out.empty());
+}
+
+TEST_F(WireEncoderBinaryTest, FastPathMatchesMpack) {
+  // integers at encoding boundaries, plus random ones
+  std::vector<int64_t> ints{0,          1,          127,       128,
+                            255,        256,        65535,     65536,
+                            UINT32_MAX, 1ll << 32,  INT64_MAX, -1,
+                            -32,        -33,        -128,      -129,
+                            -32768,     -32769,     INT32_MIN, -(1ll << 32),
+                            INT64_MIN};
+  std::mt19937_64 rng{5};
+  for (int i = 0; i < 50; ++i) {
+    ints.emplace_back(static_cast<int64_t>(rng()) >> (rng() % 64));
+  }
+  auto randomInt = [&] { return ints[rng() % ints.size()]; };
+  auto randomBytes = [&] {
+    static const size_t sizes[] = {0, 1, 31, 32, 255, 256, 65535, 65536};
+    std::string str(sizes[rng() % std::size(sizes)], '\0');
+    for (auto&& ch : str) {
+      ch = rng();
+    }
+    return str;
+  };
+  auto randomLength = [&] {
+    static const size_t sizes[] = {0, 1, 15, 16, 100, 129, 65535, 65536};
+    return sizes[rng() % std::size(sizes)];
+  };
+
+  std::vector<uint8_t> expected;
+  wpi::raw_uvector_ostream expectedOs{expected};
+  for (int i = 0; i < 2000; ++i) {
+    Value value;
+    switch (rng() % 10) {
+      case 0:
+        value = Value::MakeBoolean(rng() % 2);
+        break;
+      case 1:
+        value = Value::MakeInteger(randomInt());
+        break;
+      case 2:
+        value = Value::MakeFloat(std::bit_cast<float>(
+            static_cast<uint32_t>(rng())));
+        break;
+      case 3:
+        value = Value::MakeDouble(std::bit_cast<double>(rng()));
+        break;
+      case 4:
+        value = Value::MakeString(randomBytes());
+        break;
+      case 5: {
+        auto raw = randomBytes();
+        value = Value::MakeRaw(std::span{
+            reinterpret_cast<const uint8_t*>(raw.data()), raw.size()});
+        break;
+      }
+      case 6: {
+        std::vector<int64_t> arr(randomLength());
+        for (auto&& val : arr) {
+          val = randomInt();
+        }
+        value = Value::MakeIntegerArray(std::move(arr));
+        break;
+      }
+      case 7: {
+        std::vector<float> arr(randomLength());
+        for (auto&& val : arr) {
+          val = std::bit_cast<float>(static_cast<uint32_t>(rng()));
+        }
+        value = Value::MakeFloatArray(std::move(arr));
+        break;
+      }
+      case 8: {
+        std::vector<double> arr(randomLength());
+        for (auto&& val : arr) {
+          val = std::bit_cast<double>(rng());
+        }
+        value = Value::MakeDoubleArray(std::move(arr));
+        break;
+      }
+      default:
+        value = Value::MakeBooleanArray({1, 0});  // not on fast path
+        break;
+    }
+    int64_t id = randomInt();
+    int64_t time = randomInt();
+    out.clear();
+    expected.clear();
+    ASSERT_TRUE(net::WireEncodeBinary(os, id, time, value));
+    ASSERT_TRUE(net::WireEncodeBinaryMpack(expectedOs, id, time, value));
+    ASSERT_THAT(out, wpi::SpanEq(std::span<const uint8_t>{expected}))
+        << "id " << id << " time " << time << " type " << value.type();
+  }
+}
+
 }  // namespace nt
@@ -6,8 +6,11 @@
 
 #include <cfloat>
 #include <climits>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 #include "../SpanMatcher.h"
 #include "../TestPrinters.h"
@@ -273,4 +276,117 @@ TEST_F(WireDecoder3Test, EntryUpdateTypeError) {
   ASSERT_EQ(decoder.GetError(), "unrecognized value type");
 }
 
+// Records handler calls, to compare decoding the same data fed in different
+// chunks.  Values are kept separately as their printed form only shows array
+// and raw contents by address.
+class RecordingMessageHandler3 : public net3::MessageHandler3 {
+ public:
+  void KeepAlive() override { log << "KeepAlive\n"; }
+  void ServerHelloDone() override { log << "ServerHelloDone\n"; }
+  void ClientHelloDone() override { log << "ClientHelloDone\n"; }
+  void ClearEntries() override { log << "ClearEntries\n"; }
+  void ProtoUnsup(unsigned int proto_rev) override {
+    log << "ProtoUnsup " << proto_rev << '\n';
+  }
+  void ClientHello(std::string_view self_id, unsigned int proto_rev) override {
+    log << "ClientHello " << self_id << ' ' << proto_rev << '\n';
+  }
+  void ServerHello(unsigned int flags, std::string_view self_id) override {
+    log << "ServerHello " << flags << ' ' << self_id << '\n';
+  }
+  void EntryAssign(std::string_view name, unsigned int id,
+                   unsigned int seq_num, const Value& value,
+                   unsigned int flags) override {
+    log << "EntryAssign " << name << ' ' << id << ' ' << seq_num << ' '
+        << flags << '\n';
+    values.emplace_back(value);
+  }
+  void EntryUpdate(unsigned int id, unsigned int seq_num,
+                   const Value& value) override {
+    log << "EntryUpdate " << id << ' ' << seq_num << '\n';
+    values.emplace_back(value);
+  }
+  void FlagsUpdate(unsigned int id, unsigned int flags) override {
+    log << "FlagsUpdate " << id << ' ' << flags << '\n';
+  }
+  void EntryDelete(unsigned int id) override {
+    log << "EntryDelete " << id << '\n';
+  }
+  void ExecuteRpc(unsigned int id, unsigned int uid,
+                  std::span<const uint8_t> params) override {
+    log << "ExecuteRpc " << id << ' ' << uid << ' ' << ToString(params) << '\n';
+  }
+  void RpcResponse(unsigned int id, unsigned int uid,
+                   std::span<const uint8_t> result) override {
+    log << "RpcResponse " << id << ' ' << uid << ' ' << ToString(result)
+        << '\n';
+  }
+
+  static std::string ToString(std::span<const uint8_t> data) {
+    return {reinterpret_cast<const char*>(data.data()), data.size()};
+  }
+
+  std::ostringstream log;
+  std::vector<Value> values;
+};
+
+TEST(WireDecoder3SplitTest, MatchesWhole) {
+  // one of each message and value type
+  std::vector<uint8_t> in;
+  auto add = [&](std::span<const uint8_t> msg) {
+    in.insert(in.end(), msg.begin(), msg.end());
+  };
+  add("\x00"_us);
+  add("\x01\x03\x00\x05hello"_us);
+  add("\x01\x02\x00"_us);
+  add("\x02\x03\x00"_us);
+  add("\x03\x05"_us);
+  add("\x04\x01\x03"
+      "abc"_us);
+  add("\x10\x04test\x00\x56\x78\x12\x34\x9a\x01"_us);
+  add("\x10\x04test\x01\x56\x78\x12\x34"
+      "\x9a\x41\x0c\x13\x80\x00\x00\x00\x00"_us);
+  add("\x11\x56\x78\x12\x34\x02\x05hello"_us);
+  add("\x11\x56\x78\x12\x34\x03\x05hello"_us);
+  add("\x11\x56\x78\x12\x34\x10\x03\x00\x01\x00"_us);
+  add("\x11\x56\x78\x12\x34\x11\x02"
+      "\x3f\xe0\x00\x00\x00\x00\x00\x00"
+      "\x3f\xd0\x00\x00\x00\x00\x00\x00"_us);
+  add("\x11\x56\x78\x12\x34\x12\x02\x05hello\x03"
+      "bye"_us);
+  add("\x11\x56\x78\x12\x34\x12\x00"_us);
+  add("\x11\x56\x78\x12\x34\x20\x05hello"_us);
+  add("\x11\x56\x78\x12\x34\x02\x80\x01"_us);
+  in.insert(in.end(), 128, '*');
+  add("\x12\x56\x78\x9a"_us);
+  add("\x13\x56\x78"_us);
+  add("\x14\xd0\x6c\xb2\x7a"_us);
+  add("\x20\x56\x78\x12\x34\x05hello"_us);
+  add("\x21\x56\x78\x12\x34\x05hello"_us);
+  add("\x00"_us);
+
+  auto decode = [&](size_t chunkSize, size_t firstChunk) {
+    RecordingMessageHandler3 handler;
+    net3::WireDecoder3 decoder{handler};
+    std::span<const uint8_t> data = in;
+    size_t size = firstChunk;
+    while (!data.empty()) {
+      auto chunk = data.subspan(0, (std::min)(size, data.size()));
+      data = data.subspan(chunk.size());
+      EXPECT_TRUE(decoder.Execute(&chunk));
+      EXPECT_TRUE(chunk.empty());
+      size = chunkSize;
+    }
+    EXPECT_EQ(decoder.GetError(), "");
+    return std::pair{handler.log.str(), std::move(handler.values)};
+  };
+
+  auto whole = decode(in.size(), in.size());
+  ASSERT_EQ(whole.second.size(), 10u);
+  EXPECT_EQ(decode(1, 1), whole);
+  for (size_t i = 1; i < in.size(); ++i) {
+    ASSERT_EQ(decode(in.size(), i), whole) << "split at " << i;
+  }
+}
+
 }  // namespace nt
@@ -0,0 +1,141 @@
+// Copyright (c) FIRST and other WPILib contributors.
+// Open Source Software; you can modify and/or share it under the terms of
+// the WPILib BSD license file in the root directory of this project.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <thread>
+#include <vector>
+
+#include "fmt/format.h"
+#include "wpi/DataLog.h"
+#include "wpi/DataLogReader.h"
+#include "wpi/DenseMap.h"
+#include "wpi/MemoryBuffer.h"
+#include "wpi/fs.h"
+
+// Writes a synthetic log of approximately the given size in MB, then compares
+// serial record-by-record decoding with DataLogReader::DecodeColumns().
+int main(int argc, char** argv) {
+  using std::chrono::duration_cast;
+  using std::chrono::high_resolution_clock;
+  using std::chrono::milliseconds;
+
+  int sizeMB = 1024;
+  if (argc == 2) {
+    sizeMB = std::stoi(argv[1]);
+  }
+
+  auto dir = fs::temp_directory_path();
+  std::string filename = "decodelog.wpilog";
+  {
+    wpi::log::DataLog log{dir.string(), filename, 1};
+    std::vector<wpi::log::DoubleLogEntry> doubles;
+    for (int i = 0; i < 16; ++i) {
+      doubles.emplace_back(log, fmt::format("double{}", i), 1);
+    }
+    wpi::log::DoubleArrayLogEntry array{log, "array", 1};
+    wpi::log::StringLogEntry str{log, "string", 1};
+    std::vector<double> arr(12);
+    // 16 * 14 + 102 + ~19 bytes per step
+    int64_t steps = sizeMB * int64_t{1024} * 1024 / 345;
+    for (int64_t t = 0; t < steps; ++t) {
+      for (auto&& entry : doubles) {
+        entry.Append(t * 0.001, t);
+      }
+      arr[0] = t;
+      array.Append(arr, t);
+      str.Append(fmt::format("value {}", t), t);
+    }
+  }
+  auto path = dir / filename;
+
+  std::error_code ec;
+  auto buf = wpi::MemoryBuffer::GetFile(path.string(), ec);
+  if (!buf) {
+    fmt::print(stderr, "could not open {}: {}\n", path.string(), ec.message());
+    return EXIT_FAILURE;
+  }
+  wpi::log::DataLogReader reader{std::move(buf)};
+  fmt::print("log size: {} MB\n", fs::file_size(path, ec) >> 20);
+
+  // serial decode, one vector per record
+  {
+    auto start = high_resolution_clock::now();
+    size_t count = 0;
+    wpi::DenseMap<int, std::vector<std::pair<int64_t, std::vector<double>>>>
+        values;
+    for (auto&& record : reader) {
+      if (record.IsControl()) {
+        continue;
+      }
+      std::vector<double> arr;
+      double val;
+      if (record.GetDouble(&val)) {
+        arr.emplace_back(val);
+      } else if (!record.GetDoubleArray(&arr)) {
+        continue;
+      }
+      values[record.GetEntry()].emplace_back(record.GetTimestamp(),
+                                             std::move(arr));
+      ++count;
+    }
+    auto stop = high_resolution_clock::now();
+    fmt::print("serial: {} records in {}ms\n", count,
+               duration_cast<milliseconds>(stop - start).count());
+  }
+
+  // serial scan without copying
+  {
+    auto start = high_resolution_clock::now();
+    size_t count = 0;
+    double sum = 0;
+    wpi::log::DataLogArrayView<double> arr;
+    for (auto&& record : reader) {
+      if (record.IsControl()) {
+        continue;
+      }
+      double val;
+      if (record.GetDouble(&val)) {
+        sum += val;
+      } else if (record.GetDoubleArray(&arr)) {
+        for (double v : arr) {
+          sum += v;
+        }
+      } else {
+        continue;
+      }
+      ++count;
+    }
+    auto stop = high_resolution_clock::now();
+    fmt::print("serial views: {} records (sum {}) in {}ms\n", count, sum,
+               duration_cast<milliseconds>(stop - start).count());
+  }
+
+  // build the index separately so it's not counted in the decode timings
+  {
+    auto start = high_resolution_clock::now();
+    reader.GetEntryRecords(0);
+    auto stop = high_resolution_clock::now();
+    fmt::print("index: {}ms\n",
+               duration_cast<milliseconds>(stop - start).count());
+  }
+
+  for (unsigned int threads : {1u, 0u}) {
+    auto start = high_resolution_clock::now();
+    auto columns = reader.DecodeColumns(threads);
+    auto stop = high_resolution_clock::now();
+    size_t count = 0;
+    for (auto&& column : columns) {
+      count += column.timestamps.size();
+    }
+    fmt::print("columns ({} threads): {} records in {}ms\n",
+               threads == 0 ? std::thread::hardware_concurrency() : threads,
+               count, duration_cast<milliseconds>(stop - start).count());
+  }
+
+  fs::remove(path, ec);
+  return EXIT_SUCCESS;
+}
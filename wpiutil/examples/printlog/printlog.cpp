@@ -128,28 +128,28 @@ int main(int argc, const char** argv) {
           fmt::print("  invalid\n");
         }
       } else if (entry->second.type == "double[]") {
-        std::vector<double> val;
+        wpi::log::DataLogArrayView<double> val;
         if (record.GetDoubleArray(&val)) {
           fmt::print("  {}\n", fmt::join(val, ", "));
         } else {
           fmt::print("  invalid\n");
         }
       } else if (entry->second.type == "float[]") {
-        std::vector<float> val;
+        wpi::log::DataLogArrayView<float> val;
         if (record.GetFloatArray(&val)) {
           fmt::print("  {}\n", fmt::join(val, ", "));
         } else {
           fmt::print("  invalid\n");
         }
       } else if (entry->second.type == "int64[]") {
-        std::vector<int64_t> val;
+        wpi::log::DataLogArrayView<int64_t> val;
         if (record.GetIntegerArray(&val)) {
           fmt::print("  {}\n", fmt::join(val, ", "));
         } else {
           fmt::print("  invalid\n");
         }
       } else if (entry->second.type == "string[]") {
-        std::vector<std::string_view> val;
+        wpi::log::DataLogStringArrayView val;
         if (record.GetStringArray(&val)) {
           fmt::print("  {}\n", fmt::join(val, ", "));
         } else {
@@ -7,6 +7,9 @@
 #include "wpi/Synchronization.h"
 
 #ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
@@ -19,16 +22,23 @@
 
 #endif
 
+#include <algorithm>
 #include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <random>
+#include <utility>
 #include <vector>
 
 #include "fmt/format.h"
+#include "wpi/DataLogReader.h"
+#include "wpi/DenseMap.h"
 #include "wpi/Endian.h"
 #include "wpi/Logger.h"
+#include "wpi/Lz4.h"
+#include "wpi/MappedFileRegion.h"
 #include "wpi/MathExtras.h"
 #include "wpi/fs.h"
 #include "wpi/timestamp.h"
@@ -37,6 +47,11 @@ using namespace wpi::log;
 
 static constexpr size_t kBlockSize = 16 * 1024;
 static constexpr size_t kRecordMaxHeaderSize = 17;
+// blocks allocated for each appending thread when it first uses a log
+static constexpr int kThreadPreallocBlocks = 4;
+#ifdef __linux__
+static constexpr uint64_t kPreallocSize = 1024 * 1024;
+#endif
 
 template <typename T>
 static unsigned int WriteVarInt(uint8_t* buf, T val) {
@@ -49,6 +64,16 @@ static unsigned int WriteVarInt(uint8_t* buf, T val) {
   return len;
 }
 
+static uint64_t ReadVarInt(std::span<const uint8_t> buf) {
+  uint64_t val = 0;
+  int shift = 0;
+  for (auto v : buf) {
+    val |= static_cast<uint64_t>(v) << shift;
+    shift += 8;
+  }
+  return val;
+}
+
 // min size: 4, max size: 17
 static unsigned int WriteRecordHeader(uint8_t* buf, uint32_t entry,
                                       uint64_t timestamp,
@@ -67,6 +92,12 @@ static unsigned int WriteRecordHeader(uint8_t* buf, uint32_t entry,
   return buf - origbuf;
 }
 
+static uint8_t* WriteString(uint8_t* buf, std::string_view str) {
+  wpi::support::endian::write32le(buf, str.size());
+  std::memcpy(buf + 4, str.data(), str.size());
+  return buf + 4 + str.size();
+}
+
 class DataLog::Buffer {
  public:
   explicit Buffer(size_t alloc = kBlockSize)
@@ -76,26 +107,6 @@ class DataLog::Buffer {
   Buffer(const Buffer&) = delete;
   Buffer& operator=(const Buffer&) = delete;
 
-  Buffer(Buffer&& oth)
-      : m_buf{oth.m_buf}, m_len{oth.m_len}, m_maxLen{oth.m_maxLen} {
-    oth.m_buf = nullptr;
-    oth.m_len = 0;
-    oth.m_maxLen = 0;
-  }
-
-  Buffer& operator=(Buffer&& oth) {
-    if (m_buf) {
-      delete[] m_buf;
-    }
-    m_buf = oth.m_buf;
-    m_len = oth.m_len;
-    m_maxLen = oth.m_maxLen;
-    oth.m_buf = nullptr;
-    oth.m_len = 0;
-    oth.m_maxLen = 0;
-    return *this;
-  }
-
   uint8_t* Reserve(size_t size) {
     assert(size <= GetRemaining());
     uint8_t* rv = m_buf + m_len;
@@ -109,15 +120,59 @@ class DataLog::Buffer {
 
   size_t GetRemaining() const { return m_maxLen - m_len; }
 
+  // true for standard-sized blocks (which are reused)
+  bool IsBlock() const { return m_maxLen == kBlockSize; }
+
   std::span<uint8_t> GetData() { return {m_buf, m_len}; }
   std::span<const uint8_t> GetData() const { return {m_buf, m_len}; }
 
+  // deletes a list of buffers linked by next
+  static void DeleteList(Buffer* bufs) {
+    while (bufs) {
+      auto next = bufs->next;
+      delete bufs;
+      bufs = next;
+    }
+  }
+
+  // next buffer in the pending or free list
+  Buffer* next = nullptr;
+
  private:
   uint8_t* m_buf;
   size_t m_len = 0;
   size_t m_maxLen;
 };
 
+// Per-thread append state.  Between appends, the current buffer is parked in
+// an atomic slot.  The owning thread takes it out of the slot for the length
+// of an append; the writer thread (or a Finish / SetMetadata call) takes it
+// to write it.  Both sides use a single exchange, so neither ever waits on the
+// other: a buffer taken by the writer is simply replaced by a free one on the
+// next append, and an append in progress is written at the next flush.
+struct DataLog::ThreadBuffer {
+  ~ThreadBuffer() {
+    delete slot.exchange(nullptr);
+    Buffer::DeleteList(free);
+  }
+
+  void Acquire() { buf = slot.exchange(nullptr, std::memory_order_acquire); }
+  void Release() {
+    slot.store(buf, std::memory_order_release);
+    buf = nullptr;
+  }
+
+  // current buffer, when no append is in progress
+  std::atomic<Buffer*> slot{nullptr};
+  // set when the owning log is destroyed
+  std::atomic_bool closed{false};
+  // the following are only accessed by the owning thread
+  // current buffer, during an append
+  Buffer* buf = nullptr;
+  // private cache of free buffers
+  Buffer* free = nullptr;
+};
+
 static void DefaultLog(unsigned int level, const char* file, unsigned int line,
                        const char* msg) {
   if (level > wpi::WPI_LOG_INFO) {
@@ -129,33 +184,57 @@ static void DefaultLog(unsigned int level, const char* file, unsigned int line,
 
 static wpi::Logger defaultMessageLog{DefaultLog};
 
+// unique log id, used to look up per-thread buffers
+static std::atomic<uint64_t> gNextLogId{1};
+
 DataLog::DataLog(std::string_view dir, std::string_view filename, double period,
-                 std::string_view extraHeader)
-    : DataLog{defaultMessageLog, dir, filename, period, extraHeader} {}
+                 std::string_view extraHeader, bool compress)
+    : DataLog{defaultMessageLog, dir, filename, period, extraHeader,
+              compress} {}
 
 DataLog::DataLog(wpi::Logger& msglog, std::string_view dir,
                  std::string_view filename, double period,
-                 std::string_view extraHeader)
+                 std::string_view extraHeader, bool compress)
     : m_msglog{msglog},
       m_period{period},
       m_extraHeader{extraHeader},
+      m_compress{compress},
       m_newFilename{filename},
+      m_id{gNextLogId.fetch_add(1, std::memory_order_relaxed)},
       m_thread{[this, dir = std::string{dir}] { WriterThreadMain(dir); }} {}
 
 DataLog::DataLog(std::function<void(std::span<const uint8_t> data)> write,
-                 double period, std::string_view extraHeader)
-    : DataLog{defaultMessageLog, std::move(write), period, extraHeader} {}
+                 double period, std::string_view extraHeader, bool compress)
+    : DataLog{defaultMessageLog, std::move(write), period, extraHeader,
+              compress} {}
 
 DataLog::DataLog(wpi::Logger& msglog,
                  std::function<void(std::span<const uint8_t> data)> write,
-                 double period, std::string_view extraHeader)
+                 double period, std::string_view extraHeader, bool compress)
     : m_msglog{msglog},
       m_period{period},
       m_extraHeader{extraHeader},
+      m_compress{compress},
+      m_id{gNextLogId.fetch_add(1, std::memory_order_relaxed)},
       m_thread{[this, write = std::move(write)] {
         WriterThreadMain(std::move(write));
       }} {}
 
+DataLog::DataLog(std::string_view filename, uint64_t ringSize, double period,
+                 std::string_view extraHeader)
+    : DataLog{defaultMessageLog, filename, ringSize, period, extraHeader} {}
+
+DataLog::DataLog(wpi::Logger& msglog, std::string_view filename,
+                 uint64_t ringSize, double period, std::string_view extraHeader)
+    : m_msglog{msglog},
+      m_period{period},
+      m_extraHeader{extraHeader},
+      m_compress{false},
+      m_id{gNextLogId.fetch_add(1, std::memory_order_relaxed)},
+      m_thread{[this, filename = std::string{filename}, ringSize] {
+        RingWriterThreadMain(filename, ringSize);
+      }} {}
+
 DataLog::~DataLog() {
   {
     std::scoped_lock lock{m_mutex};
@@ -164,6 +243,17 @@ DataLog::~DataLog() {
   }
   m_cond.notify_all();
   m_thread.join();
+
+  // release any buffers not written by the writer thread; the per-thread
+  // state itself may outlive the log
+  for (auto&& tb : m_threadBuffers) {
+    tb->closed = true;
+    delete tb->slot.exchange(nullptr);
+    Buffer::DeleteList(tb->free);
+    tb->free = nullptr;
+  }
+  Buffer::DeleteList(m_pending.exchange(nullptr));
+  Buffer::DeleteList(m_free.exchange(nullptr));
 }
 
 void DataLog::SetFilename(std::string_view filename) {
@@ -174,6 +264,23 @@ void DataLog::SetFilename(std::string_view filename) {
   m_cond.notify_all();
 }
 
+void DataLog::SetRotation(uint64_t maxSize, double maxTime,
+                          uint64_t maxTotalSize) {
+  std::scoped_lock lock{m_mutex};
+  m_maxSegmentSize = maxSize;
+  m_maxSegmentTime = maxTime;
+  m_maxTotalSize = maxTotalSize;
+}
+
+void DataLog::Dump(std::string_view filename) {
+  {
+    std::scoped_lock lock{m_mutex};
+    m_dumpFilename = filename;
+    m_doFlush = true;
+  }
+  m_cond.notify_all();
+}
+
 void DataLog::Flush() {
   {
     std::scoped_lock lock{m_mutex};
@@ -183,12 +290,10 @@ void DataLog::Flush() {
 }
 
 void DataLog::Pause() {
-  std::scoped_lock lock{m_mutex};
   m_paused = true;
 }
 
 void DataLog::Resume() {
-  std::scoped_lock lock{m_mutex};
   m_paused = false;
 }
 
@@ -222,6 +327,78 @@ static void WriteToFile(fs::file_t f, std::span<const uint8_t> data,
   } while (data.size() > 0);
 }
 
+// writes several buffers with as few system calls as possible
+static void WriteToFile(fs::file_t f, std::span<std::span<const uint8_t>> data,
+                        std::string_view filename, wpi::Logger& msglog) {
+#ifdef _WIN32
+  for (auto&& buf : data) {
+    WriteToFile(f, buf, filename, msglog);
+  }
+#else
+  static constexpr size_t kMaxIov = 64;
+  struct iovec iov[kMaxIov];
+  while (!data.empty()) {
+    size_t count = (std::min)(data.size(), kMaxIov);
+    for (size_t i = 0; i < count; ++i) {
+      iov[i].iov_base = const_cast<uint8_t*>(data[i].data());
+      iov[i].iov_len = data[i].size();
+    }
+    ssize_t ret = ::writev(f, iov, count);
+    if (ret < 0) {
+      // If it's a recoverable error, swallow it and retry the write
+      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+        continue;
+      }
+
+      // Otherwise it's a non-recoverable error; quit trying
+      WPI_ERROR(msglog, "Error writing to log file '{}': {}", filename,
+                std::strerror(errno));
+      return;
+    }
+
+    // The write may have written some or all of the data
+    size_t written = ret;
+    while (!data.empty() && written >= data.front().size()) {
+      written -= data.front().size();
+      data = data.subspan(1);
+    }
+    if (written > 0) {
+      data.front() = data.front().subspan(written);
+    }
+  }
+#endif
+}
+
+// Compressed (version 2.0) logs store records in frames:
+// 4-byte uncompressed size
+// 4-byte stored size (equal to uncompressed size if stored uncompressed)
+// LZ4 block data
+// Each buffer is its own frame, so records never span frames.
+static void CompressFrames(std::span<const std::span<const uint8_t>> data,
+                           std::vector<uint8_t>* out) {
+  size_t bound = 0;
+  for (auto&& buf : data) {
+    bound += 8 + wpi::Lz4CompressBound(buf.size());
+  }
+  out->resize(bound);
+  uint8_t* op = out->data();
+  for (auto&& buf : data) {
+    if (buf.empty()) {
+      continue;
+    }
+    size_t size = wpi::Lz4Compress(buf, {op + 8, out->data() + bound});
+    if (size == 0 || size >= buf.size()) {
+      // store incompressible data as-is
+      size = buf.size();
+      std::memcpy(op + 8, buf.data(), size);
+    }
+    wpi::support::endian::write32le(op, buf.size());
+    wpi::support::endian::write32le(op + 4, size);
+    op += 8 + size;
+  }
+  out->resize(op - out->data());
+}
+
 static std::string MakeRandomFilename() {
   // build random filename
   static std::random_device dev;
@@ -236,74 +413,331 @@ static std::string MakeRandomFilename() {
   return filename;
 }
 
-void DataLog::WriterThreadMain(std::string_view dir) {
-  std::chrono::duration<double> periodTime{m_period};
+namespace {
 
-  std::error_code ec;
-  fs::path dirPath{dir};
-  std::string filename;
+// An open log file (or segment, when rotating).
+class LogFile {
+ public:
+  LogFile(wpi::Logger& msglog, std::span<const uint8_t> header)
+      : m_msglog{msglog}, m_header{header} {}
+  ~LogFile() { Close(); }
 
-  {
-    std::scoped_lock lock{m_mutex};
-    filename = std::move(m_newFilename);
-    m_newFilename.clear();
-  }
+  LogFile(const LogFile&) = delete;
+  LogFile& operator=(const LogFile&) = delete;
 
-  if (filename.empty()) {
-    filename = MakeRandomFilename();
-  }
+  // Creates a new file and writes the log header.  If the file can't be
+  // created (e.g. it already exists), tries a few random filenames before
+  // giving up.  Updates filename to the name actually used.
+  void Open(const fs::path& dirPath, std::string* filename);
+
+  bool IsOpen() const { return m_file != fs::kInvalidFile; }
+
+  // size of the file, including the header
+  uint64_t GetSize() const { return m_size; }
+
+  void Write(std::span<std::span<const uint8_t>> data,
+             std::string_view filename);
+
+  // syncs written data to storage
+  void Sync();
 
+  void Close();
+
+ private:
+  wpi::Logger& m_msglog;
+  std::span<const uint8_t> m_header;
+  fs::file_t m_file = fs::kInvalidFile;
+  uint64_t m_size = 0;
+#ifdef __linux__
+  // how much of the file has been preallocated
+  uint64_t m_allocSize = 0;
+  bool m_doPrealloc = true;
+  // start of data that may still be in the page cache
+  uint64_t m_cachedStart = 0;
+#endif
+};
+
+}  // namespace
+
+void LogFile::Open(const fs::path& dirPath, std::string* filename) {
+  std::error_code ec;
   // try preferred filename, or randomize it a few times, before giving up
-  fs::file_t f;
   for (int i = 0; i < 5; ++i) {
     // open file for append
 #ifdef _WIN32
     // WIN32 doesn't allow combination of CreateNew and Append
-    f = fs::OpenFileForWrite(dirPath / filename, ec, fs::CD_CreateNew,
-                             fs::OF_None);
+    m_file = fs::OpenFileForWrite(dirPath / *filename, ec, fs::CD_CreateNew,
+                                  fs::OF_None);
 #else
-    f = fs::OpenFileForWrite(dirPath / filename, ec, fs::CD_CreateNew,
-                             fs::OF_Append);
+    m_file = fs::OpenFileForWrite(dirPath / *filename, ec, fs::CD_CreateNew,
+                                  fs::OF_Append);
 #endif
     if (ec) {
       WPI_ERROR(m_msglog, "Could not open log file '{}': {}",
-                (dirPath / filename).string(), ec.message());
+                (dirPath / *filename).string(), ec.message());
       // try again with random filename
-      filename = MakeRandomFilename();
+      *filename = MakeRandomFilename();
     } else {
       break;
     }
   }
 
-  if (f == fs::kInvalidFile) {
+  if (m_file == fs::kInvalidFile) {
     WPI_ERROR(m_msglog, "Could not open log file, no log being saved");
-  } else {
-    WPI_INFO(m_msglog, "Logging to '{}'", (dirPath / filename).string());
+    return;
   }
+  WPI_INFO(m_msglog, "Logging to '{}'", (dirPath / *filename).string());
 
-  // write header (version 1.0)
-  if (f != fs::kInvalidFile) {
-    const uint8_t header[] = {'W', 'P', 'I', 'L', 'O', 'G', 0, 1};
-    WriteToFile(f, header, filename, m_msglog);
-    uint8_t extraLen[4];
-    support::endian::write32le(extraLen, m_extraHeader.size());
-    WriteToFile(f, extraLen, filename, m_msglog);
-    if (m_extraHeader.size() > 0) {
-      WriteToFile(f,
-                  {reinterpret_cast<const uint8_t*>(m_extraHeader.data()),
-                   m_extraHeader.size()},
-                  filename, m_msglog);
+  m_size = 0;
+#ifdef __linux__
+  m_allocSize = 0;
+  m_doPrealloc = true;
+  m_cachedStart = 0;
+#endif
+  WriteToFile(m_file, m_header, *filename, m_msglog);
+  m_size = m_header.size();
+}
+
+void LogFile::Write(std::span<std::span<const uint8_t>> data,
+                    std::string_view filename) {
+  if (m_file == fs::kInvalidFile) {
+    return;
+  }
+  size_t size = 0;
+  for (auto&& buf : data) {
+    size += buf.size();
+  }
+
+#ifdef __linux__
+  // allocate file space ahead of time (without changing the file size), so
+  // the filesystem doesn't need to allocate on every flush
+  if (m_doPrealloc && m_size + size > m_allocSize) {
+    uint64_t newAllocSize = m_size + size + kPreallocSize;
+    if (::fallocate(m_file, FALLOC_FL_KEEP_SIZE, m_allocSize,
+                    newAllocSize - m_allocSize) == 0) {
+      m_allocSize = newAllocSize;
+    } else {
+      m_doPrealloc = false;  // not supported by this filesystem
+    }
+  }
+#endif
+
+  WriteToFile(m_file, data, filename, m_msglog);
+  m_size += size;
+}
+
+void LogFile::Sync() {
+  if (m_file == fs::kInvalidFile) {
+    return;
+  }
+#if defined(__linux__)
+  ::fdatasync(m_file);
+  // synced data is never read back; drop it from the page cache so it
+  // doesn't crowd out other pages
+  uint64_t cachedEnd = m_size & ~static_cast<uint64_t>(4095);
+  if (cachedEnd > m_cachedStart) {
+    ::posix_fadvise(m_file, m_cachedStart, cachedEnd - m_cachedStart,
+                    POSIX_FADV_DONTNEED);
+    m_cachedStart = cachedEnd;
+  }
+#elif defined(__APPLE__)
+  ::fsync(m_file);
+#endif
+}
+
+void LogFile::Close() {
+  if (m_file == fs::kInvalidFile) {
+    return;
+  }
+#ifdef __linux__
+  // release any preallocated space past the end of the file
+  if (m_allocSize > m_size) {
+    struct stat st;
+    if (::fstat(m_file, &st) == 0) {
+      [[maybe_unused]] int rv = ::ftruncate(m_file, st.st_size);
+    }
+  }
+#endif
+  fs::CloseFile(m_file);
+  m_file = fs::kInvalidFile;
+}
+
+// Name of a segment after the first: "name_N.ext"
+static std::string MakeSegmentFilename(std::string_view filename,
+                                       unsigned int segment) {
+  fs::path path{filename};
+  return fmt::format("{}_{}{}", path.stem().string(), segment,
+                     path.extension().string());
+}
+
+namespace {
+struct ActiveEntry {
+  std::string name;
+  std::string type;
+  std::string metadata;
+  // start record timestamp; 0 to use the time the record is written
+  uint64_t timestamp = 0;
+};
+}  // namespace
+
+// Updates the set of active entries from a buffer written to the log.
+// Control records are always in a buffer of their own.
+static void TrackControlRecord(std::span<const uint8_t> data,
+                               wpi::DenseMap<int, ActiveEntry>* entries) {
+  if (data.size() < 4 || (data[0] & 0x3) != 0 || data[1] != 0) {
+    return;  // not a control record
+  }
+  unsigned int sizeLen = ((data[0] >> 2) & 0x3) + 1;
+  unsigned int timestampLen = ((data[0] >> 4) & 0x7) + 1;
+  size_t headerLen = 2 + sizeLen + timestampLen;
+  if (data.size() < headerLen) {
+    return;
+  }
+  uint64_t timestamp = 0;
+  for (unsigned int i = 0; i < timestampLen; ++i) {
+    timestamp |= static_cast<uint64_t>(data[2 + sizeLen + i]) << (8 * i);
+  }
+  DataLogRecord record{0, 0, data.subspan(headerLen)};
+  StartRecordData start;
+  MetadataRecordData metadata;
+  int entry;
+  if (record.GetStartData(&start)) {
+    (*entries)[start.entry] = {
+        std::string{start.name}, std::string{start.type},
+        std::string{start.metadata}, timestamp};
+  } else if (record.GetFinishEntry(&entry)) {
+    entries->erase(entry);
+  } else if (record.GetSetMetadataData(&metadata)) {
+    auto it = entries->find(metadata.entry);
+    if (it != entries->end()) {
+      it->second.metadata = metadata.metadata;
     }
   }
+}
+
+// Encodes start records for all active entries, in entry ID order.
+static void MakeStartRecords(const wpi::DenseMap<int, ActiveEntry>& entries,
+                             std::vector<uint8_t>* out) {
+  std::vector<int> ids;
+  for (auto&& entry : entries) {
+    ids.emplace_back(entry.first);
+  }
+  std::sort(ids.begin(), ids.end());
+  out->clear();
+  uint64_t now = wpi::Now();
+  for (int id : ids) {
+    auto& entry = entries.find(id)->second;
+    size_t size = 5 + 12 + entry.name.size() + entry.type.size() +
+                  entry.metadata.size();
+    size_t pos = out->size();
+    out->resize(pos + kRecordMaxHeaderSize + size);
+    uint8_t* buf = out->data() + pos;
+    buf += WriteRecordHeader(
+        buf, 0, entry.timestamp != 0 ? entry.timestamp : now, size);
+    *buf++ = impl::kControlStart;
+    wpi::support::endian::write32le(buf, id);
+    buf = WriteString(buf + 4, entry.name);
+    buf = WriteString(buf, entry.type);
+    buf = WriteString(buf, entry.metadata);
+    out->resize(buf - out->data());
+  }
+}
+
+void DataLog::WriterThreadMain(std::string_view dir) {
+  std::chrono::duration<double> periodTime{m_period};
+
+  std::error_code ec;
+  fs::path dirPath{dir};
+  std::string filename;
+
+  {
+    std::scoped_lock lock{m_mutex};
+    filename = std::move(m_newFilename);
+    m_newFilename.clear();
+  }
 
-  std::vector<Buffer> toWrite;
+  if (filename.empty()) {
+    filename = MakeRandomFilename();
+  }
+
+  // header (version 1.0, or 2.0 if compressed)
+  std::vector<uint8_t> header{'W', 'P', 'I', 'L', 'O', 'G', 0, 1, 0, 0, 0, 0};
+  if (m_compress) {
+    header[7] = 2;
+  }
+  support::endian::write32le(&header[8], m_extraHeader.size());
+  header.insert(header.end(), m_extraHeader.begin(), m_extraHeader.end());
+
+  LogFile file{m_msglog, header};
+  file.Open(dirPath, &filename);
+
+  // rotation state; segments are named after baseFilename
+  std::string baseFilename = filename;
+  unsigned int segment = 0;
+  auto segmentStart = std::chrono::steady_clock::now();
+  uint64_t segmentBaseSize = file.GetSize();  // header and replayed starts
+  uint64_t maxSegmentSize = 0;
+  std::chrono::duration<double> maxSegmentTime{0};
+  uint64_t maxTotalSize = 0;
+  std::deque<std::pair<fs::path, uint64_t>> oldSegments;
+  uint64_t oldSegmentsSize = 0;
+  wpi::DenseMap<int, ActiveEntry> activeEntries;
+
+  std::vector<std::span<const uint8_t>> toWriteData;
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> frame;
+  std::vector<uint8_t> replay;
+
+  // writes the queued data to the current file
+  auto writeQueued = [&] {
+    if (m_compress && !compressed.empty()) {
+      toWriteData.assign(1, compressed);
+    }
+    if (!toWriteData.empty()) {
+      file.Write(toWriteData, filename);
+    }
+    toWriteData.clear();
+    compressed.clear();
+  };
+
+  // closes the current segment and starts the next one
+  auto rotate = [&] {
+    writeQueued();
+    file.Sync();
+    uint64_t size = file.GetSize();
+    file.Close();
+    oldSegments.emplace_back(dirPath / filename, size);
+    oldSegmentsSize += size;
+
+    filename = MakeSegmentFilename(baseFilename, ++segment);
+    file.Open(dirPath, &filename);
+    segmentStart = std::chrono::steady_clock::now();
+
+    // each segment starts with the active entries, so it can be read alone
+    MakeStartRecords(activeEntries, &replay);
+    if (!replay.empty()) {
+      if (m_compress) {
+        std::span<const uint8_t> data{replay};
+        CompressFrames({&data, 1}, &compressed);
+      } else {
+        toWriteData.emplace_back(replay);
+      }
+      writeQueued();
+    }
+    segmentBaseSize = file.GetSize();
+  };
 
   std::unique_lock lock{m_mutex};
-  while (m_active) {
-    bool doFlush = false;
-    auto timeoutTime = std::chrono::steady_clock::now() + periodTime;
-    if (m_cond.wait_until(lock, timeoutTime) == std::cv_status::timeout) {
-      doFlush = true;
+  for (bool active = true; active;) {
+    // after the log is destroyed, do a final flush and exit; appends may
+    // still be in thread buffers
+    active = m_active;
+    bool doFlush = !active;
+    if (active && !m_doFlush) {
+      auto timeoutTime = std::chrono::steady_clock::now() + periodTime;
+      if (m_cond.wait_until(lock, timeoutTime) == std::cv_status::timeout) {
+        doFlush = true;
+      }
     }
 
     if (!m_newFilename.empty()) {
@@ -321,56 +755,109 @@ void DataLog::WriterThreadMain(std::string_view dir) {
         WPI_INFO(m_msglog, "Renamed log file from '{}' to '{}'", filename,
                  newFilename);
       }
+      // later segments are numbered from the new name; segments already
+      // written keep their names and still count toward the size budget
+      if (newFilename != baseFilename) {
+        segment = 0;
+      }
       filename = std::move(newFilename);
+      baseFilename = filename;
       lock.lock();
     }
 
     if (doFlush || m_doFlush) {
       // flush to file
       m_doFlush = false;
-      if (m_outgoing.empty()) {
+      StealThreadBuffers();
+      Buffer* toWrite = TakePending();
+      if (!toWrite) {
         continue;
       }
-      // swap outgoing with empty vector
-      toWrite.swap(m_outgoing);
+      maxSegmentSize = m_maxSegmentSize;
+      maxSegmentTime = std::chrono::duration<double>{m_maxSegmentTime};
+      maxTotalSize = m_maxTotalSize;
 
-      if (f != fs::kInvalidFile) {
+      if (file.IsOpen()) {
         lock.unlock();
-        // write buffers to file
-        for (auto&& buf : toWrite) {
-          WriteToFile(f, buf.GetData(), filename, m_msglog);
+        if (maxSegmentTime.count() > 0 &&
+            file.GetSize() > segmentBaseSize &&
+            std::chrono::steady_clock::now() - segmentStart >=
+                maxSegmentTime) {
+          rotate();
         }
 
-        // sync to storage
-#if defined(__linux__)
-        ::fdatasync(f);
-#elif defined(__APPLE__)
-        ::fsync(f);
-#endif
+        uint64_t queuedSize = 0;
+        for (Buffer* buf = toWrite; buf; buf = buf->next) {
+          std::span<const uint8_t> data = buf->GetData();
+          if (data.empty()) {
+            continue;
+          }
+          size_t size = data.size();
+          if (m_compress) {
+            CompressFrames({&data, 1}, &frame);
+            size = frame.size();
+          }
+
+          // start a new segment if this buffer would overflow the current
+          // one (unless it's the first data in the segment)
+          if (maxSegmentSize != 0) {
+            uint64_t segmentSize = file.GetSize() + queuedSize;
+            if (segmentSize > segmentBaseSize &&
+                segmentSize + size > maxSegmentSize) {
+              rotate();
+              queuedSize = 0;
+            }
+          }
+
+          // control records are never in standard blocks
+          if (!buf->IsBlock()) {
+            TrackControlRecord(data, &activeEntries);
+          }
+
+          if (m_compress) {
+            compressed.insert(compressed.end(), frame.begin(), frame.end());
+          } else {
+            toWriteData.emplace_back(data);
+          }
+          queuedSize += size;
+        }
+
+        // write buffers to file and sync to storage
+        writeQueued();
+        file.Sync();
+
+        // delete old segments to stay within the size budget
+        while (maxTotalSize != 0 && !oldSegments.empty() &&
+               oldSegmentsSize + file.GetSize() > maxTotalSize) {
+          auto& [path, size] = oldSegments.front();
+          fs::remove(path, ec);
+          if (ec) {
+            WPI_ERROR(m_msglog, "Could not remove log file '{}': {}",
+                      path.string(), ec.message());
+          } else {
+            WPI_INFO(m_msglog, "Removed log file '{}'", path.string());
+          }
+          oldSegmentsSize -= size;
+          oldSegments.pop_front();
+        }
         lock.lock();
       }
 
-      // release buffers back to free list
-      for (auto&& buf : toWrite) {
-        buf.Clear();
-        m_free.emplace_back(std::move(buf));
-      }
-      toWrite.resize(0);
+      ReleaseBuffers(toWrite);
     }
   }
-
-  if (f != fs::kInvalidFile) {
-    fs::CloseFile(f);
-  }
 }
 
 void DataLog::WriterThreadMain(
     std::function<void(std::span<const uint8_t> data)> write) {
   std::chrono::duration<double> periodTime{m_period};
 
-  // write header (version 1.0)
+  // write header (version 1.0, or 2.0 if compressed)
   {
-    const uint8_t header[] = {'W', 'P', 'I', 'L', 'O', 'G', 0, 1};
+    uint8_t header[] = {'W', 'P', 'I', 'L', 'O', 'G', 0, 1};
+    if (m_compress) {
+      header[7] = 2;
+    }
     write(header);
     uint8_t extraLen[4];
     support::endian::write32le(extraLen, m_extraHeader.size());
@@ -381,46 +868,639 @@ void DataLog::WriterThreadMain(
     }
   }
 
-  std::vector<Buffer> toWrite;
+  std::vector<std::span<const uint8_t>> toWriteData;
+  std::vector<uint8_t> compressed;
 
   std::unique_lock lock{m_mutex};
-  while (m_active) {
-    bool doFlush = false;
-    auto timeoutTime = std::chrono::steady_clock::now() + periodTime;
-    if (m_cond.wait_until(lock, timeoutTime) == std::cv_status::timeout) {
-      doFlush = true;
+  for (bool active = true; active;) {
+    // after the log is destroyed, do a final flush and exit; appends may
+    // still be in thread buffers
+    active = m_active;
+    bool doFlush = !active;
+    if (active && !m_doFlush) {
+      auto timeoutTime = std::chrono::steady_clock::now() + periodTime;
+      if (m_cond.wait_until(lock, timeoutTime) == std::cv_status::timeout) {
+        doFlush = true;
+      }
     }
 
     if (doFlush || m_doFlush) {
       // flush to file
       m_doFlush = false;
-      if (m_outgoing.empty()) {
+      StealThreadBuffers();
+      Buffer* toWrite = TakePending();
+      if (!toWrite) {
         continue;
       }
-      // swap outgoing with empty vector
-      toWrite.swap(m_outgoing);
 
       lock.unlock();
       // write buffers
-      for (auto&& buf : toWrite) {
-        if (!buf.GetData().empty()) {
-          write(buf.GetData());
+      if (m_compress) {
+        for (Buffer* buf = toWrite; buf; buf = buf->next) {
+          toWriteData.emplace_back(buf->GetData());
+        }
+        CompressFrames(toWriteData, &compressed);
+        toWriteData.clear();
+        if (!compressed.empty()) {
+          write(compressed);
+        }
+      } else {
+        for (Buffer* buf = toWrite; buf; buf = buf->next) {
+          if (!buf->GetData().empty()) {
+            write(buf->GetData());
+          }
         }
       }
       lock.lock();
 
-      // release buffers back to free list
-      for (auto&& buf : toWrite) {
-        buf.Clear();
-        m_free.emplace_back(std::move(buf));
-      }
-      toWrite.resize(0);
+      ReleaseBuffers(toWrite);
     }
   }
 
   write({});  // indicate EOF
 }
 
+// Flight recorder ring files use the following format (little-endian):
+// 8-byte magic ("WPIRING" followed by version 1)
+// 4-byte slot size (including slot header)
+// 4-byte slot count
+// 4-byte offset of first slot
+// 4-byte entry table capacity
+// 4-byte active entry table (0 or 1)
+// 4-byte entry table 0 size
+// 4-byte entry table 1 size
+// 4-byte log header size
+// (reserved to kRingHeaderSize)
+// log header (as in a version 1.0 log file)
+// 2 entry tables
+// slots
+//
+// Each slot has a 8-byte sequence number (0 if unused), 4-byte data size,
+// 4 reserved bytes, and whole records.  Start records are not kept in the
+// slots; instead, the active entry table holds start records for all entries
+// that may have data in the ring.  The tables are alternated so one is always
+// complete.
+static constexpr uint8_t kRingMagic[8] = {'W', 'P', 'I', 'R', 'I', 'N', 'G', 1};
+static constexpr size_t kRingHeaderSize = 64;
+static constexpr size_t kRingSlotSize = 64 * 1024;
+static constexpr size_t kRingSlotHeaderSize = 16;
+static constexpr size_t kRingSlotDataSize = kRingSlotSize - kRingSlotHeaderSize;
+
+bool impl::ReadRing(std::span<const uint8_t> ring,
+                    std::vector<std::span<const uint8_t>>* parts) {
+  parts->clear();
+  if (ring.size() < kRingHeaderSize ||
+      std::memcmp(ring.data(), kRingMagic, sizeof(kRingMagic)) != 0) {
+    return false;
+  }
+  uint32_t slotSize = wpi::support::endian::read32le(&ring[8]);
+  uint32_t slotCount = wpi::support::endian::read32le(&ring[12]);
+  uint32_t firstSlot = wpi::support::endian::read32le(&ring[16]);
+  uint32_t tableCapacity = wpi::support::endian::read32le(&ring[20]);
+  uint32_t table = wpi::support::endian::read32le(&ring[24]) & 1;
+  uint32_t tableSize = wpi::support::endian::read32le(&ring[28 + 4 * table]);
+  uint32_t headerSize = wpi::support::endian::read32le(&ring[36]);
+  uint64_t tableOffset = kRingHeaderSize + static_cast<uint64_t>(headerSize) +
+                         static_cast<uint64_t>(table) * tableCapacity;
+  if (slotSize < kRingSlotHeaderSize || tableSize > tableCapacity ||
+      tableOffset + tableSize > ring.size() ||
+      firstSlot + static_cast<uint64_t>(slotSize) * slotCount > ring.size()) {
+    return false;
+  }
+  parts->emplace_back(ring.subspan(kRingHeaderSize, headerSize));
+  parts->emplace_back(ring.subspan(tableOffset, tableSize));
+
+  // slots, oldest first
+  std::vector<std::pair<uint64_t, std::span<const uint8_t>>> slots;
+  for (uint32_t i = 0; i < slotCount; ++i) {
+    auto slot = ring.subspan(firstSlot + static_cast<uint64_t>(i) * slotSize,
+                             slotSize);
+    uint64_t seq = wpi::support::endian::read64le(&slot[0]);
+    uint32_t size = wpi::support::endian::read32le(&slot[8]);
+    if (seq != 0 && size <= slotSize - kRingSlotHeaderSize) {
+      slots.emplace_back(seq, slot.subspan(kRingSlotHeaderSize, size));
+    }
+  }
+  std::sort(slots.begin(), slots.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+  for (auto&& slot : slots) {
+    parts->emplace_back(slot.second);
+  }
+  return true;
+}
+
+// Gets the first record in a buffer of whole records.  Returns the size of
+// the record (including the header), or 0 if there is no complete record.
+static size_t ParseRecord(std::span<const uint8_t> data,
+                          DataLogRecord* record) {
+  if (data.size() < 4) {  // minimum header length
+    return 0;
+  }
+  unsigned int entryLen = (data[0] & 0x3) + 1;
+  unsigned int sizeLen = ((data[0] >> 2) & 0x3) + 1;
+  unsigned int timestampLen = ((data[0] >> 4) & 0x7) + 1;
+  size_t headerLen = 1 + entryLen + sizeLen + timestampLen;
+  if (data.size() < headerLen) {
+    return 0;
+  }
+  uint32_t size = ReadVarInt(data.subspan(1 + entryLen, sizeLen));
+  if (size > (data.size() - headerLen)) {
+    return 0;
+  }
+  *record = DataLogRecord{
+      static_cast<int>(ReadVarInt(data.subspan(1, entryLen))),
+      static_cast<int64_t>(
+          ReadVarInt(data.subspan(1 + entryLen + sizeLen, timestampLen))),
+      data.subspan(headerLen, size)};
+  return headerLen + size;
+}
+
+namespace {
+
+// A flight recorder ring file.  Only used by the writer thread.
+class RingFile {
+ public:
+  explicit RingFile(wpi::Logger& msglog) : m_msglog{msglog} {}
+  ~RingFile() { Close(); }
+
+  RingFile(const RingFile&) = delete;
+  RingFile& operator=(const RingFile&) = delete;
+
+  // Creates (or overwrites) the ring file and maps it.
+  void Open(std::string_view filename, uint64_t size,
+            std::span<const uint8_t> header);
+
+  bool IsOpen() const { return static_cast<bool>(m_map); }
+
+  // Updates the entry table from the start and set metadata records in a
+  // buffer.  Call for all control record buffers of a batch, followed by
+  // WriteTable(), before writing the batch, so the table covers its data.
+  void TrackEntries(std::span<const uint8_t> data);
+
+  // Writes the entry table, if it has changed.
+  void WriteTable();
+
+  // Writes the records in a buffer, overwriting the oldest slots as needed.
+  void Write(std::span<const uint8_t> data);
+
+  // Saves the ring contents as a standard log file.
+  void Dump(const std::string& filename);
+
+  void Close();
+
+ private:
+  uint8_t* GetSlot(uint32_t slot) {
+    return m_map.data() + m_firstSlot +
+           static_cast<uint64_t>(slot) * kRingSlotSize;
+  }
+
+  // starts writing into the next slot, replacing its data
+  void NextSlot();
+
+  wpi::Logger& m_msglog;
+  fs::file_t m_file = fs::kInvalidFile;
+  wpi::MappedFileRegion m_map;
+  uint32_t m_tableOffset = 0;
+  uint32_t m_tableCapacity = 0;
+  uint32_t m_firstSlot = 0;
+  uint32_t m_slotCount = 0;
+  // current slot
+  uint32_t m_slot = 0;
+  uint64_t m_seq = 0;
+  size_t m_slotSize = 0;
+  // entries that may have data in the ring; finished entries are kept until
+  // the slot with their finish record is overwritten
+  wpi::DenseMap<int, ActiveEntry> m_entries;
+  wpi::DenseMap<int, uint64_t> m_finished;  // slot sequence number
+  bool m_tableChanged = true;
+  bool m_tableFull = false;
+  std::vector<uint8_t> m_table;
+};
+
+}  // namespace
+
+void RingFile::Open(std::string_view filename, uint64_t size,
+                    std::span<const uint8_t> header) {
+  // the entry tables are sized relative to the ring, within limits
+  m_tableCapacity = std::clamp<uint64_t>(size / 16, 16 * 1024, 1024 * 1024);
+  m_tableOffset = kRingHeaderSize + header.size();
+  m_firstSlot = wpi::alignTo(m_tableOffset + 2 * m_tableCapacity, 8);
+  uint64_t minSize = m_firstSlot + 2 * kRingSlotSize;
+  if (size < minSize) {
+    WPI_ERROR(m_msglog,
+              "Flight recorder size {} is too small (minimum {}), no log "
+              "being saved",
+              size, minSize);
+    return;
+  }
+  m_slotCount = (std::min<uint64_t>)((size - m_firstSlot) / kRingSlotSize,
+                                     UINT32_MAX);
+  size = m_firstSlot + static_cast<uint64_t>(m_slotCount) * kRingSlotSize;
+
+  std::error_code ec;
+  m_file = fs::OpenFileForReadWrite(fs::path{filename}, ec,
+                                    fs::CD_CreateAlways, fs::OF_None);
+  if (ec) {
+    WPI_ERROR(m_msglog, "Could not open log file '{}': {}", filename,
+              ec.message());
+    return;
+  }
+#ifndef _WIN32
+  // extends the (empty) file with zeros; on Windows, mapping extends it
+  if (::ftruncate(m_file, size) != 0) {
+    WPI_ERROR(m_msglog, "Could not resize log file '{}': {}", filename,
+              std::strerror(errno));
+    Close();
+    return;
+  }
+#endif
+  m_map = wpi::MappedFileRegion{m_file, size, 0,
+                                wpi::MappedFileRegion::kReadWrite, ec};
+  if (ec) {
+    WPI_ERROR(m_msglog, "Could not map log file '{}': {}", filename,
+              ec.message());
+    Close();
+    return;
+  }
+
+  uint8_t* buf = m_map.data();
+  std::memcpy(buf + kRingHeaderSize, header.data(), header.size());
+  wpi::support::endian::write32le(buf + 8, kRingSlotSize);
+  wpi::support::endian::write32le(buf + 12, m_slotCount);
+  wpi::support::endian::write32le(buf + 16, m_firstSlot);
+  wpi::support::endian::write32le(buf + 20, m_tableCapacity);
+  wpi::support::endian::write32le(buf + 36, header.size());
+  // magic last, so the file isn't recognized until the header is complete
+  std::memcpy(buf, kRingMagic, sizeof(kRingMagic));
+  WPI_INFO(m_msglog, "Logging to flight recorder '{}'", filename);
+}
+
+void RingFile::TrackEntries(std::span<const uint8_t> data) {
+  DataLogRecord record;
+  while (size_t len = ParseRecord(data, &record)) {
+    data = data.subspan(len);
+    StartRecordData start;
+    MetadataRecordData metadata;
+    if (record.GetStartData(&start)) {
+      m_entries[start.entry] = {std::string{start.name},
+                                std::string{start.type},
+                                std::string{start.metadata},
+                                static_cast<uint64_t>(record.GetTimestamp())};
+      // a restarted entry must not be forgotten with its old finish record
+      m_finished.erase(start.entry);
+      m_tableChanged = true;
+    } else if (record.GetSetMetadataData(&metadata)) {
+      auto it = m_entries.find(metadata.entry);
+      if (it != m_entries.end()) {
+        it->second.metadata = metadata.metadata;
+        m_tableChanged = true;
+      }
+    }
+  }
+}
+
+void RingFile::WriteTable() {
+  if (!m_tableChanged || !IsOpen()) {
+    return;
+  }
+  m_tableChanged = false;
+  MakeStartRecords(m_entries, &m_table);
+  size_t size = m_table.size();
+  if (size > m_tableCapacity) {
+    // keep as many whole records as fit
+    size = 0;
+    DataLogRecord record;
+    std::span<const uint8_t> data{m_table};
+    while (size_t len = ParseRecord(data.subspan(size), &record)) {
+      if (size + len > m_tableCapacity) {
+        break;
+      }
+      size += len;
+    }
+    if (!m_tableFull) {
+      WPI_WARNING(m_msglog,
+                  "Too many entries for flight recorder; some entries will "
+                  "be missing start records");
+      m_tableFull = true;
+    }
+  }
+
+  // write the inactive table, then make it active
+  uint8_t* buf = m_map.data();
+  uint32_t table = (wpi::support::endian::read32le(buf + 24) & 1) ^ 1;
+  std::memcpy(buf + m_tableOffset + table * m_tableCapacity, m_table.data(),
+              size);
+  wpi::support::endian::write32le(buf + 28 + 4 * table, size);
+  wpi::support::endian::write32le(buf + 24, table);
+}
+
+void RingFile::NextSlot() {
+  if (m_seq != 0) {
+    m_slot = (m_slot + 1) % m_slotCount;
+  }
+  uint8_t* slot = GetSlot(m_slot);
+  uint64_t overwritten = wpi::support::endian::read64le(slot);
+  m_slotSize = 0;
+  wpi::support::endian::write32le(slot + 8, 0);
+  wpi::support::endian::write64le(slot, ++m_seq);
+
+  // forget finished entries once their finish record is gone
+  if (overwritten != 0) {
+    for (auto it = m_finished.begin(); it != m_finished.end();) {
+      auto cur = it++;
+      if (cur->second <= overwritten) {
+        m_entries.erase(cur->first);
+        m_finished.erase(cur);
+        m_tableChanged = true;
+      }
+    }
+  }
+}
+
+void RingFile::Write(std::span<const uint8_t> data) {
+  if (!IsOpen()) {
+    return;
+  }
+  DataLogRecord record;
+  while (size_t len = ParseRecord(data, &record)) {
+    auto raw = data.subspan(0, len);
+    data = data.subspan(len);
+    StartRecordData start;
+    if (record.GetStartData(&start)) {
+      // kept in the entry table; also handles a finish and restart in the
+      // same batch
+      m_finished.erase(start.entry);
+      continue;
+    }
+    if (len > kRingSlotDataSize) {
+      WPI_WARNING(m_msglog,
+                  "Dropped {} byte record (entry {}) too large for flight "
+                  "recorder",
+                  len, record.GetEntry());
+      continue;
+    }
+    if (m_seq == 0 || m_slotSize + len > kRingSlotDataSize) {
+      NextSlot();
+    }
+    uint8_t* slot = GetSlot(m_slot);
+    std::memcpy(slot + kRingSlotHeaderSize + m_slotSize, raw.data(), len);
+    m_slotSize += len;
+    wpi::support::endian::write32le(slot + 8, m_slotSize);
+    int entry;
+    if (record.GetFinishEntry(&entry)) {
+      m_finished[entry] = m_seq;
+    }
+  }
+}
+
+void RingFile::Dump(const std::string& filename) {
+  std::vector<std::span<const uint8_t>> parts;
+  if (!IsOpen() ||
+      !impl::ReadRing({m_map.const_data(), m_map.size()}, &parts)) {
+    return;
+  }
+  std::error_code ec;
+  fs::file_t f = fs::OpenFileForWrite(fs::path{filename}, ec,
+                                      fs::CD_CreateAlways, fs::OF_None);
+  if (ec) {
+    WPI_ERROR(m_msglog, "Could not open log file '{}': {}", filename,
+              ec.message());
+    return;
+  }
+  WriteToFile(f, parts, filename, m_msglog);
+  fs::CloseFile(f);
+  WPI_INFO(m_msglog, "Saved flight recorder to '{}'", filename);
+}
+
+void RingFile::Close() {
+  if (m_map) {
+    m_map.Flush();
+    m_map.Unmap();
+  }
+  if (m_file != fs::kInvalidFile) {
+    fs::CloseFile(m_file);
+    m_file = fs::kInvalidFile;
+  }
+}
+
+void DataLog::RingWriterThreadMain(std::string_view filename,
+                                   uint64_t ringSize) {
+  std::chrono::duration<double> periodTime{m_period};
+
+  // header (always version 1.0)
+  std::vector<uint8_t> header{'W', 'P', 'I', 'L', 'O', 'G', 0, 1, 0, 0, 0, 0};
+  support::endian::write32le(&header[8], m_extraHeader.size());
+  header.insert(header.end(), m_extraHeader.begin(), m_extraHeader.end());
+
+  RingFile ring{m_msglog};
+  ring.Open(filename, ringSize, header);
+
+  std::unique_lock lock{m_mutex};
+  for (bool active = true; active;) {
+    // after the log is destroyed, do a final flush and exit; appends may
+    // still be in thread buffers
+    active = m_active;
+    bool doFlush = !active;
+    if (active && !m_doFlush) {
+      auto timeoutTime = std::chrono::steady_clock::now() + periodTime;
+      if (m_cond.wait_until(lock, timeoutTime) == std::cv_status::timeout) {
+        doFlush = true;
+      }
+    }
+
+    if (doFlush || m_doFlush) {
+      // flush to ring
+      m_doFlush = false;
+      std::string dumpFilename = std::move(m_dumpFilename);
+      m_dumpFilename.clear();
+      StealThreadBuffers();
+      Buffer* toWrite = TakePending();
+
+      lock.unlock();
+      // control records are never in standard blocks
+      for (Buffer* buf = toWrite; buf; buf = buf->next) {
+        if (!buf->IsBlock()) {
+          ring.TrackEntries(buf->GetData());
+        }
+      }
+      ring.WriteTable();
+      for (Buffer* buf = toWrite; buf; buf = buf->next) {
+        ring.Write(buf->GetData());
+      }
+      // drop entries whose data was overwritten
+      ring.WriteTable();
+      if (!dumpFilename.empty()) {
+        ring.Dump(dumpFilename);
+      }
+      lock.lock();
+
+      ReleaseBuffers(toWrite);
+    }
+  }
+}
+
+void DataLog::PushPending(Buffer* buf) {
+  buf->next = m_pending.load(std::memory_order_relaxed);
+  while (!m_pending.compare_exchange_weak(
+      buf->next, buf, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+}
+
+void DataLog::StealThreadBuffers() {
+  for (auto it = m_threadBuffers.begin(); it != m_threadBuffers.end();) {
+    auto& tb = **it;
+    if (Buffer* buf = tb.slot.exchange(nullptr, std::memory_order_acquire)) {
+      if (!buf->GetData().empty()) {
+        PushPending(buf);
+      } else if (Buffer* expected = nullptr; !tb.slot.compare_exchange_strong(
+                     expected, buf, std::memory_order_release,
+                     std::memory_order_relaxed)) {
+        // the owner already replaced it
+        buf->next = nullptr;
+        ReleaseBuffers(buf);
+      }
+    }
+    // drop state for threads that have exited
+    if (it->use_count() == 1) {
+      it = m_threadBuffers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+DataLog::Buffer* DataLog::TakePending() {
+  // reverse the stack to get the buffers in the order they were pushed
+  Buffer* bufs = m_pending.exchange(nullptr, std::memory_order_acquire);
+  Buffer* out = nullptr;
+  while (bufs) {
+    auto next = bufs->next;
+    bufs->next = out;
+    out = bufs;
+    bufs = next;
+  }
+  return out;
+}
+
+void DataLog::ReleaseBuffers(Buffer* bufs) {
+  // return standard blocks to the free list; oversized ones are discarded
+  Buffer* head = nullptr;
+  Buffer* tail = nullptr;
+  while (bufs) {
+    auto next = bufs->next;
+    if (bufs->IsBlock()) {
+      bufs->Clear();
+      bufs->next = head;
+      head = bufs;
+      if (!tail) {
+        tail = bufs;
+      }
+    } else {
+      delete bufs;
+    }
+    bufs = next;
+  }
+  if (head) {
+    tail->next = m_free.load(std::memory_order_relaxed);
+    while (!m_free.compare_exchange_weak(tail->next, head,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+    }
+  }
+}
+
+DataLog::ThreadBuffer& DataLog::AcquireThreadBuffer() {
+  struct ThreadBuffers {
+    uint64_t lastId = 0;
+    ThreadBuffer* last = nullptr;
+    std::vector<std::pair<uint64_t, std::shared_ptr<ThreadBuffer>>> buffers;
+  };
+  thread_local ThreadBuffers threadBuffers;
+
+  ThreadBuffer* tb = nullptr;
+  if (threadBuffers.lastId == m_id) {
+    tb = threadBuffers.last;
+  } else {
+    for (auto&& [id, buf] : threadBuffers.buffers) {
+      if (id == m_id) {
+        tb = buf.get();
+        break;
+      }
+    }
+    if (!tb) {
+      // forget logs that have been destroyed
+      std::erase_if(threadBuffers.buffers,
+                    [](auto& elem) { return elem.second->closed.load(); });
+      auto buf = std::make_shared<ThreadBuffer>();
+      tb = buf.get();
+      // preallocate, so appends don't allocate until the writer falls behind
+      for (int i = 0; i < kThreadPreallocBlocks; ++i) {
+        auto block = new Buffer;
+        block->next = tb->free;
+        tb->free = block;
+      }
+      threadBuffers.buffers.emplace_back(m_id, buf);
+      std::scoped_lock lock{m_mutex};
+      m_threadBuffers.emplace_back(std::move(buf));
+    }
+    threadBuffers.lastId = m_id;
+    threadBuffers.last = tb;
+  }
+  tb->Acquire();
+  return *tb;
+}
+
+uint8_t* DataLog::Reserve(ThreadBuffer& tb, size_t size) {
+  if (!tb.buf || size > tb.buf->GetRemaining()) {
+    // hand off the current buffer
+    if (tb.buf) {
+      if (tb.buf->GetData().empty()) {
+        tb.buf->next = tb.free;
+        tb.free = tb.buf;
+      } else {
+        PushPending(tb.buf);
+      }
+    }
+    // records are never split across buffers, as another thread's buffer
+    // could be written between them
+    if (size > kBlockSize) {
+      tb.buf = new Buffer{size};
+    } else {
+      if (!tb.free) {
+        tb.free = m_free.exchange(nullptr, std::memory_order_acquire);
+      }
+      if (tb.free) {
+        tb.buf = tb.free;
+        tb.free = tb.free->next;
+        tb.buf->next = nullptr;
+      } else {
+        // all blocks are waiting to be written
+        tb.buf = new Buffer;
+      }
+    }
+  }
+  return tb.buf->Reserve(size);
+}
+
+uint8_t* DataLog::StartRecord(ThreadBuffer& tb, uint32_t entry,
+                              uint64_t timestamp, uint32_t payloadSize) {
+  uint8_t* buf = Reserve(tb, kRecordMaxHeaderSize + payloadSize);
+  auto headerLen = WriteRecordHeader(buf, entry, timestamp, payloadSize);
+  tb.buf->Unreserve(kRecordMaxHeaderSize - headerLen);
+  return buf + headerLen;
+}
+
+// must be called with m_mutex held
+uint8_t* DataLog::StartControlRecord(uint64_t timestamp, uint32_t payloadSize) {
+  // control records are rare, so each gets its own exactly-sized buffer
+  auto cbuf = new Buffer{kRecordMaxHeaderSize + payloadSize};
+  uint8_t* buf = cbuf->Reserve(kRecordMaxHeaderSize + payloadSize);
+  auto headerLen = WriteRecordHeader(buf, 0, timestamp, payloadSize);
+  cbuf->Unreserve(kRecordMaxHeaderSize - headerLen);
+  PushPending(cbuf);
+  return buf + headerLen;
+}
+
 // Control records use the following format:
 // 1-byte type
 // 4-byte entry
@@ -445,13 +1525,16 @@ int DataLog::Start(std::string_view name, std::string_view type,
     return entryInfo.id;
   }
   entryInfo.type = type;
+  // data records for this entry can only be appended after this returns, so
+  // unlike Finish() there's no need to hand off thread buffers first
   size_t strsize = name.size() + type.size() + metadata.size();
-  uint8_t* buf = StartRecord(0, timestamp, 5 + 12 + strsize, 5);
+  uint8_t* buf = StartControlRecord(timestamp, 5 + 12 + strsize);
   *buf++ = impl::kControlStart;
   wpi::support::endian::write32le(buf, entryInfo.id);
-  AppendStringImpl(name);
-  AppendStringImpl(type);
-  AppendStringImpl(metadata);
+  buf += 4;
+  buf = WriteString(buf, name);
+  buf = WriteString(buf, type);
+  WriteString(buf, metadata);
 
   return entryInfo.id;
 }
@@ -470,7 +1553,9 @@ void DataLog::Finish(int entry, int64_t timestamp) {
     return;
   }
   m_entryCounts.erase(entry);
-  uint8_t* buf = StartRecord(0, timestamp, 5, 5);
+  // data appended before this must be written before the finish record
+  StealThreadBuffers();
+  uint8_t* buf = StartControlRecord(timestamp, 5);
   *buf++ = impl::kControlFinish;
   wpi::support::endian::write32le(buf, entry);
 }
@@ -481,139 +1566,91 @@ void DataLog::SetMetadata(int entry, std::string_view metadata,
     return;
   }
   std::scoped_lock lock{m_mutex};
-  uint8_t* buf = StartRecord(0, timestamp, 5 + 4 + metadata.size(), 5);
+  StealThreadBuffers();
+  uint8_t* buf = StartControlRecord(timestamp, 5 + 4 + metadata.size());
   *buf++ = impl::kControlSetMetadata;
   wpi::support::endian::write32le(buf, entry);
-  AppendStringImpl(metadata);
-}
-
-uint8_t* DataLog::Reserve(size_t size) {
-  assert(size <= kBlockSize);
-  if (m_outgoing.empty() || size > m_outgoing.back().GetRemaining()) {
-    if (m_free.empty()) {
-      m_outgoing.emplace_back();
-    } else {
-      m_outgoing.emplace_back(std::move(m_free.back()));
-      m_free.pop_back();
-    }
-  }
-  return m_outgoing.back().Reserve(size);
-}
-
-uint8_t* DataLog::StartRecord(uint32_t entry, uint64_t timestamp,
-                              uint32_t payloadSize, size_t reserveSize) {
-  uint8_t* buf = Reserve(kRecordMaxHeaderSize + reserveSize);
-  auto headerLen = WriteRecordHeader(buf, entry, timestamp, payloadSize);
-  m_outgoing.back().Unreserve(kRecordMaxHeaderSize - headerLen);
-  buf += headerLen;
-  return buf;
-}
-
-void DataLog::AppendImpl(std::span<const uint8_t> data) {
-  while (data.size() > kBlockSize) {
-    uint8_t* buf = Reserve(kBlockSize);
-    std::memcpy(buf, data.data(), kBlockSize);
-    data = data.subspan(kBlockSize);
-  }
-  uint8_t* buf = Reserve(data.size());
-  std::memcpy(buf, data.data(), data.size());
-}
-
-void DataLog::AppendStringImpl(std::string_view str) {
-  uint8_t* buf = Reserve(4);
-  wpi::support::endian::write32le(buf, str.size());
-  AppendImpl({reinterpret_cast<const uint8_t*>(str.data()), str.size()});
+  WriteString(buf + 4, metadata);
 }
 
 void DataLog::AppendRaw(int entry, std::span<const uint8_t> data,
                         int64_t timestamp) {
-  if (entry <= 0) {
-    return;
-  }
-  std::scoped_lock lock{m_mutex};
-  if (m_paused) {
+  if (entry <= 0 || m_paused) {
     return;
   }
-  StartRecord(entry, timestamp, data.size(), 0);
-  AppendImpl(data);
+  auto& tb = AcquireThreadBuffer();
+  uint8_t* buf = StartRecord(tb, entry, timestamp, data.size());
+  std::memcpy(buf, data.data(), data.size());
+  tb.Release();
 }
 
 void DataLog::AppendRaw2(int entry,
                          std::span<const std::span<const uint8_t>> data,
                          int64_t timestamp) {
-  if (entry <= 0) {
-    return;
-  }
-  std::scoped_lock lock{m_mutex};
-  if (m_paused) {
+  if (entry <= 0 || m_paused) {
     return;
   }
   size_t size = 0;
   for (auto&& chunk : data) {
     size += chunk.size();
   }
-  StartRecord(entry, timestamp, size, 0);
+  auto& tb = AcquireThreadBuffer();
+  uint8_t* buf = StartRecord(tb, entry, timestamp, size);
   for (auto chunk : data) {
-    AppendImpl(chunk);
+    std::memcpy(buf, chunk.data(), chunk.size());
+    buf += chunk.size();
   }
+  tb.Release();
 }
 
 void DataLog::AppendBoolean(int entry, bool value, int64_t timestamp) {
-  if (entry <= 0) {
+  if (entry <= 0 || m_paused) {
     return;
   }
-  std::scoped_lock lock{m_mutex};
-  if (m_paused) {
-    return;
-  }
-  uint8_t* buf = StartRecord(entry, timestamp, 1, 1);
+  auto& tb = AcquireThreadBuffer();
+  uint8_t* buf = StartRecord(tb, entry, timestamp, 1);
   buf[0] = value ? 1 : 0;
+  tb.Release();
 }
 
 void DataLog::AppendInteger(int entry, int64_t value, int64_t timestamp) {
-  if (entry <= 0) {
+  if (entry <= 0 || m_paused) {
     return;
   }
-  std::scoped_lock lock{m_mutex};
-  if (m_paused) {
-    return;
-  }
-  uint8_t* buf = StartRecord(entry, timestamp, 8, 8);
+  auto& tb = AcquireThreadBuffer();
+  uint8_t* buf = StartRecord(tb, entry, timestamp, 8);
   wpi::support::endian::write64le(buf, value);
+  tb.Release();
 }
 
 void DataLog::AppendFloat(int entry, float value, int64_t timestamp) {
-  if (entry <= 0) {
+  if (entry <= 0 || m_paused) {
     return;
   }
-  std::scoped_lock lock{m_mutex};
-  if (m_paused) {
-    return;
-  }
-  uint8_t* buf = StartRecord(entry, timestamp, 4, 4);
+  auto& tb = AcquireThreadBuffer();
+  uint8_t* buf = StartRecord(tb, entry, timestamp, 4);
   if constexpr (wpi::support::endian::system_endianness() ==
                 wpi::support::little) {
     std::memcpy(buf, &value, 4);
   } else {
     wpi::support::endian::write32le(buf, wpi::FloatToBits(value));
   }
+  tb.Release();
 }
 
 void DataLog::AppendDouble(int entry, double value, int64_t timestamp) {
-  if (entry <= 0) {
+  if (entry <= 0 || m_paused) {
     return;
   }
-  std::scoped_lock lock{m_mutex};
-  if (m_paused) {
-    return;
-  }
-  uint8_t* buf = StartRecord(entry, timestamp, 8, 8);
+  auto& tb = AcquireThreadBuffer();
+  uint8_t* buf = StartRecord(tb, entry, timestamp, 8);
   if constexpr (wpi::support::endian::system_endianness() ==
                 wpi::support::little) {
     std::memcpy(buf, &value, 8);
   } else {
     wpi::support::endian::write64le(buf, wpi::DoubleToBits(value));
   }
+  tb.Release();
 }
 
 void DataLog::AppendString(int entry, std::string_view value,
@@ -625,50 +1662,28 @@ void DataLog::AppendString(int entry, std::string_view value,
 
 void DataLog::AppendBooleanArray(int entry, std::span<const bool> arr,
                                  int64_t timestamp) {
-  if (entry <= 0) {
+  if (entry <= 0 || m_paused) {
     return;
   }
-  std::scoped_lock lock{m_mutex};
-  if (m_paused) {
-    return;
-  }
-  StartRecord(entry, timestamp, arr.size(), 0);
-  uint8_t* buf;
-  while (arr.size() > kBlockSize) {
-    buf = Reserve(kBlockSize);
-    for (auto val : arr.subspan(0, kBlockSize)) {
-      *buf++ = val ? 1 : 0;
-    }
-    arr = arr.subspan(kBlockSize);
-  }
-  buf = Reserve(arr.size());
+  auto& tb = AcquireThreadBuffer();
+  uint8_t* buf = StartRecord(tb, entry, timestamp, arr.size());
   for (auto val : arr) {
     *buf++ = val ? 1 : 0;
   }
+  tb.Release();
 }
 
 void DataLog::AppendBooleanArray(int entry, std::span<const int> arr,
                                  int64_t timestamp) {
-  if (entry <= 0) {
-    return;
-  }
-  std::scoped_lock lock{m_mutex};
-  if (m_paused) {
+  if (entry <= 0 || m_paused) {
     return;
   }
-  StartRecord(entry, timestamp, arr.size(), 0);
-  uint8_t* buf;
-  while (arr.size() > kBlockSize) {
-    buf = Reserve(kBlockSize);
-    for (auto val : arr.subspan(0, kBlockSize)) {
-      *buf++ = val & 1;
-    }
-    arr = arr.subspan(kBlockSize);
-  }
-  buf = Reserve(arr.size());
+  auto& tb = AcquireThreadBuffer();
+  uint8_t* buf = StartRecord(tb, entry, timestamp, arr.size());
   for (auto val : arr) {
     *buf++ = val & 1;
   }
+  tb.Release();
 }
 
 void DataLog::AppendBooleanArray(int entry, std::span<const uint8_t> arr,
@@ -684,28 +1699,16 @@ void DataLog::AppendIntegerArray(int entry, std::span<const int64_t> arr,
               {reinterpret_cast<const uint8_t*>(arr.data()), arr.size() * 8},
               timestamp);
   } else {
-    if (entry <= 0) {
+    if (entry <= 0 || m_paused) {
       return;
     }
-    std::scoped_lock lock{m_mutex};
-    if (m_paused) {
-      return;
-    }
-    StartRecord(entry, timestamp, arr.size() * 8, 0);
-    uint8_t* buf;
-    while ((arr.size() * 8) > kBlockSize) {
-      buf = Reserve(kBlockSize);
-      for (auto val : arr.subspan(0, kBlockSize / 8)) {
-        wpi::support::endian::write64le(buf, val);
-        buf += 8;
-      }
-      arr = arr.subspan(kBlockSize / 8);
-    }
-    buf = Reserve(arr.size() * 8);
+    auto& tb = AcquireThreadBuffer();
+    uint8_t* buf = StartRecord(tb, entry, timestamp, arr.size() * 8);
     for (auto val : arr) {
       wpi::support::endian::write64le(buf, val);
       buf += 8;
     }
+    tb.Release();
   }
 }
 
@@ -717,28 +1720,16 @@ void DataLog::AppendFloatArray(int entry, std::span<const float> arr,
               {reinterpret_cast<const uint8_t*>(arr.data()), arr.size() * 4},
               timestamp);
   } else {
-    if (entry <= 0) {
-      return;
-    }
-    std::scoped_lock lock{m_mutex};
-    if (m_paused) {
+    if (entry <= 0 || m_paused) {
       return;
     }
-    StartRecord(entry, timestamp, arr.size() * 4, 0);
-    uint8_t* buf;
-    while ((arr.size() * 4) > kBlockSize) {
-      buf = Reserve(kBlockSize);
-      for (auto val : arr.subspan(0, kBlockSize / 4)) {
-        wpi::support::endian::write32le(buf, wpi::FloatToBits(val));
-        buf += 4;
-      }
-      arr = arr.subspan(kBlockSize / 4);
-    }
-    buf = Reserve(arr.size() * 4);
+    auto& tb = AcquireThreadBuffer();
+    uint8_t* buf = StartRecord(tb, entry, timestamp, arr.size() * 4);
     for (auto val : arr) {
       wpi::support::endian::write32le(buf, wpi::FloatToBits(val));
       buf += 4;
     }
+    tb.Release();
   }
 }
 
@@ -750,34 +1741,22 @@ void DataLog::AppendDoubleArray(int entry, std::span<const double> arr,
               {reinterpret_cast<const uint8_t*>(arr.data()), arr.size() * 8},
               timestamp);
   } else {
-    if (entry <= 0) {
-      return;
-    }
-    std::scoped_lock lock{m_mutex};
-    if (m_paused) {
+    if (entry <= 0 || m_paused) {
       return;
     }
-    StartRecord(entry, timestamp, arr.size() * 8, 0);
-    uint8_t* buf;
-    while ((arr.size() * 8) > kBlockSize) {
-      buf = Reserve(kBlockSize);
-      for (auto val : arr.subspan(0, kBlockSize / 8)) {
-        wpi::support::endian::write64le(buf, wpi::DoubleToBits(val));
-        buf += 8;
-      }
-      arr = arr.subspan(kBlockSize / 8);
-    }
-    buf = Reserve(arr.size() * 8);
+    auto& tb = AcquireThreadBuffer();
+    uint8_t* buf = StartRecord(tb, entry, timestamp, arr.size() * 8);
     for (auto val : arr) {
       wpi::support::endian::write64le(buf, wpi::DoubleToBits(val));
       buf += 8;
     }
+    tb.Release();
   }
 }
 
 void DataLog::AppendStringArray(int entry, std::span<const std::string> arr,
                                 int64_t timestamp) {
-  if (entry <= 0) {
+  if (entry <= 0 || m_paused) {
     return;
   }
   // storage: 4-byte array length, each string prefixed by 4-byte length
@@ -786,21 +1765,20 @@ void DataLog::AppendStringArray(int entry, std::span<const std::string> arr,
   for (auto&& str : arr) {
     size += 4 + str.size();
   }
-  std::scoped_lock lock{m_mutex};
-  if (m_paused) {
-    return;
-  }
-  uint8_t* buf = StartRecord(entry, timestamp, size, 4);
+  auto& tb = AcquireThreadBuffer();
+  uint8_t* buf = StartRecord(tb, entry, timestamp, size);
   wpi::support::endian::write32le(buf, arr.size());
+  buf += 4;
   for (auto&& str : arr) {
-    AppendStringImpl(str);
+    buf = WriteString(buf, str);
   }
+  tb.Release();
 }
 
 void DataLog::AppendStringArray(int entry,
                                 std::span<const std::string_view> arr,
                                 int64_t timestamp) {
-  if (entry <= 0) {
+  if (entry <= 0 || m_paused) {
     return;
   }
   // storage: 4-byte array length, each string prefixed by 4-byte length
@@ -809,13 +1787,81 @@ void DataLog::AppendStringArray(int entry,
   for (auto&& str : arr) {
     size += 4 + str.size();
   }
-  std::scoped_lock lock{m_mutex};
-  if (m_paused) {
-    return;
-  }
-  uint8_t* buf = StartRecord(entry, timestamp, size, 4);
+  auto& tb = AcquireThreadBuffer();
+  uint8_t* buf = StartRecord(tb, entry, timestamp, size);
   wpi::support::endian::write32le(buf, arr.size());
+  buf += 4;
   for (auto sv : arr) {
-    AppendStringImpl(sv);
+    buf = WriteString(buf, sv);
+  }
+  tb.Release();
+}
+
+template <typename T, typename F>
+void DataLog::AppendBatchImpl(int entry, std::span<const int64_t> timestamps,
+                              std::span<const T> values, uint32_t payloadSize,
+                              F&& encode) {
+  if (entry <= 0 || m_paused) {
+    return;
   }
+  size_t count = (std::min)(timestamps.size(), values.size());
+  size_t maxSize = kRecordMaxHeaderSize + payloadSize;
+  auto& tb = AcquireThreadBuffer();
+  for (size_t i = 0; i < count;) {
+    // reserve as many records as fit in the current buffer, or in a new one
+    size_t n = tb.buf ? tb.buf->GetRemaining() / maxSize : 0;
+    if (n == 0) {
+      n = kBlockSize / maxSize;
+    }
+    n = (std::min)(n, count - i);
+    uint8_t* start = Reserve(tb, n * maxSize);
+    uint8_t* buf = start;
+    for (size_t end = i + n; i < end; ++i) {
+      buf += WriteRecordHeader(buf, entry, timestamps[i], payloadSize);
+      encode(buf, values[i]);
+      buf += payloadSize;
+    }
+    tb.buf->Unreserve(n * maxSize - (buf - start));
+  }
+  tb.Release();
+}
+
+void DataLog::AppendBatch(int entry, std::span<const int64_t> timestamps,
+                          std::span<const bool> values) {
+  AppendBatchImpl(entry, timestamps, values, 1,
+                  [](uint8_t* buf, bool value) { buf[0] = value ? 1 : 0; });
+}
+
+void DataLog::AppendBatch(int entry, std::span<const int64_t> timestamps,
+                          std::span<const int64_t> values) {
+  AppendBatchImpl(entry, timestamps, values, 8,
+                  [](uint8_t* buf, int64_t value) {
+                    wpi::support::endian::write64le(buf, value);
+                  });
+}
+
+void DataLog::AppendBatch(int entry, std::span<const int64_t> timestamps,
+                          std::span<const float> values) {
+  AppendBatchImpl(entry, timestamps, values, 4, [](uint8_t* buf, float value) {
+    if constexpr (wpi::support::endian::system_endianness() ==
+                  wpi::support::little) {
+      std::memcpy(buf, &value, 4);
+    } else {
+      wpi::support::endian::write32le(buf, wpi::FloatToBits(value));
+    }
+  });
+}
+
+void DataLog::AppendBatch(int entry, std::span<const int64_t> timestamps,
+                          std::span<const double> values) {
+  AppendBatchImpl(entry, timestamps, values, 8,
+                  [](uint8_t* buf, double value) {
+                    if constexpr (wpi::support::endian::system_endianness() ==
+                                  wpi::support::little) {
+                      std::memcpy(buf, &value, 8);
+                    } else {
+                      wpi::support::endian::write64le(
+                          buf, wpi::DoubleToBits(value));
+                    }
+                  });
 }
@@ -4,8 +4,19 @@
 
 #include "wpi/DataLogReader.h"
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <numeric>
+#include <string_view>
+#include <thread>
+#include <vector>
+
 #include "wpi/DataLog.h"
 #include "wpi/Endian.h"
+#include "wpi/Lz4.h"
 #include "wpi/MathExtras.h"
 
 using namespace wpi::log;
@@ -159,6 +170,84 @@ bool DataLogRecord::GetDoubleArray(std::vector<double>* arr) const {
   return true;
 }
 
+bool DataLogRecord::GetIntegerArray(std::span<int64_t> arr) const {
+  if (m_data.size() != arr.size() * 8) {
+    return false;
+  }
+  for (size_t i = 0; i < arr.size(); ++i) {
+    arr[i] = wpi::support::endian::read64le(&m_data[i * 8]);
+  }
+  return true;
+}
+
+bool DataLogRecord::GetFloatArray(std::span<float> arr) const {
+  if (m_data.size() != arr.size() * 4) {
+    return false;
+  }
+  for (size_t i = 0; i < arr.size(); ++i) {
+    arr[i] = wpi::BitsToFloat(wpi::support::endian::read32le(&m_data[i * 4]));
+  }
+  return true;
+}
+
+bool DataLogRecord::GetDoubleArray(std::span<double> arr) const {
+  if (m_data.size() != arr.size() * 8) {
+    return false;
+  }
+  for (size_t i = 0; i < arr.size(); ++i) {
+    arr[i] = wpi::BitsToDouble(wpi::support::endian::read64le(&m_data[i * 8]));
+  }
+  return true;
+}
+
+bool DataLogRecord::GetIntegerArray(DataLogArrayView<int64_t>* arr) const {
+  if ((m_data.size() % 8) != 0) {
+    return false;
+  }
+  *arr = DataLogArrayView<int64_t>{m_data};
+  return true;
+}
+
+bool DataLogRecord::GetFloatArray(DataLogArrayView<float>* arr) const {
+  if ((m_data.size() % 4) != 0) {
+    return false;
+  }
+  *arr = DataLogArrayView<float>{m_data};
+  return true;
+}
+
+bool DataLogRecord::GetDoubleArray(DataLogArrayView<double>* arr) const {
+  if ((m_data.size() % 8) != 0) {
+    return false;
+  }
+  *arr = DataLogArrayView<double>{m_data};
+  return true;
+}
+
+bool DataLogRecord::GetStringArray(DataLogStringArrayView* arr) const {
+  if (m_data.size() < 4) {
+    return false;
+  }
+  uint32_t size = wpi::support::endian::read32le(m_data.data());
+  // sanity check size
+  if (size > ((m_data.size() - 4) / 4)) {
+    return false;
+  }
+  auto buf = m_data.subspan(4);
+  for (uint32_t i = 0; i < size; ++i) {
+    std::string_view str;
+    if (!ReadString(&buf, &str)) {
+      return false;
+    }
+  }
+  // any left over?  treat as corrupt
+  if (!buf.empty()) {
+    return false;
+  }
+  *arr = DataLogStringArrayView{m_data.subspan(4), size};
+  return true;
+}
+
 bool DataLogRecord::GetStringArray(std::vector<std::string_view>* arr) const {
   arr->clear();
   if (m_data.size() < 4) {
@@ -187,8 +276,98 @@ bool DataLogRecord::GetStringArray(std::vector<std::string_view>* arr) const {
   return true;
 }
 
+// version written by DataLog for compressed logs
+static constexpr uint16_t kCompressedVersion = 0x0200;
+
+// LZ4 can expand a block by at most about 255 times, as each extra length
+// byte adds at most 255 bytes
+static constexpr uint64_t kMaxFrameRatio = 255;
+
+// limit on the decompressed size of a log; frame sizes are untrusted input
+static constexpr uint64_t kMaxDecompressedSize =
+    (std::min<uint64_t>)(UINT32_MAX, SIZE_MAX / 2);
+
+// Expands the frames of a compressed (version 2.0) log into a version 2.0
+// header followed by plain records.  Like a truncated log, anything after a
+// corrupt frame is dropped; a frame that claims more than its stored size can
+// expand to, or would take the total over kMaxDecompressedSize, is corrupt.
+static std::unique_ptr<wpi::MemoryBuffer> DecompressLog(
+    std::unique_ptr<wpi::MemoryBuffer> in) {
+  auto buf = in->GetBuffer();
+  size_t headerSize = 12 + wpi::support::endian::read32le(&buf[8]);
+  if (buf.size() < headerSize) {
+    return in;
+  }
+
+  // get total size, and the part of the input with valid frame sizes
+  uint64_t size = headerSize;
+  auto frames = buf.subspan(headerSize);
+  while (frames.size() >= 8) {
+    uint32_t frameSize = wpi::support::endian::read32le(&frames[0]);
+    uint32_t storedSize = wpi::support::endian::read32le(&frames[4]);
+    if (storedSize > (frames.size() - 8) ||
+        frameSize > storedSize * kMaxFrameRatio ||
+        (size + frameSize) > kMaxDecompressedSize) {
+      break;
+    }
+    size += frameSize;
+    frames = frames.subspan(8 + storedSize);
+  }
+  auto valid = buf.subspan(headerSize, frames.data() - buf.data() - headerSize);
+
+  auto out = wpi::WritableMemoryBuffer::GetNewUninitMemBuffer(
+      static_cast<size_t>(size), in->GetBufferIdentifier());
+  uint8_t* op = out->begin();
+  std::memcpy(op, buf.data(), headerSize);
+  op += headerSize;
+  for (frames = valid; !frames.empty();) {
+    uint32_t frameSize = wpi::support::endian::read32le(&frames[0]);
+    uint32_t storedSize = wpi::support::endian::read32le(&frames[4]);
+    auto stored = frames.subspan(8, storedSize);
+    if (storedSize == frameSize) {
+      std::memcpy(op, stored.data(), storedSize);
+    } else if (!wpi::Lz4Decompress(stored, {op, frameSize})) {
+      // corrupt; keep what was good
+      return wpi::MemoryBuffer::GetMemBufferCopy(
+          {out->begin(), op}, in->GetBufferIdentifier());
+    }
+    op += frameSize;
+    frames = frames.subspan(8 + storedSize);
+  }
+  return out;
+}
+
+// Converts a flight recorder ring file into a version 1.0 log.  Returns the
+// input if it is not a ring file.
+static std::unique_ptr<wpi::MemoryBuffer> ExpandRing(
+    std::unique_ptr<wpi::MemoryBuffer> in) {
+  std::vector<std::span<const uint8_t>> parts;
+  if (!impl::ReadRing(in->GetBuffer(), &parts)) {
+    return in;
+  }
+  size_t size = 0;
+  for (auto&& part : parts) {
+    size += part.size();
+  }
+  auto out = wpi::WritableMemoryBuffer::GetNewUninitMemBuffer(
+      size, in->GetBufferIdentifier());
+  uint8_t* op = out->begin();
+  for (auto&& part : parts) {
+    std::memcpy(op, part.data(), part.size());
+    op += part.size();
+  }
+  return out;
+}
+
 DataLogReader::DataLogReader(std::unique_ptr<MemoryBuffer> buffer)
-    : m_buf{std::move(buffer)} {}
+    : m_buf{std::move(buffer)} {
+  if (m_buf) {
+    m_buf = ExpandRing(std::move(m_buf));
+  }
+  if (IsValid() && GetVersion() == kCompressedVersion) {
+    m_buf = DecompressLog(std::move(m_buf));
+  }
+}
 
 bool DataLogReader::IsValid() const {
   if (!m_buf) {
@@ -198,7 +377,8 @@ bool DataLogReader::IsValid() const {
   return buf.size() >= 12 &&
          std::string_view{reinterpret_cast<const char*>(buf.data()), 6} ==
              "WPILOG" &&
-         wpi::support::endian::read16le(&buf[6]) >= 0x0100;
+         wpi::support::endian::read16le(&buf[6]) >= 0x0100 &&
+         wpi::support::endian::read16le(&buf[6]) <= kCompressedVersion;
 }
 
 uint16_t DataLogReader::GetVersion() const {
@@ -227,18 +407,22 @@ std::string_view DataLogReader::GetExtraHeader() const {
 }
 
 DataLogReader::iterator DataLogReader::begin() const {
+  return DataLogIterator{this, GetStartPos()};
+}
+
+size_t DataLogReader::GetStartPos() const {
   if (!m_buf) {
-    return end();
+    return SIZE_MAX;
   }
   auto buf = m_buf->GetBuffer();
   if (buf.size() < 12) {
-    return end();
+    return SIZE_MAX;
   }
   uint32_t size = wpi::support::endian::read32le(&buf[8]);
   if (buf.size() < (12 + size)) {
-    return end();
+    return SIZE_MAX;
   }
-  return DataLogIterator{this, 12 + size};
+  return 12 + size;
 }
 
 static uint64_t ReadVarInt(std::span<const uint8_t> buf) {
@@ -305,3 +489,376 @@ bool DataLogReader::GetNextRecord(size_t* pos) const {
   *pos += headerLen + size;
   return true;
 }
+
+// sorts the records of an index by timestamp, keeping log order for equal
+// timestamps; timestamps are usually in order, but aren't guaranteed to be
+template <typename Index>
+static void SortByTimestamp(Index* index) {
+  if (std::is_sorted(index->timestamps.begin(), index->timestamps.end())) {
+    return;
+  }
+  std::vector<size_t> order(index->timestamps.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return index->timestamps[a] < index->timestamps[b];
+  });
+  std::vector<int64_t> timestamps;
+  std::vector<size_t> positions;
+  timestamps.reserve(order.size());
+  positions.reserve(order.size());
+  for (auto i : order) {
+    timestamps.emplace_back(index->timestamps[i]);
+    positions.emplace_back(index->positions[i]);
+  }
+  index->timestamps = std::move(timestamps);
+  index->positions = std::move(positions);
+}
+
+wpi::DenseMap<int, DataLogReader::IdIndex> DataLogReader::BuildIndex() const {
+  wpi::DenseMap<int, IdIndex> ids;
+  DataLogRecord record;
+  for (size_t pos = GetStartPos(); pos != SIZE_MAX;) {
+    size_t recordPos = pos;
+    if (!GetRecord(&pos, &record)) {
+      break;
+    }
+    if (record.IsControl()) {
+      // each start record begins a new use of the ID, unless nothing has
+      // been seen for it since the last one
+      StartRecordData start;
+      if (record.GetStartData(&start)) {
+        auto& uses = ids[start.entry].uses;
+        if (uses.empty() || !uses.back().positions.empty()) {
+          uses.emplace_back();
+        }
+        uses.back().name = start.name;
+        uses.back().type = start.type;
+      }
+      continue;
+    }
+    // data records without a start record get a use with no name or type
+    auto& uses = ids[record.GetEntry()].uses;
+    if (uses.empty()) {
+      uses.emplace_back();
+    }
+    uses.back().timestamps.emplace_back(record.GetTimestamp());
+    uses.back().positions.emplace_back(recordPos);
+  }
+
+  for (auto&& [id, index] : ids) {
+    for (auto&& use : index.uses) {
+      SortByTimestamp(&use);
+    }
+    if (index.uses.size() > 1) {
+      for (auto&& use : index.uses) {
+        index.merged.timestamps.insert(index.merged.timestamps.end(),
+                                       use.timestamps.begin(),
+                                       use.timestamps.end());
+        index.merged.positions.insert(index.merged.positions.end(),
+                                      use.positions.begin(),
+                                      use.positions.end());
+      }
+      SortByTimestamp(&index.merged);
+    }
+  }
+  return ids;
+}
+
+const wpi::DenseMap<int, DataLogReader::IdIndex>& DataLogReader::GetIndex()
+    const {
+  // if building throws, nothing is stored and the next call tries again
+  std::call_once(m_index->built, [&] { m_index->ids = BuildIndex(); });
+  return m_index->ids;
+}
+
+const DataLogReader::EntryIndex* DataLogReader::GetEntryIndex(int entry) const {
+  auto& ids = GetIndex();
+  auto it = ids.find(entry);
+  if (it == ids.end()) {
+    return nullptr;
+  }
+  return &it->second.GetAll();
+}
+
+DataLogEntryRange DataLogReader::GetEntryRecords(int entry, int64_t start,
+                                                 int64_t end) const {
+  auto index = GetEntryIndex(entry);
+  if (!index || start >= end) {
+    return {this, {}};
+  }
+  auto& ts = index->timestamps;
+  auto first = std::lower_bound(ts.begin(), ts.end(), start);
+  auto last = std::lower_bound(first, ts.end(), end);
+  return {this, std::span{index->positions}.subspan(first - ts.begin(),
+                                                     last - first)};
+}
+
+bool DataLogReader::GetEntryTimestampRange(int entry, int64_t* first,
+                                           int64_t* last) const {
+  auto index = GetEntryIndex(entry);
+  if (!index || index->timestamps.empty()) {
+    return false;
+  }
+  *first = index->timestamps.front();
+  *last = index->timestamps.back();
+  return true;
+}
+
+namespace {
+enum class ColumnKind {
+  kInteger,
+  kIntegerArray,
+  kBoolean,
+  kBooleanArray,
+  kFloat,
+  kFloatArray,
+  kDouble,
+  kDoubleArray,
+  kString,
+  kStringArray,
+  kRaw
+};
+}  // namespace
+
+static ColumnKind GetColumnKind(std::string_view type) {
+  if (type == "int64") {
+    return ColumnKind::kInteger;
+  } else if (type == "int64[]") {
+    return ColumnKind::kIntegerArray;
+  } else if (type == "boolean") {
+    return ColumnKind::kBoolean;
+  } else if (type == "boolean[]") {
+    return ColumnKind::kBooleanArray;
+  } else if (type == "float") {
+    return ColumnKind::kFloat;
+  } else if (type == "float[]") {
+    return ColumnKind::kFloatArray;
+  } else if (type == "double") {
+    return ColumnKind::kDouble;
+  } else if (type == "double[]") {
+    return ColumnKind::kDoubleArray;
+  } else if (type == "string") {
+    return ColumnKind::kString;
+  } else if (type == "string[]") {
+    return ColumnKind::kStringArray;
+  } else {
+    return ColumnKind::kRaw;
+  }
+}
+
+// Appends the array decoded by get to the end of vec; returns false (leaving
+// vec unchanged) on error
+template <typename T, typename F>
+static bool AppendArray(std::vector<T>* vec, size_t size, F&& get) {
+  size_t oldSize = vec->size();
+  vec->resize(oldSize + size);
+  if (!get(std::span{*vec}.subspan(oldSize))) {
+    vec->resize(oldSize);
+    return false;
+  }
+  return true;
+}
+
+void DataLogReader::DecodeColumnRecords(const EntryIndex& index, size_t first,
+                                        size_t last,
+                                        DataLogColumn* out) const {
+  auto kind = GetColumnKind(index.type);
+  out->timestamps.reserve(last - first);
+  out->offsets.reserve(last - first + 1);
+  switch (kind) {
+    case ColumnKind::kInteger:
+    case ColumnKind::kBoolean:
+      out->integers.reserve(last - first);
+      break;
+    case ColumnKind::kFloat:
+      out->floats.reserve(last - first);
+      break;
+    case ColumnKind::kDouble:
+      out->doubles.reserve(last - first);
+      break;
+    case ColumnKind::kString:
+    case ColumnKind::kRaw:
+      out->strings.reserve(last - first);
+      break;
+    default:
+      break;
+  }
+  std::vector<std::string_view> strings;
+  DataLogRecord record;
+  for (size_t i = first; i < last; ++i) {
+    size_t pos = index.positions[i];
+    if (!GetRecord(&pos, &record)) {
+      continue;
+    }
+    size_t size = record.GetSize();
+    bool ok = false;
+    switch (kind) {
+      case ColumnKind::kInteger: {
+        int64_t val;
+        ok = record.GetInteger(&val);
+        if (ok) {
+          out->integers.emplace_back(val);
+        }
+        break;
+      }
+      case ColumnKind::kIntegerArray:
+        ok = size % 8 == 0 &&
+             AppendArray(&out->integers, size / 8, [&](auto arr) {
+               return record.GetIntegerArray(arr);
+             });
+        break;
+      case ColumnKind::kBoolean: {
+        bool val;
+        ok = record.GetBoolean(&val);
+        if (ok) {
+          out->integers.emplace_back(val ? 1 : 0);
+        }
+        break;
+      }
+      case ColumnKind::kBooleanArray:
+        for (auto val : record.GetRaw()) {
+          out->integers.emplace_back(val ? 1 : 0);
+        }
+        ok = true;
+        break;
+      case ColumnKind::kFloat: {
+        float val;
+        ok = record.GetFloat(&val);
+        if (ok) {
+          out->floats.emplace_back(val);
+        }
+        break;
+      }
+      case ColumnKind::kFloatArray:
+        ok = size % 4 == 0 &&
+             AppendArray(&out->floats, size / 4, [&](auto arr) {
+               return record.GetFloatArray(arr);
+             });
+        break;
+      case ColumnKind::kDouble: {
+        double val;
+        ok = record.GetDouble(&val);
+        if (ok) {
+          out->doubles.emplace_back(val);
+        }
+        break;
+      }
+      case ColumnKind::kDoubleArray:
+        ok = size % 8 == 0 &&
+             AppendArray(&out->doubles, size / 8, [&](auto arr) {
+               return record.GetDoubleArray(arr);
+             });
+        break;
+      case ColumnKind::kStringArray:
+        ok = record.GetStringArray(&strings);
+        if (ok) {
+          out->strings.insert(out->strings.end(), strings.begin(),
+                              strings.end());
+        }
+        break;
+      case ColumnKind::kString:
+      case ColumnKind::kRaw: {
+        std::string_view val;
+        ok = record.GetString(&val);
+        if (ok) {
+          out->strings.emplace_back(val);
+        }
+        break;
+      }
+    }
+    if (!ok) {
+      continue;
+    }
+    out->timestamps.emplace_back(record.GetTimestamp());
+    out->offsets.emplace_back(out->integers.size() + out->floats.size() +
+                              out->doubles.size() + out->strings.size());
+  }
+}
+
+std::vector<DataLogColumn> DataLogReader::DecodeColumns(
+    unsigned int threads) const {
+  // build index and get entries; each use of an ID is a separate column
+  std::vector<std::pair<int, const EntryIndex*>> entries;
+  for (auto&& [id, index] : GetIndex()) {
+    for (auto&& use : index.uses) {
+      if (!use.positions.empty()) {
+        entries.emplace_back(id, &use);
+      }
+    }
+  }
+  std::stable_sort(
+      entries.begin(), entries.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+
+  // split large entries into multiple tasks so one busy entry doesn't
+  // serialize the decode
+  static constexpr size_t kChunkSize = 65536;
+  struct Task {
+    size_t entry;
+    size_t first;
+    size_t last;
+  };
+  std::vector<Task> tasks;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    size_t count = entries[i].second->positions.size();
+    for (size_t first = 0; first < count; first += kChunkSize) {
+      tasks.emplace_back(Task{i, first, (std::min)(first + kChunkSize, count)});
+    }
+  }
+
+  std::vector<DataLogColumn> parts(tasks.size());
+  std::atomic<size_t> nextTask{0};
+  auto worker = [&] {
+    for (;;) {
+      size_t i = nextTask.fetch_add(1, std::memory_order_relaxed);
+      if (i >= tasks.size()) {
+        break;
+      }
+      auto& task = tasks[i];
+      DecodeColumnRecords(*entries[task.entry].second, task.first, task.last,
+                          &parts[i]);
+    }
+  };
+  if (threads == 0) {
+    threads = (std::max)(std::thread::hardware_concurrency(), 1u);
+  }
+  threads = (std::min)(threads, static_cast<unsigned int>(tasks.size()));
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < threads; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto&& thr : workers) {
+    thr.join();
+  }
+
+  // concatenate the parts of each entry
+  std::vector<DataLogColumn> columns(entries.size());
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    auto& part = parts[i];
+    auto& column = columns[tasks[i].entry];
+    if (tasks[i].first == 0) {
+      column = std::move(part);
+      column.entry = entries[tasks[i].entry].first;
+      column.name = entries[tasks[i].entry].second->name;
+      column.type = entries[tasks[i].entry].second->type;
+      continue;
+    }
+    size_t base = column.offsets.back();
+    column.timestamps.insert(column.timestamps.end(), part.timestamps.begin(),
+                             part.timestamps.end());
+    for (size_t j = 1; j < part.offsets.size(); ++j) {
+      column.offsets.emplace_back(base + part.offsets[j]);
+    }
+    column.integers.insert(column.integers.end(), part.integers.begin(),
+                           part.integers.end());
+    column.floats.insert(column.floats.end(), part.floats.begin(),
+                         part.floats.end());
+    column.doubles.insert(column.doubles.end(), part.doubles.begin(),
+                          part.doubles.end());
+    column.strings.insert(column.strings.end(), part.strings.begin(),
+                          part.strings.end());
+    part = DataLogColumn{};  // release memory
+  }
+  return columns;
+}
@@ -0,0 +1,182 @@
+// Copyright (c) FIRST and other WPILib contributors.
+// Open Source Software; you can modify and/or share it under the terms of
+// the WPILib BSD license file in the root directory of this project.
+
+#include "wpi/Lz4.h"
+
+#include <cstring>
+
+#include "wpi/Endian.h"
+
+// LZ4 block format: a sequence of (token, literals, match offset, match
+// length) tuples, with the final sequence having only literals.  The last 5
+// bytes are always literals, and the last match must start at least 12 bytes
+// before the end of the block.
+static constexpr size_t kMinMatch = 4;
+static constexpr size_t kLastLiterals = 5;
+static constexpr size_t kMatchFindLimit = 12;
+static constexpr size_t kMaxOffset = 65535;
+static constexpr int kHashLog = 12;
+
+static inline uint32_t Read32(const uint8_t* p) {
+  uint32_t val;
+  std::memcpy(&val, p, 4);
+  return val;
+}
+
+static inline uint32_t Hash(uint32_t val) {
+  return (val * 2654435761u) >> (32 - kHashLog);
+}
+
+static uint8_t* WriteLength(uint8_t* op, size_t len) {
+  while (len >= 255) {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = len;
+  return op;
+}
+
+static uint8_t* WriteSequence(uint8_t* op, const uint8_t* anchor,
+                              size_t litLen, size_t offset, size_t matchLen) {
+  uint8_t* token = op++;
+  *token = (litLen >= 15 ? 15 : litLen) << 4;
+  if (litLen >= 15) {
+    op = WriteLength(op, litLen - 15);
+  }
+  std::memcpy(op, anchor, litLen);
+  op += litLen;
+  if (matchLen == 0) {
+    return op;  // last sequence
+  }
+  wpi::support::endian::write16le(op, offset);
+  op += 2;
+  matchLen -= kMinMatch;
+  *token |= matchLen >= 15 ? 15 : matchLen;
+  if (matchLen >= 15) {
+    op = WriteLength(op, matchLen - 15);
+  }
+  return op;
+}
+
+size_t wpi::Lz4Compress(std::span<const uint8_t> in, std::span<uint8_t> out) {
+  const uint8_t* base = in.data();
+  const uint8_t* ip = base;
+  const uint8_t* anchor = base;
+  const uint8_t* end = base + in.size();
+  uint8_t* op = out.data();
+  uint8_t* oend = out.data() + out.size();
+
+  if (in.size() > kMatchFindLimit) {
+    const uint8_t* matchLimit = end - kLastLiterals;
+    uint32_t table[1 << kHashLog];
+    std::memset(table, 0, sizeof(table));
+
+    while (ip + kMatchFindLimit <= end) {
+      uint32_t seq = Read32(ip);
+      uint32_t h = Hash(seq);
+      const uint8_t* ref = base + table[h];
+      table[h] = ip - base;
+      if (ref >= ip || static_cast<size_t>(ip - ref) > kMaxOffset ||
+          Read32(ref) != seq) {
+        ++ip;
+        continue;
+      }
+
+      // extend the match backwards into pending literals, then forwards
+      while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+        --ip;
+        --ref;
+      }
+      size_t matchLen = kMinMatch;
+      while (ip + matchLen < matchLimit && ip[matchLen] == ref[matchLen]) {
+        ++matchLen;
+      }
+
+      size_t litLen = ip - anchor;
+      if (static_cast<size_t>(oend - op) <
+          1 + litLen + litLen / 255 + 2 + matchLen / 255 + 2) {
+        return 0;
+      }
+      op = WriteSequence(op, anchor, litLen, ip - ref, matchLen);
+      ip += matchLen;
+      anchor = ip;
+    }
+  }
+
+  // remaining literals
+  size_t litLen = end - anchor;
+  if (static_cast<size_t>(oend - op) < 1 + litLen + litLen / 255 + 1) {
+    return 0;
+  }
+  op = WriteSequence(op, anchor, litLen, 0, 0);
+  return op - out.data();
+}
+
+static bool ReadLength(const uint8_t** ip, const uint8_t* iend, size_t* len) {
+  uint8_t val;
+  do {
+    if (*ip >= iend) {
+      return false;
+    }
+    val = *(*ip)++;
+    *len += val;
+  } while (val == 255);
+  return true;
+}
+
+bool wpi::Lz4Decompress(std::span<const uint8_t> in, std::span<uint8_t> out) {
+  const uint8_t* ip = in.data();
+  const uint8_t* iend = ip + in.size();
+  uint8_t* op = out.data();
+  uint8_t* oend = op + out.size();
+
+  while (ip < iend) {
+    uint8_t token = *ip++;
+
+    // literals
+    size_t litLen = token >> 4;
+    if (litLen == 15 && !ReadLength(&ip, iend, &litLen)) {
+      return false;
+    }
+    if (litLen > static_cast<size_t>(iend - ip) ||
+        litLen > static_cast<size_t>(oend - op)) {
+      return false;
+    }
+    std::memcpy(op, ip, litLen);
+    ip += litLen;
+    op += litLen;
+    if (ip == iend) {
+      break;  // last sequence
+    }
+
+    // match
+    if (iend - ip < 2) {
+      return false;
+    }
+    size_t offset = wpi::support::endian::read16le(ip);
+    ip += 2;
+    if (offset == 0 || offset > static_cast<size_t>(op - out.data())) {
+      return false;
+    }
+    size_t matchLen = token & 15;
+    if (matchLen == 15 && !ReadLength(&ip, iend, &matchLen)) {
+      return false;
+    }
+    matchLen += kMinMatch;
+    if (matchLen > static_cast<size_t>(oend - op)) {
+      return false;
+    }
+    const uint8_t* ref = op - offset;
+    if (offset >= matchLen) {
+      std::memcpy(op, ref, matchLen);
+      op += matchLen;
+    } else {
+      // overlapping copy repeats the pattern
+      for (size_t i = 0; i < matchLen; ++i) {
+        *op++ = *ref++;
+      }
+    }
+  }
+  return op == oend;
+}
@@ -6,6 +6,7 @@
 
 #include <stdint.h>
 
+#include <atomic>
 #include <functional>
 #include <initializer_list>
 #include <memory>
@@ -34,6 +35,19 @@ enum ControlRecordType {
   kControlSetMetadata
 };
 
+/**
+ * Gets the contents of a flight recorder ring file (see DataLog) as the parts
+ * of a standard (version 1.0) log, in order: the header, start records for
+ * the entries with data in the ring, and the ring slots from oldest to
+ * newest.  The parts refer to the ring data.
+ *
+ * @param ring ring file contents
+ * @param parts parts of the log (output)
+ * @return False if ring is not a valid ring file
+ */
+bool ReadRing(std::span<const uint8_t> ring,
+              std::vector<std::span<const uint8_t>>* parts);
+
 }  // namespace impl
 
 /**
@@ -56,12 +70,15 @@ enum ControlRecordType {
  * good idea to call Finish() from destructors for this reason.
  *
  * DataLog calls are thread safe.  DataLog uses a typical multiple-supplier,
- * single-consumer setup.  Writes to the log are atomic, but there is no
- * guaranteed order in the log when multiple threads are writing to it;
- * whichever thread grabs the write mutex first will get written first.
- * For this reason (as well as the fact that timestamps can be set to
- * arbitrary values), records in the log are not guaranteed to be sorted by
- * timestamp.
+ * single-consumer setup.  Each thread appends data records to its own buffer
+ * without taking a shared lock; full buffers are handed to the writer thread
+ * in the order they fill.  Writes to the log are atomic, but there is no
+ * guaranteed order in the log when multiple threads are writing to it.
+ * Records from a single thread stay in order, and data records appended
+ * before a Finish() or SetMetadata() call are written before that control
+ * record.  For this reason (as well as the fact that timestamps can be set
+ * to arbitrary values), records in the log are not guaranteed to be sorted
+ * by timestamp.
  */
 class DataLog final {
  public:
@@ -75,9 +92,12 @@ class DataLog final {
    * @param period time between automatic flushes to disk, in seconds;
    *               this is a time/storage tradeoff
    * @param extraHeader extra header data
+   * @param compress compress the log data (this requires a reader that
+   *                 supports version 2.0 logs)
    */
   explicit DataLog(std::string_view dir = "", std::string_view filename = "",
-                   double period = 0.25, std::string_view extraHeader = "");
+                   double period = 0.25, std::string_view extraHeader = "",
+                   bool compress = false);
 
   /**
    * Construct a new Data Log.  The log will be initially created with a
@@ -90,10 +110,12 @@ class DataLog final {
    * @param period time between automatic flushes to disk, in seconds;
    *               this is a time/storage tradeoff
    * @param extraHeader extra header data
+   * @param compress compress the log data (this requires a reader that
+   *                 supports version 2.0 logs)
    */
   explicit DataLog(wpi::Logger& msglog, std::string_view dir = "",
                    std::string_view filename = "", double period = 0.25,
-                   std::string_view extraHeader = "");
+                   std::string_view extraHeader = "", bool compress = false);
 
   /**
    * Construct a new Data Log that passes its output to the provided function
@@ -105,9 +127,12 @@ class DataLog final {
    * @param period time between automatic calls to write, in seconds;
    *               this is a time/storage tradeoff
    * @param extraHeader extra header data
+   * @param compress compress the log data (this requires a reader that
+   *                 supports version 2.0 logs)
    */
   explicit DataLog(std::function<void(std::span<const uint8_t> data)> write,
-                   double period = 0.25, std::string_view extraHeader = "");
+                   double period = 0.25, std::string_view extraHeader = "",
+                   bool compress = false);
 
   /**
    * Construct a new Data Log that passes its output to the provided function
@@ -120,10 +145,46 @@ class DataLog final {
    * @param period time between automatic calls to write, in seconds;
    *               this is a time/storage tradeoff
    * @param extraHeader extra header data
+   * @param compress compress the log data (this requires a reader that
+   *                 supports version 2.0 logs)
    */
   explicit DataLog(wpi::Logger& msglog,
                    std::function<void(std::span<const uint8_t> data)> write,
-                   double period = 0.25, std::string_view extraHeader = "");
+                   double period = 0.25, std::string_view extraHeader = "",
+                   bool compress = false);
+
+  /**
+   * Construct a new Data Log in "flight recorder" mode.  Rather than growing
+   * a log file, records are continuously written into a fixed-size
+   * memory-mapped ring file, overwriting the oldest data, so the ring always
+   * holds the most recent data at full rate.  Call Dump() (e.g. when a fault
+   * is detected) to save the current contents of the ring as a standard log
+   * file.  The ring file can also be read directly by DataLogReader (e.g.
+   * after a crash).
+   *
+   * Appending works as in other modes; the ring is only written by the writer
+   * thread.  Records larger than a ring slot (64 KiB) are dropped.
+   *
+   * @param filename ring filename; the file is created (or overwritten)
+   * @param ringSize size of the ring file, in bytes
+   * @param period time between automatic flushes to the ring, in seconds
+   * @param extraHeader extra header data
+   */
+  DataLog(std::string_view filename, uint64_t ringSize, double period = 0.25,
+          std::string_view extraHeader = "");
+
+  /**
+   * Construct a new Data Log in "flight recorder" mode.  See the constructor
+   * above for details.
+   *
+   * @param msglog message logger (will be called from separate thread)
+   * @param filename ring filename; the file is created (or overwritten)
+   * @param ringSize size of the ring file, in bytes
+   * @param period time between automatic flushes to the ring, in seconds
+   * @param extraHeader extra header data
+   */
+  DataLog(wpi::Logger& msglog, std::string_view filename, uint64_t ringSize,
+          double period = 0.25, std::string_view extraHeader = "");
 
   ~DataLog();
   DataLog(const DataLog&) = delete;
@@ -138,6 +199,38 @@ class DataLog final {
    */
   void SetFilename(std::string_view filename);
 
+  /**
+   * Enables rotation of the log file into segments.  When the current segment
+   * would grow past maxSize, or has been open for maxTime, it is closed and a
+   * new segment is started.  Each segment is a complete log that begins with
+   * start records (with current metadata) for all active entries, so it can be
+   * read on its own.  Segments after the first are named by adding "_1", "_2",
+   * etc. to the log filename.  Changing the filename renames the current
+   * segment and numbers later segments from the new name; segments already
+   * written keep their names and still count toward maxTotalSize.  Rotation
+   * happens on the writer thread, at flush time; it has no effect on logs that
+   * pass their output to a function or are in flight recorder mode.
+   *
+   * @param maxSize maximum segment size, in bytes; 0 for no limit
+   * @param maxTime maximum segment duration, in seconds; 0 for no limit
+   * @param maxTotalSize if non-zero, the oldest segments are deleted to keep
+   *                     the total size of all segments below this, in bytes
+   */
+  void SetRotation(uint64_t maxSize, double maxTime = 0,
+                   uint64_t maxTotalSize = 0);
+
+  /**
+   * Saves the current contents of the flight recorder ring as a standard
+   * (version 1.0) log file, with start records for all entries that have data
+   * in the ring.  Pending data is written to the ring first, and the ring is
+   * not modified while it is saved.  The save happens on the writer thread;
+   * this function does not wait for it.  Has no effect if the log is not in
+   * flight recorder mode.
+   *
+   * @param filename filename of the log to write
+   */
+  void Dump(std::string_view filename);
+
   /**
    * Explicitly flushes the log data to disk.
    */
@@ -230,30 +323,72 @@ class DataLog final {
   void AppendStringArray(int entry, std::span<const std::string_view> arr,
                          int64_t timestamp);
 
+  /**
+   * Appends a batch of records to the log, one per value.  This is faster
+   * than appending each record separately, as the records are reserved and
+   * encoded together.  The timestamps and values must be the same size; any
+   * extra elements of the longer one are ignored.
+   *
+   * @param entry Entry index, as returned by Start()
+   * @param timestamps Time stamps, one per value (0 to indicate now)
+   * @param values Values to record
+   */
+  void AppendBatch(int entry, std::span<const int64_t> timestamps,
+                   std::span<const bool> values);
+  void AppendBatch(int entry, std::span<const int64_t> timestamps,
+                   std::span<const int64_t> values);
+  void AppendBatch(int entry, std::span<const int64_t> timestamps,
+                   std::span<const float> values);
+  void AppendBatch(int entry, std::span<const int64_t> timestamps,
+                   std::span<const double> values);
+
  private:
   void WriterThreadMain(std::string_view dir);
   void WriterThreadMain(
       std::function<void(std::span<const uint8_t> data)> write);
+  void RingWriterThreadMain(std::string_view filename, uint64_t ringSize);
+
+  class Buffer;
+  struct ThreadBuffer;
+
+  // returns the calling thread's state, with its buffer taken for appending;
+  // call Release() when done
+  ThreadBuffer& AcquireThreadBuffer();
+  uint8_t* Reserve(ThreadBuffer& tb, size_t size);
+  uint8_t* StartRecord(ThreadBuffer& tb, uint32_t entry, uint64_t timestamp,
+                       uint32_t payloadSize);
+  void PushPending(Buffer* buf);
+  template <typename T, typename F>
+  void AppendBatchImpl(int entry, std::span<const int64_t> timestamps,
+                       std::span<const T> values, uint32_t payloadSize,
+                       F&& encode);
 
   // must be called with m_mutex held
-  uint8_t* StartRecord(uint32_t entry, uint64_t timestamp, uint32_t payloadSize,
-                       size_t reserveSize);
-  uint8_t* Reserve(size_t size);
-  void AppendImpl(std::span<const uint8_t> data);
-  void AppendStringImpl(std::string_view str);
+  uint8_t* StartControlRecord(uint64_t timestamp, uint32_t payloadSize);
+  void StealThreadBuffers();
+  Buffer* TakePending();
+  void ReleaseBuffers(Buffer* bufs);
 
   wpi::Logger& m_msglog;
   mutable wpi::mutex m_mutex;
   wpi::condition_variable m_cond;
   bool m_active{true};
   bool m_doFlush{false};
-  bool m_paused{false};
+  std::atomic_bool m_paused{false};
   double m_period;
   std::string m_extraHeader;
+  bool m_compress;
   std::string m_newFilename;
-  class Buffer;
-  std::vector<Buffer> m_free;
-  std::vector<Buffer> m_outgoing;
+  uint64_t m_maxSegmentSize{0};
+  double m_maxSegmentTime{0};
+  uint64_t m_maxTotalSize{0};
+  std::string m_dumpFilename;
+  uint64_t m_id;
+  // buffers ready to write (lock-free stack, newest first)
+  std::atomic<Buffer*> m_pending{nullptr};
+  // empty buffers returned by the writer thread (lock-free stack)
+  std::atomic<Buffer*> m_free{nullptr};
+  std::vector<std::shared_ptr<ThreadBuffer>> m_threadBuffers;
   struct EntryInfo {
     std::string type;
     int id{0};
@@ -366,6 +501,17 @@ class BooleanLogEntry : public DataLogEntry {
   void Append(bool value, int64_t timestamp = 0) {
     m_log->AppendBoolean(m_entry, value, timestamp);
   }
+
+  /**
+   * Appends a batch of records to the log, one per value.
+   *
+   * @param timestamps Time stamps, one per value (0 to indicate now)
+   * @param values Values to record
+   */
+  void AppendBatch(std::span<const int64_t> timestamps,
+                   std::span<const bool> values) {
+    m_log->AppendBatch(m_entry, timestamps, values);
+  }
 };
 
 /**
@@ -391,6 +537,17 @@ class IntegerLogEntry : public DataLogEntry {
   void Append(int64_t value, int64_t timestamp = 0) {
     m_log->AppendInteger(m_entry, value, timestamp);
   }
+
+  /**
+   * Appends a batch of records to the log, one per value.
+   *
+   * @param timestamps Time stamps, one per value (0 to indicate now)
+   * @param values Values to record
+   */
+  void AppendBatch(std::span<const int64_t> timestamps,
+                   std::span<const int64_t> values) {
+    m_log->AppendBatch(m_entry, timestamps, values);
+  }
 };
 
 /**
@@ -416,6 +573,17 @@ class FloatLogEntry : public DataLogEntry {
   void Append(float value, int64_t timestamp = 0) {
     m_log->AppendFloat(m_entry, value, timestamp);
   }
+
+  /**
+   * Appends a batch of records to the log, one per value.
+   *
+   * @param timestamps Time stamps, one per value (0 to indicate now)
+   * @param values Values to record
+   */
+  void AppendBatch(std::span<const int64_t> timestamps,
+                   std::span<const float> values) {
+    m_log->AppendBatch(m_entry, timestamps, values);
+  }
 };
 
 /**
@@ -441,6 +609,17 @@ class DoubleLogEntry : public DataLogEntry {
   void Append(double value, int64_t timestamp = 0) {
     m_log->AppendDouble(m_entry, value, timestamp);
   }
+
+  /**
+   * Appends a batch of records to the log, one per value.
+   *
+   * @param timestamps Time stamps, one per value (0 to indicate now)
+   * @param values Values to record
+   */
+  void AppendBatch(std::span<const int64_t> timestamps,
+                   std::span<const double> values) {
+    m_log->AppendBatch(m_entry, timestamps, values);
+  }
 };
 
 /**
@@ -6,12 +6,22 @@
 
 #include <stdint.h>
 
+#include <bit>
+#include <compare>
+#include <cstddef>
 #include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <span>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "wpi/DenseMap.h"
+#include "wpi/Endian.h"
+#include "wpi/MathExtras.h"
 #include "wpi/MemoryBuffer.h"
 
 namespace wpi::log {
@@ -47,6 +57,189 @@ struct MetadataRecordData {
   std::string_view metadata;
 };
 
+/**
+ * A view of a little-endian int64_t, float, or double array in a data record,
+ * as returned by DataLogRecord::GetIntegerArray() etc. The record data is not
+ * copied, and need not be aligned; elements are decoded as they are accessed.
+ * When the host is little-endian and the data happens to be aligned,
+ * GetSpan() provides direct access to the elements.
+ */
+template <typename T>
+class DataLogArrayView {
+ public:
+  /** Random access iterator; dereferences to element values. */
+  class iterator {
+   public:
+    using iterator_concept = std::random_access_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = T;
+
+    iterator() = default;
+    explicit iterator(const uint8_t* pos) : m_pos{pos} {}
+
+    T operator*() const { return Decode(m_pos); }
+    T operator[](difference_type n) const { return *(*this + n); }
+
+    iterator& operator++() {
+      m_pos += sizeof(T);
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator tmp = *this;
+      ++*this;
+      return tmp;
+    }
+    iterator& operator--() {
+      m_pos -= sizeof(T);
+      return *this;
+    }
+    iterator operator--(int) {
+      iterator tmp = *this;
+      --*this;
+      return tmp;
+    }
+    iterator& operator+=(difference_type n) {
+      m_pos += n * static_cast<difference_type>(sizeof(T));
+      return *this;
+    }
+    iterator& operator-=(difference_type n) { return *this += -n; }
+
+    friend iterator operator+(iterator it, difference_type n) {
+      return it += n;
+    }
+    friend iterator operator+(difference_type n, iterator it) {
+      return it += n;
+    }
+    friend iterator operator-(iterator it, difference_type n) {
+      return it -= n;
+    }
+    friend difference_type operator-(const iterator& a, const iterator& b) {
+      return (a.m_pos - b.m_pos) / static_cast<difference_type>(sizeof(T));
+    }
+
+    bool operator==(const iterator&) const = default;
+    auto operator<=>(const iterator&) const = default;
+
+   private:
+    const uint8_t* m_pos = nullptr;
+  };
+
+  DataLogArrayView() = default;
+
+  /**
+   * Constructs a view of raw record data.
+   *
+   * @param data data; size must be a multiple of sizeof(T)
+   */
+  explicit DataLogArrayView(std::span<const uint8_t> data) : m_data{data} {}
+
+  iterator begin() const { return iterator{m_data.data()}; }
+  iterator end() const { return iterator{m_data.data() + m_data.size()}; }
+
+  size_t size() const { return m_data.size() / sizeof(T); }
+  bool empty() const { return m_data.empty(); }
+
+  T operator[](size_t i) const { return Decode(&m_data[i * sizeof(T)]); }
+
+  /**
+   * Gets the elements as a span without decoding them. This is only possible
+   * on little-endian hosts, and only if the data is aligned for T.
+   *
+   * @param[out] span elements (if successful)
+   * @return True on success, false if elements must be accessed individually
+   */
+  bool GetSpan(std::span<const T>* span) const {
+    if constexpr (std::endian::native != std::endian::little) {
+      return false;
+    }
+    if (reinterpret_cast<uintptr_t>(m_data.data()) % alignof(T) != 0) {
+      return false;
+    }
+    *span = {reinterpret_cast<const T*>(m_data.data()), size()};
+    return true;
+  }
+
+ private:
+  static T Decode(const uint8_t* data) {
+    if constexpr (std::is_same_v<T, float>) {
+      return wpi::BitsToFloat(wpi::support::endian::read32le(data));
+    } else if constexpr (std::is_same_v<T, double>) {
+      return wpi::BitsToDouble(wpi::support::endian::read64le(data));
+    } else {
+      return wpi::support::endian::read64le(data);
+    }
+  }
+
+  std::span<const uint8_t> m_data;
+};
+
+/**
+ * A view of a string array in a data record, as returned by
+ * DataLogRecord::GetStringArray(). The strings refer to the record data; no
+ * copies are made.
+ */
+class DataLogStringArrayView {
+ public:
+  /** Forward iterator; dereferences to std::string_view. */
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::string_view;
+
+    iterator() = default;
+    explicit iterator(const uint8_t* pos) : m_pos{pos} {}
+
+    std::string_view operator*() const {
+      return {reinterpret_cast<const char*>(m_pos + 4), GetLength()};
+    }
+
+    iterator& operator++() {
+      m_pos += 4 + GetLength();
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    bool operator==(const iterator&) const = default;
+
+   private:
+    size_t GetLength() const { return wpi::support::endian::read32le(m_pos); }
+
+    const uint8_t* m_pos = nullptr;
+  };
+
+  DataLogStringArrayView() = default;
+
+  /**
+   * Constructs a view of string array data. The data must have been validated
+   * (see DataLogRecord::GetStringArray()).
+   *
+   * @param data string data, after the array size
+   * @param size number of strings
+   */
+  DataLogStringArrayView(std::span<const uint8_t> data, size_t size)
+      : m_data{data}, m_size{size} {}
+
+  iterator begin() const { return iterator{m_data.data()}; }
+  iterator end() const { return iterator{m_data.data() + m_data.size()}; }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+ private:
+  std::span<const uint8_t> m_data;
+  size_t m_size = 0;
+};
+
 /**
  * A record in the data log. May represent either a control record (entry == 0)
  * or a data record. Used only for reading (e.g. with DataLogReader).
@@ -209,6 +402,23 @@ class DataLogRecord {
    */
   bool GetIntegerArray(std::vector<int64_t>* arr) const;
 
+  /**
+   * Decodes a data record as an integer array into a caller-provided buffer,
+   * without allocating.
+   *
+   * @param[out] arr integer array; must have exactly GetSize() / 8 elements
+   * @return True on success, false on error
+   */
+  bool GetIntegerArray(std::span<int64_t> arr) const;
+
+  /**
+   * Decodes a data record as an integer array, without copying.
+   *
+   * @param[out] arr integer array view (if successful)
+   * @return True on success, false on error
+   */
+  bool GetIntegerArray(DataLogArrayView<int64_t>* arr) const;
+
   /**
    * Decodes a data record as a float array. Note if the data type (as
    * indicated in the corresponding start control record for this entry) is not
@@ -219,6 +429,23 @@ class DataLogRecord {
    */
   bool GetFloatArray(std::vector<float>* arr) const;
 
+  /**
+   * Decodes a data record as a float array into a caller-provided buffer,
+   * without allocating.
+   *
+   * @param[out] arr float array; must have exactly GetSize() / 4 elements
+   * @return True on success, false on error
+   */
+  bool GetFloatArray(std::span<float> arr) const;
+
+  /**
+   * Decodes a data record as a float array, without copying.
+   *
+   * @param[out] arr float array view (if successful)
+   * @return True on success, false on error
+   */
+  bool GetFloatArray(DataLogArrayView<float>* arr) const;
+
   /**
    * Decodes a data record as a double array. Note if the data type (as
    * indicated in the corresponding start control record for this entry) is not
@@ -229,6 +456,23 @@ class DataLogRecord {
    */
   bool GetDoubleArray(std::vector<double>* arr) const;
 
+  /**
+   * Decodes a data record as a double array into a caller-provided buffer,
+   * without allocating.
+   *
+   * @param[out] arr double array; must have exactly GetSize() / 8 elements
+   * @return True on success, false on error
+   */
+  bool GetDoubleArray(std::span<double> arr) const;
+
+  /**
+   * Decodes a data record as a double array, without copying.
+   *
+   * @param[out] arr double array view (if successful)
+   * @return True on success, false on error
+   */
+  bool GetDoubleArray(DataLogArrayView<double>* arr) const;
+
   /**
    * Decodes a data record as a string array. Note if the data type (as
    * indicated in the corresponding start control record for this entry) is not
@@ -239,12 +483,50 @@ class DataLogRecord {
    */
   bool GetStringArray(std::vector<std::string_view>* arr) const;
 
+  /**
+   * Decodes a data record as a string array, without building a vector. The
+   * record is validated up front, so iterating the view cannot fail.
+   *
+   * @param[out] arr string array view (if successful)
+   * @return True on success, false on error
+   */
+  bool GetStringArray(DataLogStringArrayView* arr) const;
+
  private:
   int64_t m_timestamp{0};
   std::span<const uint8_t> m_data;
   int m_entry{-1};
 };
 
+/**
+ * The data records of a single entry, decoded into contiguous arrays by
+ * DataLogReader::DecodeColumns().  Record i has timestamp timestamps[i] and
+ * values [offsets[i], offsets[i + 1]) in the value array for the entry type:
+ * - "boolean", "boolean[]", "int64", "int64[]": integers
+ * - "float", "float[]": floats
+ * - "double", "double[]": doubles
+ * - "string", "string[]": strings
+ * - any other type: strings (the raw data of each record)
+ *
+ * Strings refer to the reader's buffer.  Records that fail to decode are
+ * skipped.
+ */
+struct DataLogColumn {
+  /** Entry ID. */
+  int entry = 0;
+
+  /** Entry name and type, from the start record. */
+  std::string_view name;
+  std::string_view type;
+
+  std::vector<int64_t> timestamps;
+  std::vector<size_t> offsets{0};
+  std::vector<int64_t> integers;
+  std::vector<float> floats;
+  std::vector<double> doubles;
+  std::vector<std::string_view> strings;
+};
+
 class DataLogReader;
 
 /** DataLogReader iterator. */
@@ -295,14 +577,92 @@ class DataLogIterator {
   mutable DataLogRecord m_value;
 };
 
+/** DataLogReader iterator over the indexed records of a single entry. */
+class DataLogEntryIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = DataLogRecord;
+  using pointer = const value_type*;
+  using reference = const value_type&;
+
+  DataLogEntryIterator(const DataLogReader* reader, const size_t* pos)
+      : m_reader{reader}, m_pos{pos} {}
+
+  bool operator==(const DataLogEntryIterator& oth) const {
+    return m_pos == oth.m_pos;
+  }
+  bool operator!=(const DataLogEntryIterator& oth) const {
+    return !this->operator==(oth);
+  }
+
+  DataLogEntryIterator& operator++() {
+    ++m_pos;
+    m_valid = false;
+    return *this;
+  }
+
+  DataLogEntryIterator operator++(int) {
+    DataLogEntryIterator tmp = *this;
+    ++*this;
+    return tmp;
+  }
+
+  reference operator*() const;
+
+  pointer operator->() const { return &this->operator*(); }
+
+ private:
+  const DataLogReader* m_reader;
+  const size_t* m_pos;
+  mutable bool m_valid = false;
+  mutable DataLogRecord m_value;
+};
+
+/**
+ * Range of indexed records of a single entry, as returned by
+ * DataLogReader::GetEntryRecords().
+ */
+class DataLogEntryRange {
+ public:
+  DataLogEntryRange(const DataLogReader* reader, std::span<const size_t> pos)
+      : m_reader{reader}, m_pos{pos} {}
+
+  DataLogEntryIterator begin() const {
+    return DataLogEntryIterator{m_reader, m_pos.data()};
+  }
+  DataLogEntryIterator end() const {
+    return DataLogEntryIterator{m_reader, m_pos.data() + m_pos.size()};
+  }
+
+  /** Returns the number of records. */
+  size_t size() const { return m_pos.size(); }
+
+  /** Returns true if there are no records. */
+  bool empty() const { return m_pos.empty(); }
+
+  /** Returns the positions of the records in the log. */
+  std::span<const size_t> GetPositions() const { return m_pos; }
+
+ private:
+  const DataLogReader* m_reader;
+  std::span<const size_t> m_pos;
+};
+
 /** Data log reader (reads logs written by the DataLog class). */
 class DataLogReader {
   friend class DataLogIterator;
+  friend class DataLogEntryIterator;
 
  public:
   using iterator = DataLogIterator;
 
-  /** Constructs from a memory buffer. */
+  /**
+   * Constructs from a memory buffer.  Compressed (version 2.0) logs are
+   * decompressed into memory up front, so record positions and iteration
+   * behave the same as for uncompressed logs.  Likewise, flight recorder ring
+   * files (see DataLog) are converted to a version 1.0 log, oldest data first.
+   * Logs with a version newer than 2.0 are not valid.
+   */
   explicit DataLogReader(std::unique_ptr<MemoryBuffer> buffer);
 
   /** Returns true if the data log is valid (e.g. has a valid header). */
@@ -341,8 +701,87 @@ class DataLogReader {
   /** Returns end iterator. */
   iterator end() const { return DataLogIterator{this, SIZE_MAX}; }
 
+  /**
+   * Gets the data records of an entry with timestamps in the range
+   * [start, end), in timestamp order (records with equal timestamps are in
+   * log order).
+   *
+   * The first call to this or GetEntryTimestampRange() builds an index of
+   * the whole log with a single pass over the record headers; later calls
+   * are a binary search.  This is safe to call from multiple threads.
+   *
+   * If the entry ID was finished and then reused by a later start record
+   * (possibly with a different type), the records of every use are included.
+   *
+   * @param entry entry ID
+   * @param start first timestamp (inclusive)
+   * @param end last timestamp (exclusive)
+   * @return Range of records
+   */
+  DataLogEntryRange GetEntryRecords(
+      int entry, int64_t start = std::numeric_limits<int64_t>::min(),
+      int64_t end = std::numeric_limits<int64_t>::max()) const;
+
+  /**
+   * Gets the range of timestamps of the data records of an entry.  See
+   * GetEntryRecords() for how the index is built.
+   *
+   * @param entry entry ID
+   * @param first first timestamp (output)
+   * @param last last timestamp (output)
+   * @return False if there are no data records for the entry
+   */
+  bool GetEntryTimestampRange(int entry, int64_t* first, int64_t* last) const;
+
+  /**
+   * Decodes the data records of all entries into columns, splitting the work
+   * across multiple threads.  Builds the index (see GetEntryRecords()) if
+   * needed.  Within each column, records are in timestamp order.
+   *
+   * Each start record begins a new column, so an entry ID that is finished
+   * and reused has a column for each use, each decoded with its own type.
+   *
+   * @param threads number of decoding threads; 0 to use the number of
+   *                hardware threads
+   * @return Columns, sorted by entry ID, then in log order
+   */
+  std::vector<DataLogColumn> DecodeColumns(unsigned int threads = 0) const;
+
  private:
+  // data records of one use of an entry ID (from a start record up to the
+  // next start record for the same ID), sorted by timestamp
+  struct EntryIndex {
+    std::string_view name;
+    std::string_view type;
+    std::vector<int64_t> timestamps;
+    std::vector<size_t> positions;
+  };
+
+  struct IdIndex {
+    std::vector<EntryIndex> uses;  // in log order; never empty
+    EntryIndex merged;             // all uses; only filled if more than one
+
+    const EntryIndex& GetAll() const {
+      return uses.size() == 1 ? uses.front() : merged;
+    }
+  };
+
+  struct Index {
+    std::once_flag built;
+    DenseMap<int, IdIndex> ids;
+  };
+
+  void DecodeColumnRecords(const EntryIndex& index, size_t first, size_t last,
+                           DataLogColumn* out) const;
+
+  DenseMap<int, IdIndex> BuildIndex() const;
+  const DenseMap<int, IdIndex>& GetIndex() const;
+  const EntryIndex* GetEntryIndex(int entry) const;
+  size_t GetStartPos() const;
+
   std::unique_ptr<MemoryBuffer> m_buf;
+  // built on first use; separately allocated to keep the reader movable
+  std::unique_ptr<Index> m_index = std::make_unique<Index>();
 
   bool GetRecord(size_t* pos, DataLogRecord* out) const;
   bool GetNextRecord(size_t* pos) const;
@@ -366,4 +805,15 @@ inline DataLogIterator::reference DataLogIterator::operator*() const {
   return m_value;
 }
 
+inline DataLogEntryIterator::reference DataLogEntryIterator::operator*()
+    const {
+  if (!m_valid) {
+    size_t pos = *m_pos;
+    if (m_reader->GetRecord(&pos, &m_value)) {
+      m_valid = true;
+    }
+  }
+  return m_value;
+}
+
 }  // namespace wpi::log
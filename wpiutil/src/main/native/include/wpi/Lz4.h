@@ -0,0 +1,45 @@
+// Copyright (c) FIRST and other WPILib contributors.
+// Open Source Software; you can modify and/or share it under the terms of
+// the WPILib BSD license file in the root directory of this project.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <span>
+
+namespace wpi {
+
+/**
+ * Gets the maximum compressed size of a block of data.
+ *
+ * @param size uncompressed size
+ * @return Maximum compressed size
+ */
+constexpr size_t Lz4CompressBound(size_t size) {
+  return size + size / 255 + 16;
+}
+
+/**
+ * Compresses a block of data using the LZ4 block format.  This is a simple,
+ * fast compressor intended for streaming use; the output can be decompressed
+ * by any LZ4 block decoder.
+ *
+ * @param in data to compress
+ * @param out output buffer; should be at least Lz4CompressBound(in.size())
+ * @return Compressed size, or 0 if the output buffer is too small
+ */
+size_t Lz4Compress(std::span<const uint8_t> in, std::span<uint8_t> out);
+
+/**
+ * Decompresses a block of data in the LZ4 block format.
+ *
+ * @param in compressed data
+ * @param out output buffer; must be exactly the uncompressed size
+ * @return False if the compressed data is corrupt or doesn't decompress to
+ *         exactly the output size
+ */
+bool Lz4Decompress(std::span<const uint8_t> in, std::span<uint8_t> out);
+
+}  // namespace wpi
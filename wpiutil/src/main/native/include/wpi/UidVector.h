@@ -5,7 +5,11 @@
 #ifndef WPIUTIL_WPI_UIDVECTOR_H_
 #define WPIUTIL_WPI_UIDVECTOR_H_
 
+#include <stdint.h>
+
+#include <bit>
 #include <iterator>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -20,23 +24,25 @@ class UidVectorIterator {
   using difference_type = typename It::difference_type;
   using reference = typename It::reference;
   using pointer = typename It::pointer;
+  using size_type = std::make_unsigned_t<difference_type>;
 
   UidVectorIterator() = default;
-  explicit UidVectorIterator(It it, It end) : m_it(it), m_end(end) {
+  UidVectorIterator(It begin, size_type index, size_type size,
+                    const uint64_t* used)
+      : m_begin(begin), m_index(index), m_size(size), m_used(used) {
     // advance to first non-empty element
-    while (m_it != m_end && !*m_it) {
-      ++m_it;
-    }
+    SkipEmpty();
   }
 
-  reference operator*() const noexcept { return *m_it; }
-  pointer operator->() const noexcept { return m_it.operator->(); }
+  reference operator*() const noexcept { return m_begin[m_index]; }
+  pointer operator->() const noexcept {
+    return (m_begin + m_index).operator->();
+  }
 
   UidVectorIterator& operator++() noexcept {
     // advance past empty elements
-    do {
-      ++m_it;
-    } while (m_it != m_end && !*m_it);
+    ++m_index;
+    SkipEmpty();
     return *this;
   }
 
@@ -47,16 +53,38 @@ class UidVectorIterator {
   }
 
   bool operator==(const UidVectorIterator& oth) const noexcept {
-    return m_it == oth.m_it;
+    return m_index == oth.m_index;
   }
 
   bool operator!=(const UidVectorIterator& oth) const noexcept {
-    return m_it != oth.m_it;
+    return m_index != oth.m_index;
   }
 
  private:
-  It m_it;
-  It m_end;
+  // Skips unused slots a word of the bitmap at a time, so long runs of erased
+  // elements are cheap to step over.
+  void SkipEmpty() noexcept {
+    while (m_index < m_size) {
+      uint64_t word = m_used[m_index / 64] >> (m_index % 64);
+      if (word == 0) {
+        m_index = (m_index / 64 + 1) * 64;
+        continue;
+      }
+      m_index += std::countr_zero(word);
+      if (m_index >= m_size || m_begin[m_index]) {
+        break;
+      }
+      ++m_index;
+    }
+    if (m_index > m_size) {
+      m_index = m_size;
+    }
+  }
+
+  It m_begin;
+  size_type m_index = 0;
+  size_type m_size = 0;
+  const uint64_t* m_used = nullptr;
 };
 }  // namespace impl
 
@@ -64,6 +92,10 @@ class UidVectorIterator {
  * Vector which provides an integrated freelist for removal and reuse of
  * individual elements.
  *
+ * Freed elements are reused in the order they were freed.  Iteration skips
+ * over freed elements using a bitmap of used slots, so its cost depends
+ * mostly on the number of elements in use rather than the historical maximum.
+ *
  * @tparam T element type; must be default-constructible and evaluate in
  *           boolean context to false when "empty"
  * @tparam reuse_threshold how many free elements to store up before starting
@@ -88,20 +120,28 @@ class UidVector {
   T& operator[](size_type i) { return m_vector[i]; }
   const T& operator[](size_type i) const { return m_vector[i]; }
 
-  // Add a new T to the vector.  If there are elements on the freelist,
-  // reuses the last one; otherwise adds to the end of the vector.
+  // Add a new T to the vector.  If enough elements are on the freelist,
+  // reuses the one freed longest ago; otherwise adds to the end of the vector.
   // Returns the resulting element index.
   template <class... Args>
   size_type emplace_back(Args&&... args) {
     size_type uid;
-    if (m_free.size() < reuse_threshold) {
+    if (m_free.size() - m_free_head < reuse_threshold) {
       uid = m_vector.size();
       m_vector.emplace_back(std::forward<Args>(args)...);
+      if (uid / 64 >= m_used.size()) {
+        m_used.emplace_back(0);
+      }
     } else {
-      uid = m_free.front();
-      m_free.erase(m_free.begin());
+      uid = m_free[m_free_head++];
+      // drop the consumed part of the freelist once it's half the size
+      if (m_free_head * 2 >= m_free.size()) {
+        m_free.erase(m_free.begin(), m_free.begin() + m_free_head);
+        m_free_head = 0;
+      }
       m_vector[uid] = T(std::forward<Args>(args)...);
     }
+    m_used[uid / 64] |= uint64_t{1} << (uid % 64);
     ++m_active_count;
     return uid;
   }
@@ -115,6 +155,7 @@ class UidVector {
       return T();
     }
     m_free.push_back(uid);
+    m_used[uid / 64] &= ~(uint64_t{1} << (uid % 64));
     auto rv = std::move(m_vector[uid]);
     m_vector[uid] = T();
     --m_active_count;
@@ -126,31 +167,37 @@ class UidVector {
    */
   void clear() noexcept {
     m_vector.clear();
+    m_used.clear();
     m_free.clear();
+    m_free_head = 0;
     m_active_count = 0;
   }
 
   // Iterator access
   iterator begin() noexcept {
-    return iterator(m_vector.begin(), m_vector.end());
+    return iterator(m_vector.begin(), 0, m_vector.size(), m_used.data());
   }
   const_iterator begin() const noexcept {
-    return const_iterator(m_vector.begin(), m_vector.end());
+    return const_iterator(m_vector.begin(), 0, m_vector.size(), m_used.data());
   }
-  const_iterator cbegin() const noexcept {
-    return const_iterator(m_vector.begin(), m_vector.end());
+  const_iterator cbegin() const noexcept { return begin(); }
+  iterator end() noexcept {
+    return iterator(m_vector.begin(), m_vector.size(), m_vector.size(),
+                    m_used.data());
   }
-  iterator end() noexcept { return iterator(m_vector.end(), m_vector.end()); }
   const_iterator end() const noexcept {
-    return const_iterator(m_vector.end(), m_vector.end());
-  }
-  const_iterator cend() const noexcept {
-    return const_iterator(m_vector.end(), m_vector.end());
+    return const_iterator(m_vector.begin(), m_vector.size(), m_vector.size(),
+                          m_used.data());
   }
+  const_iterator cend() const noexcept { return end(); }
 
  private:
   std::vector<T> m_vector;
+  // bit set for each element that has been added and not erased
+  std::vector<uint64_t> m_used;
+  // elements before m_free_head have already been reused
   std::vector<size_type> m_free;
+  size_type m_free_head{0};
   size_type m_active_count{0};
 };
 
@@ -453,6 +453,36 @@ class json::parser
         return not strict or (get_token() == token_type::end_of_input);
     }
 
+    /*!
+    @brief public SAX interface
+
+    @param[in,out] sax  SAX event listener
+    @param[in] strict  whether to expect the last token to be EOF
+    @return false if the listener stopped the parse
+
+    @throw parse_error.101 in case of an unexpected token
+    @throw parse_error.102 if to_unicode fails or surrogate error
+    @throw parse_error.103 if to_unicode fails
+    */
+    bool sax_parse(json_sax* sax, const bool strict = true)
+    {
+        // read first token
+        get_token();
+
+        if (not sax_parse_internal(sax))
+        {
+            return false;
+        }
+
+        // strict => last token must be EOF
+        if (strict)
+        {
+            get_token();
+            return expect(token_type::end_of_input);
+        }
+        return true;
+    }
+
   private:
     /*!
     @brief the actual parser
@@ -474,6 +504,13 @@ class json::parser
     */
     bool accept_internal();
 
+    /*!
+    @brief the actual SAX parser
+
+    Follows the same invariants as @ref accept_internal.
+    */
+    bool sax_parse_internal(json_sax* sax);
+
     /// get next token from lexer
     token_type get_token()
     {
@@ -1896,6 +1933,162 @@ bool json::parser::accept_internal()
     }
 }
 
+bool json::parser::sax_parse_internal(json_sax* sax)
+{
+    switch (last_token)
+    {
+        case token_type::begin_object:
+        {
+            if (not sax->start_object())
+            {
+                return false;
+            }
+
+            // read next token
+            get_token();
+
+            // closing } -> we are done
+            if (last_token == token_type::end_object)
+            {
+                return sax->end_object();
+            }
+
+            // parse values
+            while (true)
+            {
+                // parse key
+                if (not expect(token_type::value_string))
+                {
+                    return false;
+                }
+                if (not sax->key(m_lexer.get_string()))
+                {
+                    return false;
+                }
+
+                // parse separator (:)
+                get_token();
+                if (not expect(token_type::name_separator))
+                {
+                    return false;
+                }
+
+                // parse value
+                get_token();
+                if (not sax_parse_internal(sax))
+                {
+                    return false;
+                }
+
+                // comma -> next value
+                get_token();
+                if (last_token == token_type::value_separator)
+                {
+                    get_token();
+                    continue;
+                }
+
+                // closing }
+                if (not expect(token_type::end_object))
+                {
+                    return false;
+                }
+                return sax->end_object();
+            }
+        }
+
+        case token_type::begin_array:
+        {
+            if (not sax->start_array())
+            {
+                return false;
+            }
+
+            // read next token
+            get_token();
+
+            // closing ] -> we are done
+            if (last_token == token_type::end_array)
+            {
+                return sax->end_array();
+            }
+
+            // parse values
+            while (true)
+            {
+                // parse value
+                if (not sax_parse_internal(sax))
+                {
+                    return false;
+                }
+
+                // comma -> next value
+                get_token();
+                if (last_token == token_type::value_separator)
+                {
+                    get_token();
+                    continue;
+                }
+
+                // closing ]
+                if (not expect(token_type::end_array))
+                {
+                    return false;
+                }
+                return sax->end_array();
+            }
+        }
+
+        case token_type::literal_null:
+            return sax->null();
+
+        case token_type::value_string:
+            return sax->string(m_lexer.get_string());
+
+        case token_type::literal_true:
+            return sax->boolean(true);
+
+        case token_type::literal_false:
+            return sax->boolean(false);
+
+        case token_type::value_unsigned:
+            return sax->number_unsigned(m_lexer.get_number_unsigned());
+
+        case token_type::value_integer:
+            return sax->number_integer(m_lexer.get_number_integer());
+
+        case token_type::value_float:
+        {
+            // throw in case of infinity or NAN
+            if (JSON_UNLIKELY(not std::isfinite(m_lexer.get_number_float())))
+            {
+                if (allow_exceptions)
+                {
+                    JSON_THROW(out_of_range::create(406,
+                        fmt::format("number overflow parsing '{}'", m_lexer.get_token_string())));
+                }
+                expect(token_type::uninitialized);
+                return false;
+            }
+            return sax->number_float(m_lexer.get_number_float());
+        }
+
+        case token_type::parse_error:
+        {
+            // using "uninitialized" to avoid "expected" message
+            expect(token_type::uninitialized);
+            return false;
+        }
+
+        default:
+        {
+            // the last token was unexpected; we expected a value
+            expect(token_type::literal_or_value);
+            return false;
+        }
+    }
+}
+
 void json::parser::throw_exception() const
 {
     std::string error_msg = "syntax error - ";
@@ -1942,6 +2135,24 @@ json json::parse(raw_istream& i,
     return result;
 }
 
+bool json::sax_parse(std::string_view s, json_sax* sax, const bool strict)
+{
+    raw_mem_istream is(std::span<const char>(s.data(), s.size()));
+    return parser(is).sax_parse(sax, strict);
+}
+
+bool json::sax_parse(std::span<const uint8_t> arr, json_sax* sax,
+                     const bool strict)
+{
+    raw_mem_istream is(arr);
+    return parser(is).sax_parse(sax, strict);
+}
+
+bool json::sax_parse(raw_istream& i, json_sax* sax, const bool strict)
+{
+    return parser(i).sax_parse(sax, strict);
+}
+
 bool json::accept(std::string_view s)
 {
     raw_mem_istream is(std::span<const char>(s.data(), s.size()));
@@ -3118,6 +3118,56 @@ class json
     using parser_callback_t =
         std::function<bool(int depth, parse_event_t event, json& parsed)>;
 
+    /*!
+    @brief SAX interface
+
+    This class describes the SAX interface used by @ref sax_parse. Each
+    function is called in different situations while the input is parsed. The
+    boolean return value informs the parser whether to continue processing the
+    input.
+
+    Unlike @ref parse, no JSON values are constructed; string values and
+    object keys passed to @ref string and @ref key are only valid for the
+    duration of the call.
+    */
+    struct json_sax
+    {
+        virtual ~json_sax() = default;
+
+        /// a null value was read
+        virtual bool null() = 0;
+
+        /// a boolean value was read
+        virtual bool boolean(bool val) = 0;
+
+        /// an integer number was read
+        virtual bool number_integer(int64_t val) = 0;
+
+        /// an unsigned integer number was read
+        virtual bool number_unsigned(uint64_t val) = 0;
+
+        /// a floating-point number was read
+        virtual bool number_float(double val) = 0;
+
+        /// a string was read
+        virtual bool string(std::string_view val) = 0;
+
+        /// the beginning of an object was read
+        virtual bool start_object() = 0;
+
+        /// an object key was read
+        virtual bool key(std::string_view val) = 0;
+
+        /// the end of an object was read
+        virtual bool end_object() = 0;
+
+        /// the beginning of an array was read
+        virtual bool start_array() = 0;
+
+        /// the end of an array was read
+        virtual bool end_array() = 0;
+    };
+
 
     //////////////////
     // constructors //
@@ -7031,6 +7081,33 @@ class json
 
     static bool accept(raw_istream& i);
 
+    /*!
+    @brief generate SAX events
+
+    Parses the input like @ref parse, but reports its contents to @a sax as
+    they are read instead of building a JSON value.  Events are generated up
+    to the point where a parse error is detected.
+
+    @param[in] s  input to read from
+    @param[in,out] sax  SAX event listener
+    @param[in] strict  whether the input has to be consumed completely
+
+    @return false if @a sax stopped the parse, true otherwise
+
+    @throw parse_error.101 if a parse error occurs
+    @throw parse_error.102 if to_unicode fails or surrogate error
+    @throw parse_error.103 if to_unicode fails
+    @throw out_of_range.406 if a parsed number is infinite or NaN
+    */
+    static bool sax_parse(std::string_view s, json_sax* sax,
+                          const bool strict = true);
+
+    static bool sax_parse(std::span<const uint8_t> arr, json_sax* sax,
+                          const bool strict = true);
+
+    static bool sax_parse(raw_istream& i, json_sax* sax,
+                          const bool strict = true);
+
     /*!
     @brief deserialize from stream
 
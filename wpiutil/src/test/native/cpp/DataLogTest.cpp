@@ -0,0 +1,875 @@
+// Copyright (c) FIRST and other WPILib contributors.
+// Open Source Software; you can modify and/or share it under the terms of
+// the WPILib BSD license file in the root directory of this project.
+
+#include "wpi/DataLog.h"  // NOLINT(build/include_order)
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "gtest/gtest.h"
+#include "wpi/DataLogReader.h"
+#include "wpi/Endian.h"
+#include "wpi/MathExtras.h"
+#include "wpi/MemoryBuffer.h"
+#include "wpi/StringExtras.h"
+#include "wpi/fs.h"
+
+namespace {
+
+class DataLogTest : public ::testing::Test {
+ public:
+  // destroys the log (flushing it) and returns a reader for the output
+  wpi::log::DataLogReader Finish() {
+    log.reset();
+    return wpi::log::DataLogReader{wpi::MemoryBuffer::GetMemBufferCopy(data)};
+  }
+
+  std::vector<uint8_t> data;
+  std::unique_ptr<wpi::log::DataLog> log =
+      std::make_unique<wpi::log::DataLog>(
+          [this](auto out) { data.insert(data.end(), out.begin(), out.end()); },
+          60.0);
+};
+
+}  // namespace
+
+TEST_F(DataLogTest, Simple) {
+  wpi::log::IntegerLogEntry entry{*log, "a", 1};
+  entry.Append(5, 2);
+  entry.Append(6, 3);
+
+  auto reader = Finish();
+  ASSERT_TRUE(reader.IsValid());
+  auto it = reader.begin();
+  ASSERT_NE(it, reader.end());
+  ASSERT_TRUE(it->IsStart());
+  wpi::log::StartRecordData start;
+  ASSERT_TRUE(it->GetStartData(&start));
+  EXPECT_EQ(start.name, "a");
+  EXPECT_EQ(start.type, "int64");
+  for (int64_t expected : {5, 6}) {
+    ++it;
+    ASSERT_NE(it, reader.end());
+    int64_t value;
+    ASSERT_TRUE(it->GetInteger(&value));
+    EXPECT_EQ(it->GetEntry(), start.entry);
+    EXPECT_EQ(value, expected);
+  }
+  ++it;
+  EXPECT_EQ(it, reader.end());
+}
+
+TEST_F(DataLogTest, LargeRecord) {
+  wpi::log::RawLogEntry entry{*log, "a", 1};
+  entry.Append(std::vector<uint8_t>(100, 1), 2);
+  std::vector<uint8_t> large(100000);
+  for (size_t i = 0; i < large.size(); ++i) {
+    large[i] = i & 0xff;
+  }
+  entry.Append(large, 3);
+  entry.Append(std::vector<uint8_t>(100, 2), 4);
+
+  auto reader = Finish();
+  std::vector<size_t> sizes;
+  for (auto&& record : reader) {
+    if (record.GetEntry() == 1) {
+      sizes.push_back(record.GetSize());
+      if (record.GetTimestamp() == 3) {
+        EXPECT_TRUE(std::equal(large.begin(), large.end(),
+                               record.GetRaw().begin(), record.GetRaw().end()));
+      }
+    }
+  }
+  EXPECT_EQ(sizes, (std::vector<size_t>{100, 100000, 100}));
+}
+
+TEST_F(DataLogTest, MultipleThreads) {
+  // each thread's records must be in order
+  static constexpr int kThreads = 4;
+  static constexpr int kValues = 5000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      wpi::log::IntegerLogEntry entry{*log, fmt::format("thread{}", t), 1};
+      for (int i = 0; i < kValues; ++i) {
+        entry.Append(i, 1);
+      }
+    });
+  }
+  for (auto&& thr : threads) {
+    thr.join();
+  }
+
+  auto reader = Finish();
+  std::vector<int> entryThread(kThreads + 1, -1);
+  std::vector<int64_t> next(kThreads, 0);
+  for (auto&& record : reader) {
+    if (record.IsStart()) {
+      wpi::log::StartRecordData start;
+      ASSERT_TRUE(record.GetStartData(&start));
+      ASSERT_GT(start.entry, 0);
+      ASSERT_LE(start.entry, kThreads);
+      entryThread[start.entry] = start.name.back() - '0';
+    } else if (!record.IsControl()) {
+      // data must follow the start record
+      int t = entryThread[record.GetEntry()];
+      ASSERT_NE(t, -1);
+      int64_t value;
+      ASSERT_TRUE(record.GetInteger(&value));
+      ASSERT_EQ(value, next[t]++);
+    }
+  }
+  for (auto count : next) {
+    EXPECT_EQ(count, kValues);
+  }
+}
+
+TEST_F(DataLogTest, FlushDuringAppend) {
+  // buffers taken by the writer mid-append must not lose or reorder records
+  static constexpr int kThreads = 2;
+  static constexpr int kValues = 20000;
+  wpi::log::StringLogEntry other{*log, "other", 1};
+  std::atomic_bool done{false};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      wpi::log::IntegerLogEntry entry{*log, fmt::format("thread{}", t), 1};
+      for (int i = 0; i < kValues; ++i) {
+        entry.Append(i, 2);
+      }
+    });
+  }
+  std::thread flusher{[&] {
+    for (int i = 0; !done; ++i) {
+      log->Flush();
+      other.SetMetadata(std::to_string(i), 2);
+    }
+  }};
+  for (auto&& thr : threads) {
+    thr.join();
+  }
+  done = true;
+  flusher.join();
+
+  auto reader = Finish();
+  std::map<int, int64_t> next;
+  for (auto&& record : reader) {
+    if (record.IsStart()) {
+      wpi::log::StartRecordData start;
+      ASSERT_TRUE(record.GetStartData(&start));
+      if (start.name != "other") {
+        next[start.entry] = 0;
+      }
+    } else if (!record.IsControl()) {
+      auto it = next.find(record.GetEntry());
+      ASSERT_TRUE(it != next.end());
+      int64_t value;
+      ASSERT_TRUE(record.GetInteger(&value));
+      ASSERT_EQ(value, it->second++);
+    }
+  }
+  ASSERT_EQ(next.size(), static_cast<size_t>(kThreads));
+  for (auto&& [entry, count] : next) {
+    EXPECT_EQ(count, kValues);
+  }
+}
+
+TEST_F(DataLogTest, FinishAfterAppend) {
+  // data appended on another thread must be written before the finish
+  wpi::log::DoubleLogEntry entry{*log, "a", 1};
+  std::thread{[&] {
+    entry.Append(1.0, 2);
+  }}.join();
+  entry.Finish(3);
+
+  auto reader = Finish();
+  std::vector<int64_t> timestamps;
+  for (auto&& record : reader) {
+    timestamps.push_back(record.GetTimestamp());
+  }
+  EXPECT_EQ(timestamps, (std::vector<int64_t>{1, 2, 3}));
+}
+
+TEST(DataLogFileTest, Write) {
+  auto dir = fs::temp_directory_path();
+  auto filename =
+      fmt::format("datalogtest_{}.wpilog", reinterpret_cast<uintptr_t>(&dir));
+  {
+    wpi::log::DataLog log{dir.string(), filename, 60.0, "extra"};
+    wpi::log::DoubleLogEntry entry{log, "a", 1};
+    for (int i = 0; i < 10000; ++i) {
+      entry.Append(i, i + 2);
+    }
+    log.Flush();
+    for (int i = 10000; i < 20000; ++i) {
+      entry.Append(i, i + 2);
+    }
+  }
+
+  auto path = dir / filename;
+  std::error_code ec;
+  wpi::log::DataLogReader reader{
+      wpi::MemoryBuffer::GetFile(path.string(), ec)};
+  ASSERT_FALSE(ec);
+  ASSERT_TRUE(reader.IsValid());
+  EXPECT_EQ(reader.GetExtraHeader(), "extra");
+  int count = 0;
+  for (auto&& record : reader) {
+    if (record.IsControl()) {
+      continue;
+    }
+    double value;
+    ASSERT_TRUE(record.GetDouble(&value));
+    ASSERT_EQ(value, count);
+    ASSERT_EQ(record.GetTimestamp(), count + 2);
+    ++count;
+  }
+  EXPECT_EQ(count, 20000);
+  fs::remove(path, ec);
+}
+
+TEST(DataLogCompressTest, RoundTrip) {
+  std::vector<uint8_t> data;
+  {
+    wpi::log::DataLog log{
+        [&](auto out) { data.insert(data.end(), out.begin(), out.end()); },
+        60.0, "extra", true};
+    wpi::log::DoubleArrayLogEntry entry{log, "a", 1};
+    std::vector<double> values(10, 0.0);
+    for (int i = 0; i < 5000; ++i) {
+      values[i % 10] = i;
+      entry.Append(values, i + 2);
+    }
+  }
+
+  wpi::log::DataLogReader reader{wpi::MemoryBuffer::GetMemBufferCopy(data)};
+  ASSERT_TRUE(reader.IsValid());
+  EXPECT_EQ(reader.GetVersion(), 0x0200);
+  EXPECT_EQ(reader.GetExtraHeader(), "extra");
+  int count = 0;
+  std::vector<double> values(10, 0.0);
+  for (auto&& record : reader) {
+    if (record.IsControl()) {
+      continue;
+    }
+    values[count % 10] = count;
+    std::vector<double> arr;
+    ASSERT_TRUE(record.GetDoubleArray(&arr));
+    ASSERT_EQ(arr, values);
+    ASSERT_EQ(record.GetTimestamp(), count + 2);
+    ++count;
+  }
+  EXPECT_EQ(count, 5000);
+  // 5000 records of 80 bytes each
+  EXPECT_LT(data.size(), 5000u * 80 / 2);
+}
+
+TEST(DataLogCompressTest, BadFrames) {
+  std::vector<uint8_t> data;
+  {
+    wpi::log::DataLog log{
+        [&](auto out) { data.insert(data.end(), out.begin(), out.end()); },
+        60.0, "", true};
+    wpi::log::IntegerLogEntry entry{log, "a", 1};
+    entry.Append(5, 2);
+  }
+  ASSERT_EQ(data[7], 2);
+
+  // a frame claiming more than its stored size could expand to is treated as
+  // corrupt, without allocating space for it
+  for (uint32_t frameSize : {4u * 256, 0xffffffffu}) {
+    auto bad = data;
+    bad.insert(bad.end(), 12, 0);
+    wpi::support::endian::write32le(&bad[data.size()], frameSize);
+    wpi::support::endian::write32le(&bad[data.size() + 4], 4);
+    wpi::log::DataLogReader reader{wpi::MemoryBuffer::GetMemBufferCopy(bad)};
+    ASSERT_TRUE(reader.IsValid());
+    int count = 0;
+    for (auto&& record : reader) {
+      int64_t value;
+      if (!record.IsControl() && record.GetInteger(&value)) {
+        EXPECT_EQ(value, 5);
+        ++count;
+      }
+    }
+    EXPECT_EQ(count, 1) << frameSize;
+  }
+
+  // unknown versions are rejected
+  data[6] = 1;
+  EXPECT_FALSE(
+      wpi::log::DataLogReader{wpi::MemoryBuffer::GetMemBufferCopy(data)});
+  data[6] = 0;
+  data[7] = 3;
+  EXPECT_FALSE(
+      wpi::log::DataLogReader{wpi::MemoryBuffer::GetMemBufferCopy(data)});
+}
+
+TEST_F(DataLogTest, EntryIndex) {
+  wpi::log::IntegerLogEntry a{*log, "a", 1};
+  wpi::log::IntegerLogEntry b{*log, "b", 1};
+  for (int i = 0; i < 100; ++i) {
+    a.Append(i, 10 + i);
+    b.Append(i * 2, 10 + i * 2);
+  }
+  // out of order timestamp
+  a.Append(1000, 15);
+
+  auto reader = Finish();
+
+  int64_t first, last;
+  ASSERT_TRUE(reader.GetEntryTimestampRange(1, &first, &last));
+  EXPECT_EQ(first, 10);
+  EXPECT_EQ(last, 109);
+  ASSERT_TRUE(reader.GetEntryTimestampRange(2, &first, &last));
+  EXPECT_EQ(first, 10);
+  EXPECT_EQ(last, 208);
+  EXPECT_FALSE(reader.GetEntryTimestampRange(3, &first, &last));
+
+  EXPECT_EQ(reader.GetEntryRecords(1).size(), 101u);
+  EXPECT_TRUE(reader.GetEntryRecords(3).empty());
+
+  // sorted by timestamp; equal timestamps in log order
+  std::vector<int64_t> values;
+  for (auto&& record : reader.GetEntryRecords(1, 14, 17)) {
+    EXPECT_EQ(record.GetEntry(), 1);
+    int64_t value;
+    ASSERT_TRUE(record.GetInteger(&value));
+    values.push_back(value);
+  }
+  EXPECT_EQ(values, (std::vector<int64_t>{4, 5, 1000, 6}));
+
+  values.clear();
+  for (auto&& record : reader.GetEntryRecords(2, 200)) {
+    int64_t value;
+    ASSERT_TRUE(record.GetInteger(&value));
+    values.push_back(value);
+  }
+  EXPECT_EQ(values, (std::vector<int64_t>{190, 192, 194, 196, 198}));
+}
+
+TEST_F(DataLogTest, DecodeColumns) {
+  wpi::log::DoubleLogEntry d{*log, "d", 1};
+  wpi::log::DoubleArrayLogEntry da{*log, "da", 1};
+  wpi::log::StringArrayLogEntry sa{*log, "sa", 1};
+  wpi::log::BooleanLogEntry b{*log, "b", 1};
+  wpi::log::IntegerLogEntry unused{*log, "unused", 1};
+  for (int i = 0; i < 100000; ++i) {
+    d.Append(i * 0.5, 10 + i);
+  }
+  da.Append({1, 2, 3}, 20);
+  da.Append({}, 10);
+  da.Append({4}, 30);
+  sa.Append({"x", "yz"}, 5);
+  b.Append(true, 5);
+  b.Append(false, 6);
+
+  auto reader = Finish();
+  auto columns = reader.DecodeColumns(3);
+  ASSERT_EQ(columns.size(), 4u);
+
+  auto& cd = columns[0];
+  EXPECT_EQ(cd.name, "d");
+  EXPECT_EQ(cd.type, "double");
+  ASSERT_EQ(cd.timestamps.size(), 100000u);
+  ASSERT_EQ(cd.doubles.size(), 100000u);
+  ASSERT_EQ(cd.offsets.size(), 100001u);
+  for (int i = 0; i < 100000; ++i) {
+    EXPECT_EQ(cd.timestamps[i], 10 + i);
+    EXPECT_EQ(cd.doubles[i], i * 0.5);
+    EXPECT_EQ(cd.offsets[i + 1], static_cast<size_t>(i + 1));
+  }
+
+  auto& cda = columns[1];
+  EXPECT_EQ(cda.type, "double[]");
+  EXPECT_EQ(cda.timestamps, (std::vector<int64_t>{10, 20, 30}));
+  EXPECT_EQ(cda.offsets, (std::vector<size_t>{0, 0, 3, 4}));
+  EXPECT_EQ(cda.doubles, (std::vector<double>{1, 2, 3, 4}));
+
+  auto& csa = columns[2];
+  EXPECT_EQ(csa.offsets, (std::vector<size_t>{0, 2}));
+  ASSERT_EQ(csa.strings.size(), 2u);
+  EXPECT_EQ(csa.strings[0], "x");
+  EXPECT_EQ(csa.strings[1], "yz");
+
+  auto& cb = columns[3];
+  EXPECT_EQ(cb.entry, 4);
+  EXPECT_EQ(cb.integers, (std::vector<int64_t>{1, 0}));
+}
+
+TEST_F(DataLogTest, EntryIdReused) {
+  {
+    wpi::log::IntegerLogEntry a{*log, "a", 1};
+    a.Append(5, 10);
+    a.Append(6, 11);
+    a.Finish(12);
+  }
+  // same name, so same ID, but a different type
+  wpi::log::DoubleLogEntry a{*log, "a", 13};
+  a.Append(1.5, 14);
+
+  auto reader = Finish();
+  std::vector<int64_t> timestamps;
+  for (auto&& record : reader.GetEntryRecords(1)) {
+    timestamps.push_back(record.GetTimestamp());
+  }
+  EXPECT_EQ(timestamps, (std::vector<int64_t>{10, 11, 14}));
+
+  // each use is decoded with its own type
+  auto columns = reader.DecodeColumns(2);
+  ASSERT_EQ(columns.size(), 2u);
+  EXPECT_EQ(columns[0].entry, 1);
+  EXPECT_EQ(columns[0].type, "int64");
+  EXPECT_EQ(columns[0].integers, (std::vector<int64_t>{5, 6}));
+  EXPECT_EQ(columns[1].entry, 1);
+  EXPECT_EQ(columns[1].type, "double");
+  EXPECT_EQ(columns[1].timestamps, (std::vector<int64_t>{14}));
+  EXPECT_EQ(columns[1].doubles, (std::vector<double>{1.5}));
+}
+
+TEST_F(DataLogTest, EntryIndexThreads) {
+  wpi::log::IntegerLogEntry a{*log, "a", 1};
+  for (int i = 0; i < 10000; ++i) {
+    a.Append(i, 10 + i);
+  }
+
+  auto reader = Finish();
+  std::vector<std::thread> threads;
+  std::vector<size_t> sizes(4);
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    threads.emplace_back(
+        [&, i] { sizes[i] = reader.GetEntryRecords(1, 10, 5010).size(); });
+  }
+  for (auto&& thr : threads) {
+    thr.join();
+  }
+  EXPECT_EQ(sizes, (std::vector<size_t>(4, 5000)));
+}
+
+TEST_F(DataLogTest, GetArraySpan) {
+  wpi::log::DoubleArrayLogEntry entry{*log, "a", 1};
+  entry.Append({1.5, 2.5}, 2);
+
+  auto reader = Finish();
+  auto records = reader.GetEntryRecords(1);
+  ASSERT_EQ(records.size(), 1u);
+  auto record = *records.begin();
+  double arr[2];
+  ASSERT_TRUE(record.GetDoubleArray(std::span<double>{arr}));
+  EXPECT_EQ(arr[0], 1.5);
+  EXPECT_EQ(arr[1], 2.5);
+  double wrong[3];
+  EXPECT_FALSE(record.GetDoubleArray(std::span<double>{wrong}));
+}
+
+TEST_F(DataLogTest, AppendBatch) {
+  // enough records to span several buffers
+  std::vector<int64_t> timestamps;
+  std::vector<double> values;
+  for (int i = 0; i < 5000; ++i) {
+    timestamps.emplace_back(i + 2);
+    values.emplace_back(i * 0.5);
+  }
+  wpi::log::DoubleLogEntry a{*log, "a", 1};
+  a.Append(-1, 1);
+  a.AppendBatch(timestamps, values);
+  wpi::log::BooleanLogEntry b{*log, "b", 1};
+  int64_t boolTimestamps[] = {5, 6};
+  bool bools[] = {true, false};
+  b.AppendBatch(boolTimestamps, bools);
+  wpi::log::IntegerLogEntry c{*log, "c", 1};
+  int64_t ints[] = {10, 20, 30};
+  c.AppendBatch(std::span{timestamps}.subspan(0, 2), ints);
+  wpi::log::FloatLogEntry d{*log, "d", 1};
+  float floats[] = {1.5f};
+  d.AppendBatch(timestamps, floats);
+
+  auto reader = Finish();
+  auto records = reader.GetEntryRecords(1);
+  ASSERT_EQ(records.size(), 5001u);
+  int i = -1;
+  for (auto&& record : records) {
+    double value;
+    ASSERT_TRUE(record.GetDouble(&value));
+    if (i < 0) {
+      EXPECT_EQ(value, -1);
+    } else {
+      ASSERT_EQ(value, i * 0.5);
+      ASSERT_EQ(record.GetTimestamp(), i + 2);
+    }
+    ++i;
+  }
+
+  records = reader.GetEntryRecords(2);
+  ASSERT_EQ(records.size(), 2u);
+  bool boolValue;
+  ASSERT_TRUE(records.begin()->GetBoolean(&boolValue));
+  EXPECT_TRUE(boolValue);
+  EXPECT_EQ(records.begin()->GetTimestamp(), 5);
+
+  // extra values are ignored
+  records = reader.GetEntryRecords(3);
+  ASSERT_EQ(records.size(), 2u);
+  int64_t intValue;
+  ASSERT_TRUE((++records.begin())->GetInteger(&intValue));
+  EXPECT_EQ(intValue, 20);
+
+  records = reader.GetEntryRecords(4);
+  ASSERT_EQ(records.size(), 1u);
+  float floatValue;
+  ASSERT_TRUE(records.begin()->GetFloat(&floatValue));
+  EXPECT_EQ(floatValue, 1.5f);
+}
+
+TEST(DataLogRecordTest, ArrayViews) {
+  // offset by 1 so the data is unaligned
+  alignas(8) uint8_t data[1 + 3 * 8] = {0};
+  for (int i = 0; i < 3; ++i) {
+    wpi::support::endian::write64le(&data[1 + i * 8],
+                                    wpi::DoubleToBits(i + 0.5));
+  }
+
+  wpi::log::DataLogRecord unaligned{1, 0, std::span{data}.subspan(1)};
+  wpi::log::DataLogArrayView<double> view;
+  ASSERT_TRUE(unaligned.GetDoubleArray(&view));
+  ASSERT_EQ(view.size(), 3u);
+  EXPECT_EQ(view[1], 1.5);
+  EXPECT_EQ(std::vector<double>(view.begin(), view.end()),
+            (std::vector<double>{0.5, 1.5, 2.5}));
+  EXPECT_EQ(view.end() - view.begin(), 3);
+  std::span<const double> span;
+  EXPECT_FALSE(view.GetSpan(&span));
+
+  std::memmove(data, data + 1, 3 * 8);
+  wpi::log::DataLogRecord aligned{1, 0, std::span{data}.subspan(0, 3 * 8)};
+  ASSERT_TRUE(aligned.GetDoubleArray(&view));
+  if constexpr (std::endian::native == std::endian::little) {
+    ASSERT_TRUE(view.GetSpan(&span));
+    EXPECT_EQ(span.size(), 3u);
+    EXPECT_EQ(span[2], 2.5);
+  }
+
+  wpi::log::DataLogArrayView<float> floatView;
+  EXPECT_TRUE(aligned.GetFloatArray(&floatView));
+  EXPECT_EQ(floatView.size(), 6u);
+  wpi::log::DataLogArrayView<int64_t> intView;
+  wpi::log::DataLogRecord bad{1, 0, std::span{data}.subspan(0, 5)};
+  EXPECT_FALSE(bad.GetIntegerArray(&intView));
+}
+
+TEST(DataLogRecordTest, StringArrayView) {
+  std::vector<uint8_t> data(4 + 4 + 1 + 4 + 2);
+  wpi::support::endian::write32le(&data[0], 2);
+  wpi::support::endian::write32le(&data[4], 1);
+  data[8] = 'a';
+  wpi::support::endian::write32le(&data[9], 2);
+  data[13] = 'b';
+  data[14] = 'c';
+
+  wpi::log::DataLogRecord record{1, 0, data};
+  wpi::log::DataLogStringArrayView view;
+  ASSERT_TRUE(record.GetStringArray(&view));
+  EXPECT_EQ(view.size(), 2u);
+  std::vector<std::string_view> strs(view.begin(), view.end());
+  ASSERT_EQ(strs.size(), 2u);
+  EXPECT_EQ(strs[0], "a");
+  EXPECT_EQ(strs[1], "bc");
+
+  // truncated
+  wpi::log::DataLogRecord bad{1, 0, std::span{data}.subspan(0, 14)};
+  EXPECT_FALSE(bad.GetStringArray(&view));
+}
+
+TEST(DataLogFileTest, Rotation) {
+  int unique;
+  auto dir =
+      fs::temp_directory_path() /
+      fmt::format("datalogrotate_{}", reinterpret_cast<uintptr_t>(&unique));
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+  fs::create_directories(dir);
+  {
+    wpi::log::DataLog log{dir.string(), "rotate.wpilog", 60.0};
+    log.SetRotation(40000, 0, 100000);
+    wpi::log::DoubleLogEntry a{log, "a", "meta1", 1};
+    wpi::log::DoubleLogEntry b{log, "b", 1};
+    b.Finish();
+    for (int i = 0; i < 20000; ++i) {
+      if (i == 10000) {
+        a.SetMetadata("meta2");
+      }
+      a.Append(i, i + 2);
+      if (i % 1000 == 0) {
+        log.Flush();
+      }
+    }
+  }
+
+  // older segments were removed to stay within the size budget
+  std::vector<std::pair<int, fs::path>> segments;
+  uint64_t totalSize = 0;
+  for (auto&& file : fs::directory_iterator{dir}) {
+    auto name = file.path().stem().string();
+    int segment = 0;
+    if (name != "rotate") {
+      ASSERT_TRUE(wpi::starts_with(name, "rotate_"));
+      segment = std::stoi(name.substr(7));
+    }
+    segments.emplace_back(segment, file.path());
+    totalSize += fs::file_size(file.path());
+  }
+  std::sort(segments.begin(), segments.end());
+  ASSERT_GE(segments.size(), 2u);
+  EXPECT_GT(segments.front().first, 0);
+  EXPECT_LE(totalSize, 100000u);
+
+  // each segment is a complete log, and together they hold the newest data
+  int next = -1;
+  for (auto&& [segment, path] : segments) {
+    wpi::log::DataLogReader reader{
+        wpi::MemoryBuffer::GetFile(path.string(), ec)};
+    ASSERT_TRUE(reader.IsValid());
+    auto it = reader.begin();
+    wpi::log::StartRecordData start;
+    ASSERT_TRUE(it->GetStartData(&start));
+    EXPECT_EQ(start.name, "a");
+    EXPECT_EQ(it->GetTimestamp(), 1);
+    std::string_view metadata = start.metadata;
+    int count = 0;
+    for (++it; it != reader.end(); ++it) {
+      wpi::log::MetadataRecordData setMetadata;
+      if (it->GetSetMetadataData(&setMetadata)) {
+        metadata = setMetadata.metadata;
+        continue;
+      }
+      double value;
+      ASSERT_TRUE(it->GetDouble(&value));
+      if (next < 0) {
+        next = value;
+      }
+      ASSERT_EQ(value, next);
+      EXPECT_EQ(metadata, next < 10000 ? "meta1" : "meta2");
+      ++next;
+      ++count;
+    }
+    EXPECT_GT(count, 0);
+    EXPECT_LE(fs::file_size(path), 40000u + 16 * 1024);
+  }
+  EXPECT_EQ(next, 20000);
+  fs::remove_all(dir, ec);
+}
+
+TEST(DataLogFileTest, RotationRename) {
+  int unique;
+  auto dir =
+      fs::temp_directory_path() /
+      fmt::format("datalogrename_{}", reinterpret_cast<uintptr_t>(&unique));
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+  fs::create_directories(dir);
+  {
+    wpi::log::DataLog log{dir.string(), "first.wpilog", 60.0};
+    log.SetRotation(20000);
+    wpi::log::DoubleLogEntry a{log, "a", 1};
+    for (int i = 0; i < 20000; ++i) {
+      if (i == 10000) {
+        // rename once the first name has a closed segment after the first
+        for (int j = 0; j < 500 && !fs::exists(dir / "first_2.wpilog"); ++j) {
+          log.Flush();
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        log.SetFilename("second.wpilog");
+      }
+      a.Append(i, i + 2);
+      if (i % 500 == 0) {
+        log.Flush();
+      }
+    }
+  }
+
+  // segments of each name are numbered from zero, with no gaps
+  std::map<std::string, std::vector<int>> segments;
+  for (auto&& file : fs::directory_iterator{dir}) {
+    auto name = file.path().stem().string();
+    auto pos = name.find('_');
+    segments[name.substr(0, pos)].emplace_back(
+        pos == std::string::npos ? 0 : std::stoi(name.substr(pos + 1)));
+  }
+  ASSERT_EQ(segments.size(), 2u);
+  for (auto&& [name, numbers] : segments) {
+    std::sort(numbers.begin(), numbers.end());
+    ASSERT_GE(numbers.size(), 2u) << name;
+    for (size_t i = 0; i < numbers.size(); ++i) {
+      EXPECT_EQ(numbers[i], static_cast<int>(i)) << name;
+    }
+  }
+  fs::remove_all(dir, ec);
+}
+
+TEST(DataLogFileTest, FlightRecorder) {
+  int unique;
+  auto dir =
+      fs::temp_directory_path() /
+      fmt::format("datalogring_{}", reinterpret_cast<uintptr_t>(&unique));
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+  fs::create_directories(dir);
+  auto ringPath = dir / "ring.wpiring";
+  auto dumpPath = dir / "dump.wpilog";
+  {
+    wpi::log::DataLog log{ringPath.string(), 512 * 1024, 60.0, "extra"};
+    wpi::log::DoubleLogEntry a{log, "a", "meta1", 1};
+    wpi::log::IntegerLogEntry b{log, "b", 1};
+    b.Append(5, 1);
+    b.Finish();
+    wpi::log::IntegerLogEntry c;
+    for (int i = 0; i < 100000; ++i) {
+      if (i == 90000) {
+        c = wpi::log::IntegerLogEntry{log, "c", i + 2};
+        a.SetMetadata("meta2");
+      }
+      a.Append(i, i + 2);
+      if (i % 1000 == 0) {
+        log.Flush();
+      }
+    }
+    c.Append(7, 100002);
+    log.Dump(dumpPath.string());
+  }
+
+  // the dump and the ring itself read the same, with the newest data
+  std::vector<uint8_t> dumped;
+  for (auto&& path : {dumpPath, ringPath}) {
+    auto buf = wpi::MemoryBuffer::GetFile(path.string(), ec);
+    ASSERT_FALSE(ec);
+    if (path == dumpPath) {
+      auto data = buf->GetBuffer();
+      dumped.assign(data.begin(), data.end());
+    }
+    wpi::log::DataLogReader reader{std::move(buf)};
+    ASSERT_TRUE(reader.IsValid());
+    EXPECT_EQ(reader.GetVersion(), 0x0100);
+    EXPECT_EQ(reader.GetExtraHeader(), "extra");
+
+    // start records for the entries with data in the ring come first; b was
+    // finished long ago
+    auto it = reader.begin();
+    wpi::log::StartRecordData start;
+    ASSERT_TRUE(it->GetStartData(&start));
+    int aEntry = start.entry;
+    EXPECT_EQ(start.name, "a");
+    EXPECT_EQ(start.metadata, "meta2");
+    ++it;
+    ASSERT_TRUE(it->GetStartData(&start));
+    EXPECT_EQ(start.name, "c");
+    EXPECT_EQ(it->GetTimestamp(), 90002);
+
+    int first = -1;
+    int next = -1;
+    int setMetadata = 0;
+    bool sawC = false;
+    for (++it; it != reader.end(); ++it) {
+      ASSERT_FALSE(it->IsStart());
+      if (it->IsSetMetadata()) {
+        ++setMetadata;
+        continue;
+      }
+      if (it->IsFinish()) {
+        continue;
+      }
+      if (it->GetEntry() != aEntry) {
+        int64_t value;
+        ASSERT_TRUE(it->GetInteger(&value));
+        EXPECT_EQ(value, 7);
+        sawC = true;
+        continue;
+      }
+      double value;
+      ASSERT_TRUE(it->GetDouble(&value));
+      if (next < 0) {
+        first = next = value;
+      }
+      ASSERT_EQ(value, next);
+      ASSERT_EQ(it->GetTimestamp(), next + 2);
+      ++next;
+    }
+    EXPECT_GT(first, 0);  // older data was overwritten
+    EXPECT_EQ(next, 100000);
+    EXPECT_EQ(setMetadata, 1);
+    EXPECT_TRUE(sawC);
+  }
+
+  // the dump is a plain log, without ring framing
+  EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(dumped.data()), 6),
+            "WPILOG");
+  EXPECT_LT(dumped.size(), 512u * 1024);
+  fs::remove_all(dir, ec);
+}
+
+TEST(DataLogFileTest, FlightRecorderRestart) {
+  int unique;
+  auto dir =
+      fs::temp_directory_path() /
+      fmt::format("datalogrestart_{}", reinterpret_cast<uintptr_t>(&unique));
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+  fs::create_directories(dir);
+  auto ringPath = dir / "ring.wpiring";
+  auto dumpPath = dir / "dump.wpilog";
+  {
+    wpi::log::DataLog log{ringPath.string(), 512 * 1024, 60.0};
+    wpi::log::DoubleLogEntry a{log, "a", 1};
+    // b is finished and restarted in separate flushes, c in the same one
+    wpi::log::IntegerLogEntry b{log, "b", 1};
+    wpi::log::IntegerLogEntry c{log, "c", 1};
+    b.Finish(2);
+    log.Flush();
+    wpi::log::IntegerLogEntry b2{log, "b", 3};
+    c.Finish(2);
+    wpi::log::IntegerLogEntry c2{log, "c", 3};
+    log.Flush();
+    // wrap the ring well past the finish records
+    for (int i = 0; i < 100000; ++i) {
+      a.Append(i, i + 4);
+      if (i % 1000 == 0) {
+        log.Flush();
+      }
+    }
+    b2.Append(5, 100004);
+    c2.Append(6, 100004);
+    log.Dump(dumpPath.string());
+  }
+
+  wpi::log::DataLogReader reader{
+      wpi::MemoryBuffer::GetFile(dumpPath.string(), ec)};
+  ASSERT_TRUE(reader.IsValid());
+  std::map<int, std::string> names;
+  std::vector<std::string> values;
+  for (auto&& record : reader) {
+    wpi::log::StartRecordData start;
+    int64_t value;
+    if (record.GetStartData(&start)) {
+      names[start.entry] = start.name;
+    } else if (!record.IsControl() && record.GetInteger(&value)) {
+      auto it = names.find(record.GetEntry());
+      ASSERT_TRUE(it != names.end()) << "no start record for " << value;
+      if (it->second != "a") {
+        values.emplace_back(fmt::format("{}={}", it->second, value));
+      }
+    }
+  }
+  EXPECT_EQ(values, (std::vector<std::string>{"b=5", "c=6"}));
+  fs::remove_all(dir, ec);
+}
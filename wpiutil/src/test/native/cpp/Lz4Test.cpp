@@ -0,0 +1,96 @@
+// Copyright (c) FIRST and other WPILib contributors.
+// Open Source Software; you can modify and/or share it under the terms of
+// the WPILib BSD license file in the root directory of this project.
+
+#include "wpi/Lz4.h"  // NOLINT(build/include_order)
+
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace wpi {
+
+static std::vector<uint8_t> RoundTrip(std::span<const uint8_t> in,
+                                      size_t* compressedSize = nullptr) {
+  std::vector<uint8_t> compressed(Lz4CompressBound(in.size()));
+  size_t size = Lz4Compress(in, compressed);
+  EXPECT_GT(size, 0u);
+  compressed.resize(size);
+  if (compressedSize) {
+    *compressedSize = size;
+  }
+  std::vector<uint8_t> out(in.size());
+  EXPECT_TRUE(Lz4Decompress(compressed, out));
+  return out;
+}
+
+TEST(Lz4Test, Empty) {
+  std::vector<uint8_t> in;
+  EXPECT_EQ(RoundTrip(in), in);
+}
+
+TEST(Lz4Test, Short) {
+  std::string_view str = "hello hello";
+  std::vector<uint8_t> in{str.begin(), str.end()};
+  EXPECT_EQ(RoundTrip(in), in);
+}
+
+TEST(Lz4Test, Repetitive) {
+  std::vector<uint8_t> in;
+  for (int i = 0; i < 10000; ++i) {
+    in.push_back(i % 7);
+  }
+  size_t size;
+  EXPECT_EQ(RoundTrip(in, &size), in);
+  EXPECT_LT(size, in.size() / 20);
+}
+
+TEST(Lz4Test, Random) {
+  std::mt19937 gen{1};
+  std::vector<uint8_t> in;
+  for (int i = 0; i < 20000; ++i) {
+    in.push_back(gen() & 0xff);
+  }
+  size_t size;
+  EXPECT_EQ(RoundTrip(in, &size), in);
+  EXPECT_LE(size, Lz4CompressBound(in.size()));
+}
+
+TEST(Lz4Test, Large) {
+  // longer than the maximum match offset
+  std::mt19937 gen{2};
+  std::vector<uint8_t> in;
+  for (int i = 0; i < 200000; ++i) {
+    in.push_back((i / 100) % 2 == 0 ? gen() & 0xff : i & 0x0f);
+  }
+  EXPECT_EQ(RoundTrip(in), in);
+}
+
+TEST(Lz4Test, OutputTooSmall) {
+  std::vector<uint8_t> in(1000, 5);
+  std::vector<uint8_t> out(2);
+  EXPECT_EQ(Lz4Compress(in, out), 0u);
+}
+
+TEST(Lz4Test, Corrupt) {
+  std::vector<uint8_t> in(1000, 5);
+  std::vector<uint8_t> compressed(Lz4CompressBound(in.size()));
+  compressed.resize(Lz4Compress(in, compressed));
+  std::vector<uint8_t> out(in.size());
+
+  // wrong output size
+  std::vector<uint8_t> shortOut(in.size() - 1);
+  EXPECT_FALSE(Lz4Decompress(compressed, shortOut));
+
+  // truncated input
+  EXPECT_FALSE(Lz4Decompress(
+      std::span{compressed}.subspan(0, compressed.size() - 1), out));
+
+  // offset before start of output
+  const uint8_t badOffset[] = {0x10, 'a', 0x05, 0x00, 0x00};
+  EXPECT_FALSE(Lz4Decompress(badOffset, out));
+}
+
+}  // namespace wpi
@@ -4,6 +4,8 @@
 
 #include "wpi/UidVector.h"  // NOLINT(build/include_order)
 
+#include <vector>
+
 #include "gtest/gtest.h"
 
 namespace wpi {
@@ -44,4 +46,61 @@ TEST(UidVectorTest, Iterate) {
   EXPECT_EQ(out[1], 1);
 }
 
+TEST(UidVectorTest, ReuseOrder) {
+  UidVector<int, 2> v;
+  for (int i = 1; i <= 6; ++i) {
+    v.emplace_back(i);
+  }
+  v.erase(3);
+  // below threshold, so not reused yet
+  EXPECT_EQ(v.emplace_back(7), 6u);
+  v.erase(1);
+  v.erase(5);
+  // reused in the order freed
+  EXPECT_EQ(v.emplace_back(8), 3u);
+  EXPECT_EQ(v.emplace_back(9), 1u);
+  v.erase(0);
+  EXPECT_EQ(v.emplace_back(10), 5u);
+  EXPECT_EQ(v.emplace_back(11), 7u);
+  EXPECT_EQ(v.size(), 8u);
+}
+
+TEST(UidVectorTest, IterateSparse) {
+  UidVector<int, 1000> v;
+  for (int i = 1; i <= 300; ++i) {
+    v.emplace_back(i);
+  }
+  for (size_t i = 0; i < 300; ++i) {
+    if (i != 0 && i != 63 && i != 64 && i != 200 && i != 299) {
+      v.erase(i);
+    }
+  }
+  std::vector<int> out;
+  for (auto&& val : v) {
+    out.push_back(val);
+  }
+  EXPECT_EQ(out, (std::vector<int>{1, 64, 65, 201, 300}));
+
+  v.erase(299);
+  out.clear();
+  for (auto&& val : v) {
+    out.push_back(val);
+  }
+  EXPECT_EQ(out, (std::vector<int>{1, 64, 65, 201}));
+}
+
+TEST(UidVectorTest, IterateAssigned) {
+  UidVector<int, 4> v;
+  size_t uid = v.emplace_back(0);
+  v.emplace_back(1);
+  v[uid] = 2;
+  std::vector<int> out;
+  for (auto&& val : v) {
+    out.push_back(val);
+  }
+  ASSERT_EQ(out.size(), 2u);
+  EXPECT_EQ(out[0], 2);
+  EXPECT_EQ(out[1], 1);
+}
+
 }  // namespace wpi
@@ -106,6 +106,95 @@ TEST(JsonDeserializationTest, UnsuccessfulUserStringLiteral)
                      "[json.exception.parse_error.101] parse error at 29: syntax error - unexpected end of input; expected ']'");
 }
 
+namespace {
+// records events as a compact string
+class SaxEventLogger : public json::json_sax
+{
+  public:
+    bool null() override
+    {
+        events += "null;";
+        return true;
+    }
+    bool boolean(bool val) override
+    {
+        events += val ? "true;" : "false;";
+        return true;
+    }
+    bool number_integer(int64_t val) override
+    {
+        events += "int(" + std::to_string(val) + ");";
+        return true;
+    }
+    bool number_unsigned(uint64_t val) override
+    {
+        events += "uint(" + std::to_string(val) + ");";
+        return true;
+    }
+    bool number_float(double val) override
+    {
+        events += "float;";
+        return true;
+    }
+    bool string(std::string_view val) override
+    {
+        events += "string(" + std::string(val) + ");";
+        return true;
+    }
+    bool start_object() override
+    {
+        events += "{";
+        return true;
+    }
+    bool key(std::string_view val) override
+    {
+        events += "key(" + std::string(val) + ");";
+        return stop_key.empty() or val != stop_key;
+    }
+    bool end_object() override
+    {
+        events += "}";
+        return true;
+    }
+    bool start_array() override
+    {
+        events += "[";
+        return true;
+    }
+    bool end_array() override
+    {
+        events += "]";
+        return true;
+    }
+
+    std::string events;
+    std::string stop_key;
+};
+}  // namespace
+
+TEST(JsonDeserializationTest, SaxSuccessful)
+{
+    SaxEventLogger sax;
+    ASSERT_TRUE(json::sax_parse("[\"foo\",1,-2,3.5,false,null,{\"one\":1}]", &sax));
+    ASSERT_EQ(sax.events, "[string(foo);uint(1);int(-2);float;false;null;{key(one);uint(1);}]");
+}
+
+TEST(JsonDeserializationTest, SaxStopped)
+{
+    SaxEventLogger sax;
+    sax.stop_key = "two";
+    ASSERT_FALSE(json::sax_parse("{\"one\":1,\"two\":2,\"three\":3}", &sax));
+    ASSERT_EQ(sax.events, "{key(one);uint(1);key(two);");
+}
+
+TEST(JsonDeserializationTest, SaxUnsuccessful)
+{
+    SaxEventLogger sax;
+    ASSERT_THROW_MSG(json::sax_parse("[\"foo\",1,2,3,false,{\"one\":1}", &sax), json::parse_error,
+                     "[json.exception.parse_error.101] parse error at 29: syntax error - unexpected end of input; expected ']'");
+    ASSERT_EQ(sax.events, "[string(foo);uint(1);uint(2);uint(3);false;{key(one);uint(1);}");
+}
+
 // these cases are required for 100% line coverage
 class JsonDeserializationErrorTest
     : public ::testing::TestWithParam<const char*> {};
@@ -113,6 +202,8 @@ class JsonDeserializationErrorTest
 TEST_P(JsonDeserializationErrorTest, ErrorCase)
 {
     ASSERT_THROW(json::parse(GetParam()), json::parse_error);
+    SaxEventLogger sax;
+    ASSERT_THROW(json::sax_parse(GetParam(), &sax), json::parse_error);
 }
 
 static const char* error_cases[] = {